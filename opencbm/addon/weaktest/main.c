@@ -40,6 +40,7 @@ static d64copy_severity_e verbosity = sev_warning;
 
 /* other globals */
 static CBM_FILE fd_cbm;
+static d64copy_context copy_ctx;
 
 
 static int is_cbm(char *name)
@@ -243,8 +244,8 @@ static int testLastDirectorySectorWithWeakBits(
     send_turbo(fd_cbm, cbm_drive, 1, 1, setup.drive_type == cbm_dt_cbm1541 ? 0 : 1);
 
     SETSTATEDEBUG((void)0);
-    if(target->open_disk(fd_cbm, &setup, (void*)(ULONG_PTR)cbm_drive, 1,
-                      turbo_routine_starter, my_message_cb) == 0)
+    if(target->open_disk(&copy_ctx, fd_cbm, &setup, (void*)(ULONG_PTR)cbm_drive, 1,
+                                   turbo_routine_starter, my_message_cb) == 0)
     {
         for(i=0; i<GCRBUFSIZE; i++)
         {
@@ -257,8 +258,8 @@ static int testLastDirectorySectorWithWeakBits(
         printGcrBuffer(gcr, 0);
 
         SETSTATEDEBUG((void)0);
-        st = target->write_block(track, se, gcr, GCRBUFSIZE-1, 0);
-        target->close_disk();
+        st = target->write_block(&copy_ctx, track, se, gcr, GCRBUFSIZE-1, 0);
+        target->close_disk(&copy_ctx);
 
         if(st)
         {
@@ -272,18 +273,18 @@ static int testLastDirectorySectorWithWeakBits(
         send_turbo(fd_cbm, cbm_drive, 0, 1, setup.drive_type == cbm_dt_cbm1541 ? 0 : 1);
 
         SETSTATEDEBUG((void)0);
-        if(target->open_disk(fd_cbm, &setup, (void*)(ULONG_PTR)cbm_drive, 0,
-                          turbo_routine_starter, my_message_cb) == 0)
+        if(target->open_disk(&copy_ctx, fd_cbm, &setup, (void*)(ULONG_PTR)cbm_drive, 0,
+                                       turbo_routine_starter, my_message_cb) == 0)
         {
             // set up the map with sectors to copy
             memset(trackmap, bs_dont_copy, sizeof(trackmap));
             trackmap[se] = bs_must_copy;
             SETSTATEDEBUG((void)0);
-            target->send_track_map(track, trackmap, 1);
+            target->send_track_map(&copy_ctx, track, trackmap, 1);
 
             SETSTATEDEBUG((void)0);
-            st = target->read_gcr_block(&se, gcr);
-            target->close_disk();
+            st = target->read_gcr_block(&copy_ctx, &se, gcr);
+            target->close_disk(&copy_ctx);
 
             if(st)
             {
@@ -0,0 +1,68 @@
+/*
+ *      This program is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU General Public License
+ *      as published by the Free Software Foundation; either version
+ *      2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 The OpenCBM project
+ *
+*/
+
+/*! ************************************************************** 
+** \file arch/linux/spawn.c \n
+** \author The OpenCBM project \n
+** \n
+** \brief Run an external program and wait for it
+**
+****************************************************************/
+
+#include "arch.h"
+
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*! \brief Run a program and wait until it terminates
+
+ No shell is involved, thus, the arguments are passed to the
+ program exactly as given.
+
+ The program is started in a process group of its own, so that a
+ Ctrl-C on the terminal only reaches the caller, which can decide
+ itself what to do with a program that is still running.
+
+ \param Argv
+   The program (searched in the PATH) in Argv[0], followed by its
+   arguments; terminated by a NULL pointer.
+
+ \return
+   The exit code of the program, or -1 if it could not be started
+   or did not terminate normally.
+*/
+int
+arch_spawn(const char * const Argv[])
+{
+    pid_t pid;
+    int status;
+
+    pid = fork();
+
+    if (pid < 0)
+        return -1;
+
+    if (pid == 0)
+    {
+        setpgid(0, 0);
+        execvp(Argv[0], (char * const *) Argv);
+        _exit(127);
+    }
+
+    while (waitpid(pid, &status, 0) < 0)
+    {
+        if (errno != EINTR)
+            return -1;
+    }
+
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
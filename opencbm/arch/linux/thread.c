@@ -0,0 +1,171 @@
+/*
+ *      This program is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU General Public License
+ *      as published by the Free Software Foundation; either version
+ *      2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 The OpenCBM project
+ *
+*/
+
+/*! ************************************************************** 
+** \file arch/linux/thread.c \n
+** \author The OpenCBM project \n
+** \n
+** \brief Minimal threads and semaphores on top of pthreads
+**
+****************************************************************/
+
+#include "arch.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+/*! a counting semaphore
+
+ Unnamed POSIX semaphores are not available on all platforms we
+ support (MacOS X), thus, build one from a mutex and a condition.
+*/
+struct arch_semaphore_s
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+    unsigned int    count;
+};
+
+/*! a thread */
+struct arch_thread_s
+{
+    pthread_t        thread;
+    ARCH_THREAD_FUNC func;
+    void            *context;
+};
+
+/*! \brief Create a counting semaphore
+
+ \param InitialCount
+   The initial value of the semaphore.
+
+ \return
+   The semaphore, or NULL if it could not be created.
+*/
+ARCH_SEMAPHORE
+arch_semaphore_create(unsigned int InitialCount)
+{
+    ARCH_SEMAPHORE sem = malloc(sizeof(*sem));
+
+    if (sem)
+    {
+        if (pthread_mutex_init(&sem->mutex, NULL) != 0)
+        {
+            free(sem);
+            return NULL;
+        }
+        if (pthread_cond_init(&sem->cond, NULL) != 0)
+        {
+            pthread_mutex_destroy(&sem->mutex);
+            free(sem);
+            return NULL;
+        }
+        sem->count = InitialCount;
+    }
+    return sem;
+}
+
+/*! \brief Decrement a semaphore, waiting until it is not 0
+
+ \param Semaphore
+   The semaphore, as returned by arch_semaphore_create().
+*/
+void
+arch_semaphore_wait(ARCH_SEMAPHORE Semaphore)
+{
+    pthread_mutex_lock(&Semaphore->mutex);
+    while (Semaphore->count == 0)
+    {
+        pthread_cond_wait(&Semaphore->cond, &Semaphore->mutex);
+    }
+    Semaphore->count--;
+    pthread_mutex_unlock(&Semaphore->mutex);
+}
+
+/*! \brief Increment a semaphore
+
+ \param Semaphore
+   The semaphore, as returned by arch_semaphore_create().
+*/
+void
+arch_semaphore_post(ARCH_SEMAPHORE Semaphore)
+{
+    pthread_mutex_lock(&Semaphore->mutex);
+    Semaphore->count++;
+    pthread_cond_signal(&Semaphore->cond);
+    pthread_mutex_unlock(&Semaphore->mutex);
+}
+
+/*! \brief Free a semaphore
+
+ \param Semaphore
+   The semaphore, as returned by arch_semaphore_create().
+   Nobody may be waiting on it anymore.
+*/
+void
+arch_semaphore_destroy(ARCH_SEMAPHORE Semaphore)
+{
+    pthread_cond_destroy(&Semaphore->cond);
+    pthread_mutex_destroy(&Semaphore->mutex);
+    free(Semaphore);
+}
+
+static void *
+thread_start(void *Arg)
+{
+    ARCH_THREAD thread = Arg;
+
+    thread->func(thread->context);
+    return NULL;
+}
+
+/*! \brief Start a new thread
+
+ \param Func
+   The function the thread executes. The thread ends when
+   this function returns.
+
+ \param Context
+   Given to Func as its only parameter.
+
+ \return
+   The thread, or NULL if it could not be started. A thread must
+   be waited for with arch_thread_join().
+*/
+ARCH_THREAD
+arch_thread_create(ARCH_THREAD_FUNC Func, void *Context)
+{
+    ARCH_THREAD thread = malloc(sizeof(*thread));
+
+    if (thread)
+    {
+        thread->func = Func;
+        thread->context = Context;
+
+        if (pthread_create(&thread->thread, NULL, thread_start, thread) != 0)
+        {
+            free(thread);
+            thread = NULL;
+        }
+    }
+    return thread;
+}
+
+/*! \brief Wait for a thread to end, and free it
+
+ \param Thread
+   The thread, as returned by arch_thread_create().
+*/
+void
+arch_thread_join(ARCH_THREAD Thread)
+{
+    pthread_join(Thread->thread, NULL);
+    free(Thread);
+}
@@ -115,6 +115,18 @@ SOURCE=..\getopt1.c
 
 SOURCE=..\getopt_init.c
 # End Source File
+# Begin Source File
+
+SOURCE=..\spawn.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\thread.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\time.c
+# End Source File
 # End Group
 # Begin Group "Header Files"
 
@@ -15,8 +15,18 @@
 
 #include "arch.h"
 
+#include <io.h>
+#include <stdlib.h>
 #include <sys/stat.h>
 
+/*! a part of a file mapped into memory */
+struct arch_mapping_s
+{
+    HANDLE handle;
+    void  *address;
+    size_t size;
+};
+
 
 /*! \brief Obtain the size of a given file
 
@@ -50,3 +60,85 @@ int arch_filesize(const char *Filename, off_t *Filesize)
 
     return ret;
 }
+
+/*! \brief Map the beginning of a file into memory
+
+ \param Fd
+   The file descriptor of the file. The file must be at least
+   Size bytes long, and it must not shrink while it is mapped.
+
+ \param Size
+   The number of bytes to map, starting at the beginning of the
+   file. Must not be 0.
+
+ \param Writable
+   If not 0, the mapping can be written to, and the changes
+   go to the file (after arch_msync() or arch_munmap()).
+
+ \param Address
+   Pointer to a location which will be set to the start of the
+   mapped memory on successfull termination.
+
+ \return
+   The mapping, or NULL if an error occurred.
+*/
+
+ARCH_MAPPING arch_mmap(int Fd, size_t Size, int Writable, void **Address)
+{
+    ARCH_MAPPING mapping = malloc(sizeof(*mapping));
+
+    if (mapping)
+    {
+        mapping->size = Size;
+        mapping->handle = CreateFileMapping((HANDLE) _get_osfhandle(Fd), NULL,
+                                            Writable ? PAGE_READWRITE : PAGE_READONLY,
+                                            0, (DWORD) Size, NULL);
+        if (mapping->handle == NULL)
+        {
+            free(mapping);
+            return NULL;
+        }
+
+        mapping->address = MapViewOfFile(mapping->handle,
+                                         Writable ? FILE_MAP_WRITE : FILE_MAP_READ,
+                                         0, 0, Size);
+        if (mapping->address == NULL)
+        {
+            CloseHandle(mapping->handle);
+            free(mapping);
+            return NULL;
+        }
+        *Address = mapping->address;
+    }
+    return mapping;
+}
+
+/*! \brief Write the changes to a mapping back into the file
+
+ \param Mapping
+   The mapping, as returned by arch_mmap().
+
+ \return
+   0 on success, everything else denotes an error.
+*/
+
+int arch_msync(ARCH_MAPPING Mapping)
+{
+    return FlushViewOfFile(Mapping->address, Mapping->size) ? 0 : -1;
+}
+
+/*! \brief Remove a mapping
+
+ Changes are written back into the file, but not necessarily
+ before this function returns; use arch_msync() for that.
+
+ \param Mapping
+   The mapping, as returned by arch_mmap().
+*/
+
+void arch_munmap(ARCH_MAPPING Mapping)
+{
+    UnmapViewOfFile(Mapping->address);
+    CloseHandle(Mapping->handle);
+    free(Mapping);
+}
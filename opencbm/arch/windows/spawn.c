@@ -0,0 +1,87 @@
+/*
+ *      This program is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU General Public License
+ *      as published by the Free Software Foundation; either version
+ *      2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 The OpenCBM project
+ *
+*/
+
+/*! ************************************************************** 
+** \file arch/windows/spawn.c \n
+** \author The OpenCBM project \n
+** \n
+** \brief Run an external program and wait for it
+**
+****************************************************************/
+
+#include "arch.h"
+
+#include <process.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*! \brief Run a program and wait until it terminates
+
+ No command interpreter is involved. As _spawnvp() joins the
+ arguments into one command line, arguments which contain blanks
+ are quoted.
+
+ \param Argv
+   The program (searched in the PATH) in Argv[0], followed by its
+   arguments; terminated by a NULL pointer.
+
+ \return
+   The exit code of the program, or -1 if it could not be started.
+*/
+int
+arch_spawn(const char * const Argv[])
+{
+    const char **quoted;
+    int count;
+    int i;
+    int rv;
+
+    for (count = 0; Argv[count] != NULL; count++)
+        ;
+
+    quoted = calloc(count + 1, sizeof(*quoted));
+    if (quoted == NULL)
+        return -1;
+
+    rv = 0;
+    for (i = 0; i < count; i++)
+    {
+        if (strpbrk(Argv[i], " \t") != NULL)
+        {
+            char *q = malloc(strlen(Argv[i]) + 3);
+
+            if (q == NULL)
+            {
+                rv = -1;
+                break;
+            }
+            strcpy(q, "\"");
+            strcat(q, Argv[i]);
+            strcat(q, "\"");
+            quoted[i] = q;
+        }
+        else
+        {
+            quoted[i] = Argv[i];
+        }
+    }
+
+    if (rv == 0)
+        rv = (int) _spawnvp(_P_WAIT, Argv[0], quoted);
+
+    for (i = 0; i < count; i++)
+    {
+        if (quoted[i] != NULL && quoted[i] != Argv[i])
+            free((void *) quoted[i]);
+    }
+    free((void *) quoted);
+
+    return rv;
+}
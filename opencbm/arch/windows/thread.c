@@ -0,0 +1,153 @@
+/*
+ *      This program is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU General Public License
+ *      as published by the Free Software Foundation; either version
+ *      2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 The OpenCBM project
+ *
+*/
+
+/*! ************************************************************** 
+** \file arch/windows/thread.c \n
+** \author The OpenCBM project \n
+** \n
+** \brief Minimal threads and semaphores on top of the Win32 API
+**
+****************************************************************/
+
+#include <windows.h>
+
+#include "arch.h"
+
+#include <stdlib.h>
+
+/*! a counting semaphore */
+struct arch_semaphore_s
+{
+    HANDLE handle;
+};
+
+/*! a thread */
+struct arch_thread_s
+{
+    HANDLE           handle;
+    ARCH_THREAD_FUNC func;
+    void            *context;
+};
+
+/*! \brief Create a counting semaphore
+
+ \param InitialCount
+   The initial value of the semaphore.
+
+ \return
+   The semaphore, or NULL if it could not be created.
+*/
+ARCH_SEMAPHORE
+arch_semaphore_create(unsigned int InitialCount)
+{
+    ARCH_SEMAPHORE sem = malloc(sizeof(*sem));
+
+    if (sem)
+    {
+        sem->handle = CreateSemaphore(NULL, InitialCount, 0x7fffffff, NULL);
+        if (sem->handle == NULL)
+        {
+            free(sem);
+            sem = NULL;
+        }
+    }
+    return sem;
+}
+
+/*! \brief Decrement a semaphore, waiting until it is not 0
+
+ \param Semaphore
+   The semaphore, as returned by arch_semaphore_create().
+*/
+void
+arch_semaphore_wait(ARCH_SEMAPHORE Semaphore)
+{
+    WaitForSingleObject(Semaphore->handle, INFINITE);
+}
+
+/*! \brief Increment a semaphore
+
+ \param Semaphore
+   The semaphore, as returned by arch_semaphore_create().
+*/
+void
+arch_semaphore_post(ARCH_SEMAPHORE Semaphore)
+{
+    ReleaseSemaphore(Semaphore->handle, 1, NULL);
+}
+
+/*! \brief Free a semaphore
+
+ \param Semaphore
+   The semaphore, as returned by arch_semaphore_create().
+   Nobody may be waiting on it anymore.
+*/
+void
+arch_semaphore_destroy(ARCH_SEMAPHORE Semaphore)
+{
+    CloseHandle(Semaphore->handle);
+    free(Semaphore);
+}
+
+static DWORD WINAPI
+thread_start(LPVOID Arg)
+{
+    ARCH_THREAD thread = Arg;
+
+    thread->func(thread->context);
+    return 0;
+}
+
+/*! \brief Start a new thread
+
+ \param Func
+   The function the thread executes. The thread ends when
+   this function returns.
+
+ \param Context
+   Given to Func as its only parameter.
+
+ \return
+   The thread, or NULL if it could not be started. A thread must
+   be waited for with arch_thread_join().
+*/
+ARCH_THREAD
+arch_thread_create(ARCH_THREAD_FUNC Func, void *Context)
+{
+    ARCH_THREAD thread = malloc(sizeof(*thread));
+    DWORD threadId;
+
+    if (thread)
+    {
+        thread->func = Func;
+        thread->context = Context;
+
+        thread->handle = CreateThread(NULL, 0, thread_start, thread, 0, &threadId);
+        if (thread->handle == NULL)
+        {
+            free(thread);
+            thread = NULL;
+        }
+    }
+    return thread;
+}
+
+/*! \brief Wait for a thread to end, and free it
+
+ \param Thread
+   The thread, as returned by arch_thread_create().
+*/
+void
+arch_thread_join(ARCH_THREAD Thread)
+{
+    WaitForSingleObject(Thread->handle, INFINITE);
+    CloseHandle(Thread->handle);
+    free(Thread);
+}
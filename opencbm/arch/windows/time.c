@@ -0,0 +1,35 @@
+/*
+ *      This program is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU General Public License
+ *      as published by the Free Software Foundation; either version
+ *      2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 The OpenCBM project
+ *
+*/
+
+/*! ************************************************************** 
+** \file arch/windows/time.c \n
+** \author The OpenCBM project \n
+** \n
+** \brief Millisecond time stamps
+**
+****************************************************************/
+
+#include <windows.h>
+
+#include "arch.h"
+
+/*! \brief Get a millisecond time stamp
+
+ The value has no defined origin; only differences between two
+ calls are meaningful. It wraps around silently.
+
+ \return
+   The current time stamp, in ms.
+*/
+unsigned long
+arch_time_ms(void)
+{
+    return GetTickCount();
+}
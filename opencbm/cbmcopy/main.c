@@ -79,6 +79,172 @@ static int my_status_cb(int blocks_written)
     return 0;
 }
 
+/* writes the file data to disk while it is read, see my_read_sink() */
+typedef struct
+{
+    FILE *file;
+    char *fs_name;
+    int address;
+    size_t written;
+    char type;      /* wildcard reads: only files of this type, if set */
+    int files;      /* wildcard reads: number of files read */
+    const char *output_name; /* wildcard reads: --output, if given */
+} read_sink;
+
+static int my_read_sink(void *context, const unsigned char *data, size_t size)
+{
+    read_sink *sink = context;
+    unsigned char override[2];
+    size_t skip = 0;
+    int rv = 0;
+
+    if(sink->written == 0 && sink->address >= 0 && size > 1)
+    {
+        override[0] = sink->address % 0x100;
+        override[1] = sink->address / 0x100;
+
+        my_message_cb( sev_debug,
+                       "override address: $%02x%02x",
+                       override[1], override[0] );
+
+        rv = cbmcopy_file_sink(sink->file, override, 2);
+        skip = 2;
+    }
+
+    if(rv == 0 && size > skip)
+    {
+        rv = cbmcopy_file_sink(sink->file, data + skip, size - skip);
+    }
+
+    if(rv)
+    {
+        my_message_cb(sev_warning,
+                      "could not write %s: %s",
+                      sink->fs_name, arch_strerror(arch_get_errno()));
+        return -1;
+    }
+
+    sink->written += size;
+    return 0;
+}
+
+
+/* the file name extension for the type of a directory entry */
+static const char *my_type_ext(const cbmcopy_dir_entry *entry)
+{
+    static const char *exts[] = { "del", "seq", "prg", "usr", "rel" };
+
+    if((entry->type & 0x07) >= sizeof(exts) / sizeof(exts[0]))
+    {
+        return "prg";
+    }
+    return exts[entry->type & 0x07];
+}
+
+/* counts the files of a wildcard read, honouring the type filter */
+static int my_count_matches(cbmcopy_session *session, const char *pattern,
+                            const read_sink *sink)
+{
+    const cbmcopy_dir_entry *entries;
+    int num_entries;
+    int matches;
+    int i;
+
+    if(cbmcopy_session_read_dir(session, &entries, &num_entries) != 0)
+    {
+        return -1;
+    }
+
+    matches = 0;
+    for(i = 0; i < num_entries; i++)
+    {
+        if(cbmcopy_match_name(pattern, entries[i].name)
+           && (!sink->type || sink->type == my_type_ext(&entries[i])[0]))
+        {
+            matches++;
+        }
+    }
+    return matches;
+}
+
+/* opens the output file for the next file of a wildcard read */
+static int my_read_begin(void *context, const cbmcopy_dir_entry *entry)
+{
+    read_sink *sink = context;
+    const char *ext;
+    char name[17];
+    char *tail;
+
+    ext = my_type_ext(entry);
+    if(sink->type && sink->type != ext[0])
+    {
+        return 1;
+    }
+
+    strcpy(name, entry->name);
+    cbm_petscii2ascii(name);
+
+    if(sink->output_name)
+    {
+        sink->fs_name = arch_strdup(sink->output_name);
+    }
+    else
+    {
+        sink->fs_name = malloc(strlen(name) + strlen(ext) + 2);
+    }
+    if(sink->fs_name == NULL)
+    {
+        my_message_cb(sev_fatal, "Out of memory");
+        return -1;
+    }
+    if(sink->output_name == NULL)
+    {
+        sprintf(sink->fs_name, "%s.%s", name, ext);
+        for(tail = sink->fs_name; *tail; tail++)
+        {
+            if(*tail == '/') *tail = '_';
+        }
+    }
+
+    my_message_cb( sev_info, "reading %s -> %s", name, sink->fs_name );
+
+    sink->file = fopen(sink->fs_name, "wb");
+    if(sink->file == NULL)
+    {
+        my_message_cb(sev_warning,
+                      "could not open %s: %s",
+                      sink->fs_name, arch_strerror(arch_get_errno()));
+        free(sink->fs_name);
+        sink->fs_name = NULL;
+        return 1;
+    }
+    sink->written = 0;
+    sink->files++;
+    return 0;
+}
+
+static void my_read_end(void *context, const cbmcopy_dir_entry *entry, int rv)
+{
+    read_sink *sink = context;
+
+    if(rv == 0)
+    {
+        if(fclose(sink->file) != 0)
+        {
+            my_message_cb(sev_warning,
+                          "could not write %s: %s",
+                          sink->fs_name, arch_strerror(arch_get_errno()));
+        }
+    }
+    else
+    {
+        my_message_cb(sev_warning, "error reading %s", sink->fs_name);
+        fclose(sink->file);
+        arch_unlink(sink->fs_name);
+    }
+    free(sink->fs_name);
+    sink->fs_name = NULL;
+}
 
 static void help(const char *prog)
 {
@@ -92,6 +258,8 @@ static void help(const char *prog)
 "  -w, --write                transfer PC->15x1\n"
 "                             (default when started as 'cbmwrite')\n"
 "                             -r and -w are mutually exclusive\n"
+"                             when reading, FILE may contain the wildcards\n"
+"                             * and ?; all matching files are read\n"
 "\n"
 "  -h, --help                 display this help and exit\n"
 "  -V, --version              display version information and exit\n"
@@ -117,6 +285,12 @@ static void help(const char *prog)
 "                               1541, 1570, 1571, 1581\n"
 "  -a, --address=ADDRESS      override file start address\n"
 "  -o, --output=NAME          specifies target name (ASCII, even for writing).\n"
+"  -i, --interleave=VALUE     interleave of the written files (1541 only);\n"
+"                             the default depends on the transfer mode\n"
+"  -D, --block-delay=USEC     wait USEC microseconds after the handshake of\n"
+"                             each block when reading (default: 1000, or\n"
+"                             block-delay in section [cbmcopy] of the\n"
+"                             configuration file)\n"
 "\n"
 "Options for writing:\n"
 "  -f, --file-type            specify CBM file type (D,P,S,U)\n"
@@ -180,6 +354,8 @@ int ARCH_MAINDECL main(int argc, char **argv)
     int option;
     unsigned char *filedata;
     size_t filesize;
+    read_sink sink;
+    cbmcopy_session *session = NULL;
     char buf[48];
     int num_entries;
     int num_files;
@@ -229,10 +405,12 @@ int ARCH_MAINDECL main(int argc, char **argv)
         { "output"          , required_argument, NULL, 'o' },
         { "raw"             , no_argument      , NULL, 'R' },
         { "address"         , no_argument      , NULL, 'a' },
+        { "block-delay"     , required_argument, NULL, 'D' },
+        { "interleave"      , required_argument, NULL, 'i' },
         { NULL              , 0                , NULL, 0   }
     };
 
-    const char shortopts[] ="hVqvrwnt:d:f:o:Ra:@:";
+    const char shortopts[] ="hVqvrwnt:d:f:o:Ra:D:i:@:";
 
     if(NULL == (tail = strrchr(argv[0], '/')))
     {
@@ -257,6 +435,16 @@ int ARCH_MAINDECL main(int argc, char **argv)
 
     settings = cbmcopy_get_default_settings();
 
+    /* a block delay which suits this environment may be in the configuration */
+    if(cbm_get_config_value("cbmcopy", "block-delay", buf, sizeof(buf)) == 0)
+    {
+        i = (int) strtol(buf, &tail, 10);
+        if(tail != buf && i >= 0)
+        {
+            settings->block_delay = i;
+        }
+    }
+
     /* loop over cmd line opts */
     while((option = getopt_long(argc, argv, shortopts, longopts, NULL)) != -1)
     {
@@ -309,6 +497,24 @@ int ARCH_MAINDECL main(int argc, char **argv)
             case 'a': /* override-address */
                 char_star_opt_once(&address_str, "--address", argv);
                 break;
+            case 'D': /* --block-delay */
+                settings->block_delay = (int) strtol(optarg, &tail, 10);
+                if(*tail || settings->block_delay < 0)
+                {
+                    my_message_cb(sev_fatal, "invalid block delay: %s", optarg);
+                    hint(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'i': /* --interleave */
+                settings->interleave = (int) strtol(optarg, &tail, 10);
+                if(*tail || settings->interleave < 1 || settings->interleave > 20)
+                {
+                    my_message_cb(sev_fatal, "invalid interleave: %s", optarg);
+                    hint(argv[0]);
+                    return 1;
+                }
+                break;
             case '@': /* choose adapter */
                 if (adapter == NULL)
                     adapter = cbmlibmisc_strdup(optarg);
@@ -550,6 +756,58 @@ int ARCH_MAINDECL main(int argc, char **argv)
                                    fname, arch_strerror(arch_get_errno()) );
                 }
             }
+            else if(strpbrk(fname, "*?"))
+            {
+                /* wildcards: read all matching files in one session */
+                sink.address = address;
+                sink.type = '\0';
+                sink.files = 0;
+                sink.output_name = output_name;
+
+                tail = strrchr(fname, ',');
+                if(tail)
+                {
+                    *tail++ = '\0';
+                    sink.type = (char) tolower(*tail);
+                }
+
+                strncpy(buf, fname, 16);
+                buf[16] = '\0';
+                cbm_ascii2petscii(buf);
+
+                if(session == NULL)
+                {
+                    session = cbmcopy_session_open(fd, settings, drive, my_message_cb);
+                }
+
+                if(session != NULL && output_name)
+                {
+                    /* --output names exactly one file */
+                    i = my_count_matches(session, buf, &sink);
+                    if(i > 1)
+                    {
+                        my_message_cb(sev_fatal,
+                                      "--output requires exactly one file, but %d match %s",
+                                      i, fname);
+                        rv = 1;
+                        continue;
+                    }
+                }
+
+                if(session == NULL
+                   || cbmcopy_session_read_files(session, buf,
+                                                 my_read_begin, my_read_end,
+                                                 my_read_sink, &sink,
+                                                 my_status_cb) != 0)
+                {
+                    rv = 1;
+                }
+                else if(sink.files == 0)
+                {
+                    my_message_cb(sev_warning, "no files match %s", fname);
+                    rv = 1;
+                }
+            }
             else
             {
                 strncpy(buf, fname, 16);
@@ -597,51 +855,36 @@ int ARCH_MAINDECL main(int argc, char **argv)
 
                 my_message_cb( sev_info, "reading %s -> %s", buf, fs_name );
 
-                if(cbmcopy_read_file(fd, settings, drive, buf, strlen(buf),
-                                     &filedata, &filesize,
-                                     my_message_cb, my_status_cb) == 0)
+                sink.file = fopen(fs_name, "wb");
+                sink.fs_name = fs_name;
+                sink.address = address;
+                sink.written = 0;
+
+                if(sink.file == NULL)
+                {
+                    my_message_cb(sev_warning,
+                                  "could not open %s: %s",
+                                  fs_name, arch_strerror(arch_get_errno()));
+                }
+                else if(cbmcopy_read_file_stream(fd, settings, drive, buf, strlen(buf),
+                                                 my_read_sink, &sink,
+                                                 my_message_cb, my_status_cb) == 0)
                 {
                     rv = cbm_device_status( fd, drive, buf, sizeof(buf) );
                     my_message_cb( rv ? sev_warning : sev_info, "%s", buf );
 
-                    file = fopen(fs_name, "wb");
-                    if(file)
-                    {
-                        if(filedata)
-                        {
-                            if(address >= 0 && filesize > 1)
-                            {
-                                filedata[0] = address % 0x100;
-                                filedata[1] = address / 0x100;
-
-                                my_message_cb( sev_debug, 
-                                               "override address: $%02x%02x",
-                                               filedata[1], filedata[0] );
-                            }
-                            if(fwrite(filedata, filesize, 1, file) != 1)
-                            {
-                                my_message_cb(sev_warning,
-                                              "could not write %s: %s",
-                                              fs_name, arch_strerror(arch_get_errno()));
-                            }
-                        }
-                        fclose(file);
-                    }
-                    else
+                    if(fclose(sink.file) != 0)
                     {
                         my_message_cb(sev_warning,
-                                      "could not open %s: %s",
+                                      "could not write %s: %s",
                                       fs_name, arch_strerror(arch_get_errno()));
                     }
-
-                    if(filedata)
-                    {
-                        free(filedata);
-                    }
                 }
                 else
                 {
                     my_message_cb(sev_warning, "error reading %s", buf);
+                    fclose(sink.file);
+                    arch_unlink(fs_name);
                 }
                 if(fs_name)
                 {
@@ -649,6 +892,7 @@ int ARCH_MAINDECL main(int argc, char **argv)
                 }
             }
         }
+        cbmcopy_session_close( session );
         cbm_driver_close( fd );
 
         if(rv)
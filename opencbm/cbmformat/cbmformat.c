@@ -162,7 +162,7 @@ int ARCH_MAINDECL main(int argc, char *argv[])
 
     if(cbm_driver_open_ex(&fd, adapter) == 0)
     {
-        cbm_upload(fd, drive, 0x0500, dskfrmt, sizeof(dskfrmt));
+        cbm_upload_fast(fd, drive, 0x0500, dskfrmt, sizeof(dskfrmt));
         sprintf(cmd, "M-E%c%c%c%c%c%c%c%c0:%s", 3, 5, tracks + 1, 
             orig, bump, show_progress, demagnetize, verify, name);
         cbm_exec_command(fd, drive, cmd, 13+strlen(name));
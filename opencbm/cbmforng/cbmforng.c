@@ -245,7 +245,7 @@ int ARCH_MAINDECL main(int argc, char *argv[])
 
     if(cbm_driver_open_ex(&fd, adapter) == 0)
     {
-        cbm_upload(fd, drive, 0x0300, dskfrmt, sizeof(dskfrmt));
+        cbm_upload_fast(fd, drive, 0x0300, dskfrmt, sizeof(dskfrmt));
 
 
         prepareFmtPattern(&parmBlock, orig, endtrack, name[id_ofs+1], name[id_ofs+2]);
@@ -15,6 +15,7 @@
 #include "libmisc.h"
 
 #include <getopt.h>
+#include <signal.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -27,6 +28,7 @@ static int no_progress = 0;
 
 /* other globals */
 static CBM_FILE fd_cbm;
+static d64copy_context *copy_ctx;
 
 
 static int is_cbm(char *name)
@@ -81,6 +83,12 @@ static void help()
 "                            if data transfer is very slow, increasing this\n"
 "                            value may help.\n"
 "\n"
+"  -T, --tune-interleave     time some interleave values while copying and\n"
+"                            use the fastest one for the remaining tracks. It\n"
+"                            is stored in the OpenCBM configuration file and\n"
+"                            used by later runs with the same adapter, drive\n"
+"                            and transfer mode which do not give `-i'.\n"
+"\n"
 "  -w, --warp                enable warp mode; this is not possible if\n"
 "                            TRANSFER is set to `original'\n"
 "                            This is the default if transfer is not `original'.\n"
@@ -109,7 +117,33 @@ static void help()
 "                              never\n"
 "\n"
 "  -2, --two-sided           two-sided disk transfer (.d71): Requires 1571.\n"
-"                            Warp mode is not available for .d71 images.\n"
+"\n"
+"  -R, --resume              continue an interrupted copy from the drive to\n"
+"                            TARGET; only sectors which have not been copied\n"
+"                            yet are read. This needs TARGET.journal, which is\n"
+"                            kept until all sectors have been copied.\n"
+"\n"
+"  -D, --diff                when copying to the drive, compare the disk with\n"
+"                            the image first and only write sectors which\n"
+"                            differ.\n"
+"\n"
+"  -c, --verify              when copying to the drive, compare the disk with\n"
+"                            the image after writing it.\n"
+"\n"
+"  -N, --batch               read one disk after the other from the drive,\n"
+"                            until interrupted with Ctrl-C. TARGET is used as a\n"
+"                            pattern: disk.d64 gives disk-0001.d64,\n"
+"                            disk-0002.d64, ...; existing images are skipped.\n"
+"                            After each disk, d64copy waits until it has been\n"
+"                            replaced by the next one. Ctrl-C lets the disk\n"
+"                            being read finish and waits for the --post\n"
+"                            commands; a second Ctrl-C aborts at once.\n"
+"\n"
+"  -P, --post=COMMAND        in batch mode, run `COMMAND IMAGE' for each image\n"
+"                            which has been read, e.g. to check or compress it.\n"
+"                            This runs in the background while the next disk is\n"
+"                            read. COMMAND is split at blanks and run without a\n"
+"                            shell.\n"
 "\n"
 );
 }
@@ -141,11 +175,11 @@ static void my_message_cb(int severity, const char *format, ...)
     }
 }
 
-static int my_status_cb(d64copy_status status)
+static void my_event_cb(d64copy_context *ctx, const d64copy_event *event, void *arg)
 {
     static char trackmap[MAX_SECTORS+1];
     static int last_track;
-    char *s;
+    const char *s;
     char *d;
 
     static const char bs2char[] =
@@ -153,44 +187,288 @@ static int my_status_cb(d64copy_status status)
         ' ', '.', '-', '?', '*'
     };
 
-    if(status.track == 0)
+    if(event->type == d64copy_ev_start)
     {
         last_track = 0;
-        return 0;
+        return;
     }
 
-    if(no_progress)
+    if(no_progress || event->type != d64copy_ev_sector)
     {
-        return 0;
+        return;
     }
 
-    if(last_track != status.track)
+    if(last_track != event->track)
     {
         if(last_track)
         {
             printf("\r%2d: %-24s               \n", last_track, trackmap);
         }
 
-        for(s = status.bam[status.track-1], d = trackmap; *s; s++, d++)
+        for(s = d64copy_get_bam(ctx, event->track), d = trackmap; *s; s++, d++)
         {
             *d = bs2char[(int)*s];
         }
         *d = '\0';
-        last_track = status.track;
+        last_track = event->track;
     }
 
-    trackmap[status.sector] = 
-        bs2char[(status.read_result || 
-                 status.write_result) ? bs_error : bs_copied];
+    trackmap[event->sector] = 
+        bs2char[(event->read_result || 
+                 event->write_result) ? bs_error : bs_copied];
 
-    printf("\r%2d: %-24s%3d%%  %4d/%d", status.track, trackmap,
-           100 * status.sectors_processed / status.total_sectors,
-           status.sectors_processed, status.total_sectors);
+    printf("\r%2d: %-24s%3d%%  %4d/%d", event->track, trackmap,
+           100 * event->sectors_processed / event->total_sectors,
+           event->sectors_processed, event->total_sectors);
 
     fflush(stdout);
+}
+
+
+/*
+ * batch mode: images which have been read are handed to a helper thread
+ * which runs the --post command on them while the next disk is read
+ */
+#define BATCH_QUEUE 16
+
+static struct
+{
+    const char *command;
+    char *words;
+    const char **argv;
+    int argc;
+    ARCH_SEMAPHORE free_slots;
+    ARCH_SEMAPHORE used_slots;
+    ARCH_THREAD thread;
+    char *image[BATCH_QUEUE];
+    int head;
+    int tail;
+} batch;
+
+/* set by batch_interrupt() */
+static volatile sig_atomic_t batch_stop;
+
+static void batch_thread(void *context)
+{
+    char *image;
+    int rv;
+
+    for(;;)
+    {
+        arch_semaphore_wait(batch.used_slots);
+        image = batch.image[batch.tail];
+        batch.tail = (batch.tail + 1) % BATCH_QUEUE;
+        arch_semaphore_post(batch.free_slots);
+
+        if(image == NULL)
+        {
+            /* see batch_finish() */
+            return;
+        }
+
+        /* the image is the last argument, see batch_start() */
+        batch.argv[batch.argc] = image;
+        rv = arch_spawn(batch.argv);
+        if(rv != 0)
+        {
+            my_message_cb(sev_warning, "%s: `%s' failed (%d)",
+                          image, batch.command, rv);
+        }
+        free(image);
+    }
+}
+
+/* hand an image to the helper thread, which free()s it */
+static void batch_put(char *image)
+{
+    arch_semaphore_wait(batch.free_slots);
+    batch.image[batch.head] = image;
+    batch.head = (batch.head + 1) % BATCH_QUEUE;
+    arch_semaphore_post(batch.used_slots);
+}
+
+/*
+ * split the --post command into words at blanks; no shell is involved,
+ * thus, the image name can contain any character
+ */
+static int batch_split(const char *command)
+{
+    char *word;
+    int count = 0;
+
+    batch.words = cbmlibmisc_strdup(command);
+    batch.argv = malloc((strlen(command) / 2 + 3) * sizeof(*batch.argv));
+    if(batch.words == NULL || batch.argv == NULL)
+    {
+        return -1;
+    }
+    for(word = strtok(batch.words, " \t"); word; word = strtok(NULL, " \t"))
+    {
+        batch.argv[count++] = word;
+    }
+    if(count == 0)
+    {
+        return -1;
+    }
+    batch.argc = count;
+    batch.argv[count + 1] = NULL;
+    return 0;
+}
+
+static void batch_free_command(void)
+{
+    cbmlibmisc_strfree(batch.words);
+    free((void *) batch.argv);
+    batch.words = NULL;
+    batch.argv = NULL;
+}
+
+static int batch_start(const char *command)
+{
+    batch.command = command;
+    if(batch_split(command) != 0)
+    {
+        batch_free_command();
+        return -1;
+    }
+    batch.free_slots = arch_semaphore_create(BATCH_QUEUE);
+    batch.used_slots = arch_semaphore_create(0);
+    if(batch.free_slots && batch.used_slots)
+    {
+        batch.thread = arch_thread_create(batch_thread, NULL);
+    }
+    if(batch.thread == NULL)
+    {
+        if(batch.free_slots) arch_semaphore_destroy(batch.free_slots);
+        if(batch.used_slots) arch_semaphore_destroy(batch.used_slots);
+        batch_free_command();
+        return -1;
+    }
     return 0;
 }
 
+/* wait until the helper thread has processed all images */
+static void batch_finish(void)
+{
+    if(batch.thread)
+    {
+        batch_put(NULL);
+        arch_thread_join(batch.thread);
+        batch.thread = NULL;
+        arch_semaphore_destroy(batch.free_slots);
+        arch_semaphore_destroy(batch.used_slots);
+        batch_free_command();
+    }
+}
+
+/*
+ * the name of the next image in batch mode: "disk.d64" gives
+ * "disk-0001.d64", "disk-0002.d64", ...; existing images are skipped
+ */
+static char *batch_image_name(const char *pattern, int *number)
+{
+    const char *ext = strrchr(pattern, '.');
+    const char *p;
+    char *name;
+    off_t size;
+
+    for(p = pattern; *p; p++)
+    {
+        if((*p == '/' || *p == '\\') && ext != NULL && ext < p)
+        {
+            /* the dot belongs to a directory name */
+            ext = NULL;
+        }
+    }
+    if(ext == NULL)
+    {
+        ext = pattern + strlen(pattern);
+    }
+
+    name = malloc(strlen(pattern) + 16);
+    if(name != NULL)
+    {
+        do
+        {
+            (*number)++;
+            sprintf(name, "%.*s-%04d%s",
+                    (int)(ext - pattern), pattern, *number, ext);
+        }
+        while(arch_filesize(name, &size) == 0);
+    }
+    return name;
+}
+
+static int batch_stopped(void)
+{
+    return batch_stop;
+}
+
+/*
+ * read one disk after the other into images. The plugin, the adapter,
+ * the drive type and the transfer mode are only set up once.
+ */
+static int batch_copy(d64copy_settings *settings, int drive, const char *pattern)
+{
+    d64copy_settings disk_settings;
+    char *image;
+    int number = 0;
+    int rv;
+
+    for(;;)
+    {
+        image = batch_image_name(pattern, &number);
+        if(image == NULL)
+        {
+            my_message_cb(sev_fatal, "out of memory");
+            return 1;
+        }
+
+        printf("reading %s\n", image);
+
+        /* copy_disk() changes some settings as it goes along */
+        disk_settings = *settings;
+        rv = d64copy_read_image_ctx(copy_ctx, fd_cbm, &disk_settings,
+                drive, image, my_message_cb, NULL);
+        settings->drive_type = disk_settings.drive_type;
+
+        if(rv >= 0)
+        {
+            if(!no_progress)
+            {
+                printf("\n%d blocks copied.\n", rv);
+            }
+            if(batch.thread)
+            {
+                batch_put(image);
+                image = NULL;
+            }
+        }
+        else
+        {
+            my_message_cb(sev_warning, "%s: could not read the disk", image);
+        }
+        free(image);
+
+        if(batch_stop)
+        {
+            return 0;
+        }
+
+        printf("insert the next disk into drive %d (Ctrl-C to stop)\n", drive);
+        fflush(stdout);
+        rv = d64copy_wait_disk_change(fd_cbm, drive, batch_stopped);
+        if(rv < 0)
+        {
+            my_message_cb(sev_fatal, "drive %d does not respond", drive);
+            return 1;
+        }
+        if(rv > 0)
+        {
+            return 0;
+        }
+    }
+}
 
 static void ARCH_SIGNALDECL reset(int dummy)
 {
@@ -208,12 +486,26 @@ static void ARCH_SIGNALDECL reset(int dummy)
 #ifdef LIBD64COPY_DEBUG
     printDebugLibD64Counters(my_message_cb);
 #endif
-    d64copy_cleanup();
+    if(copy_ctx)
+    {
+        d64copy_cleanup_ctx(copy_ctx);
+    }
     cbm_reset(fd_cbm_local);
     cbm_driver_close(fd_cbm_local);
     exit(1);
 }
 
+/*
+ * the first Ctrl-C in batch mode only asks batch_copy() to stop after
+ * the current disk, so that the main loop can wait for the --post
+ * commands. A second one aborts at once.
+ */
+static void ARCH_SIGNALDECL batch_interrupt(int dummy)
+{
+    batch_stop = 1;
+    arch_set_ctrlbreak_handler(reset);
+}
+
 int ARCH_MAINDECL main(int argc, char *argv[])
 {
     d64copy_settings *settings = d64copy_get_default_settings();
@@ -222,8 +514,10 @@ int ARCH_MAINDECL main(int argc, char *argv[])
     char *src_arg;
     char *dst_arg;
     char *adapter = NULL;
+    char *post = NULL;
 
     int  option;
+    int  batch_mode = 0;
     int  rv = 1;
     int  l;
 
@@ -250,10 +544,16 @@ int ARCH_MAINDECL main(int argc, char *argv[])
         { "retry-count", required_argument, NULL, 'r' },
         { "two-sided"  , no_argument      , NULL, '2' },
         { "error-map"  , required_argument, NULL, 'E' },
+        { "resume"     , no_argument      , NULL, 'R' },
+        { "diff"       , no_argument      , NULL, 'D' },
+        { "verify"     , no_argument      , NULL, 'c' },
+        { "tune-interleave", no_argument  , NULL, 'T' },
+        { "batch"      , no_argument      , NULL, 'N' },
+        { "post"       , required_argument, NULL, 'P' },
         { NULL         , 0                , NULL, 0   }
     };
 
-    const char shortopts[] ="hVwqbBt:i:s:e:d:r:2vnE:@:";
+    const char shortopts[] ="hVwqbBt:i:s:e:d:r:2vnE:RDcTNP:@:";
 
     while((option = getopt_long(argc, argv, shortopts, longopts, NULL)) != -1)
     {
@@ -305,6 +605,18 @@ int ARCH_MAINDECL main(int argc, char *argv[])
                       break;
             case '2': settings->two_sided = 1;
                       break;
+            case 'R': settings->resume = 1;
+                      break;
+            case 'D': settings->diff = 1;
+                      break;
+            case 'c': settings->verify = 1;
+                      break;
+            case 'T': settings->tune_interleave = 1;
+                      break;
+            case 'N': batch_mode = 1;
+                      break;
+            case 'P': post = optarg;
+                      break;
             case 'E': l = strlen(optarg);
                       if(strncmp(optarg, "always", l) == 0)
                       {
@@ -377,6 +689,26 @@ int ARCH_MAINDECL main(int argc, char *argv[])
         return 1;
     }
 
+    if(batch_mode && !src_is_cbm)
+    {
+        my_message_cb(0, "batch mode needs a CBM drive as source");
+        return 1;
+    }
+
+    if(post && !batch_mode)
+    {
+        my_message_cb(1, "`--post' without `--batch' ignored");
+    }
+
+    copy_ctx = d64copy_create_context();
+    if(copy_ctx == NULL)
+    {
+        my_message_cb(0, "out of memory");
+        return 1;
+    }
+    d64copy_set_event_cb(copy_ctx, my_event_cb, NULL);
+    settings->adapter = adapter;
+
     if(cbm_driver_open_ex(&fd_cbm, adapter) == 0)
     {
         /*
@@ -390,20 +722,37 @@ int ARCH_MAINDECL main(int argc, char *argv[])
 
         my_message_cb(3, "decided to use transfer mode %d", settings->transfer_mode );
 
-        arch_set_ctrlbreak_handler(reset);
+        arch_set_ctrlbreak_handler(batch_mode ? batch_interrupt : reset);
 
-        if(src_is_cbm)
+        if(batch_mode)
+        {
+            if(post && batch_start(post) != 0)
+            {
+                my_message_cb(0, "could not start the --post helper thread");
+            }
+            else
+            {
+                rv = batch_copy(settings, atoi(src_arg), dst_arg);
+                if(batch.thread)
+                {
+                    printf("waiting for the --post commands...\n");
+                    fflush(stdout);
+                    batch_finish();
+                }
+            }
+        }
+        else if(src_is_cbm)
         {
-            rv = d64copy_read_image(fd_cbm, settings, atoi(src_arg), dst_arg,
-                    my_message_cb, my_status_cb);
+            rv = d64copy_read_image_ctx(copy_ctx, fd_cbm, settings,
+                    atoi(src_arg), dst_arg, my_message_cb, NULL);
         }
         else
         {
-            rv = d64copy_write_image(fd_cbm, settings, src_arg, atoi(dst_arg),
-                    my_message_cb, my_status_cb);
+            rv = d64copy_write_image_ctx(copy_ctx, fd_cbm, settings,
+                    src_arg, atoi(dst_arg), my_message_cb, NULL);
         }
 
-        if(!no_progress && rv >= 0)
+        if(!batch_mode && !no_progress && rv >= 0)
         {
             printf("\n%d blocks copied.\n", rv);
         }
@@ -418,6 +767,7 @@ int ARCH_MAINDECL main(int argc, char *argv[])
 
     cbmlibmisc_strfree(adapter);
     free(settings);
+    d64copy_free_context(copy_ctx);
     
     return rv;
 }
@@ -98,6 +98,11 @@ static void help()
 "  -2, --two-sided           two-sided disk transfer (.d82): Requires CBM-8250\n"
 "                            or SFD-1001 diskette drive.\n"
 "\n"
+"  -R, --resume              continue an interrupted copy from the drive to\n"
+"                            TARGET; only sectors which have not been copied\n"
+"                            yet are read. This needs TARGET.journal, which is\n"
+"                            kept until all sectors have been copied.\n"
+"\n"
 );
 }
 
@@ -238,10 +243,11 @@ int ARCH_MAINDECL main(int argc, char *argv[])
         { "one-sided"  , no_argument      , NULL, '1' },
         { "two-sided"  , no_argument      , NULL, '2' },
         { "error-map"  , required_argument, NULL, 'E' },
+        { "resume"     , no_argument      , NULL, 'R' },
         { NULL         , 0                , NULL, 0   }
     };
 
-    const char shortopts[] ="hVwqbBt:i:s:e:d:r:12vnE:@:";
+    const char shortopts[] ="hVwqbBt:i:s:e:d:r:12vnE:R@:";
 
     while((option = getopt_long(argc, argv, shortopts, longopts, NULL)) != -1)
     {
@@ -295,6 +301,8 @@ int ARCH_MAINDECL main(int argc, char *argv[])
                       break;
             case '2': settings->two_sided = 1;
                       break;
+            case 'R': settings->resume = 1;
+                      break;
             case 'E': l = strlen(optarg);
                       if(strncmp(optarg, "always", l) == 0)
                       {
@@ -25,11 +25,13 @@ static char *rcsid =
 #include <stdio.h>      
 #include <stdlib.h>      
 #include <string.h>    
+#include <time.h>
 
  
 /* setable via command line */   
 static imgcopy_severity_e verbosity = sev_warning;    
 static int no_progress = 0; 
+static int bench = 0;
   
 /* other globals */
 static CBM_FILE fd_cbm;  
@@ -106,6 +108,18 @@ static void help(void)
 "\n"
 "  -2, --two-sided          two-sided disk transfer (.d82): Requires CBM-8250 or SFD-1001.\n"
 "\n"
+"  -R, --resume             continue an interrupted copy from the drive to\n"
+"                           TARGET; only sectors which have not been copied\n"
+"                           yet are read. This needs TARGET.journal, which is\n"
+"                           kept until all sectors have been copied.\n"
+"\n"
+"  -c, --verify             when copying to the drive, compare the disk with\n"
+"                           the image after writing it.\n"
+"\n"
+"      --bench              report blocks per second and the host CPU time\n"
+"                           per block of the transfer mode used; run once\n"
+"                           for each transfer mode to compare them.\n"
+"\n"
 );
 }
 
@@ -146,11 +160,11 @@ static void my_message_cb(int severity, const char *format, ...)
 //
 // print status line while copy
 //
-static int my_status_cb(imgcopy_status status)
+static void my_event_cb(const imgcopy_event *event, void *arg)
 {
     static char trackmap[MAX_SECTORS+1];
     static int last_track;
-    char *s;
+    const char *s;
     char *d;
 
     static const char bs2char[] =
@@ -158,45 +172,71 @@ static int my_status_cb(imgcopy_status status)
         ' ', '.', '-', '?', '*'
     };
 
-    if(status.track == 0)
+    if(event->type == imgcopy_ev_start)
     {
         last_track = 0;
-        return 0;
+        return;
     }
 
-    if(no_progress)
+    if(no_progress || event->type != imgcopy_ev_sector)
     {
-        return 0;
+        return;
     }
 
-    if(last_track != status.track)
+    if(last_track != event->track)
     {
         if(last_track)
         {
             printf("\r%2d: %-24s               \n", last_track, trackmap);
         }
 
-        for(s = status.bam[status.track-1], d = trackmap; *s; s++, d++)
+        for(s = imgcopy_get_bam(event->track), d = trackmap; *s; s++, d++)
         {
             *d = bs2char[(int)*s];
         }
         *d = '\0';
-        last_track = status.track;
+        last_track = event->track;
     }
 
-    trackmap[status.sector] = 
-        bs2char[(status.read_result || 
-                 status.write_result) ? bs_error : bs_copied];
+    trackmap[event->sector] = 
+        bs2char[(event->read_result || 
+                 event->write_result) ? bs_error : bs_copied];
 
-    printf("\r%2d: %-24s%3d%%  %4d/%d", status.track, trackmap,
-           100 * status.sectors_processed / status.total_sectors,
-           status.sectors_processed, status.total_sectors);
+    printf("\r%2d: %-24s%3d%%  %4d/%d", event->track, trackmap,
+           100 * event->sectors_processed / event->total_sectors,
+           event->sectors_processed, event->total_sectors);
 
     fflush(stdout);
-    return 0;
 }
 
 
+//
+// print the --bench figures of a copy
+//
+static void print_bench(int transfer_mode, int blocks, unsigned long ms, clock_t cpu)
+{
+    char *modes = imgcopy_get_transfer_modes();
+    const char *name = "?";
+    char *m;
+    int i;
+
+    for(m = modes, i = 0; m && *m; m += strlen(m) + 1, i++)
+    {
+        if(i == transfer_mode)
+        {
+            name = m;
+            break;
+        }
+    }
+
+    printf("%s: %d blocks in %lu ms, %.1f blocks/s, %.3f ms CPU per block\n",
+           name, blocks, ms,
+           ms ? blocks * 1000.0 / ms : 0.0,
+           blocks ? 1000.0 * cpu / CLOCKS_PER_SEC / blocks : 0.0);
+
+    free(modes);
+}
+
 //
 // abort signal trap
 //
@@ -241,6 +281,9 @@ int ARCH_MAINDECL main(int argc, char *argv[])
     int src_is_cbm;
     int dst_is_cbm;
 
+    unsigned long bench_ms;
+    clock_t bench_cpu;
+
     struct option longopts[] =
     {
         { "help"       , no_argument      , NULL, 'h' },
@@ -262,10 +305,13 @@ int ARCH_MAINDECL main(int argc, char *argv[])
         { "one-sided"  , no_argument      , NULL, '1' },
         { "two-sided"  , no_argument      , NULL, '2' },
         { "error-map"  , required_argument, NULL, 'E' },
+        { "resume"     , no_argument      , NULL, 'R' },
+        { "verify"     , no_argument      , NULL, 'c' },
+        { "bench"      , no_argument      , &bench, 1 },
         { NULL         , 0                , NULL, 0   }
     };
 
-    const char shortopts[] ="hVwqbBt:i:s:e:d:r:2vnE:@:";
+    const char shortopts[] ="hVwqbBt:i:s:e:d:r:2vnE:Rc@:";
 
     while((c=getopt_long(argc, argv, shortopts, longopts, NULL)) != -1)
     {
@@ -356,6 +402,10 @@ int ARCH_MAINDECL main(int argc, char *argv[])
                       break;
             case '2': settings->two_sided = 1;
                       break;
+            case 'R': settings->resume = 1;
+                      break;
+            case 'c': settings->verify = 1;
+                      break;
             case 'E': l = strlen(optarg);
                       if(strncmp(optarg, "always", l) == 0)
                       {
@@ -384,7 +434,7 @@ int ARCH_MAINDECL main(int argc, char *argv[])
                           exit(1);
                       }
                       break;
-            case 0:   break; // needed for --no-warp
+            case 0:   break; // needed for --no-warp and --bench
             default : hint(argv[0]);
                       return 1;
         }
@@ -443,15 +493,20 @@ int ARCH_MAINDECL main(int argc, char *argv[])
 
         arch_set_ctrlbreak_handler(reset);
 
+        imgcopy_set_event_cb(my_event_cb, NULL);
+
+        bench_ms  = arch_time_ms();
+        bench_cpu = clock();
+
         if(src_is_cbm)
         {
             rv = imgcopy_read_image(fd_cbm, settings, atoi(src_arg), dst_arg,
-                    my_message_cb, my_status_cb);
+                    my_message_cb, NULL);
         }
         else
         {
             rv = imgcopy_write_image(fd_cbm, settings, src_arg, atoi(dst_arg),
-                    my_message_cb, my_status_cb);
+                    my_message_cb, NULL);
         }
 
         if(!no_progress && rv >= 0)
@@ -459,6 +514,12 @@ int ARCH_MAINDECL main(int argc, char *argv[])
             printf("\n%d blocks copied.\n", rv);
         }
 
+        if(bench && rv >= 0)
+        {
+            print_bench(settings->transfer_mode, rv,
+                        arch_time_ms() - bench_ms, clock() - bench_cpu);
+        }
+
         cbm_driver_close(fd_cbm);
         rv = 0;
     }
@@ -111,6 +111,13 @@ typedef bool BOOL;
 
 int arch_filesize(const char *Filename, off_t *Filesize);
 
+/*! a part of a file mapped into memory, see arch_mmap() */
+typedef struct arch_mapping_s *ARCH_MAPPING;
+
+extern ARCH_MAPPING arch_mmap(int Fd, size_t Size, int Writable, void **Address);
+extern int arch_msync(ARCH_MAPPING Mapping);
+extern void arch_munmap(ARCH_MAPPING Mapping);
+
 #define arch_strdup(_x) ARCH_CBM_LINUX_WIN(strdup(_x), _strdup(_x))
 
 #define arch_fileno(_x) ARCH_CBM_LINUX_WIN(fileno(_x), _fileno(_x))
@@ -129,4 +136,25 @@ int arch_filesize(const char *Filename, off_t *Filesize);
 typedef void (ARCH_SIGNALDECL *ARCH_CTRLBREAK_HANDLER)(int dummy);
 extern void arch_set_ctrlbreak_handler(ARCH_CTRLBREAK_HANDLER Handler);
 
+/*! a counting semaphore, see arch_semaphore_create() */
+typedef struct arch_semaphore_s *ARCH_SEMAPHORE;
+
+/*! a thread, see arch_thread_create() */
+typedef struct arch_thread_s *ARCH_THREAD;
+
+/*! the function a thread started with arch_thread_create() executes */
+typedef void (*ARCH_THREAD_FUNC)(void *Context);
+
+extern ARCH_SEMAPHORE arch_semaphore_create(unsigned int InitialCount);
+extern void arch_semaphore_wait(ARCH_SEMAPHORE Semaphore);
+extern void arch_semaphore_post(ARCH_SEMAPHORE Semaphore);
+extern void arch_semaphore_destroy(ARCH_SEMAPHORE Semaphore);
+
+extern ARCH_THREAD arch_thread_create(ARCH_THREAD_FUNC Func, void *Context);
+extern void arch_thread_join(ARCH_THREAD Thread);
+
+extern int arch_spawn(const char * const Argv[]);
+
+extern unsigned long arch_time_ms(void);
+
 #endif /* #ifndef CBM_ARCH_H */
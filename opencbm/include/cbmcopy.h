@@ -20,6 +20,8 @@ typedef struct
 {
     int transfer_mode;
     enum cbm_device_type_e drive_type;
+    int block_delay;            /* usec after the handshake of each block */
+    int interleave;             /* for host planned chains, -1: default */
 } cbmcopy_settings;
 
 typedef enum
@@ -34,6 +36,13 @@ typedef void (*cbmcopy_message_cb)(cbmcopy_severity_e sev, const char *format, .
 
 typedef int (*cbmcopy_status_cb)(int blocks_processed);
 
+/*
+ * receives the data of a file while it is being read, up to 254 bytes
+ * (one block) per call. Any return value but 0 stops the delivery; the
+ * rest of the file is still read from the drive, and the read fails.
+ */
+typedef int (*cbmcopy_sink_cb)(void *context, const unsigned char *data, size_t size);
+
 #ifdef LIBCBMCOPY_DEBUG
 /*
  * print out the state of internal counters that are used on read
@@ -97,6 +106,101 @@ extern int cbmcopy_read_file_ts(CBM_FILE cbm_fd,
                                 cbmcopy_message_cb msg_cb,
                                 cbmcopy_status_cb status_cb);
 
+/*
+ * like cbmcopy_read_file() and cbmcopy_read_file_ts(), but the data is
+ * passed to sink as soon as it arrives instead of being collected
+ */
+extern int cbmcopy_read_file_stream(CBM_FILE cbm_fd,
+                                    cbmcopy_settings *settings,
+                                    int drive,
+                                    const char *cbmname,
+                                    int cbmname_size,
+                                    cbmcopy_sink_cb sink,
+                                    void *sink_context,
+                                    cbmcopy_message_cb msg_cb,
+                                    cbmcopy_status_cb status_cb);
+
+extern int cbmcopy_read_file_ts_stream(CBM_FILE cbm_fd,
+                                       cbmcopy_settings *settings,
+                                       int drive,
+                                       int track, int sector,
+                                       cbmcopy_sink_cb sink,
+                                       void *sink_context,
+                                       cbmcopy_message_cb msg_cb,
+                                       cbmcopy_status_cb status_cb);
+
+/*
+ * cbmcopy_sink_cb which appends the data to the FILE * given as context
+ */
+extern int cbmcopy_file_sink(void *context, const unsigned char *data, size_t size);
+
+/*
+ * Sessions: the drive is identified and prepared once, and the files
+ * are read by their track/sector, using the directory read at the
+ * start of the session. Without a turbo (original transfer, IEEE
+ * drives), the directory listing is read and the files are opened by
+ * name and type instead.
+ */
+typedef struct cbmcopy_session_s cbmcopy_session;
+
+typedef struct
+{
+    char name[17];          /* PETSCII, without the shifted-space padding */
+    unsigned char type;     /* file type byte of the directory entry */
+    int track, sector;      /* first block of the file, 0 without a turbo */
+    int blocks;             /* file size in blocks */
+} cbmcopy_dir_entry;
+
+/*
+ * called before a file of cbmcopy_session_read_files() is read. Return 0
+ * to read the file, a positive value to skip it or a negative one to stop.
+ */
+typedef int (*cbmcopy_file_begin_cb)(void *context, const cbmcopy_dir_entry *entry);
+
+/* called after a file has been read; rv is 0 on success */
+typedef void (*cbmcopy_file_end_cb)(void *context, const cbmcopy_dir_entry *entry, int rv);
+
+/*
+ * returns a malloc()'d session, or NULL if the drive could not be
+ * identified. Must be freed with cbmcopy_session_close().
+ */
+extern cbmcopy_session *cbmcopy_session_open(CBM_FILE cbm_fd,
+                                             cbmcopy_settings *settings,
+                                             int drive,
+                                             cbmcopy_message_cb msg_cb);
+
+extern void cbmcopy_session_close(cbmcopy_session *session);
+
+/*
+ * reads the directory on the first call; the entries stay valid until
+ * the session is closed.
+ */
+extern int cbmcopy_session_read_dir(cbmcopy_session *session,
+                                    const cbmcopy_dir_entry **entries,
+                                    int *num_entries);
+
+extern int cbmcopy_session_read_entry(cbmcopy_session *session,
+                                      const cbmcopy_dir_entry *entry,
+                                      cbmcopy_sink_cb sink,
+                                      void *sink_context,
+                                      cbmcopy_status_cb status_cb);
+
+/*
+ * reads all files whose (PETSCII) name matches pattern, back-to-back.
+ * context is passed to begin_cb, end_cb and sink. Returns 0 if all
+ * files could be read.
+ */
+extern int cbmcopy_session_read_files(cbmcopy_session *session,
+                                      const char *pattern,
+                                      cbmcopy_file_begin_cb begin_cb,
+                                      cbmcopy_file_end_cb end_cb,
+                                      cbmcopy_sink_cb sink,
+                                      void *context,
+                                      cbmcopy_status_cb status_cb);
+
+/* CBM DOS style name matching with '*' and '?' */
+extern int cbmcopy_match_name(const char *pattern, const char *name);
+
 #ifdef __cplusplus
 }
 #endif
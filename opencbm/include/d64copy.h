@@ -57,6 +57,11 @@ typedef struct
     enum cbm_device_type_e drive_type;
     d64copy_bam_mode bam_mode;
     d64copy_error_mode error_mode;
+    int resume;
+    int diff;
+    int verify;
+    int tune_interleave;    /* time some interleaves and keep the best one */
+    const char *adapter;    /* the adapter, for storing the tuned interleave */
 } d64copy_settings;
 
 typedef struct
@@ -79,8 +84,50 @@ typedef enum
     sev_debug
 } d64copy_severity_e;
 
+/*
+ * in warp read mode, the callbacks are called from a helper thread
+ * while the copy runs. They are never called from two threads at once.
+ */
 typedef void (*d64copy_message_cb)(int d64copy_severity_e, const char *format, ...);
 typedef int (*d64copy_status_cb)(d64copy_status status);
+typedef int (*d64copy_stop_cb)(void);
+
+/*
+ * the state of one copy operation. Several copies can run at the same
+ * time (for example, from different threads on different adapters) if
+ * each one uses its own context.
+ */
+typedef struct d64copy_context_s d64copy_context;
+
+/*
+ * progress events. Unlike d64copy_status_cb, these do not carry the
+ * sector map; d64copy_get_bam() gives access to the live one instead.
+ */
+typedef enum
+{
+    d64copy_ev_start,   /* sector map set up, total_sectors is valid */
+    d64copy_ev_sector,  /* track/sector has been processed           */
+    d64copy_ev_done     /* all tracks have been processed            */
+} d64copy_event_type;
+
+typedef struct
+{
+    d64copy_event_type type;
+    int track;
+    int sector;
+    int read_result;
+    int write_result;
+    int sectors_processed;
+    int total_sectors;
+} d64copy_event;
+
+/*
+ * called in the same way as d64copy_status_cb. The event is only
+ * valid until the callback returns.
+ */
+typedef void (*d64copy_event_cb)(d64copy_context *ctx,
+                                 const d64copy_event *event,
+                                 void *arg);
 
 #ifdef LIBD64COPY_DEBUG
 /*
@@ -121,6 +168,25 @@ extern d64copy_settings *d64copy_get_default_settings(void);
  */
 extern int d64copy_sector_count(int two_sided, int track);
 
+/*
+ * wait until the disk in the drive has been replaced by another one and
+ * is ready to be read. This overwrites the drive memory used by the
+ * transfer programs, thus, it must not be called while a copy runs.
+ * stop_cb (may be NULL) is polled while waiting; if it returns non-zero,
+ * the bus is reset to end the drive program.
+ * returns 0 on success, 1 if stopped, -1 if the drive program could not
+ * be started.
+ */
+extern int d64copy_wait_disk_change(CBM_FILE cbm_fd, int drive,
+                                    d64copy_stop_cb stop_cb);
+
+/*
+ * While a disk is read into an image, the state of every sector is kept
+ * in a journal next to it ("image.d64.journal"). It is removed when all
+ * sectors have been copied. If settings->resume is set and the image and
+ * its journal exist, sectors which have been copied already are not read
+ * again.
+ */
 extern int d64copy_read_image(CBM_FILE cbm_fd,
                               d64copy_settings *settings,
                               int src_drive,
@@ -128,6 +194,12 @@ extern int d64copy_read_image(CBM_FILE cbm_fd,
                               d64copy_message_cb msg_cb,
                               d64copy_status_cb status_cb);
 
+/*
+ * If settings->diff is set, the sectors on the disk are compared with the
+ * image first, and only those which differ are written.
+ * If settings->verify is set, the sectors are compared with the image
+ * after writing; those which differ are counted as errors.
+ */
 extern int d64copy_write_image(CBM_FILE cbm_fd,
                                d64copy_settings *settings,
                                const char *src_image,
@@ -137,6 +209,68 @@ extern int d64copy_write_image(CBM_FILE cbm_fd,
 
 extern void d64copy_cleanup(void);
 
+/*
+ * returns a new context for d64copy_read_image_ctx() and
+ * d64copy_write_image_ctx(), or NULL if there is not enough memory.
+ * must be freed with d64copy_free_context() after use.
+ */
+extern d64copy_context *d64copy_create_context(void);
+
+extern void d64copy_free_context(d64copy_context *ctx);
+
+/*
+ * same as d64copy_read_image(), d64copy_write_image() and
+ * d64copy_cleanup(), but using the state in ctx instead of the
+ * global one.
+ */
+extern int d64copy_read_image_ctx(d64copy_context *ctx,
+                                  CBM_FILE cbm_fd,
+                                  d64copy_settings *settings,
+                                  int src_drive,
+                                  const char *dst_image,
+                                  d64copy_message_cb msg_cb,
+                                  d64copy_status_cb status_cb);
+
+extern int d64copy_write_image_ctx(d64copy_context *ctx,
+                                   CBM_FILE cbm_fd,
+                                   d64copy_settings *settings,
+                                   const char *src_image,
+                                   int dst_drive,
+                                   d64copy_message_cb msg_cb,
+                                   d64copy_status_cb status_cb);
+
+/*
+ * copy the image src_image to dst_image in the same way as a disk is
+ * read into an image, with the journal and the error map, but without
+ * a drive. settings->two_sided must match the source image; the
+ * transfer mode and the drive type are not used.
+ */
+extern int d64copy_copy_image_ctx(d64copy_context *ctx,
+                                  d64copy_settings *settings,
+                                  const char *src_image,
+                                  const char *dst_image,
+                                  d64copy_message_cb msg_cb,
+                                  d64copy_status_cb status_cb);
+
+extern void d64copy_cleanup_ctx(d64copy_context *ctx);
+
+/*
+ * have event_cb called with arg for every progress event of the copies
+ * run with ctx. If the status callback passed to d64copy_read_image_ctx()
+ * or d64copy_write_image_ctx() is not NULL, it is called, too.
+ */
+extern void d64copy_set_event_cb(d64copy_context *ctx,
+                                 d64copy_event_cb event_cb,
+                                 void *arg);
+
+/*
+ * return the sector map (one d64copy_bam_status per sector) of the
+ * given track of the copy running with ctx, or NULL if there is none.
+ * Only valid while the copy is running; to see a consistent state,
+ * call it from the event or status callback.
+ */
+extern const char *d64copy_get_bam(d64copy_context *ctx, int track);
+
 #ifdef __cplusplus
 }
 #endif
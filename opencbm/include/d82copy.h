@@ -75,6 +75,7 @@ typedef struct
     enum cbm_device_type_e drive_type;
     d82copy_bam_mode bam_mode;
     d82copy_error_mode error_mode;
+    int resume;
 } d82copy_settings;
 
 typedef struct
@@ -139,6 +140,13 @@ extern d82copy_settings *d82copy_get_default_settings(void);
  */
 extern int d82copy_sector_count(int two_sided, int track);
 
+/*
+ * While a disk is read into an image, the state of every sector is kept
+ * in a journal next to it ("image.d82.journal"). It is removed when all
+ * sectors have been copied. If settings->resume is set and the image and
+ * its journal exist, sectors which have been copied already are not read
+ * again.
+ */
 extern int d82copy_read_image(CBM_FILE cbm_fd,
                               d82copy_settings *settings,
                               int src_drive,
@@ -107,6 +107,8 @@ typedef struct
 	enum cbm_device_type_e drive_type;
 	imgcopy_bam_mode bam_mode;
 	imgcopy_error_mode error_mode;
+	int resume;													// resume an interrupted read, see imgcopy_read_image()
+	int verify;													// compare the disk with the image after writing
 } imgcopy_settings;
 
 typedef struct
@@ -132,6 +134,31 @@ typedef enum
 typedef void (*imgcopy_message_cb)(int imgcopy_severity_e, const char *format, ...);
 typedef int (*imgcopy_status_cb)(imgcopy_status status);
 
+/*
+ * progress events. Unlike imgcopy_status_cb, these do not carry the
+ * sector map; imgcopy_get_bam() gives access to the live one instead.
+ */
+typedef enum
+{
+    imgcopy_ev_start,   /* sector map set up, total_sectors is valid */
+    imgcopy_ev_sector,  /* track/sector has been processed           */
+    imgcopy_ev_done     /* all tracks have been processed            */
+} imgcopy_event_type;
+
+typedef struct
+{
+    imgcopy_event_type type;
+    int track;
+    int sector;
+    int read_result;
+    int write_result;
+    int sectors_processed;
+    int total_sectors;
+} imgcopy_event;
+
+/* the event is only valid until the callback returns */
+typedef void (*imgcopy_event_cb)(const imgcopy_event *event, void *arg);
+
 
 
 // Prototypes
@@ -179,6 +206,13 @@ extern imgcopy_settings *imgcopy_get_default_settings(void);
  */
 extern int imgcopy_sector_count(imgcopy_settings *, int track);
 
+/*
+ * While a disk is read into an image, the state of every sector is kept
+ * in a journal next to it ("image.d82.journal"). It is removed when all
+ * sectors have been copied. If settings->resume is set and the image and
+ * its journal exist, sectors which have been copied already are not read
+ * again.
+ */
 extern int imgcopy_read_image(CBM_FILE cbm_fd,
                               imgcopy_settings *settings,
                               int src_drive,
@@ -186,6 +220,10 @@ extern int imgcopy_read_image(CBM_FILE cbm_fd,
                               imgcopy_message_cb msg_cb,
                               imgcopy_status_cb status_cb);
 
+/*
+ * If settings->verify is set, the written sectors are compared with the
+ * image afterwards; those which differ are counted as errors.
+ */
 extern int imgcopy_write_image(CBM_FILE cbm_fd,
                                imgcopy_settings *settings,
                                const char *src_image,
@@ -195,6 +233,20 @@ extern int imgcopy_write_image(CBM_FILE cbm_fd,
 
 extern void imgcopy_cleanup(void);
 
+/*
+ * have event_cb called with arg for every progress event. If the
+ * status callback passed to imgcopy_read_image() or imgcopy_write_image()
+ * is not NULL, it is called, too.
+ */
+extern void imgcopy_set_event_cb(imgcopy_event_cb event_cb, void *arg);
+
+/*
+ * return the sector map (one imgcopy_bam_status per sector) of the
+ * given track of the running copy, or NULL if there is none. To see
+ * a consistent state, call it from the event or status callback.
+ */
+extern const char *imgcopy_get_bam(int track);
+
 
 #ifdef __cplusplus
 }
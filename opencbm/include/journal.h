@@ -0,0 +1,43 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version
+ *  2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 The OpenCBM project
+ */
+
+/*! **************************************************************
+** \file include/journal.h \n
+** \author The OpenCBM project \n
+** \n
+** \brief Sidecar journals for resuming interrupted disk copies
+**
+****************************************************************/
+
+#ifndef CBM_JOURNAL_H
+#define CBM_JOURNAL_H
+
+#include <stddef.h>
+
+struct cbmlibmisc_journal_s;
+
+/*! \brief Handle to an open journal */
+typedef struct cbmlibmisc_journal_s cbmlibmisc_journal;
+
+extern int cbmlibmisc_journal_load(const char *ImageName, const char *Id,
+                                   const char *DiskId,
+                                   void *Map, size_t Size);
+
+extern cbmlibmisc_journal * cbmlibmisc_journal_create(const char *ImageName,
+                                                      const char *Id,
+                                                      const char *DiskId,
+                                                      const void *Map,
+                                                      size_t Size);
+
+extern void cbmlibmisc_journal_update(cbmlibmisc_journal *Journal,
+                                      size_t Offset, char Value);
+
+extern void cbmlibmisc_journal_close(cbmlibmisc_journal *Journal, int Remove);
+
+#endif /* #ifndef CBM_JOURNAL_H */
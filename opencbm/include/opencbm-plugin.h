@@ -512,6 +512,101 @@ typedef int CBMAPIDECL opencbm_plugin_pp_cc_read_n_t (CBM_FILE HandleDevice,
 */
 typedef int CBMAPIDECL opencbm_plugin_pp_cc_write_n_t(CBM_FILE HandleDevice, const unsigned char *data, unsigned int size);
 
+/*! \brief IEC micro-sequence opcodes
+
+ A micro-sequence is a short program of IEC line operations which the
+ OpenCBM backend runs once per transferred byte. This allows a library to
+ implement a custom transfer protocol without one backend round trip per
+ line change. Each opcode consists of the operation in the upper nibble
+ and a mask of IEC_SEQ_DATA, IEC_SEQ_CLOCK and IEC_SEQ_ATN in the lower
+ nibble, optionally with IEC_SEQ_INV. IEC_SEQ_DELAY and IEC_SEQ_REPEAT
+ are followed by one operand byte. Every program must end with
+ IEC_SEQ_END, and every pass must receive or send one byte.
+
+ The backend keeps one program per direction: a program with IEC_SEQ_RECV
+ is used by opencbm_plugin_iec_seq_write_n(), one with IEC_SEQ_SEND by
+ opencbm_plugin_iec_seq_read_n(). Loading one does not replace the other.
+
+ \note
+   The encoding is identical to the one of the xum1541 firmware
+   (XUM_SEQ_* in xum1541_types.h), so it is passed through unchanged.
+*/
+#define IEC_SEQ_MAX_SIZE      32   /*!< maximum length of a micro-sequence */
+
+#define IEC_SEQ_DATA          0x01 /*!< the DATA line */
+#define IEC_SEQ_CLOCK         0x02 /*!< the CLOCK line */
+#define IEC_SEQ_ATN           0x04 /*!< the ATN line */
+#define IEC_SEQ_INV           0x08 /*!< invert the sense of a test or bit */
+
+#define IEC_SEQ_END           0x00 /*!< end of one pass */
+#define IEC_SEQ_SET           0x10 /*!< set the lines */
+#define IEC_SEQ_RELEASE       0x20 /*!< release the lines */
+#define IEC_SEQ_WAIT_SET      0x30 /*!< wait until any of the lines is set */
+#define IEC_SEQ_WAIT_RELEASE  0x40 /*!< wait until all lines are released */
+#define IEC_SEQ_PUT_BIT7      0x50 /*!< set the lines if bit 7 of the data byte is 1 (0 with IEC_SEQ_INV), else release them */
+#define IEC_SEQ_PUT_BIT0      0x60 /*!< set the lines if bit 0 of the data byte is 1 (0 with IEC_SEQ_INV), else release them */
+#define IEC_SEQ_GET           0x70 /*!< shift the data byte right, bit 7 becomes 1 if the line is set (released with IEC_SEQ_INV) */
+#define IEC_SEQ_WAIT_BIT7     0x80 /*!< wait until the line state differs from bit 7 of the data byte */
+#define IEC_SEQ_SHIFT         0x90 /*!< shift the data byte left (right with IEC_SEQ_INV) */
+#define IEC_SEQ_DELAY         0xa0 /*!< wait for (operand) microseconds */
+#define IEC_SEQ_REPEAT        0xb0 /*!< execute up to IEC_SEQ_NEXT (operand) times; cannot be nested */
+#define IEC_SEQ_NEXT          0xc0 /*!< end of an IEC_SEQ_REPEAT body */
+#define IEC_SEQ_RECV          0xd0 /*!< load the data byte from the host */
+#define IEC_SEQ_SEND          0xd1 /*!< send the data byte to the host */
+#define IEC_SEQ_PP_READ       0xd2 /*!< load the data byte from the parallel port */
+#define IEC_SEQ_PP_WRITE      0xd3 /*!< write the data byte to the parallel port */
+
+/*! \brief load an IEC micro-sequence into the OpenCBM backend
+
+ \param HandleDevice
+    Pointer to a CBM_FILE which will contain the file handle of the OpenCBM backend
+
+ \param program
+    Pointer to the IEC_SEQ_* program
+
+ \param size
+    The length of the program; at most IEC_SEQ_MAX_SIZE.
+
+ \return
+    0 on success, -1 if the program was rejected or the backend does not
+    support micro-sequences.
+*/
+typedef int CBMAPIDECL opencbm_plugin_iec_seq_load_t(CBM_FILE HandleDevice, const unsigned char *program, unsigned int size);
+
+/*! \brief read a block of data from the OpenCBM backend with the loaded micro-sequence
+
+ \param HandleDevice
+    Pointer to a CBM_FILE which will contain the file handle of the OpenCBM backend
+
+ \param data
+    Pointer to a buffer which will contain the data read from the OpenCBM backend
+
+ \param size
+    The number of bytes to read from the OpenCBM backend
+
+ \return
+    The number of bytes actually read, 0 on OpenCBM backend error.
+    If there is a fatal error, returns -1.
+*/
+typedef int CBMAPIDECL opencbm_plugin_iec_seq_read_n_t (CBM_FILE HandleDevice,       unsigned char *data, unsigned int size);
+
+/*! \brief write a block of data to the OpenCBM backend with the loaded micro-sequence
+
+ \param HandleDevice
+    Pointer to a CBM_FILE which will contain the file handle of the OpenCBM backend
+
+ \param data
+    Pointer to buffer which contains the data to be written to the OpenCBM backend
+
+ \param size
+    The length of the data buffer to be written to the OpenCBM backend
+
+ \return
+    The number of bytes actually written, 0 on OpenCBM backend error.
+    If there is a fatal error, returns -1.
+*/
+typedef int CBMAPIDECL opencbm_plugin_iec_seq_write_n_t(CBM_FILE HandleDevice, const unsigned char *data, unsigned int size);
+
 
 /*! \brief @@@@@ \todo document
 
@@ -532,6 +627,77 @@ typedef int CBMAPIDECL opencbm_plugin_iec_dbg_read_t(CBM_FILE HandleDevice);
 typedef int CBMAPIDECL opencbm_plugin_iec_dbg_write_t(CBM_FILE HandleDevice, unsigned char Value);
 
 
+/*! \brief the kind of an operation in a batch, see opencbm_plugin_batch_op_t */
+enum opencbm_plugin_batch_operation_e
+{
+    opencbm_batch_listen,    /*!< cbm_listen(DeviceAddress, SecondaryAddress) */
+    opencbm_batch_talk,      /*!< cbm_talk(DeviceAddress, SecondaryAddress) */
+    opencbm_batch_unlisten,  /*!< cbm_unlisten() */
+    opencbm_batch_untalk,    /*!< cbm_untalk() */
+    opencbm_batch_raw_write, /*!< cbm_raw_write(Buffer, Count) */
+    opencbm_batch_raw_read   /*!< cbm_raw_read(Buffer, Count) */
+};
+
+/*! \brief one operation of a batch of IEC operations */
+typedef
+struct opencbm_plugin_batch_op_s {
+    enum opencbm_plugin_batch_operation_e Operation; /*!< the operation to execute */
+    unsigned char DeviceAddress;    /*!< the device address for listen and talk */
+    unsigned char SecondaryAddress; /*!< the secondary address for listen and talk */
+    void *        Buffer;           /*!< the data for raw_write, or the buffer for raw_read */
+    size_t        Count;            /*!< the length of Buffer */
+    int           Result;           /*!< the return value of the operation, as the non-batch function returns it */
+} opencbm_plugin_batch_op_t;
+
+/*! \brief execute a batch of IEC operations
+
+ The operations are executed in order, with as few round trips to the
+ device as the OpenCBM backend can manage. Execution stops after a
+ listen or talk fails (Result != 0) or after a raw_write or raw_read
+ returns an error (Result < 0).
+
+ \param HandleDevice
+    Pointer to a CBM_FILE which will contain the file handle of the OpenCBM backend
+
+ \param Operations
+    Pointer to the operations to execute. The Result member is filled in
+    for each executed operation.
+
+ \param Count
+    The number of operations
+
+ \return
+    The number of operations executed successfully. If the backend could
+    not execute the batch at all (and did not start), returns -1; the
+    caller then has to execute the operations one by one.
+*/
+typedef int CBMAPIDECL opencbm_plugin_batch_t(CBM_FILE HandleDevice, opencbm_plugin_batch_op_t *Operations, unsigned int Count);
+
+/*! \brief read the error channel of a device
+
+ Talks to the device on channel 15, reads its status until EOI and
+ untalks it, in as few round trips as the OpenCBM backend can manage.
+
+ \param HandleDevice
+    Pointer to a CBM_FILE which will contain the file handle of the OpenCBM backend
+
+ \param DeviceAddress
+    The address of the device on the IEC serial bus.
+
+ \param Buffer
+    Pointer to a buffer which receives the status. It is not
+    null-terminated.
+
+ \param BufferLength
+    The size of Buffer, in bytes.
+
+ \return
+    The number of bytes read. If the device did not talk, returns -2.
+    If the backend cannot read the status this way, returns -1; the
+    caller then has to use talk, raw_read and untalk.
+*/
+typedef int CBMAPIDECL opencbm_plugin_device_status_t(CBM_FILE HandleDevice, unsigned char DeviceAddress, void *Buffer, size_t BufferLength);
+
 /*! \brief holds all callbacks of the plugin
 
   This structure contains all callbacks available in the plugin.
@@ -599,6 +765,9 @@ struct opencbm_plugin_s {
     opencbm_plugin_tap_upload_config_t          * opencbm_plugin_tap_upload_config;       /*!< pointer to a opencbm_plugin_tap_upload_config_t() function */
     opencbm_plugin_tap_break_t                  * opencbm_plugin_tap_break;               /*!< pointer to a opencbm_plugin_tap_break_t() function */
 
+    opencbm_plugin_batch_t                      * opencbm_plugin_batch;                   /*!< pointer to a opencbm_plugin_batch_t() function */
+    opencbm_plugin_device_status_t              * opencbm_plugin_device_status;           /*!< pointer to a opencbm_plugin_device_status_t() function */
+
 } opencbm_plugin_t;
 
 #endif // #ifndef OPENCBM_PLUGIN_H
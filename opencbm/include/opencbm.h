@@ -147,6 +147,9 @@ EXTERN void CBMAPIDECL cbm_unlock(CBM_FILE f);
 EXTERN const char * CBMAPIDECL cbm_get_driver_name(int port);
 EXTERN const char * CBMAPIDECL cbm_get_driver_name_ex(char * adapter);
 
+EXTERN int CBMAPIDECL cbm_get_config_value(const char *section, const char *entry, char *buffer, size_t size);
+EXTERN int CBMAPIDECL cbm_set_config_value(const char *section, const char *entry, const char *value);
+
 EXTERN int CBMAPIDECL cbm_listen(CBM_FILE f, unsigned char dev, unsigned char secadr);
 EXTERN int CBMAPIDECL cbm_talk(CBM_FILE f, unsigned char dev, unsigned char secadr);
 
@@ -175,11 +178,25 @@ EXTERN void CBMAPIDECL cbm_iec_setrelease(CBM_FILE f, int set, int release);
 EXTERN int CBMAPIDECL cbm_iec_wait(CBM_FILE f, int line, int state);
 
 EXTERN int CBMAPIDECL cbm_upload(CBM_FILE f, unsigned char dev, int adr, const void *prog, size_t size);
+EXTERN int CBMAPIDECL cbm_upload_cached(CBM_FILE f, unsigned char dev, int adr, const void *prog, size_t size);
+EXTERN int CBMAPIDECL cbm_upload_fast(CBM_FILE f, unsigned char dev, int adr, const void *prog, size_t size);
 EXTERN int CBMAPIDECL cbm_download(CBM_FILE f, unsigned char dev, int adr, void *dbuf, size_t size);
 
 EXTERN int CBMAPIDECL cbm_device_status(CBM_FILE f, unsigned char dev, void *buf, size_t bufsize);
 EXTERN int CBMAPIDECL cbm_exec_command(CBM_FILE f, unsigned char dev, const void *cmd, size_t len);
 
+/*! A queue of IEC operations which are executed together, see cbm_batch_begin() */
+typedef struct cbm_batch_s * CBM_BATCH;
+
+EXTERN CBM_BATCH CBMAPIDECL cbm_batch_begin(CBM_FILE f);
+EXTERN int CBMAPIDECL cbm_batch_listen(CBM_BATCH b, unsigned char dev, unsigned char secadr);
+EXTERN int CBMAPIDECL cbm_batch_talk(CBM_BATCH b, unsigned char dev, unsigned char secadr);
+EXTERN int CBMAPIDECL cbm_batch_unlisten(CBM_BATCH b);
+EXTERN int CBMAPIDECL cbm_batch_untalk(CBM_BATCH b);
+EXTERN int CBMAPIDECL cbm_batch_raw_write(CBM_BATCH b, const void *buf, size_t size, int *written);
+EXTERN int CBMAPIDECL cbm_batch_raw_read(CBM_BATCH b, void *buf, size_t size, int *read);
+EXTERN int CBMAPIDECL cbm_batch_submit(CBM_BATCH b);
+
 EXTERN int CBMAPIDECL cbm_identify(CBM_FILE f, unsigned char drv,
                                    enum cbm_device_type_e *t,
                                    const char **type_str);
@@ -200,6 +217,23 @@ EXTERN int CBMAPIDECL gcr_5_to_4_decode(const unsigned char *source, unsigned ch
 EXTERN int CBMAPIDECL gcr_4_to_5_encode(const unsigned char *source, unsigned char *dest,
                                         size_t sourceLength,         size_t destLength);
 
+/*! number of data bytes in a sector */
+#define GCR_BLOCK_SIZE     256
+/*! number of GCR groups of a data block: id, data, checksum and 2 fill bytes */
+#define GCR_BLOCK_GROUPS   65
+/*! number of GCR bytes of a data block */
+#define GCR_BLOCK_GCRSIZE  (GCR_BLOCK_GROUPS * 5)
+
+EXTERN int CBMAPIDECL gcr_5_to_4_decode_groups(const unsigned char *source, unsigned char *dest,
+                                               size_t groups, unsigned char *errors);
+EXTERN void CBMAPIDECL gcr_4_to_5_encode_groups(const unsigned char *source, unsigned char *dest,
+                                                size_t groups);
+EXTERN int CBMAPIDECL gcr_decode_block(const unsigned char *gcr, unsigned char *block,
+                                       unsigned char *errors);
+EXTERN void CBMAPIDECL gcr_encode_block(const unsigned char *block, unsigned char *gcr);
+EXTERN const char * CBMAPIDECL gcr_kernel_name(unsigned int index);
+EXTERN int CBMAPIDECL gcr_select_kernel(const char *name);
+
 
 #if DBG
 EXTERN int CBMAPIDECL cbm_get_debugging_buffer(CBM_FILE HandleDevice, char *buffer, size_t len);
@@ -251,6 +285,7 @@ EXTERN int CBMAPIDECL cbm_tap_break(CBM_FILE f);
 
 /* get function address of the plugin */
 EXTERN void * CBMAPIDECL cbm_get_plugin_function_address(const char * Functionname);
+EXTERN void * CBMAPIDECL cbm_get_plugin_function_address_ex(CBM_FILE f, const char * Functionname);
 
 #ifdef __cplusplus
 }
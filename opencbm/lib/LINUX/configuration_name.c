@@ -39,6 +39,9 @@
 // This string get appended to the OPENCBM_HOME environment variable if it exists
 #define OPENCBM_HOME_CONFIG_FILEPATH "/etc/opencbm.conf"
 
+/*! \brief The name of the per-user configuration file, relative to $HOME */
+#define OPENCBM_USER_CONFIG_FILEPATH "/.opencbm"
+
 /*! \brief Get the default filename for the configuration file
 
  Get the default filename of the configuration file.
@@ -55,3 +58,23 @@ configuration_get_default_filename(void)
     }
     return cbmlibmisc_strdup(OPENCBM_DEFAULT_CONFIGURATION_FILE_NAME);
 }
+
+/*! \brief Get the filename for the per-user configuration file
+
+ Get the filename of the configuration file which holds the settings
+ that are stored by the applications on behalf of the current user.
+ Unlike the default configuration file, the user can write to it.
+
+ \return
+   Returns a newly allocated memory area with the file name, or NULL
+   if $HOME is not set.
+*/
+const char *
+configuration_get_user_filename(void)
+{
+    char* home = getenv("HOME");
+    if (home == NULL || *home == 0) {
+      return NULL;
+    }
+    return cbmlibmisc_strcat(home, OPENCBM_USER_CONFIG_FILEPATH);
+}
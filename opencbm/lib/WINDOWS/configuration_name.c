@@ -90,6 +90,12 @@ get_userdir()
     return get_environment("USERPROFILE");
 }
 
+static char *
+get_appdatadir()
+{
+    return get_environment("APPDATA");
+}
+
 /*! \internal \brief Get a possible filename for the configuration file
 
  This function returns the possible filenames for the configuration
@@ -227,3 +233,27 @@ configuration_get_default_filename_for_install(unsigned int DefaultLocation)
 }
 
 
+
+/*! \brief Get the filename for the per-user configuration file
+
+ Get the filename of the configuration file which holds the settings
+ that are stored by the applications on behalf of the current user.
+ Unlike the default configuration file, the user can write to it.
+
+ \return
+   Returns a newly allocated memory area with the file name, or NULL
+   if %APPDATA% is not set.
+*/
+const char *
+configuration_get_user_filename(void)
+{
+    char * appdatadir = get_appdatadir();
+    char * buffer = NULL;
+
+    if (appdatadir != NULL) {
+        buffer = cbmlibmisc_strcat(appdatadir, "/" FILENAME_CONFIGFILE);
+        free(appdatadir);
+    }
+
+    return buffer;
+}
@@ -165,6 +165,41 @@ SOURCE=..\..\include\opencbm.h
 # Begin Source File
 
 SOURCE=.\opencbm.rc
+# End Source File
+# End Group
+# Begin Group "CA65"
+
+# PROP Default_Filter "a65"
+# Begin Source File
+
+SOURCE=..\uploadboot.a65
+
+!IF  "$(CFG)" == "opencbm - Win32 Release"
+
+# Begin Custom Build
+InputDir=\cygwin\home\tri\cbm\opencbm\lib
+InputPath=..\uploadboot.a65
+InputName=uploadboot
+
+"$(InputDir)\$(InputName).inc" : $(SOURCE) "$(INTDIR)" "$(OUTDIR)"
+	..\..\WINDOWS\buildoneinc ..\.. $(InputPath)
+
+# End Custom Build
+
+!ELSEIF  "$(CFG)" == "opencbm - Win32 Debug"
+
+# Begin Custom Build
+InputDir=\cygwin\home\tri\cbm\opencbm\lib
+InputPath=..\uploadboot.a65
+InputName=uploadboot
+
+"$(InputDir)\$(InputName).inc" : $(SOURCE) "$(INTDIR)" "$(OUTDIR)"
+	..\..\WINDOWS\buildoneinc ..\.. $(InputPath)
+
+# End Custom Build
+
+!ENDIF 
+
 # End Source File
 # End Group
 # Begin Source File
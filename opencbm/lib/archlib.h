@@ -90,6 +90,11 @@ EXTERN opencbm_plugin_pp_dc_read_n_t               opencbm_plugin_pp_dc_read_n;
 EXTERN opencbm_plugin_pp_dc_write_n_t              opencbm_plugin_pp_dc_write_n;
 EXTERN opencbm_plugin_pp_cc_read_n_t               opencbm_plugin_pp_cc_read_n;
 EXTERN opencbm_plugin_pp_cc_write_n_t              opencbm_plugin_pp_cc_write_n;
+EXTERN opencbm_plugin_iec_seq_load_t              opencbm_plugin_iec_seq_load;
+EXTERN opencbm_plugin_iec_seq_read_n_t            opencbm_plugin_iec_seq_read_n;
+EXTERN opencbm_plugin_iec_seq_write_n_t           opencbm_plugin_iec_seq_write_n;
+EXTERN opencbm_plugin_batch_t                     opencbm_plugin_batch;
+EXTERN opencbm_plugin_device_status_t             opencbm_plugin_device_status;
 
 EXTERN opencbm_plugin_iec_dbg_read_t               opencbm_plugin_iec_dbg_read;
 EXTERN opencbm_plugin_iec_dbg_write_t              opencbm_plugin_iec_dbg_write;
@@ -35,6 +35,7 @@
 #define DLL
 #include "opencbm.h"
 #include "archlib.h"
+#include "cbm_int.h"
 
 #include "opencbm-plugin.h"
 
@@ -112,17 +113,100 @@ int plugin_set_inactive(const char PluginName[])
 }
 
 
-/*! \brief @@@@@ \todo document */
+/*! \brief A loaded plugin
+
+ Every plugin is loaded only once, even if several adapters which
+ are handled by it are opened at the same time.
+*/
 struct plugin_information_s {
-    SHARED_OBJECT_HANDLE Library; /*!< \brief @@@@@ \todo document */
-    opencbm_plugin_t     Plugin;  /*!< \brief @@@@@ \todo document */
+    SHARED_OBJECT_HANDLE Library;        /*!< \brief the handle of the loaded plugin library */
+    opencbm_plugin_t     Plugin;         /*!< \brief the entry points of the plugin */
+    char *               Name;           /*!< \brief the name of the plugin, as in the configuration file */
+    unsigned int         ReferenceCount; /*!< \brief the number of users of this plugin */
+    struct plugin_information_s * Next;  /*!< \brief the next loaded plugin */
 };
 
-/*! \brief @@@@@ \todo document */
+/*! \brief A loaded plugin */
 typedef struct plugin_information_s plugin_information_t;
 
+/*! \brief the list of loaded plugins; the one loaded last comes first */
+static
+plugin_information_t * Plugin_list = NULL;
+
+/*! \brief the plugin used if no plugin is loaded; all entry points are NULL */
+static
+plugin_information_t Plugin_none = { 0 };
+
+/*! \brief An opened driver, and the plugin it belongs to
+
+ Every CBM_FILE is handled by the plugin which opened it. This way,
+ several adapters (of the same or of different types) can be used
+ at the same time.
+*/
+struct plugin_handle_s {
+    CBM_FILE               HandleDevice;       /*!< \brief the handle returned by the plugin */
+    plugin_information_t * Plugin_information; /*!< \brief the plugin which handles HandleDevice */
+    unsigned long          DeviceTypeKnown;    /*!< \brief bit n set: DeviceType[n] is valid */
+    enum cbm_device_type_e DeviceType[32];     /*!< \brief the identified devices on the bus */
+    struct plugin_handle_s * Next;             /*!< \brief the next opened driver */
+};
+
+/*! \brief the list of opened drivers */
 static
-struct plugin_information_s Plugin_information = { 0 };
+struct plugin_handle_s * Plugin_handles = NULL;
+
+/*! \internal \brief Find the entry of an opened CBM_FILE
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \return
+   The entry of HandleDevice, or NULL if it is not known.
+*/
+static struct plugin_handle_s *
+cbm_get_plugin_handle(CBM_FILE HandleDevice)
+{
+    struct plugin_handle_s * handle;
+
+    for (handle = Plugin_handles; handle != NULL; handle = handle->Next) {
+        if (handle->HandleDevice == HandleDevice) {
+            break;
+        }
+    }
+
+    return handle;
+}
+
+/*! \internal \brief Find the plugin which handles a CBM_FILE
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \return
+   The plugin which opened HandleDevice. If HandleDevice is not known,
+   the plugin which was loaded last.
+
+ \remark
+   cbm_driver_open_ex() and cbm_driver_close() change the list which
+   is searched here. Thus, they must not run concurrently with other
+   calls into this library; all other functions may be called for
+   different CBM_FILEs from different threads.
+*/
+static plugin_information_t *
+cbm_get_plugin_information(CBM_FILE HandleDevice)
+{
+    struct plugin_handle_s * handle = cbm_get_plugin_handle(HandleDevice);
+
+    if (handle != NULL) {
+        return handle->Plugin_information;
+    }
+
+    return Plugin_list ? Plugin_list : &Plugin_none;
+}
+
+/*! \internal \brief the entry points of the plugin which handles a CBM_FILE */
+#define PLUGIN(_HandleDevice) \
+    (cbm_get_plugin_information(_HandleDevice)->Plugin)
 
 struct plugin_read_pointer
 {
@@ -181,6 +265,8 @@ static struct plugin_read_pointer plugin_pointer_to_read_optional[] =
 	PLUGIN_POINTER_DEF(opencbm_plugin_parallel_burst_write_track),
 	PLUGIN_POINTER_DEF(opencbm_plugin_pp_read),
 	PLUGIN_POINTER_DEF(opencbm_plugin_pp_write),
+	PLUGIN_POINTER_DEF(opencbm_plugin_batch),
+	PLUGIN_POINTER_DEF(opencbm_plugin_device_status),
     PLUGIN_POINTER_END()
 };
 
@@ -340,11 +426,25 @@ read_plugin_pointer_groups(
     return error;
 }
 
+/*! \internal \brief Find the plugin for an adapter in the configuration
+
+ \param Adapter
+   The name of the adapter, or NULL for the default adapter.
+
+ \param PluginName
+   Pointer to a pointer to char which will get the name of the plugin.
+   This data has to be freed with cbmlibmisc_strfree() afterwards!
+
+ \param PluginLocation
+   Pointer to a pointer to char which will get the location of the plugin.
+   This data has to be freed with cbmlibmisc_strfree() afterwards!
+
+ \return
+   0 on success, else an error occurred.
+*/
 static int
-initialize_plugin_pointer(plugin_information_t *Plugin_information, const char * const Adapter)
+get_plugin_location(const char * const Adapter, char ** PluginName, char ** PluginLocation)
 {
-    int error = 1;
-
     const char * configurationFilename = configuration_get_default_filename();
 
     char * plugin_name = NULL;
@@ -418,6 +518,38 @@ initialize_plugin_pointer(plugin_information_t *Plugin_information, const char *
         }
         DBG_PRINT((DBG_PREFIX "Using plugin at '%s'", plugin_location ? plugin_location : "(none)"));
 
+    } while (0);
+
+    cbmlibmisc_strfree(configurationFilename);
+
+    if (plugin_name == NULL || plugin_location == NULL) {
+        cbmlibmisc_strfree(plugin_name);
+        cbmlibmisc_strfree(plugin_location);
+        return 1;
+    }
+
+    *PluginName = plugin_name;
+    *PluginLocation = plugin_location;
+    return 0;
+}
+
+/*! \internal \brief Load a plugin and get its entry points
+
+ \param Plugin_information
+   The plugin_information_t to fill in.
+
+ \param plugin_location
+   The location of the plugin, as returned by get_plugin_location().
+
+ \return
+   0 on success, else an error occurred.
+*/
+static int
+initialize_plugin_pointer(plugin_information_t *Plugin_information, const char * const plugin_location)
+{
+    int error = 1;
+
+    do {
         memset(&Plugin_information->Plugin, 0, sizeof(Plugin_information->Plugin));
 
         Plugin_information->Library = plugin_load(plugin_location);
@@ -450,47 +582,99 @@ initialize_plugin_pointer(plugin_information_t *Plugin_information, const char *
 
     } while (0);
 
-    cbmlibmisc_strfree(plugin_name);
-    cbmlibmisc_strfree(plugin_location);
-    cbmlibmisc_strfree(configurationFilename);
+    if (error && Plugin_information->Library) {
+        plugin_unload(Plugin_information->Library);
+        Plugin_information->Library = NULL;
+    }
 
     return error;
 }
 
+/*! \internal \brief Release a plugin
+
+ The plugin is unloaded when its last user released it.
+
+ \param Plugin_information
+   The plugin, as returned by initialize_plugin().
+*/
 static void
-uninitialize_plugin(void)
+uninitialize_plugin(plugin_information_t *Plugin_information)
 {
-    if (Plugin_information.Library != NULL)
-    {
-        if (Plugin_information.Plugin.opencbm_plugin_uninit) {
-            Plugin_information.Plugin.opencbm_plugin_uninit();
-        }
+    plugin_information_t ** pprev;
 
-        plugin_unload(Plugin_information.Library);
+    if (Plugin_information == NULL || --Plugin_information->ReferenceCount > 0)
+        return;
 
-        Plugin_information.Library = NULL;
+    for (pprev = &Plugin_list; *pprev != NULL; pprev = &(*pprev)->Next) {
+        if (*pprev == Plugin_information) {
+            *pprev = Plugin_information->Next;
+            break;
+        }
+    }
+
+    if (Plugin_information->Plugin.opencbm_plugin_uninit) {
+        Plugin_information->Plugin.opencbm_plugin_uninit();
     }
+
+    plugin_unload(Plugin_information->Library);
+
+    cbmlibmisc_strfree(Plugin_information->Name);
+    free(Plugin_information);
 }
 
-static int
+/*! \internal \brief Get the plugin for an adapter
+
+ If the plugin is already loaded, it is shared; otherwise, it is
+ loaded. Every successful call must be balanced with a call to
+ uninitialize_plugin().
+
+ \param Adapter
+   The name of the adapter, or NULL for the default adapter.
+
+ \return
+   The plugin, or NULL if it could not be loaded.
+*/
+static plugin_information_t *
 initialize_plugin(const char * const Adapter)
 {
-    /* if library is already opened and initialized correctly then 
-       this function returns OK */
-    int error = 0;
+    plugin_information_t * plugin = NULL;
+    char * plugin_name = NULL;
+    char * plugin_location = NULL;
+
+    if (get_plugin_location(Adapter, &plugin_name, &plugin_location) != 0)
+        return NULL;
+
+    for (plugin = Plugin_list; plugin != NULL; plugin = plugin->Next) {
+        if (strcmp(plugin->Name, plugin_name) == 0)
+            break;
+    }
 
     /* init pointers if library was not yet opened */
-    if (Plugin_information.Library == NULL)
+    if (plugin == NULL)
     {
-        /* if pointer init failed then close library and make Library NULL */
-        error = initialize_plugin_pointer(&Plugin_information, Adapter);
-        if(error != 0)
+        plugin = calloc(1, sizeof(*plugin));
+
+        if (plugin != NULL && initialize_plugin_pointer(plugin, plugin_location) == 0)
+        {
+            plugin->Name = plugin_name;
+            plugin_name = NULL;
+            plugin->Next = Plugin_list;
+            Plugin_list = plugin;
+        }
+        else
         {
-            uninitialize_plugin();
+            free(plugin);
+            plugin = NULL;
         }
     }
 
-    return error;
+    if (plugin != NULL)
+        plugin->ReferenceCount++;
+
+    cbmlibmisc_strfree(plugin_name);
+    cbmlibmisc_strfree(plugin_location);
+
+    return plugin;
 }
 
 // #define DBG_DUMP_RAW_READ
@@ -588,7 +772,7 @@ cbm_get_driver_name_ex(char * Adapter)
     char *adapter_stripped = NULL;
     char *port = NULL;
 
-    int error;
+    plugin_information_t * plugin;
 
     FUNC_ENTER();
 
@@ -608,10 +792,10 @@ cbm_get_driver_name_ex(char * Adapter)
             Adapter, adapter_stripped, port));
     }
 
-    error = initialize_plugin(adapter_stripped);
+    plugin = initialize_plugin(adapter_stripped);
 
-    if (error == 0) {
-        ret = Plugin_information.Plugin.opencbm_plugin_get_driver_name(port);
+    if (plugin != NULL) {
+        ret = plugin->Plugin.opencbm_plugin_get_driver_name(port);
     }
     else {
         ret = "NO PLUGIN DRIVER!";
@@ -619,6 +803,8 @@ cbm_get_driver_name_ex(char * Adapter)
 
     buffer = cbmlibmisc_strdup(ret);
 
+    uninitialize_plugin(plugin);
+
     cbmlibmisc_strfree(adapter_stripped);
     cbmlibmisc_strfree(port);
 
@@ -660,6 +846,174 @@ cbm_get_driver_name(int PortNumber)
     FUNC_LEAVE_STRING(cbm_get_driver_name_ex(number));
 }
 
+/*! \internal \brief Read a value from a specific configuration file
+
+ \param Filename
+   The name of the configuration file. If this is NULL, the
+   function fails.
+
+ \param Section
+   The name of the section from where to get the value.
+
+ \param Entry
+   The name of the entry to get.
+
+ \param Buffer
+   Pointer to a buffer which gets the null-terminated value.
+
+ \param BufferSize
+   The size of Buffer, in bytes.
+
+ \return
+   ==0: The entry was found and fit into Buffer.
+   !=0: otherwise; Buffer is not changed.
+*/
+
+static int
+cbm_get_config_value_from_file(const char *Filename, const char *Section, const char *Entry, char *Buffer, size_t BufferSize)
+{
+    int error = 1;
+
+    do {
+        opencbm_configuration_handle handle_configuration;
+        char * value = NULL;
+
+        if (Filename == NULL) {
+            break;
+        }
+
+        handle_configuration = opencbm_configuration_open(Filename);
+
+        if (handle_configuration == NULL) {
+            break;
+        }
+
+        if (opencbm_configuration_get_data(handle_configuration, Section, Entry, &value) == 0
+            && strlen(value) < BufferSize)
+        {
+            strcpy(Buffer, value);
+            error = 0;
+        }
+
+        cbmlibmisc_strfree(value);
+        opencbm_configuration_close(handle_configuration);
+
+    } while (0);
+
+    return error;
+}
+
+/*! \brief Read a value from the OpenCBM configuration file
+
+ Applications can use this to remember settings which belong to a
+ specific setup (adapter, drive) between runs.
+
+ The per-user configuration file (see cbm_set_config_value()) is
+ searched first; if the entry is not found there, the default
+ configuration file is used.
+
+ \param Section
+   The name of the section from where to get the value.
+
+ \param Entry
+   The name of the entry to get.
+
+ \param Buffer
+   Pointer to a buffer which gets the null-terminated value.
+
+ \param BufferSize
+   The size of Buffer, in bytes.
+
+ \return
+   ==0: The entry was found and fit into Buffer.
+   !=0: otherwise; Buffer is not changed.
+*/
+
+int CBMAPIDECL
+cbm_get_config_value(const char *Section, const char *Entry, char *Buffer, size_t BufferSize)
+{
+    const char * configurationFilename;
+    int error = 1;
+
+    FUNC_ENTER();
+
+    if (Buffer != NULL && BufferSize != 0) {
+        configurationFilename = configuration_get_user_filename();
+        error = cbm_get_config_value_from_file(configurationFilename, Section, Entry, Buffer, BufferSize);
+        cbmlibmisc_strfree(configurationFilename);
+
+        if (error) {
+            configurationFilename = configuration_get_default_filename();
+            error = cbm_get_config_value_from_file(configurationFilename, Section, Entry, Buffer, BufferSize);
+            cbmlibmisc_strfree(configurationFilename);
+        }
+    }
+
+    FUNC_LEAVE_INT(error);
+}
+
+/*! \brief Store a value in the per-user OpenCBM configuration file
+
+ Stores a value which can be read back with cbm_get_config_value().
+ If the entry already exists, it is overwritten.
+
+ The value is written to the per-user configuration file ($HOME/.opencbm
+ on Linux and Mac OS X, %APPDATA%\\opencbm.conf on Windows), which is
+ created if it does not exist yet. The default configuration file is
+ never changed, as it is normally not writeable for the current user.
+
+ \param Section
+   The name of the section where to store the value.
+
+ \param Entry
+   The name of the entry to store.
+
+ \param Value
+   The null-terminated value to store.
+
+ \return
+   ==0: The value has been written to the configuration file.
+   !=0: otherwise, for example, if the location of the per-user
+        configuration file is not known or it cannot be written.
+*/
+
+int CBMAPIDECL
+cbm_set_config_value(const char *Section, const char *Entry, const char *Value)
+{
+    const char * configurationFilename = configuration_get_user_filename();
+    int error = 1;
+
+    FUNC_ENTER();
+
+    do {
+        opencbm_configuration_handle handle_configuration;
+
+        if (configurationFilename == NULL) {
+            DBG_ERROR((DBG_PREFIX "no location for the per-user configuration file\n"));
+            break;
+        }
+
+        handle_configuration = opencbm_configuration_create(configurationFilename);
+
+        if (handle_configuration == NULL) {
+            DBG_ERROR((DBG_PREFIX "cannot create '%s'\n", configurationFilename));
+            break;
+        }
+
+        error = opencbm_configuration_set_data(handle_configuration, Section, Entry, Value);
+
+        if (opencbm_configuration_close(handle_configuration) != 0) {
+            DBG_ERROR((DBG_PREFIX "cannot write '%s'\n", configurationFilename));
+            error = 1;
+        }
+
+    } while (0);
+
+    cbmlibmisc_strfree(configurationFilename);
+
+    FUNC_LEAVE_INT(error);
+}
+
 /*! \brief Opens the driver, extended version
 
  This function Opens the driver.
@@ -682,9 +1036,11 @@ cbm_get_driver_name(int PortNumber)
 int CBMAPIDECL 
 cbm_driver_open_ex(CBM_FILE *HandleDevice, char * Adapter)
 {
-    int error;
+    int error = 1;
     char * port = NULL;
     char * adapter_stripped = NULL;
+    plugin_information_t * plugin;
+    struct plugin_handle_s * handle;
 
     FUNC_ENTER();
 
@@ -698,12 +1054,28 @@ cbm_driver_open_ex(CBM_FILE *HandleDevice, char * Adapter)
             Adapter, adapter_stripped, port));
     }
 
-    error = initialize_plugin(adapter_stripped);
+    plugin = initialize_plugin(adapter_stripped);
 
     cbmlibmisc_strfree(adapter_stripped);
 
+    handle = malloc(sizeof(*handle));
+
+    if (plugin != NULL && handle != NULL) {
+        error = plugin->Plugin.opencbm_plugin_driver_open(HandleDevice, port);
+    }
+
     if (error == 0) {
-        error = Plugin_information.Plugin.opencbm_plugin_driver_open(HandleDevice, port);
+        // remember which plugin handles this CBM_FILE
+
+        handle->HandleDevice = *HandleDevice;
+        handle->Plugin_information = plugin;
+        handle->DeviceTypeKnown = 0;
+        handle->Next = Plugin_handles;
+        Plugin_handles = handle;
+    }
+    else {
+        free(handle);
+        uninitialize_plugin(plugin);
     }
 
     cbmlibmisc_strfree(port);
@@ -767,11 +1139,26 @@ cbm_driver_open(CBM_FILE *HandleDevice, int PortNumber)
 void CBMAPIDECL
 cbm_driver_close(CBM_FILE HandleDevice)
 {
+    struct plugin_handle_s ** pprev;
+    struct plugin_handle_s * handle;
+
     FUNC_ENTER();
 
-    Plugin_information.Plugin.opencbm_plugin_driver_close(HandleDevice);
+    for (pprev = &Plugin_handles; *pprev != NULL; pprev = &(*pprev)->Next) {
+        if ((*pprev)->HandleDevice == HandleDevice) {
+            break;
+        }
+    }
+
+    handle = *pprev;
 
-    uninitialize_plugin();
+    if (handle != NULL) {
+        handle->Plugin_information->Plugin.opencbm_plugin_driver_close(HandleDevice);
+
+        *pprev = handle->Next;
+        uninitialize_plugin(handle->Plugin_information);
+        free(handle);
+    }
 
     FUNC_LEAVE();
 }
@@ -805,8 +1192,8 @@ cbm_lock(CBM_FILE HandleDevice)
 {
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_lock)
-        Plugin_information.Plugin.opencbm_plugin_lock(HandleDevice);
+    if (PLUGIN(HandleDevice).opencbm_plugin_lock)
+        PLUGIN(HandleDevice).opencbm_plugin_lock(HandleDevice);
 
     FUNC_LEAVE();
 }
@@ -833,8 +1220,8 @@ cbm_unlock(CBM_FILE HandleDevice)
 {
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_unlock)
-        Plugin_information.Plugin.opencbm_plugin_unlock(HandleDevice);
+    if (PLUGIN(HandleDevice).opencbm_plugin_unlock)
+        PLUGIN(HandleDevice).opencbm_plugin_unlock(HandleDevice);
 
     FUNC_LEAVE();
 }
@@ -875,7 +1262,7 @@ cbm_raw_write(CBM_FILE HandleDevice, const void *Buffer, size_t Count)
     DBG_MEMDUMP("cbm_raw_write", Buffer, Count);
 #endif
 
-    FUNC_LEAVE_INT(Plugin_information.Plugin.opencbm_plugin_raw_write(HandleDevice,Buffer, Count));
+    FUNC_LEAVE_INT(PLUGIN(HandleDevice).opencbm_plugin_raw_write(HandleDevice,Buffer, Count));
 }
 
 
@@ -909,7 +1296,7 @@ cbm_raw_read(CBM_FILE HandleDevice, void *Buffer, size_t Count)
 
     FUNC_ENTER();
 
-    bytesRead = Plugin_information.Plugin.opencbm_plugin_raw_read(HandleDevice, Buffer, Count);
+    bytesRead = PLUGIN(HandleDevice).opencbm_plugin_raw_read(HandleDevice, Buffer, Count);
 
 #ifdef DBG_DUMP_RAW_READ
     DBG_MEMDUMP("cbm_raw_read", Buffer, bytesRead);
@@ -946,7 +1333,7 @@ cbm_listen(CBM_FILE HandleDevice, unsigned char DeviceAddress, unsigned char Sec
 {
     FUNC_ENTER();
 
-    FUNC_LEAVE_INT(Plugin_information.Plugin.opencbm_plugin_listen(HandleDevice, DeviceAddress, SecondaryAddress));
+    FUNC_LEAVE_INT(PLUGIN(HandleDevice).opencbm_plugin_listen(HandleDevice, DeviceAddress, SecondaryAddress));
 }
 
 /*! \brief Send a TALK on the IEC serial bus
@@ -977,7 +1364,7 @@ cbm_talk(CBM_FILE HandleDevice, unsigned char DeviceAddress, unsigned char Secon
 {
     FUNC_ENTER();
 
-    FUNC_LEAVE_INT(Plugin_information.Plugin.opencbm_plugin_talk(HandleDevice, DeviceAddress, SecondaryAddress));
+    FUNC_LEAVE_INT(PLUGIN(HandleDevice).opencbm_plugin_talk(HandleDevice, DeviceAddress, SecondaryAddress));
 }
 
 /*! \brief Open a file on the IEC serial bus
@@ -1016,7 +1403,7 @@ cbm_open(CBM_FILE HandleDevice, unsigned char DeviceAddress, unsigned char Secon
 
     FUNC_ENTER();
 
-    returnValue = Plugin_information.Plugin.opencbm_plugin_open(HandleDevice, DeviceAddress, SecondaryAddress);
+    returnValue = PLUGIN(HandleDevice).opencbm_plugin_open(HandleDevice, DeviceAddress, SecondaryAddress);
 
     if (returnValue == 0)
     {
@@ -1073,7 +1460,7 @@ cbm_close(CBM_FILE HandleDevice, unsigned char DeviceAddress, unsigned char Seco
 {
     FUNC_ENTER();
 
-    FUNC_LEAVE_INT(Plugin_information.Plugin.opencbm_plugin_close(HandleDevice, DeviceAddress, SecondaryAddress));
+    FUNC_LEAVE_INT(PLUGIN(HandleDevice).opencbm_plugin_close(HandleDevice, DeviceAddress, SecondaryAddress));
 }
 
 /*! \brief Send an UNLISTEN on the IEC serial bus
@@ -1101,7 +1488,7 @@ cbm_unlisten(CBM_FILE HandleDevice)
 {
     FUNC_ENTER();
 
-    FUNC_LEAVE_INT(Plugin_information.Plugin.opencbm_plugin_unlisten(HandleDevice));
+    FUNC_LEAVE_INT(PLUGIN(HandleDevice).opencbm_plugin_unlisten(HandleDevice));
 }
 
 /*! \brief Send an UNTALK on the IEC serial bus
@@ -1129,7 +1516,7 @@ cbm_untalk(CBM_FILE HandleDevice)
 {
     FUNC_ENTER();
 
-    FUNC_LEAVE_INT(Plugin_information.Plugin.opencbm_plugin_untalk(HandleDevice));
+    FUNC_LEAVE_INT(PLUGIN(HandleDevice).opencbm_plugin_untalk(HandleDevice));
 }
 
 
@@ -1158,7 +1545,7 @@ cbm_get_eoi(CBM_FILE HandleDevice)
 {
     FUNC_ENTER();
 
-    FUNC_LEAVE_INT(Plugin_information.Plugin.opencbm_plugin_get_eoi(HandleDevice));
+    FUNC_LEAVE_INT(PLUGIN(HandleDevice).opencbm_plugin_get_eoi(HandleDevice));
 }
 
 /*! \brief Reset the EOI flag
@@ -1181,7 +1568,7 @@ cbm_clear_eoi(CBM_FILE HandleDevice)
 {
     FUNC_ENTER();
 
-    FUNC_LEAVE_INT(Plugin_information.Plugin.opencbm_plugin_clear_eoi(HandleDevice));
+    FUNC_LEAVE_INT(PLUGIN(HandleDevice).opencbm_plugin_clear_eoi(HandleDevice));
 }
 
 /*! \brief RESET all devices
@@ -1208,9 +1595,66 @@ cbm_clear_eoi(CBM_FILE HandleDevice)
 int CBMAPIDECL
 cbm_reset(CBM_FILE HandleDevice)
 {
+    struct plugin_handle_s * handle;
+
     FUNC_ENTER();
 
-    FUNC_LEAVE_INT(Plugin_information.Plugin.opencbm_plugin_reset(HandleDevice));
+    handle = cbm_get_plugin_handle(HandleDevice);
+
+    // the devices on the bus may be different after a reset
+
+    if (handle != NULL) {
+        handle->DeviceTypeKnown = 0;
+    }
+
+    FUNC_LEAVE_INT(PLUGIN(HandleDevice).opencbm_plugin_reset(HandleDevice));
+}
+
+/*! \internal \brief Identify a device, and remember the result
+
+ Like cbm_identify(), but the device type is only determined once
+ per CBM_FILE and device address (until the next cbm_reset()).
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param DeviceAddress
+   The address of the device on the IEC serial bus.
+
+ \param CbmDeviceType
+   Pointer to an enum which will hold the type of the device.
+
+ \return
+   0 if the device could be identified, != 0 on error.
+*/
+
+int
+cbm_identify_cached(CBM_FILE HandleDevice, unsigned char DeviceAddress,
+                    enum cbm_device_type_e *CbmDeviceType)
+{
+    struct plugin_handle_s * handle;
+    int error;
+
+    FUNC_ENTER();
+
+    handle = cbm_get_plugin_handle(HandleDevice);
+
+    if (handle != NULL && DeviceAddress < 32
+        && (handle->DeviceTypeKnown & (1ul << DeviceAddress)))
+    {
+        *CbmDeviceType = handle->DeviceType[DeviceAddress];
+        FUNC_LEAVE_INT(0);
+    }
+
+    error = cbm_identify(HandleDevice, DeviceAddress, CbmDeviceType, NULL);
+
+    if (error == 0 && handle != NULL && DeviceAddress < 32)
+    {
+        handle->DeviceType[DeviceAddress] = *CbmDeviceType;
+        handle->DeviceTypeKnown |= 1ul << DeviceAddress;
+    }
+
+    FUNC_LEAVE_INT(error);
 }
 
 
@@ -1247,8 +1691,8 @@ cbm_pp_read(CBM_FILE HandleDevice)
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_pp_read)
-        ret = Plugin_information.Plugin.opencbm_plugin_pp_read(HandleDevice);
+    if (PLUGIN(HandleDevice).opencbm_plugin_pp_read)
+        ret = PLUGIN(HandleDevice).opencbm_plugin_pp_read(HandleDevice);
 
     FUNC_LEAVE_UCHAR(ret);
 }
@@ -1283,8 +1727,8 @@ cbm_pp_write(CBM_FILE HandleDevice, unsigned char Byte)
 {
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_pp_write)
-        Plugin_information.Plugin.opencbm_plugin_pp_write(HandleDevice, Byte);
+    if (PLUGIN(HandleDevice).opencbm_plugin_pp_write)
+        PLUGIN(HandleDevice).opencbm_plugin_pp_write(HandleDevice, Byte);
 
     FUNC_LEAVE();
 }
@@ -1315,7 +1759,7 @@ cbm_iec_poll(CBM_FILE HandleDevice)
 {
     FUNC_ENTER();
 
-    FUNC_LEAVE_INT(Plugin_information.Plugin.opencbm_plugin_iec_poll(HandleDevice));
+    FUNC_LEAVE_INT(PLUGIN(HandleDevice).opencbm_plugin_iec_poll(HandleDevice));
 }
 
 
@@ -1342,10 +1786,10 @@ cbm_iec_set(CBM_FILE HandleDevice, int Line)
 {
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_iec_set)
-        Plugin_information.Plugin.opencbm_plugin_iec_set(HandleDevice, Line);
+    if (PLUGIN(HandleDevice).opencbm_plugin_iec_set)
+        PLUGIN(HandleDevice).opencbm_plugin_iec_set(HandleDevice, Line);
     else
-        Plugin_information.Plugin.opencbm_plugin_iec_setrelease(HandleDevice, Line, 0);
+        PLUGIN(HandleDevice).opencbm_plugin_iec_setrelease(HandleDevice, Line, 0);
 
     FUNC_LEAVE();
 }
@@ -1373,10 +1817,10 @@ cbm_iec_release(CBM_FILE HandleDevice, int Line)
 {
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_iec_release)
-        Plugin_information.Plugin.opencbm_plugin_iec_release(HandleDevice, Line);
+    if (PLUGIN(HandleDevice).opencbm_plugin_iec_release)
+        PLUGIN(HandleDevice).opencbm_plugin_iec_release(HandleDevice, Line);
     else
-        Plugin_information.Plugin.opencbm_plugin_iec_setrelease(HandleDevice, 0, Line);
+        PLUGIN(HandleDevice).opencbm_plugin_iec_setrelease(HandleDevice, 0, Line);
 
     FUNC_LEAVE();
 }
@@ -1413,7 +1857,7 @@ cbm_iec_setrelease(CBM_FILE HandleDevice, int Set, int Release)
 {
     FUNC_ENTER();
 
-    Plugin_information.Plugin.opencbm_plugin_iec_setrelease(HandleDevice, Set, Release);
+    PLUGIN(HandleDevice).opencbm_plugin_iec_setrelease(HandleDevice, Set, Release);
 
     FUNC_LEAVE();
 }
@@ -1449,7 +1893,7 @@ cbm_iec_wait(CBM_FILE HandleDevice, int Line, int State)
 {
     FUNC_ENTER();
 
-    FUNC_LEAVE_INT(Plugin_information.Plugin.opencbm_plugin_iec_wait(HandleDevice, Line, State));
+    FUNC_LEAVE_INT(PLUGIN(HandleDevice).opencbm_plugin_iec_wait(HandleDevice, Line, State));
 }
 
 /*! \brief Get the (logical) state of a line on the IEC serial bus
@@ -1478,7 +1922,7 @@ cbm_iec_get(CBM_FILE HandleDevice, int Line)
 {
     FUNC_ENTER();
 
-    FUNC_LEAVE_INT((Plugin_information.Plugin.opencbm_plugin_iec_poll(HandleDevice)&Line) != 0 ? 1 : 0);
+    FUNC_LEAVE_INT((PLUGIN(HandleDevice).opencbm_plugin_iec_poll(HandleDevice)&Line) != 0 ? 1 : 0);
 }
 
 
@@ -1526,6 +1970,7 @@ cbm_device_status(CBM_FILE HandleDevice, unsigned char DeviceAddress,
                   void *Buffer, size_t BufferLength)
 {
     int retValue;
+    int bytesRead;
 
     FUNC_ENTER();
 
@@ -1547,15 +1992,33 @@ cbm_device_status(CBM_FILE HandleDevice, unsigned char DeviceAddress,
 
         strncpy(bufferToWrite, "99, DRIVER ERROR,00,00\r", BufferLength);
 
-        // Now, ask the drive for its error status:
+        // Now, ask the drive for its error status. If the plugin can
+        // do it on its own, this saves some round trips to the device.
+
+        bytesRead = -1;
+        if (PLUGIN(HandleDevice).opencbm_plugin_device_status)
+        {
+            bytesRead = PLUGIN(HandleDevice).opencbm_plugin_device_status(HandleDevice,
+                DeviceAddress, bufferToWrite, BufferLength - 1);
+
+            DBG_ASSERT(bytesRead < 0 || (size_t) bytesRead < BufferLength);
+
+            if (bytesRead >= 0)
+            {
+                bufferToWrite[bytesRead] = '\0';
+            }
+        }
 
-        if (cbm_talk(HandleDevice, DeviceAddress, 15) == 0)
+        if (bytesRead == -1 && cbm_talk(HandleDevice, DeviceAddress, 15) == 0)
         {
-            unsigned int bytesRead;
-            
             bytesRead = cbm_raw_read(HandleDevice, bufferToWrite, BufferLength - 1);
 
-            DBG_ASSERT(bytesRead <= BufferLength);
+            if (bytesRead < 0)
+            {
+                bytesRead = 0;
+            }
+
+            DBG_ASSERT((size_t) bytesRead <= BufferLength);
 
             // make sure we have a trailing zero at the end of the status:
 
@@ -1614,6 +2077,424 @@ cbm_exec_command(CBM_FILE HandleDevice, unsigned char DeviceAddress,
     FUNC_LEAVE_INT(rv);
 }
 
+/*! \internal \brief A queue of IEC operations
+
+ This is the internal representation of a CBM_BATCH.
+*/
+struct cbm_batch_s {
+    CBM_FILE HandleDevice;                  /*!< the driver the batch is executed on */
+    opencbm_plugin_batch_op_t * Operations; /*!< the queued operations */
+    int ** Results;                         /*!< for every operation: where to report its result, or NULL */
+    unsigned int Count;                     /*!< the number of queued operations */
+    unsigned int Allocated;                 /*!< the number of operations Operations and Results have room for */
+    int Error;                              /*!< set if an operation could not be queued */
+};
+
+/*! \brief Start a batch of IEC operations
+
+ This function starts a new batch. Operations queued with the
+ cbm_batch_...() functions are not executed immediately, but all
+ together by cbm_batch_submit(). This allows the plugin to execute
+ the batch with as few round trips to the device as possible.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \return
+   The new batch, or NULL if there is not enough memory. It is
+   legal to pass NULL to the other cbm_batch_...() functions;
+   they will fail then.
+
+ If cbm_driver_open() did not succeed, it is illegal to 
+ call this function.
+*/
+
+CBM_BATCH CBMAPIDECL
+cbm_batch_begin(CBM_FILE HandleDevice)
+{
+    CBM_BATCH batch;
+
+    FUNC_ENTER();
+
+    batch = calloc(1, sizeof(*batch));
+    if (batch)
+    {
+        batch->HandleDevice = HandleDevice;
+    }
+
+    FUNC_LEAVE_PTR(batch, CBM_BATCH);
+}
+
+/*! \internal \brief Queue an operation in a batch
+
+ \param Batch
+   The batch to add the operation to.
+
+ \param Operation
+   The operation to add.
+
+ \param DeviceAddress
+   The device address for listen and talk.
+
+ \param SecondaryAddress
+   The secondary address for listen and talk.
+
+ \param Buffer
+   The buffer for raw_write and raw_read.
+
+ \param Count
+   The length of Buffer.
+
+ \param Result
+   Where to store the result of the operation after it has been
+   executed, or NULL.
+
+ \return
+   0 on success, -1 if there was not enough memory. In this case,
+   cbm_batch_submit() will fail without executing anything.
+*/
+
+static int
+cbm_batch_add(CBM_BATCH Batch, enum opencbm_plugin_batch_operation_e Operation,
+              unsigned char DeviceAddress, unsigned char SecondaryAddress,
+              void *Buffer, size_t Count, int *Result)
+{
+    opencbm_plugin_batch_op_t *op;
+
+    if (Batch == NULL || Batch->Error)
+        return -1;
+
+    if (Batch->Count == Batch->Allocated)
+    {
+        unsigned int allocate = Batch->Allocated ? 2 * Batch->Allocated : 8;
+        void *operations, *results;
+
+        operations = realloc(Batch->Operations, allocate * sizeof(*Batch->Operations));
+        if (operations)
+            Batch->Operations = operations;
+
+        results = realloc(Batch->Results, allocate * sizeof(*Batch->Results));
+        if (results)
+            Batch->Results = results;
+
+        if (operations == NULL || results == NULL)
+        {
+            Batch->Error = 1;
+            return -1;
+        }
+        Batch->Allocated = allocate;
+    }
+
+    op = &Batch->Operations[Batch->Count];
+    op->Operation = Operation;
+    op->DeviceAddress = DeviceAddress;
+    op->SecondaryAddress = SecondaryAddress;
+    op->Buffer = Buffer;
+    op->Count = Count;
+    op->Result = -1;
+
+    Batch->Results[Batch->Count++] = Result;
+
+    return 0;
+}
+
+/*! \brief Queue a LISTEN in a batch
+
+ See cbm_listen(). If the LISTEN fails when the batch is executed,
+ the remaining operations of the batch are not executed.
+
+ \param Batch
+   The batch, as returned by cbm_batch_begin().
+
+ \param DeviceAddress
+   The address of the device on the IEC serial bus. This
+   is known as primary address, too.
+
+ \param SecondaryAddress
+   The secondary address for the device on the IEC serial bus.
+
+ \return
+   0 if the operation was queued, else failure.
+*/
+
+int CBMAPIDECL
+cbm_batch_listen(CBM_BATCH Batch, unsigned char DeviceAddress, unsigned char SecondaryAddress)
+{
+    FUNC_ENTER();
+
+    FUNC_LEAVE_INT(cbm_batch_add(Batch, opencbm_batch_listen,
+        DeviceAddress, SecondaryAddress, NULL, 0, NULL));
+}
+
+/*! \brief Queue a TALK in a batch
+
+ See cbm_talk(). If the TALK fails when the batch is executed,
+ the remaining operations of the batch are not executed.
+
+ \param Batch
+   The batch, as returned by cbm_batch_begin().
+
+ \param DeviceAddress
+   The address of the device on the IEC serial bus. This
+   is known as primary address, too.
+
+ \param SecondaryAddress
+   The secondary address for the device on the IEC serial bus.
+
+ \return
+   0 if the operation was queued, else failure.
+*/
+
+int CBMAPIDECL
+cbm_batch_talk(CBM_BATCH Batch, unsigned char DeviceAddress, unsigned char SecondaryAddress)
+{
+    FUNC_ENTER();
+
+    FUNC_LEAVE_INT(cbm_batch_add(Batch, opencbm_batch_talk,
+        DeviceAddress, SecondaryAddress, NULL, 0, NULL));
+}
+
+/*! \brief Queue an UNLISTEN in a batch
+
+ See cbm_unlisten().
+
+ \param Batch
+   The batch, as returned by cbm_batch_begin().
+
+ \return
+   0 if the operation was queued, else failure.
+*/
+
+int CBMAPIDECL
+cbm_batch_unlisten(CBM_BATCH Batch)
+{
+    FUNC_ENTER();
+
+    FUNC_LEAVE_INT(cbm_batch_add(Batch, opencbm_batch_unlisten, 0, 0, NULL, 0, NULL));
+}
+
+/*! \brief Queue an UNTALK in a batch
+
+ See cbm_untalk().
+
+ \param Batch
+   The batch, as returned by cbm_batch_begin().
+
+ \return
+   0 if the operation was queued, else failure.
+*/
+
+int CBMAPIDECL
+cbm_batch_untalk(CBM_BATCH Batch)
+{
+    FUNC_ENTER();
+
+    FUNC_LEAVE_INT(cbm_batch_add(Batch, opencbm_batch_untalk, 0, 0, NULL, 0, NULL));
+}
+
+/*! \brief Queue writing data to the IEC serial bus in a batch
+
+ See cbm_raw_write(). The data is copied, so the buffer does not
+ need to stay valid until the batch is submitted.
+
+ \param Batch
+   The batch, as returned by cbm_batch_begin().
+
+ \param Buffer
+   Pointer to a buffer which hold the bytes to write to the bus.
+
+ \param Count
+   Number of bytes to be written.
+
+ \param BytesWritten
+   Pointer to an int which receives the result of cbm_raw_write()
+   once the batch has been submitted, or NULL. It is set to -1 if
+   the operation was not executed.
+
+ \return
+   0 if the operation was queued, else failure.
+*/
+
+int CBMAPIDECL
+cbm_batch_raw_write(CBM_BATCH Batch, const void *Buffer, size_t Count, int *BytesWritten)
+{
+    void *data = NULL;
+    int ret;
+
+    FUNC_ENTER();
+
+    if (Batch && Count > 0)
+    {
+        data = malloc(Count);
+        if (data)
+            memcpy(data, Buffer, Count);
+        else
+            Batch->Error = 1;
+    }
+
+    ret = cbm_batch_add(Batch, opencbm_batch_raw_write, 0, 0, data, Count, BytesWritten);
+    if (ret != 0)
+        free(data);
+
+    FUNC_LEAVE_INT(ret);
+}
+
+/*! \brief Queue reading data from the IEC serial bus in a batch
+
+ See cbm_raw_read().
+
+ \param Batch
+   The batch, as returned by cbm_batch_begin().
+
+ \param Buffer
+   Pointer to a buffer which will hold the bytes read. It must stay
+   valid until the batch has been submitted.
+
+ \param Count
+   Number of bytes to be read at most.
+
+ \param BytesRead
+   Pointer to an int which receives the result of cbm_raw_read()
+   once the batch has been submitted, or NULL. It is set to -1 if
+   the operation was not executed.
+
+ \return
+   0 if the operation was queued, else failure.
+*/
+
+int CBMAPIDECL
+cbm_batch_raw_read(CBM_BATCH Batch, void *Buffer, size_t Count, int *BytesRead)
+{
+    FUNC_ENTER();
+
+    FUNC_LEAVE_INT(cbm_batch_add(Batch, opencbm_batch_raw_read, 0, 0, Buffer, Count, BytesRead));
+}
+
+/*! \internal \brief Check if a batch operation failed
+
+ \param Operation
+   The executed operation.
+
+ \return
+   1 if executing the batch must stop after this operation, else 0.
+*/
+
+static int
+cbm_batch_op_failed(const opencbm_plugin_batch_op_t *Operation)
+{
+    switch (Operation->Operation)
+    {
+    case opencbm_batch_listen:
+    case opencbm_batch_talk:
+        return Operation->Result != 0;
+
+    case opencbm_batch_raw_write:
+    case opencbm_batch_raw_read:
+        return Operation->Result < 0;
+
+    default:
+        return 0;
+    }
+}
+
+/*! \brief Execute a batch of IEC operations
+
+ This function executes all operations queued in the batch, in
+ order. If the plugin supports it, this is done with as few round
+ trips to the device as possible; otherwise, the operations are
+ executed one by one. Execution stops after a LISTEN or TALK fails
+ or a read or write returns an error.
+
+ Afterwards, the batch is released, regardless of the result.
+
+ \param Batch
+   The batch, as returned by cbm_batch_begin().
+
+ \return
+   0 if all operations were executed, -1 if not (in this case, the
+   results of the operations which were not executed are -1).
+*/
+
+int CBMAPIDECL
+cbm_batch_submit(CBM_BATCH Batch)
+{
+    opencbm_plugin_batch_op_t *op;
+    unsigned int i;
+    int executed = -1;
+
+    FUNC_ENTER();
+
+    if (Batch == NULL)
+        FUNC_LEAVE_INT(-1);
+
+    if (!Batch->Error && Batch->Count > 0)
+    {
+        if (PLUGIN(Batch->HandleDevice).opencbm_plugin_batch)
+        {
+            executed = PLUGIN(Batch->HandleDevice).opencbm_plugin_batch(Batch->HandleDevice,
+                Batch->Operations, Batch->Count);
+        }
+
+        // The plugin cannot do it (or has no support), so execute one by one
+
+        if (executed < 0)
+        {
+            for (executed = 0; executed < (int) Batch->Count; executed++)
+            {
+                op = &Batch->Operations[executed];
+
+                switch (op->Operation)
+                {
+                case opencbm_batch_listen:
+                    op->Result = cbm_listen(Batch->HandleDevice, op->DeviceAddress, op->SecondaryAddress);
+                    break;
+                case opencbm_batch_talk:
+                    op->Result = cbm_talk(Batch->HandleDevice, op->DeviceAddress, op->SecondaryAddress);
+                    break;
+                case opencbm_batch_unlisten:
+                    op->Result = cbm_unlisten(Batch->HandleDevice);
+                    break;
+                case opencbm_batch_untalk:
+                    op->Result = cbm_untalk(Batch->HandleDevice);
+                    break;
+                case opencbm_batch_raw_write:
+                    op->Result = cbm_raw_write(Batch->HandleDevice, op->Buffer, op->Count);
+                    break;
+                case opencbm_batch_raw_read:
+                    op->Result = cbm_raw_read(Batch->HandleDevice, op->Buffer, op->Count);
+                    break;
+                }
+
+                if (cbm_batch_op_failed(op))
+                    break;
+            }
+        }
+    }
+    else if (Batch->Count == 0)
+    {
+        executed = 0;
+    }
+
+    for (i = 0; i < Batch->Count; i++)
+    {
+        op = &Batch->Operations[i];
+
+        if (Batch->Results[i])
+            *Batch->Results[i] = op->Result;
+
+        if (op->Operation == opencbm_batch_raw_write)
+            free(op->Buffer);
+    }
+
+    i = Batch->Count;
+
+    free(Batch->Operations);
+    free(Batch->Results);
+    free(Batch);
+
+    FUNC_LEAVE_INT(executed == (int) i ? 0 : -1);
+}
+
 /*! \brief PARBURST: Read from the parallel port
 
  This function is a helper function for parallel burst:
@@ -1638,8 +2519,8 @@ cbm_parallel_burst_read(CBM_FILE HandleDevice)
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_parallel_burst_read)
-        ret = Plugin_information.Plugin.opencbm_plugin_parallel_burst_read(HandleDevice);
+    if (PLUGIN(HandleDevice).opencbm_plugin_parallel_burst_read)
+        ret = PLUGIN(HandleDevice).opencbm_plugin_parallel_burst_read(HandleDevice);
 
     FUNC_LEAVE_UCHAR(ret);
 }
@@ -1666,8 +2547,8 @@ cbm_parallel_burst_write(CBM_FILE HandleDevice, unsigned char Value)
 {
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_parallel_burst_write)
-        Plugin_information.Plugin.opencbm_plugin_parallel_burst_write(HandleDevice, Value);
+    if (PLUGIN(HandleDevice).opencbm_plugin_parallel_burst_write)
+        PLUGIN(HandleDevice).opencbm_plugin_parallel_burst_write(HandleDevice, Value);
 
     FUNC_LEAVE();
 }
@@ -1681,12 +2562,12 @@ cbm_parallel_burst_read_n(CBM_FILE HandleDevice, unsigned char *Buffer,
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_parallel_burst_read_n) {
-        rv = Plugin_information.Plugin.opencbm_plugin_parallel_burst_read_n(
+    if (PLUGIN(HandleDevice).opencbm_plugin_parallel_burst_read_n) {
+        rv = PLUGIN(HandleDevice).opencbm_plugin_parallel_burst_read_n(
             HandleDevice, Buffer, Length);
     } else {
         for (i = 0; i < Length; i++) {
-            Buffer[i] = Plugin_information.Plugin
+            Buffer[i] = PLUGIN(HandleDevice)
                 .opencbm_plugin_parallel_burst_read(HandleDevice);
         }
         rv = Length;
@@ -1704,12 +2585,12 @@ cbm_parallel_burst_write_n(CBM_FILE HandleDevice, unsigned char *Buffer,
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_parallel_burst_write_n) {
-        rv = Plugin_information.Plugin.opencbm_plugin_parallel_burst_write_n(
+    if (PLUGIN(HandleDevice).opencbm_plugin_parallel_burst_write_n) {
+        rv = PLUGIN(HandleDevice).opencbm_plugin_parallel_burst_write_n(
             HandleDevice, Buffer, Length);
     } else {
         for (i = 0; i < Length; i++) {
-            Plugin_information.Plugin.opencbm_plugin_parallel_burst_write(
+            PLUGIN(HandleDevice).opencbm_plugin_parallel_burst_write(
                 HandleDevice, Buffer[i]);
         }
         rv = Length;
@@ -1749,8 +2630,8 @@ cbm_parallel_burst_read_track(CBM_FILE HandleDevice, unsigned char *Buffer, unsi
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_parallel_burst_read_track)
-        ret = Plugin_information.Plugin.opencbm_plugin_parallel_burst_read_track(HandleDevice, Buffer, Length);
+    if (PLUGIN(HandleDevice).opencbm_plugin_parallel_burst_read_track)
+        ret = PLUGIN(HandleDevice).opencbm_plugin_parallel_burst_read_track(HandleDevice, Buffer, Length);
 
     FUNC_LEAVE_INT(ret);
 }
@@ -1783,8 +2664,8 @@ cbm_parallel_burst_read_track_var(CBM_FILE HandleDevice, unsigned char *Buffer,
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_parallel_burst_read_track)
-        ret = Plugin_information.Plugin.opencbm_plugin_parallel_burst_read_track_var(HandleDevice, Buffer, Length);
+    if (PLUGIN(HandleDevice).opencbm_plugin_parallel_burst_read_track)
+        ret = PLUGIN(HandleDevice).opencbm_plugin_parallel_burst_read_track_var(HandleDevice, Buffer, Length);
 
     FUNC_LEAVE_INT(ret);
 }
@@ -1820,8 +2701,8 @@ cbm_parallel_burst_write_track(CBM_FILE HandleDevice, unsigned char *Buffer, uns
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_parallel_burst_write_track)
-        ret = Plugin_information.Plugin.opencbm_plugin_parallel_burst_write_track(HandleDevice, Buffer, Length);
+    if (PLUGIN(HandleDevice).opencbm_plugin_parallel_burst_write_track)
+        ret = PLUGIN(HandleDevice).opencbm_plugin_parallel_burst_write_track(HandleDevice, Buffer, Length);
 
     FUNC_LEAVE_INT(ret);
 }
@@ -1850,8 +2731,8 @@ cbm_srq_burst_read(CBM_FILE HandleDevice)
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_srq_burst_read)
-        ret = Plugin_information.Plugin.opencbm_plugin_srq_burst_read(HandleDevice);
+    if (PLUGIN(HandleDevice).opencbm_plugin_srq_burst_read)
+        ret = PLUGIN(HandleDevice).opencbm_plugin_srq_burst_read(HandleDevice);
 
     FUNC_LEAVE_UCHAR(ret);
 }
@@ -1878,8 +2759,8 @@ cbm_srq_burst_write(CBM_FILE HandleDevice, unsigned char Value)
 {
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_srq_burst_write)
-        Plugin_information.Plugin.opencbm_plugin_srq_burst_write(HandleDevice, Value);
+    if (PLUGIN(HandleDevice).opencbm_plugin_srq_burst_write)
+        PLUGIN(HandleDevice).opencbm_plugin_srq_burst_write(HandleDevice, Value);
 
     FUNC_LEAVE();
 }
@@ -1893,12 +2774,12 @@ cbm_srq_burst_read_n(CBM_FILE HandleDevice, unsigned char *Buffer,
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_srq_burst_read_n) {
-        rv = Plugin_information.Plugin.opencbm_plugin_srq_burst_read_n(
+    if (PLUGIN(HandleDevice).opencbm_plugin_srq_burst_read_n) {
+        rv = PLUGIN(HandleDevice).opencbm_plugin_srq_burst_read_n(
             HandleDevice, Buffer, Length);
     } else {
         for (i = 0; i < Length; i++) {
-            Buffer[i] = Plugin_information.Plugin
+            Buffer[i] = PLUGIN(HandleDevice)
                 .opencbm_plugin_srq_burst_read(HandleDevice);
         }
         rv = Length;
@@ -1916,12 +2797,12 @@ cbm_srq_burst_write_n(CBM_FILE HandleDevice, unsigned char *Buffer,
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_srq_burst_write_n) {
-        rv = Plugin_information.Plugin.opencbm_plugin_srq_burst_write_n(
+    if (PLUGIN(HandleDevice).opencbm_plugin_srq_burst_write_n) {
+        rv = PLUGIN(HandleDevice).opencbm_plugin_srq_burst_write_n(
             HandleDevice, Buffer, Length);
     } else {
         for (i = 0; i < Length; i++) {
-            Plugin_information.Plugin.opencbm_plugin_srq_burst_write(
+            PLUGIN(HandleDevice).opencbm_plugin_srq_burst_write(
                 HandleDevice, Buffer[i]);
         }
         rv = Length;
@@ -1961,8 +2842,8 @@ cbm_srq_burst_read_track(CBM_FILE HandleDevice, unsigned char *Buffer, unsigned
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_srq_burst_read_track)
-        ret = Plugin_information.Plugin.opencbm_plugin_srq_burst_read_track(HandleDevice, Buffer, Length);
+    if (PLUGIN(HandleDevice).opencbm_plugin_srq_burst_read_track)
+        ret = PLUGIN(HandleDevice).opencbm_plugin_srq_burst_read_track(HandleDevice, Buffer, Length);
 
     FUNC_LEAVE_INT(ret);
 }
@@ -1998,8 +2879,8 @@ cbm_srq_burst_write_track(CBM_FILE HandleDevice, unsigned char *Buffer, unsigned
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_srq_burst_write_track)
-        ret = Plugin_information.Plugin.opencbm_plugin_srq_burst_write_track(HandleDevice, Buffer, Length);
+    if (PLUGIN(HandleDevice).opencbm_plugin_srq_burst_write_track)
+        ret = PLUGIN(HandleDevice).opencbm_plugin_srq_burst_write_track(HandleDevice, Buffer, Length);
 
     FUNC_LEAVE_INT(ret);
 }
@@ -2028,8 +2909,8 @@ cbm_tap_prepare_capture(CBM_FILE HandleDevice, int *Status)
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_tap_prepare_capture)
-        ret = Plugin_information.Plugin.opencbm_plugin_tap_prepare_capture(HandleDevice, Status);
+    if (PLUGIN(HandleDevice).opencbm_plugin_tap_prepare_capture)
+        ret = PLUGIN(HandleDevice).opencbm_plugin_tap_prepare_capture(HandleDevice, Status);
 
     FUNC_LEAVE_INT(ret);
 }
@@ -2058,8 +2939,8 @@ cbm_tap_prepare_write(CBM_FILE HandleDevice, int *Status)
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_tap_prepare_write)
-        ret = Plugin_information.Plugin.opencbm_plugin_tap_prepare_write(HandleDevice, Status);
+    if (PLUGIN(HandleDevice).opencbm_plugin_tap_prepare_write)
+        ret = PLUGIN(HandleDevice).opencbm_plugin_tap_prepare_write(HandleDevice, Status);
 
     FUNC_LEAVE_INT(ret);
 }
@@ -2088,8 +2969,8 @@ cbm_tap_get_sense(CBM_FILE HandleDevice, int *Status)
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_tap_get_sense)
-        ret = Plugin_information.Plugin.opencbm_plugin_tap_get_sense(HandleDevice, Status);
+    if (PLUGIN(HandleDevice).opencbm_plugin_tap_get_sense)
+        ret = PLUGIN(HandleDevice).opencbm_plugin_tap_get_sense(HandleDevice, Status);
 
     FUNC_LEAVE_INT(ret);
 }
@@ -2118,8 +2999,8 @@ cbm_tap_wait_for_stop_sense(CBM_FILE HandleDevice, int *Status)
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_tap_wait_for_stop_sense)
-        ret = Plugin_information.Plugin.opencbm_plugin_tap_wait_for_stop_sense(HandleDevice, Status);
+    if (PLUGIN(HandleDevice).opencbm_plugin_tap_wait_for_stop_sense)
+        ret = PLUGIN(HandleDevice).opencbm_plugin_tap_wait_for_stop_sense(HandleDevice, Status);
 
     FUNC_LEAVE_INT(ret);
 }
@@ -2148,8 +3029,8 @@ cbm_tap_wait_for_play_sense(CBM_FILE HandleDevice, int *Status)
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_tap_wait_for_play_sense)
-        ret = Plugin_information.Plugin.opencbm_plugin_tap_wait_for_play_sense(HandleDevice, Status);
+    if (PLUGIN(HandleDevice).opencbm_plugin_tap_wait_for_play_sense)
+        ret = PLUGIN(HandleDevice).opencbm_plugin_tap_wait_for_play_sense(HandleDevice, Status);
 
     FUNC_LEAVE_INT(ret);
 }
@@ -2178,8 +3059,8 @@ cbm_tap_motor_on(CBM_FILE HandleDevice, int *Status)
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_tap_motor_on)
-        ret = Plugin_information.Plugin.opencbm_plugin_tap_motor_on(HandleDevice, Status);
+    if (PLUGIN(HandleDevice).opencbm_plugin_tap_motor_on)
+        ret = PLUGIN(HandleDevice).opencbm_plugin_tap_motor_on(HandleDevice, Status);
 
     FUNC_LEAVE_INT(ret);
 }
@@ -2208,8 +3089,8 @@ cbm_tap_motor_off(CBM_FILE HandleDevice, int *Status)
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_tap_motor_off)
-        ret = Plugin_information.Plugin.opencbm_plugin_tap_motor_off(HandleDevice, Status);
+    if (PLUGIN(HandleDevice).opencbm_plugin_tap_motor_off)
+        ret = PLUGIN(HandleDevice).opencbm_plugin_tap_motor_off(HandleDevice, Status);
 
     FUNC_LEAVE_INT(ret);
 }
@@ -2250,8 +3131,8 @@ cbm_tap_start_capture(CBM_FILE HandleDevice, unsigned char *Buffer, unsigned int
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_tap_start_capture)
-        ret = Plugin_information.Plugin.opencbm_plugin_tap_start_capture(HandleDevice, Buffer, Buffer_Length, Status, BytesRead);
+    if (PLUGIN(HandleDevice).opencbm_plugin_tap_start_capture)
+        ret = PLUGIN(HandleDevice).opencbm_plugin_tap_start_capture(HandleDevice, Buffer, Buffer_Length, Status, BytesRead);
 
     FUNC_LEAVE_INT(ret);
 }
@@ -2292,8 +3173,8 @@ cbm_tap_start_write(CBM_FILE HandleDevice, unsigned char *Buffer, unsigned int L
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_tap_start_write)
-        ret = Plugin_information.Plugin.opencbm_plugin_tap_start_write(HandleDevice, Buffer, Length, Status, BytesWritten);
+    if (PLUGIN(HandleDevice).opencbm_plugin_tap_start_write)
+        ret = PLUGIN(HandleDevice).opencbm_plugin_tap_start_write(HandleDevice, Buffer, Length, Status, BytesWritten);
 
     FUNC_LEAVE_INT(ret);
 }
@@ -2323,8 +3204,8 @@ cbm_tap_get_ver(CBM_FILE HandleDevice, int *Status)
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_tap_get_ver)
-        ret = Plugin_information.Plugin.opencbm_plugin_tap_get_ver(HandleDevice, Status);
+    if (PLUGIN(HandleDevice).opencbm_plugin_tap_get_ver)
+        ret = PLUGIN(HandleDevice).opencbm_plugin_tap_get_ver(HandleDevice, Status);
 
     FUNC_LEAVE_INT(ret);
 }
@@ -2337,8 +3218,8 @@ cbm_tap_break(CBM_FILE HandleDevice)
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_tap_break)
-        ret = Plugin_information.Plugin.opencbm_plugin_tap_break(HandleDevice);
+    if (PLUGIN(HandleDevice).opencbm_plugin_tap_break)
+        ret = PLUGIN(HandleDevice).opencbm_plugin_tap_break(HandleDevice);
 
     FUNC_LEAVE_INT(ret);
 }
@@ -2380,8 +3261,8 @@ cbm_tap_download_config(CBM_FILE HandleDevice, unsigned char *Buffer, unsigned i
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_tap_download_config)
-        ret = Plugin_information.Plugin.opencbm_plugin_tap_download_config(HandleDevice, Buffer, Buffer_Length, Status, BytesRead);
+    if (PLUGIN(HandleDevice).opencbm_plugin_tap_download_config)
+        ret = PLUGIN(HandleDevice).opencbm_plugin_tap_download_config(HandleDevice, Buffer, Buffer_Length, Status, BytesRead);
 
     FUNC_LEAVE_INT(ret);
 }
@@ -2422,8 +3303,8 @@ cbm_tap_upload_config(CBM_FILE HandleDevice, unsigned char *Buffer, unsigned int
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_tap_upload_config)
-        ret = Plugin_information.Plugin.opencbm_plugin_tap_upload_config(HandleDevice, Buffer, Length, Status, BytesWritten);
+    if (PLUGIN(HandleDevice).opencbm_plugin_tap_upload_config)
+        ret = PLUGIN(HandleDevice).opencbm_plugin_tap_upload_config(HandleDevice, Buffer, Length, Status, BytesWritten);
 
     FUNC_LEAVE_INT(ret);
 }
@@ -2452,8 +3333,41 @@ cbm_get_plugin_function_address(const char * Functionname)
 
     FUNC_ENTER();
 
-    if (Plugin_information.Library)
-        pointer = plugin_get_address(Plugin_information.Library, Functionname);
+    if (Plugin_list)
+        pointer = plugin_get_address(Plugin_list->Library, Functionname);
+
+    FUNC_LEAVE_PTR(pointer, void*);
+}
+
+/*! \brief Get the function pointer for a function in the plugin of a CBM_FILE
+
+ This function gets the function pointer for a function which
+ resides in the plugin that handles HandleDevice. Unlike
+ cbm_get_plugin_function_address(), this gives the right result
+ if several adapters are opened at the same time.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Functionname
+   The name of the function of which to get the address
+
+ \return
+   Pointer to the function if successfull; 0 if not.
+*/
+
+void * CBMAPIDECL
+cbm_get_plugin_function_address_ex(CBM_FILE HandleDevice, const char * Functionname)
+{
+    plugin_information_t * plugin;
+    void * pointer = NULL;
+
+    FUNC_ENTER();
+
+    plugin = cbm_get_plugin_information(HandleDevice);
+
+    if (plugin->Library)
+        pointer = plugin_get_address(plugin->Library, Functionname);
 
     FUNC_LEAVE_PTR(pointer, void*);
 }
@@ -2488,8 +3402,8 @@ cbm_iec_dbg_read(CBM_FILE HandleDevice)
 
     FUNC_ENTER();
 
-    if ( Plugin_information.Plugin.opencbm_plugin_iec_dbg_read ) {
-        returnValue = Plugin_information.Plugin.opencbm_plugin_iec_dbg_read(HandleDevice);
+    if ( PLUGIN(HandleDevice).opencbm_plugin_iec_dbg_read ) {
+        returnValue = PLUGIN(HandleDevice).opencbm_plugin_iec_dbg_read(HandleDevice);
     }
 
     FUNC_LEAVE_INT(returnValue);
@@ -2531,8 +3445,8 @@ cbm_iec_dbg_write(CBM_FILE HandleDevice, unsigned char Value)
 
     FUNC_ENTER();
 
-    if ( Plugin_information.Plugin.opencbm_plugin_iec_dbg_write ) {
-        returnValue = Plugin_information.Plugin.opencbm_plugin_iec_dbg_write(HandleDevice, Value);
+    if ( PLUGIN(HandleDevice).opencbm_plugin_iec_dbg_write ) {
+        returnValue = PLUGIN(HandleDevice).opencbm_plugin_iec_dbg_write(HandleDevice, Value);
     }
 
     FUNC_LEAVE_INT(returnValue);
@@ -0,0 +1,28 @@
+/*
+ *      This program is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU General Public License
+ *      as published by the Free Software Foundation; either version
+ *      2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 The OpenCBM project
+ *
+*/
+
+/*! ************************************************************** 
+** \file lib/cbm_int.h \n
+** \n
+** \brief Functions which are shared between the files of the
+**        library, but not exported
+**
+****************************************************************/
+
+#ifndef CBM_INT_H
+#define CBM_INT_H
+
+#include "opencbm.h"
+
+extern int
+cbm_identify_cached(CBM_FILE HandleDevice, unsigned char DeviceAddress,
+                    enum cbm_device_type_e *CbmDeviceType);
+
+#endif /* #ifndef CBM_INT_H */
@@ -35,6 +35,55 @@
 #include "archlib.h"
 
 
+/*! \internal \brief Read a footprint from the drive's memory
+
+ This function reads 3 bytes from the drive's memory with an M-R
+ command. The command and the reading of the result are queued
+ in one batch, so that they can be executed in one go.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param DeviceAddress
+   The address of the device on the IEC serial bus. This
+   is known as primary address, too.
+
+ \param Command
+   The M-R command to execute.
+
+ \param Size
+   The length of Command.
+
+ \param Buffer
+   Pointer to a 3 byte buffer which will hold the footprint.
+
+ \return
+   1 if the footprint could be read, 0 otherwise.
+*/
+
+static int
+read_footprint(CBM_FILE HandleDevice, unsigned char DeviceAddress,
+               const char *Command, size_t Size, unsigned char *Buffer)
+{
+    CBM_BATCH batch;
+    int written = -1;
+    int bytesRead = -1;
+
+    batch = cbm_batch_begin(HandleDevice);
+
+    cbm_batch_listen(batch, DeviceAddress, 15);
+    cbm_batch_raw_write(batch, Command, Size, &written);
+    cbm_batch_unlisten(batch);
+    cbm_batch_talk(batch, DeviceAddress, 15);
+    cbm_batch_raw_read(batch, Buffer, 3, &bytesRead);
+    cbm_batch_untalk(batch);
+
+    cbm_batch_submit(batch);
+
+    return written == (int) Size && bytesRead == 3;
+}
+
+
 /*! \brief Identify the connected floppy drive.
 
  This function tries to identify a connected floppy drive.
@@ -78,124 +127,114 @@ cbm_identify(CBM_FILE HandleDevice, unsigned char DeviceAddress,
     FUNC_ENTER();
 
     /* get footprint from 0xFF40 */
-    if (cbm_exec_command(HandleDevice, DeviceAddress, command, sizeof(command)) == 0 
-        && cbm_talk(HandleDevice, DeviceAddress, 15) == 0)
+    if (read_footprint(HandleDevice, DeviceAddress, command, sizeof(command), buf))
     {
-        if (cbm_raw_read(HandleDevice, buf, 3) == 3)
-        {
-            magic = buf[0] | (buf[1] << 8);
+        magic = buf[0] | (buf[1] << 8);
 
-            if(magic == 0xaaaa)
+        if(magic == 0xaaaa)
+        {
+            command[3] = (char) 0xFE; /* get footprint from 0xFFFE, IRQ vector */
+            if (read_footprint(HandleDevice, DeviceAddress, command, sizeof(command), buf)
+                && ( buf[0] != 0x67 || buf[1] != 0xFE ) )
             {
-                cbm_untalk(HandleDevice);
-                command[3] = (char) 0xFE; /* get footprint from 0xFFFE, IRQ vector */
-                if (cbm_exec_command(HandleDevice, DeviceAddress, command, sizeof(command)) == 0 
-                    && cbm_talk(HandleDevice, DeviceAddress, 15) == 0)
-                {
-                    if (cbm_raw_read(HandleDevice, buf, 3) == 3
-                        && ( buf[0] != 0x67 || buf[1] != 0xFE ) )
-                    {
-                        magic = buf[0] | (buf[1] << 8);
-                    }
-                }
+                magic = buf[0] | (buf[1] << 8);
             }
+        }
 
-            switch(magic)
-            {
-                default:
-                    unknownDevice[22] = ((magic >> 12 & 0x0F) | 0x40);
-                    unknownDevice[24] = ((magic >>  4 & 0x0F) | 0x40);
-                    magic &= 0x0F0F;
-                    magic |= 0x4040;
-                    unknownDevice[23] = magic >> 8;
-                    unknownDevice[25] = (char)magic;
-                    break;
-
-                case 0xfeb6:
-                    deviceType = cbm_dt_cbm2031;
-                    deviceString = "2031"; 
-                    break;
-
-                case 0xaaaa:
-                    deviceType = cbm_dt_cbm1541;
-                    deviceString = "1540 or 1541"; 
-                    break;
-
-                case 0xf00f:
-                    deviceType = cbm_dt_cbm1541;
-                    deviceString = "1541-II";
-                    break;
-
-                case 0xcd18:
-                    deviceType = cbm_dt_cbm1541;
-                    deviceString = "1541C";
-                    break;
-
-                case 0x10ca:
-                    deviceType = cbm_dt_cbm1541;
-                    deviceString = "DolphinDOS 1541";
-                    break;
-
-                case 0x6f10:
-                    deviceType = cbm_dt_cbm1541;
-                    deviceString = "SpeedDOS 1541";
-                    break;
-
-                case 0x2710:
-                    deviceType = cbm_dt_cbm1541;
-                    deviceString = "ProfessionalDOS 1541";
-                    break;
-
-                case 0x8085:
-                    deviceType = cbm_dt_cbm1541;
-                    deviceString = "JiffyDOS 1541";
-                    break;
-
-                case 0xaeea:
-                    deviceType = cbm_dt_cbm1541;
-                    deviceString = "64'er DOS 1541";
-                    break;
-
-                case 0xfed7:
-                    deviceType = cbm_dt_cbm1570;
-                    deviceString = "1570";
-                    break;
-
-                case 0x02ac:
-                    deviceType = cbm_dt_cbm1571;
-                    deviceString = "1571";
-                    break;
-
-                case 0x01ba:
-                    deviceType = cbm_dt_cbm1581;
-                    deviceString = "1581";
-                    break;
-
-                case 0x32f0: 
-                    deviceType = cbm_dt_cbm3040;
-                    deviceString = "3040";
-                    break;
-
-                case 0xc320: 
-                case 0x20f8: 
-                    deviceType = cbm_dt_cbm4040;
-                    deviceString = "4040";
-                    break;
-
-                case 0xf2e9:
-                    deviceType = cbm_dt_cbm8050;
-                    deviceString = "8050 dos2.5";
-                    break;
-
-                case 0xc866:       /* special dos2.7 ?? Speed-DOS 8250 ?? */
-                case 0xc611:
-                    deviceType = cbm_dt_cbm8250;
-                    deviceString = "8250 dos2.7";
-                    break;
-            }
-            rv = 0;
+        switch(magic)
+        {
+            default:
+                unknownDevice[22] = ((magic >> 12 & 0x0F) | 0x40);
+                unknownDevice[24] = ((magic >>  4 & 0x0F) | 0x40);
+                magic &= 0x0F0F;
+                magic |= 0x4040;
+                unknownDevice[23] = magic >> 8;
+                unknownDevice[25] = (char)magic;
+                break;
+
+            case 0xfeb6:
+                deviceType = cbm_dt_cbm2031;
+                deviceString = "2031"; 
+                break;
+
+            case 0xaaaa:
+                deviceType = cbm_dt_cbm1541;
+                deviceString = "1540 or 1541"; 
+                break;
+
+            case 0xf00f:
+                deviceType = cbm_dt_cbm1541;
+                deviceString = "1541-II";
+                break;
+
+            case 0xcd18:
+                deviceType = cbm_dt_cbm1541;
+                deviceString = "1541C";
+                break;
+
+            case 0x10ca:
+                deviceType = cbm_dt_cbm1541;
+                deviceString = "DolphinDOS 1541";
+                break;
+
+            case 0x6f10:
+                deviceType = cbm_dt_cbm1541;
+                deviceString = "SpeedDOS 1541";
+                break;
+
+            case 0x2710:
+                deviceType = cbm_dt_cbm1541;
+                deviceString = "ProfessionalDOS 1541";
+                break;
+
+            case 0x8085:
+                deviceType = cbm_dt_cbm1541;
+                deviceString = "JiffyDOS 1541";
+                break;
+
+            case 0xaeea:
+                deviceType = cbm_dt_cbm1541;
+                deviceString = "64'er DOS 1541";
+                break;
+
+            case 0xfed7:
+                deviceType = cbm_dt_cbm1570;
+                deviceString = "1570";
+                break;
+
+            case 0x02ac:
+                deviceType = cbm_dt_cbm1571;
+                deviceString = "1571";
+                break;
+
+            case 0x01ba:
+                deviceType = cbm_dt_cbm1581;
+                deviceString = "1581";
+                break;
+
+            case 0x32f0: 
+                deviceType = cbm_dt_cbm3040;
+                deviceString = "3040";
+                break;
+
+            case 0xc320: 
+            case 0x20f8: 
+                deviceType = cbm_dt_cbm4040;
+                deviceString = "4040";
+                break;
+
+            case 0xf2e9:
+                deviceType = cbm_dt_cbm8050;
+                deviceString = "8050 dos2.5";
+                break;
+
+            case 0xc866:       /* special dos2.7 ?? Speed-DOS 8250 ?? */
+            case 0xc611:
+                deviceType = cbm_dt_cbm8250;
+                deviceString = "8250 dos2.7";
+                break;
         }
-        cbm_untalk(HandleDevice);
+        rv = 0;
     }
 
     if(CbmDeviceType)
@@ -30,6 +30,7 @@
 #include "opencbm.h"
 
 #include <stddef.h>
+#include <string.h>
 
 /*! \brief Decode GCR data
 
@@ -265,3 +266,1027 @@ gcr_4_to_5_encode(const unsigned char *source, unsigned char *dest,
     FUNC_LEAVE_INT(rv);
     return rv;
 }
+
+
+/*
+ * Bulk conversion
+ *
+ * gcr_5_to_4_decode() and gcr_4_to_5_encode() convert one group of
+ * 5 GCR bytes at a time, with all the checks and debugging output.
+ * The functions below convert any number of groups at once. They are
+ * implemented by "kernels"; the best one is used by default, the
+ * others are there for comparison (see sample/gcrbench).
+ */
+
+/*! \brief Decoding table for two GCR quintets at once
+
+ Index is a 10 bit value with two GCR quintets. The lower 8 bits of
+ each entry are the decoded byte, bit 9 is set if the upper quintet
+ was illegal, bit 8 if the lower one was. Illegal quintets decode
+ as 0xf, as with gcr_5_to_4_decode().
+*/
+static const unsigned short gcr_decode_pair[1024] =
+{
+    0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff,
+    0x3ff, 0x2f8, 0x2f0, 0x2f1, 0x3ff, 0x2fc, 0x2f4, 0x2f5,
+    0x3ff, 0x3ff, 0x2f2, 0x2f3, 0x3ff, 0x2ff, 0x2f6, 0x2f7,
+    0x3ff, 0x2f9, 0x2fa, 0x2fb, 0x3ff, 0x2fd, 0x2fe, 0x3ff,
+    0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff,
+    0x3ff, 0x2f8, 0x2f0, 0x2f1, 0x3ff, 0x2fc, 0x2f4, 0x2f5,
+    0x3ff, 0x3ff, 0x2f2, 0x2f3, 0x3ff, 0x2ff, 0x2f6, 0x2f7,
+    0x3ff, 0x2f9, 0x2fa, 0x2fb, 0x3ff, 0x2fd, 0x2fe, 0x3ff,
+    0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff,
+    0x3ff, 0x2f8, 0x2f0, 0x2f1, 0x3ff, 0x2fc, 0x2f4, 0x2f5,
+    0x3ff, 0x3ff, 0x2f2, 0x2f3, 0x3ff, 0x2ff, 0x2f6, 0x2f7,
+    0x3ff, 0x2f9, 0x2fa, 0x2fb, 0x3ff, 0x2fd, 0x2fe, 0x3ff,
+    0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff,
+    0x3ff, 0x2f8, 0x2f0, 0x2f1, 0x3ff, 0x2fc, 0x2f4, 0x2f5,
+    0x3ff, 0x3ff, 0x2f2, 0x2f3, 0x3ff, 0x2ff, 0x2f6, 0x2f7,
+    0x3ff, 0x2f9, 0x2fa, 0x2fb, 0x3ff, 0x2fd, 0x2fe, 0x3ff,
+    0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff,
+    0x3ff, 0x2f8, 0x2f0, 0x2f1, 0x3ff, 0x2fc, 0x2f4, 0x2f5,
+    0x3ff, 0x3ff, 0x2f2, 0x2f3, 0x3ff, 0x2ff, 0x2f6, 0x2f7,
+    0x3ff, 0x2f9, 0x2fa, 0x2fb, 0x3ff, 0x2fd, 0x2fe, 0x3ff,
+    0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff,
+    0x3ff, 0x2f8, 0x2f0, 0x2f1, 0x3ff, 0x2fc, 0x2f4, 0x2f5,
+    0x3ff, 0x3ff, 0x2f2, 0x2f3, 0x3ff, 0x2ff, 0x2f6, 0x2f7,
+    0x3ff, 0x2f9, 0x2fa, 0x2fb, 0x3ff, 0x2fd, 0x2fe, 0x3ff,
+    0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff,
+    0x3ff, 0x2f8, 0x2f0, 0x2f1, 0x3ff, 0x2fc, 0x2f4, 0x2f5,
+    0x3ff, 0x3ff, 0x2f2, 0x2f3, 0x3ff, 0x2ff, 0x2f6, 0x2f7,
+    0x3ff, 0x2f9, 0x2fa, 0x2fb, 0x3ff, 0x2fd, 0x2fe, 0x3ff,
+    0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff,
+    0x3ff, 0x2f8, 0x2f0, 0x2f1, 0x3ff, 0x2fc, 0x2f4, 0x2f5,
+    0x3ff, 0x3ff, 0x2f2, 0x2f3, 0x3ff, 0x2ff, 0x2f6, 0x2f7,
+    0x3ff, 0x2f9, 0x2fa, 0x2fb, 0x3ff, 0x2fd, 0x2fe, 0x3ff,
+    0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff,
+    0x3ff, 0x2f8, 0x2f0, 0x2f1, 0x3ff, 0x2fc, 0x2f4, 0x2f5,
+    0x3ff, 0x3ff, 0x2f2, 0x2f3, 0x3ff, 0x2ff, 0x2f6, 0x2f7,
+    0x3ff, 0x2f9, 0x2fa, 0x2fb, 0x3ff, 0x2fd, 0x2fe, 0x3ff,
+    0x18f, 0x18f, 0x18f, 0x18f, 0x18f, 0x18f, 0x18f, 0x18f,
+    0x18f, 0x088, 0x080, 0x081, 0x18f, 0x08c, 0x084, 0x085,
+    0x18f, 0x18f, 0x082, 0x083, 0x18f, 0x08f, 0x086, 0x087,
+    0x18f, 0x089, 0x08a, 0x08b, 0x18f, 0x08d, 0x08e, 0x18f,
+    0x10f, 0x10f, 0x10f, 0x10f, 0x10f, 0x10f, 0x10f, 0x10f,
+    0x10f, 0x008, 0x000, 0x001, 0x10f, 0x00c, 0x004, 0x005,
+    0x10f, 0x10f, 0x002, 0x003, 0x10f, 0x00f, 0x006, 0x007,
+    0x10f, 0x009, 0x00a, 0x00b, 0x10f, 0x00d, 0x00e, 0x10f,
+    0x11f, 0x11f, 0x11f, 0x11f, 0x11f, 0x11f, 0x11f, 0x11f,
+    0x11f, 0x018, 0x010, 0x011, 0x11f, 0x01c, 0x014, 0x015,
+    0x11f, 0x11f, 0x012, 0x013, 0x11f, 0x01f, 0x016, 0x017,
+    0x11f, 0x019, 0x01a, 0x01b, 0x11f, 0x01d, 0x01e, 0x11f,
+    0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff,
+    0x3ff, 0x2f8, 0x2f0, 0x2f1, 0x3ff, 0x2fc, 0x2f4, 0x2f5,
+    0x3ff, 0x3ff, 0x2f2, 0x2f3, 0x3ff, 0x2ff, 0x2f6, 0x2f7,
+    0x3ff, 0x2f9, 0x2fa, 0x2fb, 0x3ff, 0x2fd, 0x2fe, 0x3ff,
+    0x1cf, 0x1cf, 0x1cf, 0x1cf, 0x1cf, 0x1cf, 0x1cf, 0x1cf,
+    0x1cf, 0x0c8, 0x0c0, 0x0c1, 0x1cf, 0x0cc, 0x0c4, 0x0c5,
+    0x1cf, 0x1cf, 0x0c2, 0x0c3, 0x1cf, 0x0cf, 0x0c6, 0x0c7,
+    0x1cf, 0x0c9, 0x0ca, 0x0cb, 0x1cf, 0x0cd, 0x0ce, 0x1cf,
+    0x14f, 0x14f, 0x14f, 0x14f, 0x14f, 0x14f, 0x14f, 0x14f,
+    0x14f, 0x048, 0x040, 0x041, 0x14f, 0x04c, 0x044, 0x045,
+    0x14f, 0x14f, 0x042, 0x043, 0x14f, 0x04f, 0x046, 0x047,
+    0x14f, 0x049, 0x04a, 0x04b, 0x14f, 0x04d, 0x04e, 0x14f,
+    0x15f, 0x15f, 0x15f, 0x15f, 0x15f, 0x15f, 0x15f, 0x15f,
+    0x15f, 0x058, 0x050, 0x051, 0x15f, 0x05c, 0x054, 0x055,
+    0x15f, 0x15f, 0x052, 0x053, 0x15f, 0x05f, 0x056, 0x057,
+    0x15f, 0x059, 0x05a, 0x05b, 0x15f, 0x05d, 0x05e, 0x15f,
+    0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff,
+    0x3ff, 0x2f8, 0x2f0, 0x2f1, 0x3ff, 0x2fc, 0x2f4, 0x2f5,
+    0x3ff, 0x3ff, 0x2f2, 0x2f3, 0x3ff, 0x2ff, 0x2f6, 0x2f7,
+    0x3ff, 0x2f9, 0x2fa, 0x2fb, 0x3ff, 0x2fd, 0x2fe, 0x3ff,
+    0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff,
+    0x3ff, 0x2f8, 0x2f0, 0x2f1, 0x3ff, 0x2fc, 0x2f4, 0x2f5,
+    0x3ff, 0x3ff, 0x2f2, 0x2f3, 0x3ff, 0x2ff, 0x2f6, 0x2f7,
+    0x3ff, 0x2f9, 0x2fa, 0x2fb, 0x3ff, 0x2fd, 0x2fe, 0x3ff,
+    0x12f, 0x12f, 0x12f, 0x12f, 0x12f, 0x12f, 0x12f, 0x12f,
+    0x12f, 0x028, 0x020, 0x021, 0x12f, 0x02c, 0x024, 0x025,
+    0x12f, 0x12f, 0x022, 0x023, 0x12f, 0x02f, 0x026, 0x027,
+    0x12f, 0x029, 0x02a, 0x02b, 0x12f, 0x02d, 0x02e, 0x12f,
+    0x13f, 0x13f, 0x13f, 0x13f, 0x13f, 0x13f, 0x13f, 0x13f,
+    0x13f, 0x038, 0x030, 0x031, 0x13f, 0x03c, 0x034, 0x035,
+    0x13f, 0x13f, 0x032, 0x033, 0x13f, 0x03f, 0x036, 0x037,
+    0x13f, 0x039, 0x03a, 0x03b, 0x13f, 0x03d, 0x03e, 0x13f,
+    0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff,
+    0x3ff, 0x2f8, 0x2f0, 0x2f1, 0x3ff, 0x2fc, 0x2f4, 0x2f5,
+    0x3ff, 0x3ff, 0x2f2, 0x2f3, 0x3ff, 0x2ff, 0x2f6, 0x2f7,
+    0x3ff, 0x2f9, 0x2fa, 0x2fb, 0x3ff, 0x2fd, 0x2fe, 0x3ff,
+    0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff,
+    0x1ff, 0x0f8, 0x0f0, 0x0f1, 0x1ff, 0x0fc, 0x0f4, 0x0f5,
+    0x1ff, 0x1ff, 0x0f2, 0x0f3, 0x1ff, 0x0ff, 0x0f6, 0x0f7,
+    0x1ff, 0x0f9, 0x0fa, 0x0fb, 0x1ff, 0x0fd, 0x0fe, 0x1ff,
+    0x16f, 0x16f, 0x16f, 0x16f, 0x16f, 0x16f, 0x16f, 0x16f,
+    0x16f, 0x068, 0x060, 0x061, 0x16f, 0x06c, 0x064, 0x065,
+    0x16f, 0x16f, 0x062, 0x063, 0x16f, 0x06f, 0x066, 0x067,
+    0x16f, 0x069, 0x06a, 0x06b, 0x16f, 0x06d, 0x06e, 0x16f,
+    0x17f, 0x17f, 0x17f, 0x17f, 0x17f, 0x17f, 0x17f, 0x17f,
+    0x17f, 0x078, 0x070, 0x071, 0x17f, 0x07c, 0x074, 0x075,
+    0x17f, 0x17f, 0x072, 0x073, 0x17f, 0x07f, 0x076, 0x077,
+    0x17f, 0x079, 0x07a, 0x07b, 0x17f, 0x07d, 0x07e, 0x17f,
+    0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff,
+    0x3ff, 0x2f8, 0x2f0, 0x2f1, 0x3ff, 0x2fc, 0x2f4, 0x2f5,
+    0x3ff, 0x3ff, 0x2f2, 0x2f3, 0x3ff, 0x2ff, 0x2f6, 0x2f7,
+    0x3ff, 0x2f9, 0x2fa, 0x2fb, 0x3ff, 0x2fd, 0x2fe, 0x3ff,
+    0x19f, 0x19f, 0x19f, 0x19f, 0x19f, 0x19f, 0x19f, 0x19f,
+    0x19f, 0x098, 0x090, 0x091, 0x19f, 0x09c, 0x094, 0x095,
+    0x19f, 0x19f, 0x092, 0x093, 0x19f, 0x09f, 0x096, 0x097,
+    0x19f, 0x099, 0x09a, 0x09b, 0x19f, 0x09d, 0x09e, 0x19f,
+    0x1af, 0x1af, 0x1af, 0x1af, 0x1af, 0x1af, 0x1af, 0x1af,
+    0x1af, 0x0a8, 0x0a0, 0x0a1, 0x1af, 0x0ac, 0x0a4, 0x0a5,
+    0x1af, 0x1af, 0x0a2, 0x0a3, 0x1af, 0x0af, 0x0a6, 0x0a7,
+    0x1af, 0x0a9, 0x0aa, 0x0ab, 0x1af, 0x0ad, 0x0ae, 0x1af,
+    0x1bf, 0x1bf, 0x1bf, 0x1bf, 0x1bf, 0x1bf, 0x1bf, 0x1bf,
+    0x1bf, 0x0b8, 0x0b0, 0x0b1, 0x1bf, 0x0bc, 0x0b4, 0x0b5,
+    0x1bf, 0x1bf, 0x0b2, 0x0b3, 0x1bf, 0x0bf, 0x0b6, 0x0b7,
+    0x1bf, 0x0b9, 0x0ba, 0x0bb, 0x1bf, 0x0bd, 0x0be, 0x1bf,
+    0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff,
+    0x3ff, 0x2f8, 0x2f0, 0x2f1, 0x3ff, 0x2fc, 0x2f4, 0x2f5,
+    0x3ff, 0x3ff, 0x2f2, 0x2f3, 0x3ff, 0x2ff, 0x2f6, 0x2f7,
+    0x3ff, 0x2f9, 0x2fa, 0x2fb, 0x3ff, 0x2fd, 0x2fe, 0x3ff,
+    0x1df, 0x1df, 0x1df, 0x1df, 0x1df, 0x1df, 0x1df, 0x1df,
+    0x1df, 0x0d8, 0x0d0, 0x0d1, 0x1df, 0x0dc, 0x0d4, 0x0d5,
+    0x1df, 0x1df, 0x0d2, 0x0d3, 0x1df, 0x0df, 0x0d6, 0x0d7,
+    0x1df, 0x0d9, 0x0da, 0x0db, 0x1df, 0x0dd, 0x0de, 0x1df,
+    0x1ef, 0x1ef, 0x1ef, 0x1ef, 0x1ef, 0x1ef, 0x1ef, 0x1ef,
+    0x1ef, 0x0e8, 0x0e0, 0x0e1, 0x1ef, 0x0ec, 0x0e4, 0x0e5,
+    0x1ef, 0x1ef, 0x0e2, 0x0e3, 0x1ef, 0x0ef, 0x0e6, 0x0e7,
+    0x1ef, 0x0e9, 0x0ea, 0x0eb, 0x1ef, 0x0ed, 0x0ee, 0x1ef,
+    0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff, 0x3ff,
+    0x3ff, 0x2f8, 0x2f0, 0x2f1, 0x3ff, 0x2fc, 0x2f4, 0x2f5,
+    0x3ff, 0x3ff, 0x2f2, 0x2f3, 0x3ff, 0x2ff, 0x2f6, 0x2f7,
+    0x3ff, 0x2f9, 0x2fa, 0x2fb, 0x3ff, 0x2fd, 0x2fe, 0x3ff
+};
+
+/*! \brief Encoding table for one byte into two GCR quintets */
+static const unsigned short gcr_encode_pair[256] =
+{
+    0x14a, 0x14b, 0x152, 0x153, 0x14e, 0x14f, 0x156, 0x157,
+    0x149, 0x159, 0x15a, 0x15b, 0x14d, 0x15d, 0x15e, 0x155,
+    0x16a, 0x16b, 0x172, 0x173, 0x16e, 0x16f, 0x176, 0x177,
+    0x169, 0x179, 0x17a, 0x17b, 0x16d, 0x17d, 0x17e, 0x175,
+    0x24a, 0x24b, 0x252, 0x253, 0x24e, 0x24f, 0x256, 0x257,
+    0x249, 0x259, 0x25a, 0x25b, 0x24d, 0x25d, 0x25e, 0x255,
+    0x26a, 0x26b, 0x272, 0x273, 0x26e, 0x26f, 0x276, 0x277,
+    0x269, 0x279, 0x27a, 0x27b, 0x26d, 0x27d, 0x27e, 0x275,
+    0x1ca, 0x1cb, 0x1d2, 0x1d3, 0x1ce, 0x1cf, 0x1d6, 0x1d7,
+    0x1c9, 0x1d9, 0x1da, 0x1db, 0x1cd, 0x1dd, 0x1de, 0x1d5,
+    0x1ea, 0x1eb, 0x1f2, 0x1f3, 0x1ee, 0x1ef, 0x1f6, 0x1f7,
+    0x1e9, 0x1f9, 0x1fa, 0x1fb, 0x1ed, 0x1fd, 0x1fe, 0x1f5,
+    0x2ca, 0x2cb, 0x2d2, 0x2d3, 0x2ce, 0x2cf, 0x2d6, 0x2d7,
+    0x2c9, 0x2d9, 0x2da, 0x2db, 0x2cd, 0x2dd, 0x2de, 0x2d5,
+    0x2ea, 0x2eb, 0x2f2, 0x2f3, 0x2ee, 0x2ef, 0x2f6, 0x2f7,
+    0x2e9, 0x2f9, 0x2fa, 0x2fb, 0x2ed, 0x2fd, 0x2fe, 0x2f5,
+    0x12a, 0x12b, 0x132, 0x133, 0x12e, 0x12f, 0x136, 0x137,
+    0x129, 0x139, 0x13a, 0x13b, 0x12d, 0x13d, 0x13e, 0x135,
+    0x32a, 0x32b, 0x332, 0x333, 0x32e, 0x32f, 0x336, 0x337,
+    0x329, 0x339, 0x33a, 0x33b, 0x32d, 0x33d, 0x33e, 0x335,
+    0x34a, 0x34b, 0x352, 0x353, 0x34e, 0x34f, 0x356, 0x357,
+    0x349, 0x359, 0x35a, 0x35b, 0x34d, 0x35d, 0x35e, 0x355,
+    0x36a, 0x36b, 0x372, 0x373, 0x36e, 0x36f, 0x376, 0x377,
+    0x369, 0x379, 0x37a, 0x37b, 0x36d, 0x37d, 0x37e, 0x375,
+    0x1aa, 0x1ab, 0x1b2, 0x1b3, 0x1ae, 0x1af, 0x1b6, 0x1b7,
+    0x1a9, 0x1b9, 0x1ba, 0x1bb, 0x1ad, 0x1bd, 0x1be, 0x1b5,
+    0x3aa, 0x3ab, 0x3b2, 0x3b3, 0x3ae, 0x3af, 0x3b6, 0x3b7,
+    0x3a9, 0x3b9, 0x3ba, 0x3bb, 0x3ad, 0x3bd, 0x3be, 0x3b5,
+    0x3ca, 0x3cb, 0x3d2, 0x3d3, 0x3ce, 0x3cf, 0x3d6, 0x3d7,
+    0x3c9, 0x3d9, 0x3da, 0x3db, 0x3cd, 0x3dd, 0x3de, 0x3d5,
+    0x2aa, 0x2ab, 0x2b2, 0x2b3, 0x2ae, 0x2af, 0x2b6, 0x2b7,
+    0x2a9, 0x2b9, 0x2ba, 0x2bb, 0x2ad, 0x2bd, 0x2be, 0x2b5
+};
+
+/*! 255 denotes illegal GCR quintets */
+static const unsigned char gcr_decode_quintet[32] =
+    {255,255,255,255,255,255,255,255,255,  8,  0,  1,255, 12,  4,  5,
+     255,255,  2,  3,255, 15,  6,  7,255,  9, 10, 11,255, 13, 14,255 };
+
+static const unsigned char gcr_encode_nybble[16] =
+    { 10, 11, 18, 19, 14, 15, 22, 23, 9, 25, 26, 27, 13, 29, 30, 21 };
+
+/*! remember an illegal quintet at position i of the output */
+#define GCR_MARK_ERROR(_err, _i) \
+    do { \
+        if (errors) errors[_i] = (unsigned char) (_err); \
+        illegal += ((_err) & 1) + ((_err) >> 1); \
+    } while (0)
+
+/*! \brief Decode groups with the pair table
+
+ Each group is split into two 20 bit halves, each of which
+ yields two bytes with one table lookup each.
+*/
+static int
+gcr_decode_groups_pair(const unsigned char *source, unsigned char *dest,
+                       size_t groups, unsigned char *errors)
+{
+    unsigned long a, b;
+    unsigned int v;
+    int illegal = 0;
+    size_t i;
+
+    for (i = 0; i < groups; i++, source += 5, dest += 4)
+    {
+        a = ((unsigned long) source[0] << 12)
+          | ((unsigned long) source[1] << 4)
+          | (source[2] >> 4);
+        b = ((unsigned long) (source[2] & 0x0f) << 16)
+          | ((unsigned long) source[3] << 8)
+          | source[4];
+
+        v = gcr_decode_pair[a >> 10];
+        dest[0] = (unsigned char) v;
+        if (v >> 8) GCR_MARK_ERROR(v >> 8, i * 4);
+
+        v = gcr_decode_pair[a & 0x3ff];
+        dest[1] = (unsigned char) v;
+        if (v >> 8) GCR_MARK_ERROR(v >> 8, i * 4 + 1);
+
+        v = gcr_decode_pair[b >> 10];
+        dest[2] = (unsigned char) v;
+        if (v >> 8) GCR_MARK_ERROR(v >> 8, i * 4 + 2);
+
+        v = gcr_decode_pair[b & 0x3ff];
+        dest[3] = (unsigned char) v;
+        if (v >> 8) GCR_MARK_ERROR(v >> 8, i * 4 + 3);
+    }
+    return illegal;
+}
+
+/*! \brief Encode groups with the pair table */
+static void
+gcr_encode_groups_pair(const unsigned char *source, unsigned char *dest,
+                       size_t groups)
+{
+    unsigned long a, b;
+    size_t i;
+
+    for (i = 0; i < groups; i++, source += 4, dest += 5)
+    {
+        a = ((unsigned long) gcr_encode_pair[source[0]] << 10)
+          | gcr_encode_pair[source[1]];
+        b = ((unsigned long) gcr_encode_pair[source[2]] << 10)
+          | gcr_encode_pair[source[3]];
+
+        dest[0] = (unsigned char) (a >> 12);
+        dest[1] = (unsigned char) (a >> 4);
+        dest[2] = (unsigned char) ((a << 4) | (b >> 16));
+        dest[3] = (unsigned char) (b >> 8);
+        dest[4] = (unsigned char) b;
+    }
+}
+
+/*! \brief Decode groups one quintet at a time
+
+ This is the algorithm of gcr_5_to_4_decode(), without the checks.
+*/
+static int
+gcr_decode_groups_quintet(const unsigned char *source, unsigned char *dest,
+                          size_t groups, unsigned char *errors)
+{
+    unsigned int tdest, hi, lo, err;
+    int illegal = 0;
+    size_t i;
+    int j;
+
+    for (i = 0; i < groups; i++, source += 5)
+    {
+        tdest = (unsigned int) source[0] << 13;
+
+        for (j = 0; j < 4; j++, dest++)
+        {
+            tdest |= (unsigned int) source[j + 1] << (5 + 2 * j);
+
+            hi = gcr_decode_quintet[(tdest >> 16) & 0x1f];
+            tdest <<= 5;
+            lo = gcr_decode_quintet[(tdest >> 16) & 0x1f];
+            tdest <<= 5;
+
+            *dest = (unsigned char) (((hi & 0x0f) << 4) | (lo & 0x0f));
+
+            err = ((hi > 15) << 1) | (lo > 15);
+            if (err) GCR_MARK_ERROR(err, i * 4 + j);
+        }
+    }
+    return illegal;
+}
+
+/*! \brief Encode groups one nybble at a time
+
+ This is the algorithm of gcr_4_to_5_encode(), without the checks.
+*/
+static void
+gcr_encode_groups_nybble(const unsigned char *source, unsigned char *dest,
+                         size_t groups)
+{
+    unsigned int tdest;
+    size_t i;
+    int j;
+
+    for (i = 0; i < groups; i++)
+    {
+        tdest = 0;
+        for (j = 2; j < 10; j += 2, source++, dest++)
+        {
+            tdest <<= 5;
+            tdest  |= gcr_encode_nybble[(*source) >> 4];
+            tdest <<= 5;
+            tdest  |= gcr_encode_nybble[(*source) & 0x0f];
+
+            *dest = (unsigned char) (tdest >> j);
+        }
+        *dest++ = (unsigned char) tdest;
+    }
+}
+
+/*
+ * SIMD kernels
+ *
+ * These convert two groups at once: the quintets of both groups are
+ * spread into 16 bytes, one quintet each, and looked up in parallel.
+ * Encoding does the reverse. As more bytes than the two groups are
+ * loaded or stored, the last groups are left to the "pair" kernel,
+ * so that no byte outside of the buffers is touched.
+ *
+ * The CPU features are checked when the kernel is selected, so the
+ * library still runs on CPUs without them. All of this assumes a
+ * little endian CPU.
+ */
+
+/* SSE2 and SSSE3; they need to be enabled per function with gcc */
+#if ((defined(__clang__) || (defined(__GNUC__) \
+      && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))) \
+     && (defined(__x86_64__) || defined(__i386__))) \
+    || (defined(_MSC_VER) && _MSC_VER >= 1500 && (defined(_M_X64) || defined(_M_IX86)))
+# define GCR_HAVE_SSE2 1
+#endif
+
+#if (defined(__aarch64__) && !defined(__AARCH64EB__)) || defined(_M_ARM64)
+# define GCR_HAVE_NEON 1
+#endif
+
+#if defined(__GNUC__) && defined(GCR_HAVE_SSE2)
+# define GCR_TARGET_SSE2  __attribute__((target("sse2")))
+# define GCR_TARGET_SSSE3 __attribute__((target("ssse3")))
+#else
+# define GCR_TARGET_SSE2
+# define GCR_TARGET_SSSE3
+#endif
+
+#if defined(GCR_HAVE_SSE2) || defined(GCR_HAVE_NEON)
+
+/*! \brief Decoding table for the SIMD kernels
+
+ Illegal quintets give 0x1f: they decode as 0xf, as with
+ gcr_5_to_4_decode(), and bit 4 marks them.
+*/
+static const unsigned char gcr_decode_simd[32] =
+    {0x1f,0x1f,0x1f,0x1f,0x1f,0x1f,0x1f,0x1f,0x1f,   8,   0,   1,0x1f,  12,   4,   5,
+     0x1f,0x1f,   2,   3,0x1f,  15,   6,   7,0x1f,   9,  10,  11,0x1f,  13,  14,0x1f };
+
+/*! \brief Record the illegal quintets of two groups
+
+ \param mask
+   Bit j is set if quintet j of the two groups was illegal.
+
+ \param errors
+   See gcr_5_to_4_decode_groups(), already advanced to the
+   first of the two groups.
+
+ \return
+   The number of illegal quintets.
+*/
+static int
+gcr_simd_errors(unsigned int mask, unsigned char *errors)
+{
+    unsigned int err;
+    int illegal = 0;
+    int i;
+
+    for (i = 0; i < 8; i++, mask >>= 2)
+    {
+        err = ((mask & 1) << 1) | ((mask >> 1) & 1);
+        if (err) GCR_MARK_ERROR(err, i);
+    }
+    return illegal;
+}
+
+#endif
+
+#ifdef GCR_HAVE_SSE2
+
+#include <emmintrin.h>
+
+/*! \brief Reverse the order of the bytes of both 64 bit lanes */
+static GCR_TARGET_SSE2 __m128i
+gcr_sse2_swap64(__m128i x)
+{
+    x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+    x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(0, 1, 2, 3));
+    return _mm_shufflehi_epi16(x, _MM_SHUFFLE(0, 1, 2, 3));
+}
+
+/*! \brief Spread the quintets of two groups into bytes
+
+ Each 64 bit lane holds one group in its bits 63..24.
+*/
+static GCR_TARGET_SSE2 __m128i
+gcr_sse2_spread(__m128i x)
+{
+    /* the group is in bits 63..24: 20 bits into each 32 bit lane, ... */
+    x = _mm_or_si128(_mm_srli_epi64(x, 44),
+        _mm_and_si128(_mm_slli_epi64(x, 8),
+                      _mm_set_epi32(0x000fffff, 0, 0x000fffff, 0)));
+    /* ... 10 bits into each 16 bit lane, ... */
+    x = _mm_or_si128(_mm_srli_epi32(x, 10),
+        _mm_and_si128(_mm_slli_epi32(x, 16), _mm_set1_epi32(0x03ff0000)));
+    /* ... and 5 bits into each byte */
+    return _mm_or_si128(_mm_srli_epi16(x, 5),
+        _mm_and_si128(_mm_slli_epi16(x, 8), _mm_set1_epi16(0x1f00)));
+}
+
+/*! \brief Load two groups and spread their quintets into bytes */
+static GCR_TARGET_SSE2 __m128i
+gcr_sse2_load_quintets(const unsigned char *source)
+{
+    return gcr_sse2_spread(gcr_sse2_swap64(
+        _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *) source),
+                           _mm_loadl_epi64((const __m128i *) (source + 5)))));
+}
+
+/*! \brief Store two groups from quintets in bytes
+
+ This writes 13 bytes: the 3 bytes after the two groups are
+ overwritten with garbage.
+*/
+static GCR_TARGET_SSE2 void
+gcr_sse2_store_quintets(unsigned char *dest, __m128i x)
+{
+    x = _mm_or_si128(_mm_srli_epi16(x, 8),
+        _mm_slli_epi16(_mm_and_si128(x, _mm_set1_epi16(0x001f)), 5));
+    x = _mm_or_si128(_mm_srli_epi32(x, 16),
+        _mm_slli_epi32(_mm_and_si128(x, _mm_set1_epi32(0x000003ff)), 10));
+    x = _mm_or_si128(_mm_slli_epi64(_mm_srli_epi64(x, 32), 24),
+        _mm_slli_epi64(_mm_and_si128(x, _mm_set_epi32(0, 0x000fffff, 0, 0x000fffff)), 44));
+    x = gcr_sse2_swap64(x);
+
+    _mm_storel_epi64((__m128i *) dest, x);
+    _mm_storel_epi64((__m128i *) (dest + 5), _mm_srli_si128(x, 8));
+}
+
+/*! \brief Load two groups of plain bytes as one nybble per byte */
+static GCR_TARGET_SSE2 __m128i
+gcr_sse2_load_nybbles(const unsigned char *source)
+{
+    __m128i x;
+
+    x = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) source),
+                          _mm_setzero_si128());
+    return _mm_or_si128(_mm_srli_epi16(x, 4),
+        _mm_slli_epi16(_mm_and_si128(x, _mm_set1_epi16(0x000f)), 8));
+}
+
+/*! \brief Store two groups of decoded nybbles, with error handling
+
+ \return
+   The number of illegal quintets.
+*/
+static GCR_TARGET_SSE2 int
+gcr_sse2_store_nybbles(unsigned char *dest, __m128i x, unsigned char *errors)
+{
+    unsigned int mask;
+    __m128i b;
+
+    b = _mm_or_si128(
+        _mm_and_si128(_mm_slli_epi16(x, 4), _mm_set1_epi16(0x00f0)),
+        _mm_and_si128(_mm_srli_epi16(x, 8), _mm_set1_epi16(0x000f)));
+    _mm_storel_epi64((__m128i *) dest, _mm_packus_epi16(b, b));
+
+    /* bit 4 of each byte into bit 7 */
+    mask = (unsigned int) _mm_movemask_epi8(_mm_slli_epi16(x, 3));
+    return mask ? gcr_simd_errors(mask, errors) : 0;
+}
+
+/*! \brief Decode groups with SSE2
+
+ SSE2 cannot look up bytes in a table, thus, the quintets are
+ compared with all 16 legal codes.
+*/
+static GCR_TARGET_SSE2 int
+gcr_decode_groups_sse2(const unsigned char *source, unsigned char *dest,
+                       size_t groups, unsigned char *errors)
+{
+    __m128i q, r;
+    int illegal = 0;
+    size_t i;
+    int n;
+
+    for (i = 0; i + 3 <= groups; i += 2, source += 10, dest += 8)
+    {
+        q = gcr_sse2_load_quintets(source);
+
+        r = _mm_setzero_si128();
+        for (n = 0; n < 16; n++)
+        {
+            r = _mm_or_si128(r, _mm_and_si128(
+                _mm_cmpeq_epi8(q, _mm_set1_epi8((char) gcr_encode_nybble[n])),
+                _mm_set1_epi8((char) (n ^ 0x1f))));
+        }
+        r = _mm_xor_si128(r, _mm_set1_epi8(0x1f));
+
+        illegal += gcr_sse2_store_nybbles(dest, r, errors ? errors + i * 4 : NULL);
+    }
+
+    return illegal + gcr_decode_groups_pair(source, dest, groups - i,
+                                            errors ? errors + i * 4 : NULL);
+}
+
+/*! \brief Encode groups with SSE2 */
+static GCR_TARGET_SSE2 void
+gcr_encode_groups_sse2(const unsigned char *source, unsigned char *dest,
+                       size_t groups)
+{
+    __m128i q, r;
+    size_t i;
+    int n;
+
+    for (i = 0; i + 3 <= groups; i += 2, source += 8, dest += 10)
+    {
+        q = gcr_sse2_load_nybbles(source);
+
+        r = _mm_setzero_si128();
+        for (n = 0; n < 16; n++)
+        {
+            r = _mm_or_si128(r, _mm_and_si128(
+                _mm_cmpeq_epi8(q, _mm_set1_epi8((char) n)),
+                _mm_set1_epi8((char) gcr_encode_nybble[n])));
+        }
+
+        gcr_sse2_store_quintets(dest, r);
+    }
+
+    gcr_encode_groups_pair(source, dest, groups - i);
+}
+
+#include <tmmintrin.h>
+
+/*! \brief Decode groups with SSSE3
+
+ PSHUFB puts the two bytes which hold each quintet into a 16 bit
+ lane, a multiplication shifts it to the top. Two more PSHUFB look
+ up the lower and upper half of the table; the index of the other
+ half is made >= 0x80, which gives 0.
+*/
+static GCR_TARGET_SSSE3 int
+gcr_decode_groups_ssse3(const unsigned char *source, unsigned char *dest,
+                        size_t groups, unsigned char *errors)
+{
+    const __m128i lo = _mm_loadu_si128((const __m128i *) gcr_decode_simd);
+    const __m128i hi = _mm_loadu_si128((const __m128i *) (gcr_decode_simd + 16));
+    const __m128i bias = _mm_set1_epi8(0x70);
+    const __m128i bit4 = _mm_set1_epi8(0x10);
+    const __m128i first = _mm_setr_epi8(1, 0, 1, 0, 2, 1, 2, 1,
+                                        3, 2, 4, 3, 4, 3, 5, 4);
+    const __m128i second = _mm_setr_epi8(6, 5, 6, 5, 7, 6, 7, 6,
+                                         8, 7, 9, 8, 9, 8, 10, 9);
+    const __m128i shift = _mm_setr_epi16(1, 32, 4, 128, 16, 2, 64, 8);
+    __m128i x, q, r;
+    int illegal = 0;
+    size_t i;
+
+    /* 16 bytes are loaded, that is, 6 more than two groups */
+    for (i = 0; i + 4 <= groups; i += 2, source += 10, dest += 8)
+    {
+        x = _mm_loadu_si128((const __m128i *) source);
+        q = _mm_packus_epi16(
+            _mm_srli_epi16(_mm_mullo_epi16(_mm_shuffle_epi8(x, first), shift), 11),
+            _mm_srli_epi16(_mm_mullo_epi16(_mm_shuffle_epi8(x, second), shift), 11));
+
+        r = _mm_or_si128(
+            _mm_shuffle_epi8(lo, _mm_add_epi8(q, bias)),
+            _mm_shuffle_epi8(hi, _mm_add_epi8(_mm_xor_si128(q, bit4), bias)));
+
+        illegal += gcr_sse2_store_nybbles(dest, r, errors ? errors + i * 4 : NULL);
+    }
+
+    return illegal + gcr_decode_groups_pair(source, dest, groups - i,
+                                            errors ? errors + i * 4 : NULL);
+}
+
+/*! \brief Encode groups with SSSE3 */
+static GCR_TARGET_SSSE3 void
+gcr_encode_groups_ssse3(const unsigned char *source, unsigned char *dest,
+                        size_t groups)
+{
+    const __m128i table = _mm_loadu_si128((const __m128i *) gcr_encode_nybble);
+    size_t i;
+
+    for (i = 0; i + 3 <= groups; i += 2, source += 8, dest += 10)
+    {
+        gcr_sse2_store_quintets(dest,
+            _mm_shuffle_epi8(table, gcr_sse2_load_nybbles(source)));
+    }
+
+    gcr_encode_groups_pair(source, dest, groups - i);
+}
+
+#if defined(_MSC_VER)
+# include <intrin.h>
+#endif
+
+/*! \brief Check if the CPU supports SSE2 */
+static int
+gcr_have_sse2(void)
+{
+#if defined(_MSC_VER)
+    int info[4];
+
+    __cpuid(info, 1);
+    return (info[3] >> 26) & 1;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2") != 0;
+#endif
+}
+
+/*! \brief Check if the CPU supports SSSE3 */
+static int
+gcr_have_ssse3(void)
+{
+#if defined(_MSC_VER)
+    int info[4];
+
+    __cpuid(info, 1);
+    return (info[2] >> 9) & 1;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("ssse3") != 0;
+#endif
+}
+
+#endif /* #ifdef GCR_HAVE_SSE2 */
+
+#ifdef GCR_HAVE_NEON
+
+#include <arm_neon.h>
+
+/*! \brief Load two groups and spread their quintets into bytes
+
+ See gcr_sse2_load_quintets().
+*/
+static uint8x16_t
+gcr_neon_load_quintets(const unsigned char *source)
+{
+    uint64x2_t x;
+    uint32x4_t w;
+    uint16x8_t h;
+
+    x = vreinterpretq_u64_u8(vrev64q_u8(
+        vcombine_u8(vld1_u8(source), vld1_u8(source + 5))));
+
+    x = vorrq_u64(vshrq_n_u64(x, 44),
+        vandq_u64(vshlq_n_u64(x, 8), vdupq_n_u64(0x000fffff00000000ULL)));
+    w = vreinterpretq_u32_u64(x);
+    w = vorrq_u32(vshrq_n_u32(w, 10),
+        vandq_u32(vshlq_n_u32(w, 16), vdupq_n_u32(0x03ff0000)));
+    h = vreinterpretq_u16_u32(w);
+    h = vorrq_u16(vshrq_n_u16(h, 5),
+        vandq_u16(vshlq_n_u16(h, 8), vdupq_n_u16(0x1f00)));
+    return vreinterpretq_u8_u16(h);
+}
+
+/*! \brief Store two groups from quintets in bytes
+
+ See gcr_sse2_store_quintets().
+*/
+static void
+gcr_neon_store_quintets(unsigned char *dest, uint8x16_t q)
+{
+    uint16x8_t h;
+    uint32x4_t w;
+    uint64x2_t x;
+    uint8x16_t b;
+
+    h = vreinterpretq_u16_u8(q);
+    h = vorrq_u16(vshrq_n_u16(h, 8),
+        vshlq_n_u16(vandq_u16(h, vdupq_n_u16(0x001f)), 5));
+    w = vreinterpretq_u32_u16(h);
+    w = vorrq_u32(vshrq_n_u32(w, 16),
+        vshlq_n_u32(vandq_u32(w, vdupq_n_u32(0x000003ff)), 10));
+    x = vreinterpretq_u64_u32(w);
+    x = vorrq_u64(vshlq_n_u64(vshrq_n_u64(x, 32), 24),
+        vshlq_n_u64(vandq_u64(x, vdupq_n_u64(0x000fffff)), 44));
+    b = vrev64q_u8(vreinterpretq_u8_u64(x));
+
+    vst1_u8(dest, vget_low_u8(b));
+    vst1_u8(dest + 5, vget_high_u8(b));
+}
+
+/*! \brief Decode groups with NEON */
+static int
+gcr_decode_groups_neon(const unsigned char *source, unsigned char *dest,
+                       size_t groups, unsigned char *errors)
+{
+    static const unsigned char weights[16] =
+        { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    uint8x16x2_t table;
+    uint8x16_t r, e;
+    uint16x8_t h;
+    unsigned int mask;
+    int illegal = 0;
+    size_t i;
+
+    table.val[0] = vld1q_u8(gcr_decode_simd);
+    table.val[1] = vld1q_u8(gcr_decode_simd + 16);
+
+    for (i = 0; i + 3 <= groups; i += 2, source += 10, dest += 8)
+    {
+        r = vqtbl2q_u8(table, gcr_neon_load_quintets(source));
+
+        h = vreinterpretq_u16_u8(r);
+        h = vorrq_u16(vandq_u16(vshlq_n_u16(h, 4), vdupq_n_u16(0x00f0)),
+                      vandq_u16(vshrq_n_u16(h, 8), vdupq_n_u16(0x000f)));
+        vst1_u8(dest, vmovn_u16(h));
+
+        if (vmaxvq_u8(r) > 0x0f)
+        {
+            e = vmulq_u8(vshrq_n_u8(r, 4), vld1q_u8(weights));
+            mask = vaddv_u8(vget_low_u8(e)) | (vaddv_u8(vget_high_u8(e)) << 8);
+            illegal += gcr_simd_errors(mask, errors ? errors + i * 4 : NULL);
+        }
+    }
+
+    return illegal + gcr_decode_groups_pair(source, dest, groups - i,
+                                            errors ? errors + i * 4 : NULL);
+}
+
+/*! \brief Encode groups with NEON */
+static void
+gcr_encode_groups_neon(const unsigned char *source, unsigned char *dest,
+                       size_t groups)
+{
+    const uint8x16_t table = vld1q_u8(gcr_encode_nybble);
+    uint16x8_t h;
+    size_t i;
+
+    for (i = 0; i + 3 <= groups; i += 2, source += 8, dest += 10)
+    {
+        h = vmovl_u8(vld1_u8(source));
+        h = vorrq_u16(vshrq_n_u16(h, 4),
+                      vshlq_n_u16(vandq_u16(h, vdupq_n_u16(0x000f)), 8));
+        gcr_neon_store_quintets(dest,
+            vqtbl1q_u8(table, vreinterpretq_u8_u16(h)));
+    }
+
+    gcr_encode_groups_pair(source, dest, groups - i);
+}
+
+#endif /* #ifdef GCR_HAVE_NEON */
+
+/*! a set of functions for bulk GCR conversion */
+typedef struct gcr_kernel_s
+{
+    const char *name;
+    int  (*decode)(const unsigned char *, unsigned char *, size_t, unsigned char *);
+    void (*encode)(const unsigned char *, unsigned char *, size_t);
+    int  (*supported)(void);    /*!< NULL if the kernel runs on every CPU */
+} gcr_kernel_t;
+
+/*! all kernels, the preferred one first */
+static const gcr_kernel_t gcr_kernels[] =
+{
+#ifdef GCR_HAVE_SSE2
+    { "ssse3",   gcr_decode_groups_ssse3,   gcr_encode_groups_ssse3,  gcr_have_ssse3 },
+#endif
+#ifdef GCR_HAVE_NEON
+    { "neon",    gcr_decode_groups_neon,    gcr_encode_groups_neon,   NULL },
+#endif
+    { "pair",    gcr_decode_groups_pair,    gcr_encode_groups_pair,   NULL },
+#ifdef GCR_HAVE_SSE2
+    /* without PSHUFB, this is slower than the table lookups of "pair" */
+    { "sse2",    gcr_decode_groups_sse2,    gcr_encode_groups_sse2,   gcr_have_sse2 },
+#endif
+    { "quintet", gcr_decode_groups_quintet, gcr_encode_groups_nybble, NULL },
+    { NULL, NULL, NULL, NULL }
+};
+
+/*! the kernel in use; NULL until the first conversion */
+static const gcr_kernel_t *gcr_kernel = NULL;
+
+/*! \brief Get the n-th kernel which runs on this CPU
+
+ \param index
+   The number of the kernel, starting with 0.
+
+ \return
+   The kernel, or NULL if there is no kernel with this index.
+*/
+static const gcr_kernel_t *
+gcr_get_kernel(unsigned int index)
+{
+    const gcr_kernel_t *k;
+
+    for (k = gcr_kernels; k->name; k++)
+    {
+        if (k->supported == NULL || k->supported())
+        {
+            if (index-- == 0)
+            {
+                return k;
+            }
+        }
+    }
+    return NULL;
+}
+
+/*! \brief Get the name of a GCR kernel
+
+ Only the kernels which run on this CPU are counted, the
+ default one first.
+
+ \param index
+   The number of the kernel, starting with 0.
+
+ \return
+   The name of the kernel, or NULL if there is no kernel
+   with this index.
+*/
+const char * CBMAPIDECL
+gcr_kernel_name(unsigned int index)
+{
+    const gcr_kernel_t *k = gcr_get_kernel(index);
+
+    return k ? k->name : NULL;
+}
+
+/*! \brief Select the GCR kernel used for bulk conversion
+
+ By default, the first kernel which runs on this CPU is chosen
+ on the first conversion. All kernels give the same results;
+ selecting another one is only useful for comparing their speed.
+ It affects the whole process.
+
+ \param name
+   The name of the kernel, as returned by gcr_kernel_name(),
+   or NULL for the default one.
+
+ \return
+   0 on success, -1 if there is no kernel with that name which
+   runs on this CPU.
+*/
+int CBMAPIDECL
+gcr_select_kernel(const char *name)
+{
+    const gcr_kernel_t *k;
+    unsigned int i;
+
+    for (i = 0; (k = gcr_get_kernel(i)) != NULL; i++)
+    {
+        if (name == NULL || strcmp(k->name, name) == 0)
+        {
+            gcr_kernel = k;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/*! \brief Decode a number of GCR groups
+
+ This function decodes groups of 5 GCR bytes into 4 plain bytes
+ each, the same way gcr_5_to_4_decode() does.
+
+ \param source
+   The pointer to the source buffer of 5 * groups GCR bytes
+
+ \param dest
+   The pointer to the destination buffer of 4 * groups plain bytes.
+   It must not overlap with source.
+
+ \param groups
+   The number of groups to decode.
+
+ \param errors
+   If not NULL, a buffer of 4 * groups bytes. For every byte
+   in dest with an illegal GCR code, the byte at the same position
+   gets bit 1 set if the upper nybble was illegal, and bit 0 if
+   the lower one was. Other bytes are not changed.
+
+ \return
+   The number of illegal GCR codes found.
+*/
+int CBMAPIDECL
+gcr_5_to_4_decode_groups(const unsigned char *source, unsigned char *dest,
+                         size_t groups, unsigned char *errors)
+{
+    if (gcr_kernel == NULL)
+    {
+        gcr_select_kernel(NULL);
+    }
+    return gcr_kernel->decode(source, dest, groups, errors);
+}
+
+/*! \brief Encode a number of GCR groups
+
+ This function encodes groups of 4 plain bytes into 5 GCR bytes
+ each, the same way gcr_4_to_5_encode() does.
+
+ \param source
+   The pointer to the source buffer of 4 * groups plain bytes
+
+ \param dest
+   The pointer to the destination buffer of 5 * groups GCR bytes.
+   It must not overlap with source.
+
+ \param groups
+   The number of groups to encode.
+*/
+void CBMAPIDECL
+gcr_4_to_5_encode_groups(const unsigned char *source, unsigned char *dest,
+                         size_t groups)
+{
+    if (gcr_kernel == NULL)
+    {
+        gcr_select_kernel(NULL);
+    }
+    gcr_kernel->encode(source, dest, groups);
+}
+
+/*! \brief Decode a GCR data block
+
+ This function decodes the data block of a sector, as read
+ from disk: The block identifier 0x07, 256 data bytes and
+ the checksum.
+
+ \param gcr
+   The pointer to the GCR_BLOCK_GCRSIZE GCR bytes of the block.
+
+ \param block
+   The pointer to a buffer for the GCR_BLOCK_SIZE data bytes.
+
+ \param errors
+   If not NULL, a buffer of GCR_BLOCK_GROUPS * 4 bytes, which is
+   filled as for gcr_5_to_4_decode_groups(). Position 0 is the
+   block identifier, the data bytes start at position 1.
+
+ \return
+   0 on success, 4 if the block identifier is wrong, 5 if the
+   checksum does not match. These are the same values the
+   drive reports as "20, READ ERROR" and "23, READ ERROR".
+*/
+int CBMAPIDECL
+gcr_decode_block(const unsigned char *gcr, unsigned char *block,
+                 unsigned char *errors)
+{
+    unsigned char decoded[GCR_BLOCK_GROUPS * 4];
+    unsigned char chksum = 0;
+    int i;
+
+    if (errors)
+    {
+        memset(errors, 0, GCR_BLOCK_GROUPS * 4);
+    }
+    gcr_5_to_4_decode_groups(gcr, decoded, GCR_BLOCK_GROUPS, errors);
+
+    if (decoded[0] != 0x07)
+    {
+        return 4;
+    }
+
+    for (i = 1; i <= GCR_BLOCK_SIZE; i++)
+    {
+        chksum ^= decoded[i];
+    }
+    memcpy(block, &decoded[1], GCR_BLOCK_SIZE);
+
+    return (decoded[GCR_BLOCK_SIZE + 1] != chksum) ? 5 : 0;
+}
+
+/*! \brief Encode a GCR data block
+
+ This function encodes a sector into the data block as it is
+ written to disk: The block identifier 0x07, 256 data bytes and
+ the checksum, followed by two 0 bytes to fill the last group.
+
+ \param block
+   The pointer to the GCR_BLOCK_SIZE data bytes.
+
+ \param gcr
+   The pointer to a buffer for the GCR_BLOCK_GCRSIZE GCR bytes.
+*/
+void CBMAPIDECL
+gcr_encode_block(const unsigned char *block, unsigned char *gcr)
+{
+    unsigned char plain[GCR_BLOCK_GROUPS * 4];
+    unsigned char chksum = 0;
+    int i;
+
+    plain[0] = 0x07;
+    for (i = 0; i < GCR_BLOCK_SIZE; i++)
+    {
+        chksum ^= block[i];
+    }
+    memcpy(&plain[1], block, GCR_BLOCK_SIZE);
+    plain[GCR_BLOCK_SIZE + 1] = chksum;
+    plain[GCR_BLOCK_SIZE + 2] = plain[GCR_BLOCK_SIZE + 3] = 0;
+
+    gcr_4_to_5_encode_groups(plain, gcr, GCR_BLOCK_GROUPS);
+}
@@ -0,0 +1,1065 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version
+ *  2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 The OpenCBM project
+ */
+
+/*! **************************************************************
+** \file lib/plugin/vdrive/archlib.c \n
+** \n
+** \brief Shared library / DLL for accessing the driver: image backed virtual drive
+**
+** This plugin does not talk to any hardware. It emulates a 1541,
+** 1571 or 1581 (depending on the image type) holding a D64, D71 or
+** D81 image, so the whole tool chain (cbmctrl, d64copy, imgcopy,
+** cbmcopy) can be run without a drive.
+**
+** The port is the name of the image file, e.g. "vdrive:/tmp/disk.d64";
+** if it is missing, the environment variable VDRIVE_IMAGE is used.
+** A non-existing image is created empty.
+**
+** Further environment variables:
+**
+** - VDRIVE_DEVICE: the primary address of the drive (default: 8)
+** - VDRIVE_XP1541: if set, emulate a parallel cable
+** - VDRIVE_LATENCY: a latency model, e.g. "iec=200/40,s1=20/12,disk=12000/0";
+**   every call of protocol "proto" costs "call" microseconds plus "byte"
+**   microseconds per transferred byte. Protocols are bus, iec, s1, s2, pp
+**   and disk (per sector access).
+** - VDRIVE_STATS: if set, print the number of calls, bytes and the
+**   virtual time spent per protocol on cbm_driver_close().
+** - VDRIVE_DEBUG: debugging level
+** - VDRIVE_ROM: a 1541 (16 KB) or 1571 (32 KB) DOS ROM. If given, the
+**   drive hardware is emulated and runs this ROM and all uploaded drive
+**   code; the host side bit-bangs the bus like the xum1541 firmware.
+**   VDRIVE_STATS then reports the drive cycles per transferred block.
+** - VDRIVE_G64: with VDRIVE_ROM, take the disk from this G64 file
+**   instead of the image.
+**
+****************************************************************/
+
+#ifdef WIN32
+#include <windows.h>
+#include <windowsx.h>
+
+/*! Mark: We are in user-space (for debug.h) */
+#define DBG_USERMODE
+
+/*! The name of the executable */
+#define DBG_PROGNAME "OPENCBM-VDRIVE.DLL"
+
+#include "debug.h"
+#endif
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//! mark: We are building the DLL */
+#define OPENCBM_PLUGIN
+#include "archlib.h"
+
+#include "arch.h"
+#include "vdrive.h"
+
+static int debug_level = -10000; /*!< \internal \brief the debugging level for debugging output */
+
+/*! the names of the protocols in VDRIVE_LATENCY and VDRIVE_STATS */
+static const char *proto_names[vdrive_proto_count] =
+{
+    "bus", "iec", "s1", "s2", "pp", "disk"
+};
+
+/*! \brief Output debugging information for the virtual drive
+
+ \param level
+   The output level; output will only be produced if this level is less or equal the debugging level
+
+ \param msg
+   The printf() style message to be output
+*/
+void
+vdrive_dbg(int level, char *msg, ...)
+{
+    va_list argp;
+
+    /* determine debug mode if not yet known */
+    if(debug_level == -10000)
+    {
+        char *val = getenv("VDRIVE_DEBUG");
+        debug_level = val ? atoi(val) : 0;
+    }
+
+    if(level <= debug_level)
+    {
+        fprintf(stderr, "[VDRIVE] ");
+        va_start(argp, msg);
+        vfprintf(stderr, msg, argp);
+        va_end(argp);
+        fprintf(stderr, "\n");
+    }
+}
+
+/*! \brief Get a handle as vdrive_t */
+#define VDRIVE(_h) ((vdrive_t *)(_h))
+
+/*! \brief Account for the virtual time of a transfer
+
+ The time is accumulated; the process sleeps whenever at least one
+ millisecond is due, so many short calls are not rounded up to the
+ granularity of the system timer one by one.
+*/
+void
+vdrive_latency(vdrive_t *vd, enum vdrive_proto_e proto, size_t bytes)
+{
+    vdrive_latency_t *l = &vd->latency[proto];
+    double us = l->call_us + l->byte_us * bytes;
+
+    l->calls++;
+    l->bytes    += (unsigned long) bytes;
+    l->total_us += us;
+
+    vd->latency_debt_us += us;
+    if(vd->latency_debt_us >= 1000.0)
+    {
+        unsigned long sleep_us = (unsigned long) vd->latency_debt_us;
+
+        arch_usleep(sleep_us);
+        vd->latency_debt_us -= sleep_us;
+    }
+}
+
+/*! \brief Parse VDRIVE_LATENCY: "proto=call/byte,..." */
+static void
+latency_init(vdrive_t *vd)
+{
+    const char *p = getenv("VDRIVE_LATENCY");
+    double call_us, byte_us;
+    size_t len;
+    int i;
+
+    while(p && *p)
+    {
+        len = strcspn(p, "=");
+        for(i = 0; i < vdrive_proto_count; i++)
+        {
+            if(strlen(proto_names[i]) == len && strncmp(p, proto_names[i], len) == 0)
+            {
+                break;
+            }
+        }
+
+        call_us = byte_us = 0;
+        if(p[len] == '=' && sscanf(p + len + 1, "%lf/%lf", &call_us, &byte_us) >= 1)
+        {
+            if(i < vdrive_proto_count)
+            {
+                vd->latency[i].call_us = call_us;
+                vd->latency[i].byte_us = byte_us;
+            }
+            else
+            {
+                vdrive_dbg(0, "unknown protocol in VDRIVE_LATENCY: %.*s", (int) len, p);
+            }
+        }
+
+        p = strchr(p, ',');
+        if(p)
+        {
+            p++;
+        }
+    }
+}
+
+/*-------------------------------------------------------------------*/
+/*--------- OPENCBM ARCH FUNCTIONS ----------------------------------*/
+
+/*! \brief Get the name of the driver for a specific port
+
+ \param Port
+   The image file; ignored.
+
+ \return
+   Returns a pointer to a null-terminated string containing the
+   driver name.
+*/
+const char * CBMAPIDECL
+opencbm_plugin_get_driver_name(const char * const Port)
+{
+    return "vdrive";
+}
+
+/*! \brief Opens the driver
+
+ This function loads the image and resets the virtual drive.
+
+ \param HandleDevice
+   Pointer to a CBM_FILE which will contain the file handle of the driver.
+
+ \param Port
+   The image file. If not set (== NULL), VDRIVE_IMAGE is used.
+
+ \return
+   ==0: This function completed successfully
+   !=0: otherwise
+
+ cbm_driver_open() should be balanced with cbm_driver_close().
+*/
+int CBMAPIDECL
+opencbm_plugin_driver_open(CBM_FILE *HandleDevice, const char * const Port)
+{
+    const char *filename = Port;
+    vdrive_t *vd;
+    char *val;
+
+    if(filename == NULL || *filename == '\0')
+    {
+        filename = getenv("VDRIVE_IMAGE");
+    }
+    if(filename == NULL || *filename == '\0')
+    {
+        fprintf(stderr, "vdrive: no image given, use vdrive:<image> or set VDRIVE_IMAGE\n");
+        return 1;
+    }
+
+    vd = calloc(1, sizeof(*vd));
+    if(vd == NULL)
+    {
+        return 1;
+    }
+
+    if(vdrive_image_open(&vd->image, filename))
+    {
+        fprintf(stderr, "vdrive: cannot open image '%s'\n", filename);
+        free(vd);
+        return 1;
+    }
+
+    val = getenv("VDRIVE_DEVICE");
+    vd->device      = (unsigned char) (val ? atoi(val) : 8);
+    vd->xp1541      = getenv("VDRIVE_XP1541") != NULL;
+    vd->print_stats = getenv("VDRIVE_STATS") != NULL;
+    vd->host_lines  = 0;
+    latency_init(vd);
+
+    vdrive_dos_reset(vd);
+
+    val = getenv("VDRIVE_ROM");
+    if(val && *val && vdrive_machine_open(vd, val, getenv("VDRIVE_G64")))
+    {
+        vdrive_image_close(&vd->image);
+        free(vd);
+        return 1;
+    }
+
+    vdrive_dbg(1, "opened '%s' as drive %u", filename, vd->device);
+
+    *HandleDevice = (CBM_FILE) vd;
+    return 0;
+}
+
+/*! \internal \brief Print the drive cycles spent per protocol */
+static void
+print_machine_stats(vdrive_t *vd)
+{
+    vdrive_machine_t *m = vd->machine;
+    int i;
+
+    fprintf(stderr, "vdrive: protocol   drive cycles       bytes  cycles/block\n");
+    for(i = 0; i < vdrive_proto_count; i++)
+    {
+        if(m->proto_cycles[i])
+        {
+            fprintf(stderr, "vdrive: %-8s %14llu  %10llu  %12.0f\n", proto_names[i],
+                    m->proto_cycles[i], m->proto_bytes[i],
+                    m->proto_bytes[i] ? (double) m->proto_cycles[i] * VDRIVE_BLOCKSIZE / m->proto_bytes[i] : 0.0);
+        }
+    }
+    fprintf(stderr, "vdrive: %lu handshake timeouts\n", m->handshake_timeouts);
+}
+
+/*! \brief Closes the driver
+
+ Writes back the image, if it was changed.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+*/
+void CBMAPIDECL
+opencbm_plugin_driver_close(CBM_FILE HandleDevice)
+{
+    vdrive_t *vd = VDRIVE(HandleDevice);
+    int i;
+
+    if(vd == NULL)
+    {
+        return;
+    }
+
+    if(vd->print_stats)
+    {
+        fprintf(stderr, "vdrive: protocol      calls       bytes     time/ms\n");
+        for(i = 0; i < vdrive_proto_count; i++)
+        {
+            fprintf(stderr, "vdrive: %-8s %10lu  %10lu  %10.1f\n", proto_names[i],
+                    vd->latency[i].calls, vd->latency[i].bytes,
+                    vd->latency[i].total_us / 1000.0);
+        }
+        if(vd->machine)
+        {
+            print_machine_stats(vd);
+        }
+    }
+
+    if(vd->machine)
+    {
+        if(vdrive_machine_flush(vd))
+        {
+            fprintf(stderr, "vdrive: cannot write back the G64\n");
+        }
+        vdrive_machine_close(vd);
+    }
+    vdrive_dos_reset(vd);
+    vdrive_image_close(&vd->image);
+    free(vd);
+}
+
+/*! \brief Lock the driver; nothing to do */
+void CBMAPIDECL
+opencbm_plugin_lock(CBM_FILE HandleDevice)
+{
+}
+
+/*! \brief Unlock the driver; nothing to do */
+void CBMAPIDECL
+opencbm_plugin_unlock(CBM_FILE HandleDevice)
+{
+}
+
+/*! \brief Write data to the IEC serial bus
+
+ This function sends data after a cbm_listen().
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Buffer
+   Pointer to a buffer which hold the bytes to write to the bus.
+
+ \param Count
+   Number of bytes to be written.
+
+ \return
+   >= 0: The actual number of bytes written.
+   <0  indicates an error.
+*/
+int CBMAPIDECL
+opencbm_plugin_raw_write(CBM_FILE HandleDevice, const void *Buffer, size_t Count)
+{
+    vdrive_t *vd = VDRIVE(HandleDevice);
+
+    vdrive_latency(vd, vdrive_proto_iec, Count);
+    if(vd->machine)
+    {
+        return vdrive_machine_raw_write(vd, Buffer, Count);
+    }
+    return vdrive_dos_write(vd, Buffer, Count);
+}
+
+/*! \brief Read data from the IEC serial bus
+
+ This function retrieves data after a cbm_talk().
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Buffer
+   Pointer to a buffer which will hold the bytes read.
+
+ \param Count
+   Number of bytes to be read at most.
+
+ \return
+   >= 0: The actual number of bytes read.
+   <0  indicates an error.
+*/
+int CBMAPIDECL
+opencbm_plugin_raw_read(CBM_FILE HandleDevice, void *Buffer, size_t Count)
+{
+    vdrive_t *vd = VDRIVE(HandleDevice);
+    int rv;
+
+    if(vd->machine)
+    {
+        rv = vdrive_machine_raw_read(vd, Buffer, Count);
+    }
+    else
+    {
+        rv = vdrive_dos_read(vd, Buffer, Count);
+    }
+    vdrive_latency(vd, vdrive_proto_iec, rv > 0 ? rv : 0);
+    return rv;
+}
+
+/*! \internal \brief Start an ATN sequence
+
+ Any ATN sequence ends drive code which might still run.
+
+ \return
+   0 if the device is the emulated drive, -1 otherwise.
+*/
+static int
+atn_sequence(vdrive_t *vd, unsigned char DeviceAddress)
+{
+    vdrive_latency(vd, vdrive_proto_bus, 2);
+
+    if(vd->turbo != vdrive_turbo_none)
+    {
+        vdrive_turbo_stop(vd);
+    }
+    return (DeviceAddress == vd->device) ? 0 : -1;
+}
+
+/*! \internal \brief Send an ATN sequence to the emulated drive hardware
+
+ \return
+   0 means success, else failure
+*/
+static int
+machine_atn(vdrive_t *vd, unsigned char c1, unsigned char c2, int count, int talk)
+{
+    unsigned char data[2];
+
+    data[0] = c1;
+    data[1] = c2;
+    vdrive_latency(vd, vdrive_proto_bus, count);
+    return !vdrive_machine_atn_write(vd, data, count, talk);
+}
+
+/*! \brief Send a LISTEN on the IEC serial bus
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param DeviceAddress
+   The address of the device on the IEC serial bus.
+
+ \param SecondaryAddress
+   The secondary address for the device on the IEC serial bus.
+
+ \return
+   0 means success, else failure
+*/
+int CBMAPIDECL
+opencbm_plugin_listen(CBM_FILE HandleDevice, unsigned char DeviceAddress, unsigned char SecondaryAddress)
+{
+    vdrive_t *vd = VDRIVE(HandleDevice);
+
+    if(vd->machine)
+    {
+        return machine_atn(vd, 0x20 | DeviceAddress, 0x60 | SecondaryAddress, 2, 0);
+    }
+
+    if(atn_sequence(vd, DeviceAddress))
+    {
+        vdrive_dos_unlisten(vd);
+        return -1;
+    }
+    return vdrive_dos_listen(vd, SecondaryAddress);
+}
+
+/*! \brief Send a TALK on the IEC serial bus
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param DeviceAddress
+   The address of the device on the IEC serial bus.
+
+ \param SecondaryAddress
+   The secondary address for the device on the IEC serial bus.
+
+ \return
+   0 means success, else failure
+*/
+int CBMAPIDECL
+opencbm_plugin_talk(CBM_FILE HandleDevice, unsigned char DeviceAddress, unsigned char SecondaryAddress)
+{
+    vdrive_t *vd = VDRIVE(HandleDevice);
+
+    if(vd->machine)
+    {
+        return machine_atn(vd, 0x40 | DeviceAddress, 0x60 | SecondaryAddress, 2, 1);
+    }
+
+    if(atn_sequence(vd, DeviceAddress))
+    {
+        vdrive_dos_untalk(vd);
+        return -1;
+    }
+    return vdrive_dos_talk(vd, SecondaryAddress);
+}
+
+/*! \brief Open a file on the IEC serial bus
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param DeviceAddress
+   The address of the device on the IEC serial bus.
+
+ \param SecondaryAddress
+   The secondary address for the device on the IEC serial bus.
+
+ \return
+   0 means success, else failure
+*/
+int CBMAPIDECL
+opencbm_plugin_open(CBM_FILE HandleDevice, unsigned char DeviceAddress, unsigned char SecondaryAddress)
+{
+    vdrive_t *vd = VDRIVE(HandleDevice);
+
+    if(vd->machine)
+    {
+        return machine_atn(vd, 0x20 | DeviceAddress, 0xf0 | SecondaryAddress, 2, 0);
+    }
+
+    if(atn_sequence(vd, DeviceAddress))
+    {
+        vdrive_dos_unlisten(vd);
+        return -1;
+    }
+    return vdrive_dos_open(vd, SecondaryAddress);
+}
+
+/*! \brief Close a file on the IEC serial bus
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param DeviceAddress
+   The address of the device on the IEC serial bus.
+
+ \param SecondaryAddress
+   The secondary address for the device on the IEC serial bus.
+
+ \return
+   0 on success, else failure
+*/
+int CBMAPIDECL
+opencbm_plugin_close(CBM_FILE HandleDevice, unsigned char DeviceAddress, unsigned char SecondaryAddress)
+{
+    vdrive_t *vd = VDRIVE(HandleDevice);
+
+    if(vd->machine)
+    {
+        return machine_atn(vd, 0x20 | DeviceAddress, 0xe0 | SecondaryAddress, 2, 0);
+    }
+
+    if(atn_sequence(vd, DeviceAddress))
+    {
+        return -1;
+    }
+    return vdrive_dos_close(vd, SecondaryAddress);
+}
+
+/*! \brief Send an UNLISTEN on the IEC serial bus
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \return
+   0 on success, else failure
+*/
+int CBMAPIDECL
+opencbm_plugin_unlisten(CBM_FILE HandleDevice)
+{
+    vdrive_t *vd = VDRIVE(HandleDevice);
+
+    if(vd->machine)
+    {
+        return machine_atn(vd, 0x3f, 0, 1, 0);
+    }
+
+    atn_sequence(vd, vd->device);
+    return vdrive_dos_unlisten(vd);
+}
+
+/*! \brief Send an UNTALK on the IEC serial bus
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \return
+   0 on success, else failure
+*/
+int CBMAPIDECL
+opencbm_plugin_untalk(CBM_FILE HandleDevice)
+{
+    vdrive_t *vd = VDRIVE(HandleDevice);
+
+    if(vd->machine)
+    {
+        return machine_atn(vd, 0x5f, 0, 1, 0);
+    }
+
+    atn_sequence(vd, vd->device);
+    return vdrive_dos_untalk(vd);
+}
+
+/*! \brief Get EOI flag after bus read
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \return
+   != 0 if an EOI was received, 0 otherwise
+*/
+int CBMAPIDECL
+opencbm_plugin_get_eoi(CBM_FILE HandleDevice)
+{
+    return VDRIVE(HandleDevice)->eoi;
+}
+
+/*! \brief Reset the EOI flag
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \return
+   0
+*/
+int CBMAPIDECL
+opencbm_plugin_clear_eoi(CBM_FILE HandleDevice)
+{
+    VDRIVE(HandleDevice)->eoi = 0;
+    return 0;
+}
+
+/*! \brief RESET all devices
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \return
+   0 on success
+*/
+int CBMAPIDECL
+opencbm_plugin_reset(CBM_FILE HandleDevice)
+{
+    vdrive_t *vd = VDRIVE(HandleDevice);
+
+    vdrive_latency(vd, vdrive_proto_bus, 0);
+    if(vd->machine)
+    {
+        vdrive_machine_reset(vd);
+        return 0;
+    }
+    vdrive_dos_reset(vd);
+    vd->host_lines = 0;
+    return 0;
+}
+
+/*! \internal \brief The address of the parallel port of the drive, 0 if none */
+static unsigned int
+pia_address(vdrive_t *vd)
+{
+    if(!vd->xp1541)
+    {
+        return 0;
+    }
+    switch(vd->image.type)
+    {
+        case vdrive_d64: return 0x1801;
+        case vdrive_d71: return 0x4001;
+        default:         return 0;
+    }
+}
+
+/*! \brief Read a byte from a XP1541/XP1571 cable
+
+ While drive code runs, this is a byte of its transfer stream.
+ Else, it is the output register of the drive's parallel port, if
+ that port is set to output.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \return
+   the byte which was received on the parallel port
+*/
+unsigned char CBMAPIDECL
+opencbm_plugin_pp_read(CBM_FILE HandleDevice)
+{
+    vdrive_t *vd = VDRIVE(HandleDevice);
+    unsigned int pia = pia_address(vd);
+    unsigned char c = 0xff;
+
+    vdrive_latency(vd, vdrive_proto_pp, 1);
+
+    if(vd->machine)
+    {
+        c = vdrive_machine_pp_read(vd);
+    }
+    else if(vd->turbo != vdrive_turbo_none)
+    {
+        vdrive_turbo_read(vd, 1, &c, 1);
+    }
+    else if(pia && vd->mem[pia + 2] == 0xff)
+    {
+        c = vd->mem[pia];
+    }
+    return c;
+}
+
+/*! \brief Write a byte to a XP1541/XP1571 cable
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Byte
+   the byte to be output on the parallel port
+*/
+void CBMAPIDECL
+opencbm_plugin_pp_write(CBM_FILE HandleDevice, unsigned char Byte)
+{
+    vdrive_t *vd = VDRIVE(HandleDevice);
+
+    vdrive_latency(vd, vdrive_proto_pp, 1);
+
+    vd->pp_out = Byte;
+    if(vd->machine)
+    {
+        vdrive_machine_pp_write(vd, Byte);
+    }
+    else if(vd->turbo != vdrive_turbo_none)
+    {
+        vdrive_turbo_write(vd, 1, &Byte, 1);
+    }
+}
+
+/*! \brief Read status of all bus lines.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \return
+   The state of the lines. The result is an OR between
+   the bit flags IEC_DATA, IEC_CLOCK, IEC_ATN, and IEC_RESET.
+*/
+int CBMAPIDECL
+opencbm_plugin_iec_poll(CBM_FILE HandleDevice)
+{
+    vdrive_t *vd = VDRIVE(HandleDevice);
+
+    vdrive_latency(vd, vdrive_proto_bus, 0);
+    if(vd->machine)
+    {
+        return vdrive_machine_iec_poll(vd);
+    }
+    return vdrive_turbo_lines(vd);
+}
+
+/*! \brief Activate a line on the IEC serial bus
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Line
+   The line to be activated.
+*/
+void CBMAPIDECL
+opencbm_plugin_iec_set(CBM_FILE HandleDevice, int Line)
+{
+    vdrive_t *vd = VDRIVE(HandleDevice);
+
+    vdrive_latency(vd, vdrive_proto_bus, 0);
+    if(vd->machine)
+    {
+        vdrive_machine_iec_setrelease(vd, Line, 0);
+        return;
+    }
+    vd->host_lines |= Line;
+}
+
+/*! \brief Release a line on the IEC serial bus
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Line
+   The line to be released.
+*/
+void CBMAPIDECL
+opencbm_plugin_iec_release(CBM_FILE HandleDevice, int Line)
+{
+    vdrive_t *vd = VDRIVE(HandleDevice);
+
+    vdrive_latency(vd, vdrive_proto_bus, 0);
+    if(vd->machine)
+    {
+        vdrive_machine_iec_setrelease(vd, 0, Line);
+        return;
+    }
+    vd->host_lines &= ~Line;
+}
+
+/*! \brief Activate and deactive a line on the IEC serial bus
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Set
+   The mask of which lines should be set.
+
+ \param Release
+   The mask of which lines should be released.
+*/
+void CBMAPIDECL
+opencbm_plugin_iec_setrelease(CBM_FILE HandleDevice, int Set, int Release)
+{
+    vdrive_t *vd = VDRIVE(HandleDevice);
+
+    vdrive_latency(vd, vdrive_proto_bus, 0);
+    if(vd->machine)
+    {
+        vdrive_machine_iec_setrelease(vd, Set, Release);
+        return;
+    }
+    vd->host_lines = (vd->host_lines & ~Release) | Set;
+}
+
+/*! \brief Wait for a line to have a specific state
+
+ Without the drive hardware emulation, the emulated drive answers
+ every handshake at once, so this never blocks.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Line
+   The line to be monitored.
+
+ \param State
+   If zero, then wait for this line to be deactivated. \n
+   If not zero, then wait for this line to be activated.
+
+ \return
+   The state of the IEC bus on return (like cbm_iec_poll).
+*/
+int CBMAPIDECL
+opencbm_plugin_iec_wait(CBM_FILE HandleDevice, int Line, int State)
+{
+    vdrive_t *vd = VDRIVE(HandleDevice);
+
+    vdrive_latency(vd, vdrive_proto_bus, 0);
+    if(vd->machine)
+    {
+        return vdrive_machine_iec_wait(vd, Line, State);
+    }
+    return vdrive_turbo_wait(vd, Line, State);
+}
+
+/*! \internal \brief Common part of the protocol read functions */
+static int
+turbo_read_n(CBM_FILE HandleDevice, enum vdrive_proto_e proto, int unit, unsigned char *data, unsigned int size)
+{
+    vdrive_t *vd = VDRIVE(HandleDevice);
+    int rv;
+
+    if(vd->machine)
+    {
+        rv = vdrive_machine_read_n(vd, proto, unit, data, size);
+        vdrive_latency(vd, proto, rv);
+        return rv;
+    }
+    if(vd->turbo == vdrive_turbo_none)
+    {
+        return -1;
+    }
+    rv = vdrive_turbo_read(vd, unit, data, size);
+    vdrive_latency(vd, proto, rv);
+    return rv;
+}
+
+/*! \internal \brief Common part of the protocol write functions */
+static int
+turbo_write_n(CBM_FILE HandleDevice, enum vdrive_proto_e proto, int unit, const unsigned char *data, unsigned int size)
+{
+    vdrive_t *vd = VDRIVE(HandleDevice);
+
+    vdrive_latency(vd, proto, size);
+    if(vd->machine)
+    {
+        return vdrive_machine_write_n(vd, proto, unit, data, size);
+    }
+    if(vd->turbo == vdrive_turbo_none)
+    {
+        return -1;
+    }
+    return vdrive_turbo_write(vd, unit, data, size);
+}
+
+/*! \brief Read data with serial1 protocol
+
+  \param HandleDevice
+    A CBM_FILE which contains the file handle of the driver.
+
+  \param data
+    Pointer to the data buffer which will hold the read bytes.
+
+  \param size
+    The size of the data buffer the read bytes will be written to.
+
+  \return
+    The number of bytes actually read, -1 if no drive code runs.
+*/
+int CBMAPIDECL
+opencbm_plugin_s1_read_n(CBM_FILE HandleDevice, unsigned char *data, unsigned int size)
+{
+    return turbo_read_n(HandleDevice, vdrive_proto_s1, 1, data, size);
+}
+
+/*! \brief Write data with serial1 protocol
+
+  \param HandleDevice
+    A CBM_FILE which contains the file handle of the driver.
+
+  \param data
+    Pointer to the data buffer to be written.
+
+  \param size
+    The size of the data buffer to be written.
+
+  \return
+    The number of bytes actually written, -1 if no drive code runs.
+*/
+int CBMAPIDECL
+opencbm_plugin_s1_write_n(CBM_FILE HandleDevice, const unsigned char *data, unsigned int size)
+{
+    return turbo_write_n(HandleDevice, vdrive_proto_s1, 1, data, size);
+}
+
+/*! \brief Read data with serial2 protocol
+
+  \param HandleDevice
+    A CBM_FILE which contains the file handle of the driver.
+
+  \param data
+    Pointer to the data buffer which will hold the read bytes.
+
+  \param size
+    The size of the data buffer the read bytes will be written to.
+
+  \return
+    The number of bytes actually read, -1 if no drive code runs.
+*/
+int CBMAPIDECL
+opencbm_plugin_s2_read_n(CBM_FILE HandleDevice, unsigned char *data, unsigned int size)
+{
+    return turbo_read_n(HandleDevice, vdrive_proto_s2, 1, data, size);
+}
+
+/*! \brief Write data with serial2 protocol
+
+  \param HandleDevice
+    A CBM_FILE which contains the file handle of the driver.
+
+  \param data
+    Pointer to the data buffer to be written.
+
+  \param size
+    The size of the data buffer to be written.
+
+  \return
+    The number of bytes actually written, -1 if no drive code runs.
+*/
+int CBMAPIDECL
+opencbm_plugin_s2_write_n(CBM_FILE HandleDevice, const unsigned char *data, unsigned int size)
+{
+    return turbo_write_n(HandleDevice, vdrive_proto_s2, 1, data, size);
+}
+
+/*! \brief Read data with the d64copy parallel protocol (byte pairs)
+
+  \param HandleDevice
+    A CBM_FILE which contains the file handle of the driver.
+
+  \param data
+    Pointer to the data buffer which will hold the read bytes.
+
+  \param size
+    The size of the data buffer the read bytes will be written to.
+
+  \return
+    The number of bytes actually read, -1 if no drive code runs.
+*/
+int CBMAPIDECL
+opencbm_plugin_pp_dc_read_n(CBM_FILE HandleDevice, unsigned char *data, unsigned int size)
+{
+    return turbo_read_n(HandleDevice, vdrive_proto_pp, 2, data, size);
+}
+
+/*! \brief Write data with the d64copy parallel protocol (byte pairs)
+
+  \param HandleDevice
+    A CBM_FILE which contains the file handle of the driver.
+
+  \param data
+    Pointer to the data buffer to be written.
+
+  \param size
+    The size of the data buffer to be written.
+
+  \return
+    The number of bytes actually written, -1 if no drive code runs.
+*/
+int CBMAPIDECL
+opencbm_plugin_pp_dc_write_n(CBM_FILE HandleDevice, const unsigned char *data, unsigned int size)
+{
+    return turbo_write_n(HandleDevice, vdrive_proto_pp, 2, data, size);
+}
+
+/*! \brief Read data with the cbmcopy parallel protocol
+
+  \param HandleDevice
+    A CBM_FILE which contains the file handle of the driver.
+
+  \param data
+    Pointer to the data buffer which will hold the read bytes.
+
+  \param size
+    The size of the data buffer the read bytes will be written to.
+
+  \return
+    The number of bytes actually read, -1 if no drive code runs.
+*/
+int CBMAPIDECL
+opencbm_plugin_pp_cc_read_n(CBM_FILE HandleDevice, unsigned char *data, unsigned int size)
+{
+    return turbo_read_n(HandleDevice, vdrive_proto_pp, 1, data, size);
+}
+
+/*! \brief Write data with the cbmcopy parallel protocol
+
+  \param HandleDevice
+    A CBM_FILE which contains the file handle of the driver.
+
+  \param data
+    Pointer to the data buffer to be written.
+
+  \param size
+    The size of the data buffer to be written.
+
+  \return
+    The number of bytes actually written, -1 if no drive code runs.
+*/
+int CBMAPIDECL
+opencbm_plugin_pp_cc_write_n(CBM_FILE HandleDevice, const unsigned char *data, unsigned int size)
+{
+    return turbo_write_n(HandleDevice, vdrive_proto_pp, 1, data, size);
+}
@@ -0,0 +1,502 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version
+ *  2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 The OpenCBM project
+ */
+
+/*! **************************************************************
+** \file lib/plugin/vdrive/cpu6502.c \n
+** \n
+** \brief Image backed virtual drive: NMOS 6502 core
+**
+** Every instruction is executed as a whole; the number of cycles
+** it takes (including page crossing and branch penalties) is
+** returned, so the VIAs and the disk can be clocked in between.
+** Undocumented opcodes are executed as NOPs.
+**
+****************************************************************/
+
+#include "vdrive.h"
+
+#define FLAG_C  0x01
+#define FLAG_Z  0x02
+#define FLAG_I  0x04
+#define FLAG_D  0x08
+#define FLAG_B  0x10
+#define FLAG_U  0x20
+#define FLAG_V  0x40
+#define FLAG_N  0x80
+
+#define RD(_a)      cpu->read(cpu->context, (unsigned short) (_a))
+#define WR(_a, _v)  cpu->write(cpu->context, (unsigned short) (_a), (unsigned char) (_v))
+
+#define SET_NZ(_v) \
+    (cpu->p = (unsigned char) ((cpu->p & ~(FLAG_N | FLAG_Z)) \
+                               | ((_v) & FLAG_N) | (((_v) & 0xff) ? 0 : FLAG_Z)))
+
+/*! base cycle count of every opcode */
+static const unsigned char cycles[256] =
+{
+/*  0 1 2 3 4 5 6 7 8 9 A B C D E F */
+    7,6,2,2,3,3,5,2,3,2,2,2,4,4,6,2, /* 0 */
+    2,5,2,2,4,4,6,2,2,4,2,2,4,4,7,2, /* 1 */
+    6,6,2,2,3,3,5,2,4,2,2,2,4,4,6,2, /* 2 */
+    2,5,2,2,4,4,6,2,2,4,2,2,4,4,7,2, /* 3 */
+    6,6,2,2,3,3,5,2,3,2,2,2,3,4,6,2, /* 4 */
+    2,5,2,2,4,4,6,2,2,4,2,2,4,4,7,2, /* 5 */
+    6,6,2,2,3,3,5,2,4,2,2,2,5,4,6,2, /* 6 */
+    2,5,2,2,4,4,6,2,2,4,2,2,4,4,7,2, /* 7 */
+    2,6,2,2,3,3,3,2,2,2,2,2,4,4,4,2, /* 8 */
+    2,6,2,2,4,4,4,2,2,5,2,2,4,5,5,2, /* 9 */
+    2,6,2,2,3,3,3,2,2,2,2,2,4,4,4,2, /* A */
+    2,5,2,2,4,4,4,2,2,4,2,2,4,4,4,2, /* B */
+    2,6,2,2,3,3,5,2,2,2,2,2,4,4,6,2, /* C */
+    2,5,2,2,4,4,6,2,2,4,2,2,4,4,7,2, /* D */
+    2,6,2,2,3,3,5,2,2,2,2,2,4,4,6,2, /* E */
+    2,5,2,2,4,4,6,2,2,4,2,2,4,4,7,2  /* F */
+};
+
+static void
+push(vdrive_cpu_t *cpu, unsigned char value)
+{
+    WR(0x100 | cpu->sp, value);
+    cpu->sp--;
+}
+
+static unsigned char
+pull(vdrive_cpu_t *cpu)
+{
+    cpu->sp++;
+    return RD(0x100 | cpu->sp);
+}
+
+static unsigned int
+read_word(vdrive_cpu_t *cpu, unsigned int address)
+{
+    return RD(address) | (RD(address + 1) << 8);
+}
+
+/*! \brief read a zero page pointer; the high byte wraps within page 0 */
+static unsigned int
+read_zp_word(vdrive_cpu_t *cpu, unsigned int address)
+{
+    return RD(address & 0xff) | (RD((address + 1) & 0xff) << 8);
+}
+
+static void
+adc(vdrive_cpu_t *cpu, unsigned char value)
+{
+    unsigned int c = cpu->p & FLAG_C;
+    unsigned int sum = cpu->a + value + c;
+
+    cpu->p &= ~(FLAG_C | FLAG_V | FLAG_N | FLAG_Z);
+
+    if(cpu->p & FLAG_D)
+    {
+        unsigned int lo = (cpu->a & 0x0f) + (value & 0x0f) + c;
+        unsigned int hi = (cpu->a & 0xf0) + (value & 0xf0);
+
+        if(((cpu->a + value + c) & 0xff) == 0)
+        {
+            cpu->p |= FLAG_Z;
+        }
+        if(lo > 9)
+        {
+            lo += 6;
+        }
+        if(lo > 0x0f)
+        {
+            hi += 0x10;
+        }
+        cpu->p |= hi & FLAG_N;
+        if(~(cpu->a ^ value) & (cpu->a ^ hi) & 0x80)
+        {
+            cpu->p |= FLAG_V;
+        }
+        if(hi > 0x90)
+        {
+            hi += 0x60;
+        }
+        if(hi > 0xff)
+        {
+            cpu->p |= FLAG_C;
+        }
+        cpu->a = (unsigned char) ((hi & 0xf0) | (lo & 0x0f));
+    }
+    else
+    {
+        if(sum > 0xff)
+        {
+            cpu->p |= FLAG_C;
+        }
+        if(~(cpu->a ^ value) & (cpu->a ^ sum) & 0x80)
+        {
+            cpu->p |= FLAG_V;
+        }
+        cpu->a = (unsigned char) sum;
+        SET_NZ(cpu->a);
+    }
+}
+
+static void
+sbc(vdrive_cpu_t *cpu, unsigned char value)
+{
+    unsigned int borrow = (cpu->p & FLAG_C) ? 0 : 1;
+    unsigned int diff = cpu->a - value - borrow;
+
+    if(cpu->p & FLAG_D)
+    {
+        int lo = (cpu->a & 0x0f) - (value & 0x0f) - (int) borrow;
+        int hi = (cpu->a & 0xf0) - (value & 0xf0);
+
+        if(lo < 0)
+        {
+            lo -= 6;
+            hi -= 0x10;
+        }
+        if(hi < 0)
+        {
+            hi -= 0x60;
+        }
+
+        cpu->p &= ~(FLAG_C | FLAG_V | FLAG_N | FLAG_Z);
+        if(diff < 0x100)
+        {
+            cpu->p |= FLAG_C;
+        }
+        if((cpu->a ^ value) & (cpu->a ^ diff) & 0x80)
+        {
+            cpu->p |= FLAG_V;
+        }
+        SET_NZ(diff);
+        cpu->a = (unsigned char) ((hi & 0xf0) | (lo & 0x0f));
+    }
+    else
+    {
+        cpu->p &= ~(FLAG_C | FLAG_V);
+        if(diff < 0x100)
+        {
+            cpu->p |= FLAG_C;
+        }
+        if((cpu->a ^ value) & (cpu->a ^ diff) & 0x80)
+        {
+            cpu->p |= FLAG_V;
+        }
+        cpu->a = (unsigned char) diff;
+        SET_NZ(cpu->a);
+    }
+}
+
+static void
+compare(vdrive_cpu_t *cpu, unsigned char reg, unsigned char value)
+{
+    unsigned int diff = reg - value;
+
+    cpu->p &= ~FLAG_C;
+    if(reg >= value)
+    {
+        cpu->p |= FLAG_C;
+    }
+    SET_NZ(diff);
+}
+
+/*! \brief Execute a read-modify-write operation (shifts, INC, DEC) */
+static unsigned char
+rmw(vdrive_cpu_t *cpu, unsigned char op, unsigned char value)
+{
+    unsigned int c;
+
+    switch(op >> 5)
+    {
+        case 0: /* ASL */
+            cpu->p = (unsigned char) ((cpu->p & ~FLAG_C) | (value >> 7));
+            value <<= 1;
+            break;
+        case 1: /* ROL */
+            c = cpu->p & FLAG_C;
+            cpu->p = (unsigned char) ((cpu->p & ~FLAG_C) | (value >> 7));
+            value = (unsigned char) ((value << 1) | c);
+            break;
+        case 2: /* LSR */
+            cpu->p = (unsigned char) ((cpu->p & ~FLAG_C) | (value & 1));
+            value >>= 1;
+            break;
+        case 3: /* ROR */
+            c = cpu->p & FLAG_C;
+            cpu->p = (unsigned char) ((cpu->p & ~FLAG_C) | (value & 1));
+            value = (unsigned char) ((value >> 1) | (c << 7));
+            break;
+        case 6: /* DEC */
+            value--;
+            break;
+        case 7: /* INC */
+            value++;
+            break;
+    }
+    SET_NZ(value);
+    return value;
+}
+
+/*! \brief Reset the CPU: fetch the reset vector */
+void
+vdrive_cpu_reset(vdrive_cpu_t *cpu)
+{
+    cpu->a = cpu->x = cpu->y = 0;
+    cpu->sp = 0xfd;
+    cpu->p  = FLAG_U | FLAG_I;
+    cpu->pc = (unsigned short) read_word(cpu, 0xfffc);
+    cpu->irq = 0;
+    cpu->cycles += 7;
+}
+
+/*! \brief Execute one instruction, or take a pending interrupt
+
+ \return
+   The number of cycles used.
+*/
+int
+vdrive_cpu_step(vdrive_cpu_t *cpu)
+{
+    unsigned char op, value = 0;
+    unsigned int address = 0, base, pc;
+    int n;
+
+    if(cpu->irq && !(cpu->p & FLAG_I))
+    {
+        push(cpu, (unsigned char) (cpu->pc >> 8));
+        push(cpu, (unsigned char) cpu->pc);
+        push(cpu, (unsigned char) ((cpu->p | FLAG_U) & ~FLAG_B));
+        cpu->p |= FLAG_I;
+        cpu->pc = (unsigned short) read_word(cpu, 0xfffe);
+        cpu->cycles += 7;
+        return 7;
+    }
+
+    pc = cpu->pc;
+    op = RD(pc);
+    n  = cycles[op];
+    pc++;
+
+    /* address calculation, by the addressing mode */
+    switch(op & 0x1f)
+    {
+        case 0x01: case 0x03:                                       /* (zp,X) */
+            address = read_zp_word(cpu, RD(pc++) + cpu->x);
+            break;
+        case 0x11: case 0x13:                                       /* (zp),Y */
+            base = read_zp_word(cpu, RD(pc++));
+            address = (base + cpu->y) & 0xffff;
+            if((base ^ address) & 0x100 && op != 0x91)
+            {
+                n++;
+            }
+            break;
+        case 0x04: case 0x05: case 0x06: case 0x07:                 /* zp */
+            address = RD(pc++);
+            break;
+        case 0x14: case 0x15: case 0x16: case 0x17:                 /* zp,X or zp,Y */
+            address = (RD(pc++) + ((op == 0x96 || op == 0xb6) ? cpu->y : cpu->x)) & 0xff;
+            break;
+        case 0x0c: case 0x0d: case 0x0e: case 0x0f:                 /* abs */
+            address = read_word(cpu, pc);
+            pc += 2;
+            break;
+        case 0x19: case 0x1b:                                       /* abs,Y */
+        case 0x1c: case 0x1d: case 0x1e: case 0x1f:                 /* abs,X (abs,Y for LDX) */
+            base = read_word(cpu, pc);
+            pc += 2;
+            address = (base + (((op & 0x1f) == 0x19 || op == 0xbe) ? cpu->y : cpu->x)) & 0xffff;
+            if((base ^ address) & 0x100 && (op & 0xe0) != 0x80
+               && ((op & 0x0f) == 0x09 || (op & 0x0f) == 0x0d || op == 0xbc || op == 0xbe))
+            {
+                n++;
+            }
+            break;
+        case 0x00: case 0x02: case 0x09: case 0x0b:                 /* immediate (most) */
+            if(op >= 0x80 || (op & 0x1f) == 0x09)
+            {
+                address = pc++;
+            }
+            break;
+        default:
+            break;
+    }
+
+    switch(op)
+    {
+        /* loads and stores */
+        case 0xa9: case 0xa5: case 0xb5: case 0xad: case 0xbd: case 0xb9: case 0xa1: case 0xb1:
+            cpu->a = RD(address);
+            SET_NZ(cpu->a);
+            break;
+        case 0xa2: case 0xa6: case 0xb6: case 0xae: case 0xbe:
+            cpu->x = RD(address);
+            SET_NZ(cpu->x);
+            break;
+        case 0xa0: case 0xa4: case 0xb4: case 0xac: case 0xbc:
+            cpu->y = RD(address);
+            SET_NZ(cpu->y);
+            break;
+        case 0x85: case 0x95: case 0x8d: case 0x9d: case 0x99: case 0x81: case 0x91:
+            WR(address, cpu->a);
+            break;
+        case 0x86: case 0x96: case 0x8e:
+            WR(address, cpu->x);
+            break;
+        case 0x84: case 0x94: case 0x8c:
+            WR(address, cpu->y);
+            break;
+
+        /* arithmetic and logic */
+        case 0x09: case 0x05: case 0x15: case 0x0d: case 0x1d: case 0x19: case 0x01: case 0x11:
+            cpu->a |= RD(address);
+            SET_NZ(cpu->a);
+            break;
+        case 0x29: case 0x25: case 0x35: case 0x2d: case 0x3d: case 0x39: case 0x21: case 0x31:
+            cpu->a &= RD(address);
+            SET_NZ(cpu->a);
+            break;
+        case 0x49: case 0x45: case 0x55: case 0x4d: case 0x5d: case 0x59: case 0x41: case 0x51:
+            cpu->a ^= RD(address);
+            SET_NZ(cpu->a);
+            break;
+        case 0x69: case 0x65: case 0x75: case 0x6d: case 0x7d: case 0x79: case 0x61: case 0x71:
+            adc(cpu, RD(address));
+            break;
+        case 0xe9: case 0xe5: case 0xf5: case 0xed: case 0xfd: case 0xf9: case 0xe1: case 0xf1:
+            sbc(cpu, RD(address));
+            break;
+        case 0xc9: case 0xc5: case 0xd5: case 0xcd: case 0xdd: case 0xd9: case 0xc1: case 0xd1:
+            compare(cpu, cpu->a, RD(address));
+            break;
+        case 0xe0: case 0xe4: case 0xec:
+            compare(cpu, cpu->x, RD(address));
+            break;
+        case 0xc0: case 0xc4: case 0xcc:
+            compare(cpu, cpu->y, RD(address));
+            break;
+        case 0x24: case 0x2c:
+            value = RD(address);
+            cpu->p = (unsigned char) ((cpu->p & ~(FLAG_N | FLAG_V | FLAG_Z))
+                                      | (value & (FLAG_N | FLAG_V)) | ((value & cpu->a) ? 0 : FLAG_Z));
+            break;
+
+        /* read-modify-write */
+        case 0x0a: case 0x2a: case 0x4a: case 0x6a:
+            cpu->a = rmw(cpu, op, cpu->a);
+            break;
+        case 0x06: case 0x16: case 0x0e: case 0x1e:
+        case 0x26: case 0x36: case 0x2e: case 0x3e:
+        case 0x46: case 0x56: case 0x4e: case 0x5e:
+        case 0x66: case 0x76: case 0x6e: case 0x7e:
+        case 0xc6: case 0xd6: case 0xce: case 0xde:
+        case 0xe6: case 0xf6: case 0xee: case 0xfe:
+            value = RD(address);
+            WR(address, value);             /* the dummy write of the NMOS 6502 */
+            WR(address, rmw(cpu, op, value));
+            break;
+
+        /* register transfers, increments and decrements */
+        case 0xaa: cpu->x = cpu->a; SET_NZ(cpu->x); break;
+        case 0x8a: cpu->a = cpu->x; SET_NZ(cpu->a); break;
+        case 0xa8: cpu->y = cpu->a; SET_NZ(cpu->y); break;
+        case 0x98: cpu->a = cpu->y; SET_NZ(cpu->a); break;
+        case 0xba: cpu->x = cpu->sp; SET_NZ(cpu->x); break;
+        case 0x9a: cpu->sp = cpu->x; break;
+        case 0xe8: cpu->x++; SET_NZ(cpu->x); break;
+        case 0xca: cpu->x--; SET_NZ(cpu->x); break;
+        case 0xc8: cpu->y++; SET_NZ(cpu->y); break;
+        case 0x88: cpu->y--; SET_NZ(cpu->y); break;
+
+        /* stack */
+        case 0x48: push(cpu, cpu->a); break;
+        case 0x08: push(cpu, (unsigned char) (cpu->p | FLAG_B | FLAG_U)); break;
+        case 0x68: cpu->a = pull(cpu); SET_NZ(cpu->a); break;
+        case 0x28: cpu->p = (unsigned char) ((pull(cpu) & ~FLAG_B) | FLAG_U); break;
+
+        /* flags */
+        case 0x18: cpu->p &= ~FLAG_C; break;
+        case 0x38: cpu->p |= FLAG_C; break;
+        case 0x58: cpu->p &= ~FLAG_I; break;
+        case 0x78: cpu->p |= FLAG_I; break;
+        case 0xb8: cpu->p &= ~FLAG_V; break;
+        case 0xd8: cpu->p &= ~FLAG_D; break;
+        case 0xf8: cpu->p |= FLAG_D; break;
+
+        /* jumps and subroutines */
+        case 0x4c:
+            pc = address;
+            break;
+        case 0x6c:
+            /* the NMOS 6502 does not carry into the high byte of the pointer */
+            pc = RD(address) | (RD((address & 0xff00) | ((address + 1) & 0xff)) << 8);
+            break;
+        case 0x20:
+            address = read_word(cpu, pc);
+            pc++;
+            push(cpu, (unsigned char) (pc >> 8));
+            push(cpu, (unsigned char) pc);
+            pc = address;
+            break;
+        case 0x60:
+            pc = pull(cpu);
+            pc |= pull(cpu) << 8;
+            pc++;
+            break;
+        case 0x40:
+            cpu->p = (unsigned char) ((pull(cpu) & ~FLAG_B) | FLAG_U);
+            pc = pull(cpu);
+            pc |= pull(cpu) << 8;
+            break;
+        case 0x00:
+            pc++;
+            push(cpu, (unsigned char) (pc >> 8));
+            push(cpu, (unsigned char) pc);
+            push(cpu, (unsigned char) (cpu->p | FLAG_B | FLAG_U));
+            cpu->p |= FLAG_I;
+            pc = read_word(cpu, 0xfffe);
+            break;
+
+        /* branches */
+        case 0x10: case 0x30: case 0x50: case 0x70:
+        case 0x90: case 0xb0: case 0xd0: case 0xf0:
+        {
+            static const unsigned char flag[4] = { FLAG_N, FLAG_V, FLAG_C, FLAG_Z };
+            int taken = ((cpu->p & flag[op >> 6]) != 0) == ((op & 0x20) != 0);
+            signed char offset = (signed char) RD(pc++);
+
+            if(taken)
+            {
+                address = (pc + offset) & 0xffff;
+                n += ((address ^ pc) & 0x100) ? 2 : 1;
+                pc = address;
+            }
+            break;
+        }
+
+        case 0xea:
+            break;
+
+        default:
+            /* undocumented opcodes: skip the operand bytes like a NOP */
+            if(!cpu->jammed)
+            {
+                cpu->jammed = op | 0x100;
+            }
+            break;
+    }
+
+    cpu->pc = (unsigned short) pc;
+    cpu->cycles += n;
+    return n;
+}
+
+/*! \brief The SO pin went active: set the V flag */
+void
+vdrive_cpu_set_overflow(vdrive_cpu_t *cpu)
+{
+    cpu->p |= FLAG_V;
+}
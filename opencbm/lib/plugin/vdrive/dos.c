@@ -0,0 +1,1005 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version
+ *  2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 The OpenCBM project
+ */
+
+/*! **************************************************************
+** \file lib/plugin/vdrive/dos.c \n
+** \n
+** \brief Image backed virtual drive: CBM DOS channels and commands
+**
+****************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vdrive.h"
+
+/*! the DOS error messages */
+static const struct
+{
+    int code;
+    const char *text;
+} dos_messages[] =
+{
+    {  0, "OK" },
+    {  1, "FILES SCRATCHED" },
+    { 20, "READ ERROR" },
+    { 21, "READ ERROR" },
+    { 22, "READ ERROR" },
+    { 23, "READ ERROR" },
+    { 24, "READ ERROR" },
+    { 25, "WRITE ERROR" },
+    { 26, "WRITE PROTECT ON" },
+    { 27, "READ ERROR" },
+    { 28, "WRITE ERROR" },
+    { 29, "DISK ID MISMATCH" },
+    { 30, "SYNTAX ERROR" },
+    { 31, "SYNTAX ERROR" },
+    { 32, "SYNTAX ERROR" },
+    { 33, "SYNTAX ERROR" },
+    { 34, "SYNTAX ERROR" },
+    { 60, "WRITE FILE OPEN" },
+    { 61, "FILE NOT OPEN" },
+    { 62, "FILE NOT FOUND" },
+    { 63, "FILE EXISTS" },
+    { 64, "FILE TYPE MISMATCH" },
+    { 65, "NO BLOCK" },
+    { 66, "ILLEGAL TRACK OR SECTOR" },
+    { 67, "ILLEGAL SYSTEM T OR S" },
+    { 70, "NO CHANNEL" },
+    { 71, "DIR ERROR" },
+    { 72, "DISK FULL" },
+    { 74, "DRIVE NOT READY" },
+    { -1, NULL }
+};
+
+/*! file type letters as given in an OPEN, in the order of the directory types */
+static const char open_types[] = "DSPU";
+
+/*! \brief Set the status of the error channel */
+void
+vdrive_dos_set_status(vdrive_t *vd, int status, unsigned int track, unsigned int sector)
+{
+    const char *text = "UNKNOWN ERROR";
+    int i;
+
+    if(status == 73)
+    {
+        text = (vd->image.type == vdrive_d81) ? "COPYRIGHT CBM DOS V10 1581"
+             : (vd->image.type == vdrive_d71) ? "CBM DOS V3.0 1571"
+             : "CBM DOS V2.6 1541";
+    }
+    for(i = 0; dos_messages[i].text; i++)
+    {
+        if(dos_messages[i].code == status)
+        {
+            text = dos_messages[i].text;
+            break;
+        }
+    }
+
+    vd->status        = status;
+    vd->status_track  = (unsigned char) track;
+    vd->status_sector = (unsigned char) sector;
+    vd->status_length = sprintf((char *) vd->status_buffer, "%02d, %s,%02u,%02u\r",
+                                status, text, track & 0xff, sector & 0xff);
+    vd->status_pos    = 0;
+}
+
+static unsigned char *
+buffer_memory(vdrive_t *vd, int buffer)
+{
+    return vd->mem + 0x300 + 0x100 * buffer;
+}
+
+static void
+channel_free(vdrive_t *vd, vdrive_channel_t *ch)
+{
+    if(ch->mode == vdrive_ch_buffer && ch->buffer >= 0)
+    {
+        vd->buffer_used[ch->buffer] = 0;
+    }
+    free(ch->data);
+    memset(ch, 0, sizeof(*ch));
+    ch->mode   = vdrive_ch_closed;
+    ch->buffer = -1;
+}
+
+/*! \brief Reset the drive to its power-on state */
+void
+vdrive_dos_reset(vdrive_t *vd)
+{
+    int i;
+
+    vdrive_turbo_stop(vd);
+
+    for(i = 0; i < VDRIVE_CHANNELS; i++)
+    {
+        channel_free(vd, &vd->channel[i]);
+    }
+    memset(vd->buffer_used, 0, sizeof(vd->buffer_used));
+
+    /* RAM is cleared, the ROM footprints are what cbm_identify() looks for */
+    memset(vd->mem, 0, sizeof(vd->mem));
+    switch(vd->image.type)
+    {
+        case vdrive_d81:
+            vd->ram_size = 0x2000;
+            vd->mem[0xff40] = 0xba;
+            vd->mem[0xff41] = 0x01;
+            break;
+
+        case vdrive_d71:
+            vd->ram_size = 0x0800;
+            vd->mem[0xff40] = 0xac;
+            vd->mem[0xff41] = 0x02;
+            break;
+
+        default:
+            vd->ram_size = 0x0800;
+            vd->mem[0xff40] = 0xaa;
+            vd->mem[0xff41] = 0xaa;
+            vd->mem[0xfffe] = 0x67;
+            vd->mem[0xffff] = 0xfe;
+            break;
+    }
+    memset(vd->upload_pages, 0, sizeof(vd->upload_pages));
+    vd->upload_next = 0;
+
+    vd->listening  = -1;
+    vd->talking    = -1;
+    vd->opening    = 0;
+    vd->cmd_length = 0;
+    vd->eoi        = 0;
+
+    vdrive_image_flush(&vd->image);
+    vdrive_dos_set_status(vd, 73, 0, 0);
+}
+
+/*! \brief Parse the numeric parameters of a command
+
+ Numbers are separated by blanks, commas, colons or cursor right
+ characters, like the 1541 DOS accepts them.
+
+ \return
+   The number of parameters found.
+*/
+static int
+parse_params(const unsigned char *cmd, size_t length, unsigned int *param, int max)
+{
+    size_t i = 0;
+    int n = 0;
+
+    while(i < length && n < max)
+    {
+        while(i < length && (cmd[i] < '0' || cmd[i] > '9'))
+        {
+            if(cmd[i] != ' ' && cmd[i] != ',' && cmd[i] != ':' && cmd[i] != 0x1d)
+            {
+                return n;
+            }
+            i++;
+        }
+        if(i == length)
+        {
+            break;
+        }
+        param[n] = 0;
+        while(i < length && cmd[i] >= '0' && cmd[i] <= '9')
+        {
+            param[n] = param[n] * 10 + (cmd[i++] - '0');
+        }
+        n++;
+    }
+    return n;
+}
+
+/*! \brief Skip the drive number and the colon of a file name or command */
+static const unsigned char *
+skip_drive(const unsigned char *p, size_t *length)
+{
+    const unsigned char *colon = memchr(p, ':', *length);
+
+    if(colon)
+    {
+        *length -= colon + 1 - p;
+        return colon + 1;
+    }
+    return p;
+}
+
+/*! \brief Length of a name up to a comma, '=' or the end */
+static size_t
+name_length(const unsigned char *p, size_t length)
+{
+    size_t n;
+
+    for(n = 0; n < length && p[n] != ',' && p[n] != '='; n++)
+        ;
+    return n;
+}
+
+static vdrive_channel_t *
+buffer_channel(vdrive_t *vd, unsigned int sa)
+{
+    if(sa >= VDRIVE_CHANNELS || vd->channel[sa].mode != vdrive_ch_buffer)
+    {
+        return NULL;
+    }
+    return &vd->channel[sa];
+}
+
+/*! \brief Execute U1/U2 and the B- commands */
+static void
+block_command(vdrive_t *vd, char op, const unsigned char *args, size_t length)
+{
+    unsigned int p[4];
+    vdrive_channel_t *ch;
+    unsigned char *buf;
+    int rv;
+
+    if(op == 'P')
+    {
+        if(parse_params(args, length, p, 2) != 2)
+        {
+            vdrive_dos_set_status(vd, 30, 0, 0);
+            return;
+        }
+        ch = buffer_channel(vd, p[0]);
+        if(ch == NULL)
+        {
+            vdrive_dos_set_status(vd, 70, 0, 0);
+            return;
+        }
+        ch->pos = p[1] & 0xff;
+        vdrive_dos_set_status(vd, 0, 0, 0);
+        return;
+    }
+
+    if(op == 'A' || op == 'F')
+    {
+        if(parse_params(args, length, p, 3) != 3)
+        {
+            vdrive_dos_set_status(vd, 30, 0, 0);
+            return;
+        }
+        rv = (op == 'A') ? vdrive_bam_allocate(&vd->image, p[1], p[2])
+                         : vdrive_bam_free(&vd->image, p[1], p[2]);
+        vdrive_dos_set_status(vd, rv, rv ? p[1] : 0, rv ? p[2] : 0);
+        return;
+    }
+
+    /* read or write: channel, drive, track, sector */
+    if(parse_params(args, length, p, 4) != 4)
+    {
+        vdrive_dos_set_status(vd, 30, 0, 0);
+        return;
+    }
+    ch = buffer_channel(vd, p[0]);
+    if(ch == NULL)
+    {
+        vdrive_dos_set_status(vd, 70, 0, 0);
+        return;
+    }
+    if(vdrive_image_check_ts(&vd->image, p[2], p[3]))
+    {
+        vdrive_dos_set_status(vd, 66, p[2], p[3]);
+        return;
+    }
+
+    vdrive_latency(vd, vdrive_proto_disk, 0);
+    buf = buffer_memory(vd, ch->buffer);
+
+    switch(op)
+    {
+        case 'R':   /* B-R: byte 0 holds the number of valid bytes */
+        case '1':   /* U1: the complete block */
+            rv = vdrive_image_read(&vd->image, p[2], p[3], buf);
+            ch->pos    = (op == 'R') ? 1 : 0;
+            ch->length = (op == 'R') ? (size_t) buf[0] + 1 : VDRIVE_BLOCKSIZE;
+            break;
+
+        case 'W':   /* B-W: the buffer pointer is stored in byte 0 */
+            buf[0] = (unsigned char) (ch->pos - 1);
+            /* fall through */
+        default:    /* U2 */
+            rv = vdrive_image_write(&vd->image, p[2], p[3], buf);
+            break;
+    }
+
+    vdrive_dos_set_status(vd, rv, rv ? p[2] : 0, rv ? p[3] : 0);
+}
+
+/*! \brief Execute the M- commands */
+static void
+memory_command(vdrive_t *vd, const unsigned char *cmd, size_t length)
+{
+    unsigned int address, count, i;
+
+    if(length < 5)
+    {
+        vdrive_dos_set_status(vd, 31, 0, 0);
+        return;
+    }
+    address = cmd[3] | (cmd[4] << 8);
+
+    switch(cmd[2])
+    {
+        case 'R':
+            count = (length > 5) ? cmd[5] : 1;
+            if(count == 0)
+            {
+                count = 0x100;
+            }
+            for(i = 0; i < count; i++)
+            {
+                vd->status_buffer[i] = vd->mem[(address + i) & 0xffff];
+            }
+            vd->status_buffer[count] = '\r';
+            vd->status_length = count + 1;
+            vd->status_pos    = 0;
+            break;
+
+        case 'W':
+            count = (length > 5) ? cmd[5] : 0;
+            if(count > length - 6)
+            {
+                count = (unsigned int) (length - 6);
+            }
+            if(count > 0 && address != vd->upload_next)
+            {
+                /* not a continuation of the previous M-W: a new upload starts here */
+                vd->upload_pages[address >> 11] |= 1 << ((address >> 8) & 7);
+            }
+            for(i = 0; i < count; i++, address++)
+            {
+                /* ROM is not writable */
+                if(address < 0x8000)
+                {
+                    vd->mem[address] = cmd[6 + i];
+                }
+            }
+            vd->upload_next = address;
+            vdrive_dos_set_status(vd, 0, 0, 0);
+            break;
+
+        case 'E':
+            vdrive_dos_set_status(vd, 0, 0, 0);
+            vdrive_turbo_start(vd, address, NULL, 0);
+            break;
+
+        default:
+            vdrive_dos_set_status(vd, 31, 0, 0);
+            break;
+    }
+}
+
+/*! \brief Execute the U commands */
+static void
+user_command(vdrive_t *vd, const unsigned char *cmd, size_t length)
+{
+    unsigned char c = (length > 1) ? cmd[1] : 0;
+    const unsigned char *param;
+    size_t param_length;
+
+    switch(c)
+    {
+        case '1': case 'A':
+            block_command(vd, '1', cmd + 2, length - 2);
+            break;
+
+        case '2': case 'B':
+            block_command(vd, '2', cmd + 2, length - 2);
+            break;
+
+        case '3': case '4': case '5': case '6': case '7': case '8':
+        case 'C': case 'D': case 'E': case 'F': case 'G': case 'H':
+            c = (unsigned char) ((c >= 'C') ? c - 'C' : c - '3');
+            param = cmd + 2;
+            param_length = length - 2;
+            if(param_length > 0 && *param == ':')
+            {
+                param++;
+                param_length--;
+            }
+            vdrive_dos_set_status(vd, 0, 0, 0);
+            vdrive_turbo_start(vd, 0x500 + 3 * c, param, param_length);
+            break;
+
+        case 'J': case ':':
+            vdrive_dos_reset(vd);
+            break;
+
+        case '0': case 'I': case '9':
+            /* mode switches and NMI: nothing to emulate */
+            vdrive_dos_set_status(vd, 0, 0, 0);
+            break;
+
+        default:
+            vdrive_dos_set_status(vd, 31, 0, 0);
+            break;
+    }
+}
+
+/*! \brief Execute C:new=old */
+static void
+copy_command(vdrive_t *vd, const unsigned char *cmd, size_t length)
+{
+    const unsigned char *new_name, *old_name;
+    size_t new_length, old_length;
+    unsigned char *entry, *data;
+    size_t data_length;
+    int rv;
+
+    new_name   = skip_drive(cmd, &length);
+    new_length = name_length(new_name, length);
+    if(new_length == length)
+    {
+        vdrive_dos_set_status(vd, 30, 0, 0);
+        return;
+    }
+    old_name   = new_name + new_length + 1;
+    old_length = length - new_length - 1;
+    old_name   = skip_drive(old_name, &old_length);
+    old_length = name_length(old_name, old_length);
+
+    entry = vdrive_image_find_file(&vd->image, old_name, old_length);
+    if(entry == NULL)
+    {
+        vdrive_dos_set_status(vd, 62, 0, 0);
+        return;
+    }
+    rv = vdrive_image_load_file(&vd->image, entry[1], entry[2], &data, &data_length);
+    if(rv == 0)
+    {
+        rv = vdrive_image_save_file(&vd->image, new_name, new_length, entry[0] & 0x07, 0,
+                                    data, data_length);
+    }
+    free(data);
+    vdrive_dos_set_status(vd, rv, 0, 0);
+}
+
+/*! \brief Execute a command sent to the command channel */
+static void
+execute_command(vdrive_t *vd, const unsigned char *cmd, size_t length)
+{
+    const unsigned char *p, *q;
+    size_t n, m;
+    int files, rv;
+
+    if(length == 0)
+    {
+        return;
+    }
+
+    if(length >= 3 && cmd[0] == 'M' && cmd[1] == '-')
+    {
+        memory_command(vd, cmd, length);
+        return;
+    }
+
+    if(cmd[0] == 'U')
+    {
+        /* the parameters of U3-U8 can be binary, keep a trailing CR */
+        if(length > 2 && cmd[length - 1] == '\r' && (cmd[1] == '1' || cmd[1] == '2'
+           || cmd[1] == 'A' || cmd[1] == 'B'))
+        {
+            length--;
+        }
+        user_command(vd, cmd, length);
+        return;
+    }
+
+    if(cmd[length - 1] == '\r')
+    {
+        length--;
+    }
+
+    switch(cmd[0])
+    {
+        case 'B':
+            if(length >= 3 && cmd[1] == '-')
+            {
+                if(cmd[2] == 'E')
+                {
+                    vdrive_dos_set_status(vd, 0, 0, 0);
+                    vdrive_turbo_start(vd, 0, NULL, 0);
+                }
+                else
+                {
+                    block_command(vd, cmd[2], cmd + 3, length - 3);
+                }
+                return;
+            }
+            break;
+
+        case 'I':
+            vdrive_turbo_stop(vd);
+            vdrive_latency(vd, vdrive_proto_disk, 0);
+            vdrive_dos_set_status(vd, 0, 0, 0);
+            return;
+
+        case 'V':
+            vdrive_dos_set_status(vd, 0, 0, 0);
+            return;
+
+        case 'N':
+            p = skip_drive(cmd, &length);
+            n = name_length(p, length);
+            rv = vdrive_image_format(&vd->image, p, n, (length >= n + 3) ? p + n + 1 : NULL);
+            vdrive_dos_set_status(vd, rv, 0, 0);
+            return;
+
+        case 'S':
+            files = 0;
+            p = skip_drive(cmd, &length);
+            while(length > 0)
+            {
+                n = name_length(p, length);
+                files += vdrive_image_scratch(&vd->image, p, n);
+                if(n == length)
+                {
+                    break;
+                }
+                p += n + 1;
+                length -= n + 1;
+            }
+            vdrive_dos_set_status(vd, 1, files, 0);
+            return;
+
+        case 'R':
+            p = skip_drive(cmd, &length);
+            n = name_length(p, length);
+            if(n == length)
+            {
+                break;
+            }
+            q = p + n + 1;
+            m = length - n - 1;
+            q = skip_drive(q, &m);
+            rv = vdrive_image_rename(&vd->image, p, n, q, name_length(q, m));
+            vdrive_dos_set_status(vd, rv, 0, 0);
+            return;
+
+        case 'C':
+            copy_command(vd, cmd, length);
+            return;
+    }
+
+    vdrive_dos_set_status(vd, 31, 0, 0);
+}
+
+/*! \brief Open a channel with the file name received */
+static void
+open_channel(vdrive_t *vd, unsigned char sa, const unsigned char *name, size_t length)
+{
+    vdrive_channel_t *ch = &vd->channel[sa];
+    const unsigned char *opt;
+    unsigned char *entry;
+    size_t n, rest;
+    unsigned int buffer;
+    int write, rv;
+    const char *type;
+
+    channel_free(vd, ch);
+
+    if(length && name[length - 1] == '\r')
+    {
+        length--;
+    }
+
+    if(length > 0 && name[0] == '#')
+    {
+        /* direct access channel */
+        if(length > 1)
+        {
+            /* the name is not terminated, so do not use atoi() on it */
+            buffer = 0;
+            for(n = 1; n < length && name[n] == ' '; n++)
+                ;
+            for(; n < length && name[n] >= '0' && name[n] <= '9'; n++)
+            {
+                buffer = buffer * 10 + (name[n] - '0');
+                if(buffer >= VDRIVE_BUFFERS)
+                {
+                    break;
+                }
+            }
+            if(buffer >= VDRIVE_BUFFERS || vd->buffer_used[buffer])
+            {
+                vdrive_dos_set_status(vd, 70, 0, 0);
+                return;
+            }
+        }
+        else
+        {
+            for(buffer = 0; buffer < VDRIVE_BUFFERS && vd->buffer_used[buffer]; buffer++)
+                ;
+            if(buffer == VDRIVE_BUFFERS)
+            {
+                vdrive_dos_set_status(vd, 70, 0, 0);
+                return;
+            }
+        }
+        vd->buffer_used[buffer] = 1;
+        ch->mode   = vdrive_ch_buffer;
+        ch->buffer = (int) buffer;
+        ch->pos    = 1;
+        ch->length = VDRIVE_BLOCKSIZE;
+        vdrive_dos_set_status(vd, 0, 0, 0);
+        return;
+    }
+
+    if(length > 0 && name[0] == '$')
+    {
+        rv = vdrive_image_directory(&vd->image, &ch->data, &ch->length);
+        if(rv == 0)
+        {
+            ch->mode = vdrive_ch_read;
+        }
+        vdrive_latency(vd, vdrive_proto_disk, 0);
+        vdrive_dos_set_status(vd, rv, 0, 0);
+        return;
+    }
+
+    if(length > 0 && name[0] == '@')
+    {
+        ch->replace = 1;
+        name++;
+        length--;
+    }
+    name = skip_drive(name, &length);
+    n = name_length(name, length);
+
+    write = (sa == 1);
+    ch->file_type = 2;  /* PRG */
+    opt  = name + n;
+    rest = length - n;
+    while(rest > 1 && *opt == ',')
+    {
+        if(opt[1] == 'W' || opt[1] == 'A')
+        {
+            write = 1;
+        }
+        else if(opt[1] == 'R')
+        {
+            write = 0;
+        }
+        else if((type = strchr(open_types, opt[1])) != NULL)
+        {
+            ch->file_type = (unsigned char) (type - open_types);
+        }
+        opt++;
+        rest--;
+        while(rest > 0 && *opt != ',')
+        {
+            opt++;
+            rest--;
+        }
+    }
+
+    if(n == 0 || n > 16)
+    {
+        vdrive_dos_set_status(vd, n ? 33 : 34, 0, 0);
+        return;
+    }
+
+    if(write)
+    {
+        if(!ch->replace && vdrive_image_find_file(&vd->image, name, n))
+        {
+            vdrive_dos_set_status(vd, 63, 0, 0);
+            return;
+        }
+        if(vd->image.read_only)
+        {
+            vdrive_dos_set_status(vd, 26, 0, 0);
+            return;
+        }
+        memcpy(ch->name, name, n);
+        ch->name_length = (unsigned char) n;
+        ch->mode = vdrive_ch_write;
+        vdrive_dos_set_status(vd, 0, 0, 0);
+        return;
+    }
+
+    entry = vdrive_image_find_file(&vd->image, name, n);
+    if(entry == NULL)
+    {
+        vdrive_dos_set_status(vd, 62, 0, 0);
+        return;
+    }
+    vdrive_latency(vd, vdrive_proto_disk, 0);
+    ch->start_track  = entry[1];
+    ch->start_sector = entry[2];
+    rv = vdrive_image_load_file(&vd->image, entry[1], entry[2], &ch->data, &ch->length);
+    if(rv == 0)
+    {
+        ch->mode = vdrive_ch_read;
+    }
+    vdrive_dos_set_status(vd, rv, 0, 0);
+}
+
+/*! \brief Process a received command or file name
+
+ This is done on the UNLISTEN, or on the next bus command if the
+ host did not send one.
+*/
+static void
+finish_listen(vdrive_t *vd)
+{
+    if(vd->opening)
+    {
+        if(vd->listening == 15)
+        {
+            execute_command(vd, vd->cmd, vd->cmd_length);
+        }
+        else if(vd->listening >= 0)
+        {
+            open_channel(vd, (unsigned char) vd->listening, vd->cmd, vd->cmd_length);
+        }
+    }
+    else if(vd->listening == 15)
+    {
+        execute_command(vd, vd->cmd, vd->cmd_length);
+    }
+    vd->opening    = 0;
+    vd->listening  = -1;
+    vd->cmd_length = 0;
+}
+
+int
+vdrive_dos_listen(vdrive_t *vd, unsigned char sa)
+{
+    finish_listen(vd);
+    vd->listening  = sa & 0x0f;
+    vd->talking    = -1;
+    vd->cmd_length = 0;
+    return 0;
+}
+
+int
+vdrive_dos_talk(vdrive_t *vd, unsigned char sa)
+{
+    finish_listen(vd);
+    vd->talking = sa & 0x0f;
+    vd->eoi     = 0;
+    return 0;
+}
+
+int
+vdrive_dos_open(vdrive_t *vd, unsigned char sa)
+{
+    finish_listen(vd);
+    vd->listening  = sa & 0x0f;
+    vd->opening    = 1;
+    vd->cmd_length = 0;
+    return 0;
+}
+
+int
+vdrive_dos_close(vdrive_t *vd, unsigned char sa)
+{
+    vdrive_channel_t *ch;
+    int i, rv;
+
+    finish_listen(vd);
+    sa &= 0x0f;
+
+    if(sa == 15)
+    {
+        /* closing the command channel closes all files */
+        for(i = 0; i < 15; i++)
+        {
+            vdrive_dos_close(vd, (unsigned char) i);
+        }
+        return 0;
+    }
+
+    ch = &vd->channel[sa];
+    if(ch->mode == vdrive_ch_write)
+    {
+        vdrive_latency(vd, vdrive_proto_disk, 0);
+        rv = vdrive_image_save_file(&vd->image, ch->name, ch->name_length, ch->file_type,
+                                    ch->replace, ch->data, ch->length);
+        vdrive_dos_set_status(vd, rv, 0, 0);
+    }
+    channel_free(vd, ch);
+    return 0;
+}
+
+int
+vdrive_dos_unlisten(vdrive_t *vd)
+{
+    finish_listen(vd);
+    return 0;
+}
+
+int
+vdrive_dos_untalk(vdrive_t *vd)
+{
+    finish_listen(vd);
+    vd->talking = -1;
+    return 0;
+}
+
+/*! \brief Append data to a file opened for writing
+
+ \return
+   0 on success, -1 if the channel is not open for writing or
+   there is not enough memory.
+*/
+int
+vdrive_dos_append(vdrive_t *vd, unsigned char sa, const unsigned char *data, size_t count)
+{
+    vdrive_channel_t *ch = &vd->channel[sa & 0x0f];
+    unsigned char *buf;
+    size_t size;
+
+    if(ch->mode != vdrive_ch_write)
+    {
+        vdrive_dos_set_status(vd, 61, 0, 0);
+        return -1;
+    }
+
+    if(ch->length + count > ch->size)
+    {
+        size = ch->size ? ch->size : 4096;
+        while(size < ch->length + count)
+        {
+            size *= 2;
+        }
+        buf = realloc(ch->data, size);
+        if(buf == NULL)
+        {
+            vdrive_dos_set_status(vd, 72, 0, 0);
+            return -1;
+        }
+        ch->data = buf;
+        ch->size = size;
+    }
+    memcpy(ch->data + ch->length, data, count);
+    ch->length += count;
+    return 0;
+}
+
+/*! \brief Bytes sent to the drive while it is listening
+
+ \return
+   The number of bytes accepted.
+*/
+int
+vdrive_dos_write(vdrive_t *vd, const unsigned char *data, size_t count)
+{
+    vdrive_channel_t *ch;
+    unsigned char *buf;
+    size_t i;
+
+    if(vd->listening < 0)
+    {
+        return -1;
+    }
+
+    if(vd->opening || vd->listening == 15)
+    {
+        for(i = 0; i < count && vd->cmd_length < VDRIVE_CMD_SIZE; i++)
+        {
+            vd->cmd[vd->cmd_length++] = data[i];
+        }
+        return (int) count;
+    }
+
+    ch = &vd->channel[vd->listening];
+    switch(ch->mode)
+    {
+        case vdrive_ch_buffer:
+            buf = buffer_memory(vd, ch->buffer);
+            for(i = 0; i < count; i++)
+            {
+                buf[ch->pos] = data[i];
+                ch->pos = (ch->pos + 1) & 0xff;
+            }
+            break;
+
+        case vdrive_ch_write:
+            if(vdrive_dos_append(vd, (unsigned char) vd->listening, data, count))
+            {
+                return -1;
+            }
+            break;
+
+        default:
+            vdrive_dos_set_status(vd, 61, 0, 0);
+            break;
+    }
+    return (int) count;
+}
+
+/*! \brief Bytes read from the drive while it is talking
+
+ The read stops after the byte sent with EOI.
+
+ \return
+   The number of bytes read.
+*/
+int
+vdrive_dos_read(vdrive_t *vd, unsigned char *data, size_t count)
+{
+    vdrive_channel_t *ch;
+    const unsigned char *buf;
+    size_t i = 0;
+
+    if(vd->talking < 0)
+    {
+        return -1;
+    }
+
+    vd->eoi = 0;
+
+    if(vd->talking == 15)
+    {
+        while(i < count && !vd->eoi)
+        {
+            data[i++] = vd->status_buffer[vd->status_pos++];
+            if(vd->status_pos == vd->status_length)
+            {
+                vd->eoi = 1;
+                vdrive_dos_set_status(vd, 0, 0, 0);
+            }
+        }
+        return (int) i;
+    }
+
+    ch = &vd->channel[vd->talking];
+    switch(ch->mode)
+    {
+        case vdrive_ch_buffer:
+            buf = buffer_memory(vd, ch->buffer);
+            while(i < count && !vd->eoi)
+            {
+                data[i++] = buf[ch->pos];
+                ch->pos = (ch->pos + 1) & 0xff;
+                vd->eoi = (ch->pos == 0 || ch->pos == ch->length);
+            }
+            break;
+
+        case vdrive_ch_read:
+            while(i < count && ch->pos < ch->length)
+            {
+                data[i++] = ch->data[ch->pos++];
+            }
+            vd->eoi = (ch->pos == ch->length);
+            break;
+
+        default:
+            vd->eoi = 1;
+            break;
+    }
+    return (int) i;
+}
+
+/*! \brief Find an open channel, secondary addresses 0 and 1 first
+
+ \return
+   The secondary address, -1 if there is no channel in that mode.
+*/
+int
+vdrive_dos_find_channel(vdrive_t *vd, enum vdrive_channel_mode_e mode)
+{
+    int sa;
+
+    for(sa = 0; sa < 15; sa++)
+    {
+        if(vd->channel[sa].mode == mode)
+        {
+            return sa;
+        }
+    }
+    return -1;
+}
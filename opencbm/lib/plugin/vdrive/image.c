@@ -0,0 +1,1131 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version
+ *  2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 The OpenCBM project
+ */
+
+/*! **************************************************************
+** \file lib/plugin/vdrive/image.c \n
+** \n
+** \brief Image backed virtual drive: D64/D71/D81 image access
+**
+** The image is held in memory completely. It is written back to
+** the file with vdrive_image_flush(), which is done when the
+** driver is closed or the drive is reset.
+**
+****************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arch.h"
+#include "vdrive.h"
+
+/*! directory entry file types */
+static const char *file_types[] = { "DEL", "SEQ", "PRG", "USR", "REL", "CBM", "DIR", "???" };
+
+/*! the known image sizes */
+static const struct
+{
+    enum vdrive_image_type_e type;
+    unsigned int tracks;
+    long size;
+    int error_info;
+} image_sizes[] =
+{
+    { vdrive_d64, 35, 174848, 0 },
+    { vdrive_d64, 35, 175531, 1 },
+    { vdrive_d64, 40, 196608, 0 },
+    { vdrive_d64, 40, 197376, 1 },
+    { vdrive_d71, 70, 349696, 0 },
+    { vdrive_d71, 70, 351062, 1 },
+    { vdrive_d81, 80, 819200, 0 },
+    { vdrive_d81, 80, 822400, 1 },
+    { vdrive_d64, 0, 0, 0 }
+};
+
+static unsigned int
+sectors_of_track(enum vdrive_image_type_e type, unsigned int track)
+{
+    if(type == vdrive_d81)
+    {
+        return 40;
+    }
+    if(type == vdrive_d71 && track > 35)
+    {
+        track -= 35;
+    }
+    return track <= 17 ? 21 : track <= 24 ? 19 : track <= 30 ? 18 : 17;
+}
+
+static void
+image_setup(vdrive_image_t *image, enum vdrive_image_type_e type, unsigned int tracks)
+{
+    unsigned int tr;
+
+    image->type   = type;
+    image->tracks = tracks;
+    image->blocks = 0;
+
+    for(tr = 1; tr <= tracks; tr++)
+    {
+        image->track_offset[tr] = image->blocks;
+        image->blocks += sectors_of_track(type, tr);
+    }
+    image->track_offset[tracks + 1] = image->blocks;
+
+    image->dir_track  = (type == vdrive_d81) ? 40 : 18;
+    image->interleave = (type == vdrive_d81) ? 1 : (type == vdrive_d71) ? 6 : 10;
+}
+
+/*! \brief Load a disk image
+
+ Loads a D64, D71 or D81 image, with or without error info.
+ If the file does not exist, an empty image is created, its
+ type is taken from the file name extension. It is written to
+ the file immediately; if that fails, the open fails, too.
+
+ \return
+   0 on success, -1 on error.
+*/
+int
+vdrive_image_open(vdrive_image_t *image, const char *filename)
+{
+    FILE *f;
+    long size;
+    int i;
+    const char *ext;
+
+    memset(image, 0, sizeof(*image));
+
+    image->filename = arch_strdup(filename);
+    if(image->filename == NULL)
+    {
+        return -1;
+    }
+
+    f = fopen(filename, "r+b");
+    if(f == NULL)
+    {
+        f = fopen(filename, "rb");
+        image->read_only = (f != NULL);
+    }
+
+    if(f == NULL)
+    {
+        /* create a new, unformatted image */
+        ext = strrchr(filename, '.');
+        if(ext && arch_strcasecmp(ext, ".d81") == 0)
+        {
+            image_setup(image, vdrive_d81, 80);
+        }
+        else if(ext && arch_strcasecmp(ext, ".d71") == 0)
+        {
+            image_setup(image, vdrive_d71, 70);
+        }
+        else
+        {
+            image_setup(image, vdrive_d64, 35);
+        }
+        image->data = calloc(image->blocks, VDRIVE_BLOCKSIZE);
+        if(image->data == NULL)
+        {
+            vdrive_image_close(image);
+            return -1;
+        }
+        image->dirty = 1;
+
+        /* write it at once, so a file which cannot be created is an error now */
+        if(vdrive_image_flush(image) != 0)
+        {
+            image->dirty = 0;
+            vdrive_image_close(image);
+            return -1;
+        }
+        return 0;
+    }
+
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    for(i = 0; image_sizes[i].size; i++)
+    {
+        if(image_sizes[i].size == size)
+        {
+            break;
+        }
+    }
+
+    if(image_sizes[i].size == 0)
+    {
+        fclose(f);
+        vdrive_image_close(image);
+        return -1;
+    }
+
+    image_setup(image, image_sizes[i].type, image_sizes[i].tracks);
+    image->has_error_info = image_sizes[i].error_info;
+
+    image->data = malloc(image->blocks * VDRIVE_BLOCKSIZE);
+    if(image->has_error_info)
+    {
+        image->errors = malloc(image->blocks);
+    }
+
+    if(image->data == NULL
+       || (image->has_error_info && image->errors == NULL)
+       || fread(image->data, VDRIVE_BLOCKSIZE, image->blocks, f) != image->blocks
+       || (image->has_error_info && fread(image->errors, image->blocks, 1, f) != 1))
+    {
+        fclose(f);
+        vdrive_image_close(image);
+        return -1;
+    }
+
+    fclose(f);
+    return 0;
+}
+
+/*! \brief Write a modified image back to its file
+
+ \return
+   0 on success, -1 on error.
+*/
+int
+vdrive_image_flush(vdrive_image_t *image)
+{
+    FILE *f;
+    int rv = 0;
+
+    if(!image->dirty || image->read_only || image->data == NULL)
+    {
+        return 0;
+    }
+
+    f = fopen(image->filename, "wb");
+    if(f == NULL)
+    {
+        return -1;
+    }
+
+    if(fwrite(image->data, VDRIVE_BLOCKSIZE, image->blocks, f) != image->blocks
+       || (image->has_error_info && fwrite(image->errors, image->blocks, 1, f) != 1))
+    {
+        rv = -1;
+    }
+
+    if(fclose(f) != 0)
+    {
+        rv = -1;
+    }
+
+    if(rv == 0)
+    {
+        image->dirty = 0;
+    }
+    return rv;
+}
+
+/*! \brief Flush and release an image */
+void
+vdrive_image_close(vdrive_image_t *image)
+{
+    vdrive_image_flush(image);
+
+    free(image->data);
+    free(image->errors);
+    free(image->filename);
+    memset(image, 0, sizeof(*image));
+}
+
+/*! \brief Number of sectors on a track, 0 if the track does not exist */
+unsigned int
+vdrive_image_sectors(const vdrive_image_t *image, unsigned int track)
+{
+    if(track < 1 || track > image->tracks)
+    {
+        return 0;
+    }
+    return image->track_offset[track + 1] - image->track_offset[track];
+}
+
+/*! \brief Check a track/sector pair
+
+ \return
+   0 if the block exists, else the DOS error 66.
+*/
+int
+vdrive_image_check_ts(const vdrive_image_t *image, unsigned int track, unsigned int sector)
+{
+    return sector < vdrive_image_sectors(image, track) ? 0 : 66;
+}
+
+/*! \brief Pointer to the data of a block, NULL if it does not exist */
+unsigned char *
+vdrive_image_block(vdrive_image_t *image, unsigned int track, unsigned int sector)
+{
+    if(vdrive_image_check_ts(image, track, sector))
+    {
+        return NULL;
+    }
+    return image->data + (size_t)(image->track_offset[track] + sector) * VDRIVE_BLOCKSIZE;
+}
+
+/*! \brief The job code the drive would report for a block
+
+ \return
+   0 if the block can be read, the 1541 job error code
+   (2 to 11) taken from the error info otherwise.
+*/
+int
+vdrive_image_job_code(const vdrive_image_t *image, unsigned int track, unsigned int sector)
+{
+    unsigned char code;
+
+    if(image->errors == NULL || vdrive_image_check_ts(image, track, sector))
+    {
+        return 0;
+    }
+    code = image->errors[image->track_offset[track] + sector];
+    return (code <= 1) ? 0 : code;
+}
+
+/*! \brief Read a block
+
+ \return
+   0 on success, else the DOS error code. Like a real drive, the
+   data is returned even if the error info flags the block.
+*/
+int
+vdrive_image_read(vdrive_image_t *image, unsigned int track, unsigned int sector, unsigned char *block)
+{
+    const unsigned char *src;
+    int code;
+
+    src = vdrive_image_block(image, track, sector);
+    if(src == NULL)
+    {
+        return 66;
+    }
+    memcpy(block, src, VDRIVE_BLOCKSIZE);
+
+    code = vdrive_image_job_code(image, track, sector);
+    return code ? code + 18 : 0;
+}
+
+/*! \brief Write a block
+
+ \return
+   0 on success, else the DOS error code.
+*/
+int
+vdrive_image_write(vdrive_image_t *image, unsigned int track, unsigned int sector, const unsigned char *block)
+{
+    unsigned char *dst;
+
+    dst = vdrive_image_block(image, track, sector);
+    if(dst == NULL)
+    {
+        return 66;
+    }
+    if(image->read_only)
+    {
+        return 26;
+    }
+    memcpy(dst, block, VDRIVE_BLOCKSIZE);
+    if(image->errors)
+    {
+        /* writing a block cures a formerly bad block */
+        image->errors[image->track_offset[track] + sector] = 1;
+    }
+    image->dirty = 1;
+    return 0;
+}
+
+/*-------------------------------------------------------------------*/
+/*--------- BAM -----------------------------------------------------*/
+
+/*! \brief Locate the BAM entry of a track
+
+ \param count
+   Returns the pointer to the free block count of the track.
+
+ \param bitmap
+   Returns the pointer to the allocation bitmap of the track.
+
+ \return
+   0 on success, -1 if the track is not covered by the BAM.
+*/
+static int
+bam_locate(vdrive_image_t *image, unsigned int track,
+           unsigned char **count, unsigned char **bitmap)
+{
+    unsigned char *bam;
+
+    switch(image->type)
+    {
+        case vdrive_d81:
+            if(track < 1 || track > 80)
+            {
+                return -1;
+            }
+            bam = vdrive_image_block(image, 40, track <= 40 ? 1 : 2);
+            *count  = bam + 0x10 + 6 * ((track - 1) % 40);
+            *bitmap = *count + 1;
+            return 0;
+
+        case vdrive_d71:
+            if(track > 35 && track <= 70)
+            {
+                bam = vdrive_image_block(image, 18, 0);
+                *count  = bam + 0xdd + (track - 36);
+                bam = vdrive_image_block(image, 53, 0);
+                *bitmap = bam + 3 * (track - 36);
+                return 0;
+            }
+            /* fall through */
+        default:
+            if(track < 1 || track > 35)
+            {
+                return -1;
+            }
+            bam = vdrive_image_block(image, 18, 0);
+            *count  = bam + 4 * track;
+            *bitmap = *count + 1;
+            return 0;
+    }
+}
+
+/*! \brief Allocate a block in the BAM
+
+ \return
+   0 if the block was free and is allocated now, 65 (NO BLOCK)
+   if it was allocated already, 66 if it does not exist.
+*/
+int
+vdrive_bam_allocate(vdrive_image_t *image, unsigned int track, unsigned int sector)
+{
+    unsigned char *count, *bitmap;
+
+    if(vdrive_image_check_ts(image, track, sector)
+       || bam_locate(image, track, &count, &bitmap))
+    {
+        return 66;
+    }
+    if(!(bitmap[sector >> 3] & (1 << (sector & 7))))
+    {
+        return 65;
+    }
+    bitmap[sector >> 3] &= ~(1 << (sector & 7));
+    (*count)--;
+    image->dirty = 1;
+    return 0;
+}
+
+/*! \brief Free a block in the BAM
+
+ \return
+   0 on success, 66 if the block does not exist.
+*/
+int
+vdrive_bam_free(vdrive_image_t *image, unsigned int track, unsigned int sector)
+{
+    unsigned char *count, *bitmap;
+
+    if(vdrive_image_check_ts(image, track, sector)
+       || bam_locate(image, track, &count, &bitmap))
+    {
+        return 66;
+    }
+    if(!(bitmap[sector >> 3] & (1 << (sector & 7))))
+    {
+        bitmap[sector >> 3] |= 1 << (sector & 7);
+        (*count)++;
+        image->dirty = 1;
+    }
+    return 0;
+}
+
+static int
+is_dir_track(const vdrive_image_t *image, unsigned int track)
+{
+    return track == image->dir_track
+        || (image->type == vdrive_d71 && track == image->dir_track + 35u);
+}
+
+/*! \brief Number of free blocks, as shown in the directory */
+unsigned int
+vdrive_bam_blocks_free(vdrive_image_t *image)
+{
+    unsigned char *count, *bitmap;
+    unsigned int tr, blocks = 0;
+
+    for(tr = 1; tr <= image->tracks; tr++)
+    {
+        if(!is_dir_track(image, tr) && bam_locate(image, tr, &count, &bitmap) == 0)
+        {
+            blocks += *count;
+        }
+    }
+    return blocks;
+}
+
+/*! \brief Find and allocate the next free data block
+
+ The search starts on the given track, interleave sectors behind
+ the given sector. If that track is full, tracks are searched
+ with increasing distance to the directory track.
+
+ \return
+   0 on success, 72 (DISK FULL) otherwise.
+*/
+static int
+bam_allocate_next(vdrive_image_t *image, unsigned char *track, unsigned char *sector)
+{
+    unsigned int n, i, se, distance, tr;
+    int side;
+
+    tr = *track;
+    if(tr != 0 && !is_dir_track(image, tr))
+    {
+        n = vdrive_image_sectors(image, tr);
+        for(i = 0; i < n; i++)
+        {
+            se = (*sector + image->interleave + i) % n;
+            if(vdrive_bam_allocate(image, tr, se) == 0)
+            {
+                *sector = (unsigned char) se;
+                return 0;
+            }
+        }
+    }
+
+    for(distance = 1; distance < image->tracks; distance++)
+    {
+        for(side = -1; side <= 1; side += 2)
+        {
+            tr = image->dir_track + side * (int) distance;
+            if(tr < 1 || tr > image->tracks || is_dir_track(image, tr))
+            {
+                continue;
+            }
+            n = vdrive_image_sectors(image, tr);
+            for(se = 0; se < n; se++)
+            {
+                if(vdrive_bam_allocate(image, tr, se) == 0)
+                {
+                    *track  = (unsigned char) tr;
+                    *sector = (unsigned char) se;
+                    return 0;
+                }
+            }
+        }
+    }
+    return 72;
+}
+
+/*! \brief Format (NEW) the image
+
+ \param id
+   The two byte disk id, or NULL for a quick format which only
+   clears the BAM and the directory and keeps the old id.
+
+ \return
+   0 on success, else the DOS error code.
+*/
+int
+vdrive_image_format(vdrive_image_t *image, const unsigned char *name, size_t name_length, const unsigned char *id)
+{
+    unsigned char block[VDRIVE_BLOCKSIZE];
+    unsigned char old_id[2];
+    unsigned char *header;
+    unsigned int tr, se, n;
+    int offset;
+
+    if(image->read_only)
+    {
+        return 26;
+    }
+
+    offset = (image->type == vdrive_d81) ? 0x16 : 0xa2;
+    header = vdrive_image_block(image, image->dir_track, 0);
+    if(id == NULL)
+    {
+        memcpy(old_id, header + offset, 2);
+        id = old_id;
+    }
+    else
+    {
+        memset(image->data, 0, (size_t)image->blocks * VDRIVE_BLOCKSIZE);
+        if(image->errors)
+        {
+            memset(image->errors, 1, image->blocks);
+        }
+    }
+
+    memset(block, 0, sizeof(block));
+
+    if(image->type == vdrive_d81)
+    {
+        /* header */
+        block[0] = 40; block[1] = 3; block[2] = 'D';
+        memset(block + 0x04, 0xa0, 0x19);
+        memcpy(block + 0x04, name, name_length > 16 ? 16 : name_length);
+        block[0x16] = id[0]; block[0x17] = id[1];
+        block[0x19] = '3'; block[0x1a] = 'D';
+        vdrive_image_write(image, 40, 0, block);
+
+        /* the two BAM blocks */
+        for(se = 1; se <= 2; se++)
+        {
+            memset(block, 0, sizeof(block));
+            block[0] = (se == 1) ? 40 : 0;
+            block[1] = (se == 1) ? 2 : 0xff;
+            block[2] = 'D'; block[3] = 0xbb;
+            block[4] = id[0]; block[5] = id[1];
+            block[6] = 0xc0;
+            for(tr = 0; tr < 40; tr++)
+            {
+                block[0x10 + 6 * tr] = 40;
+                memset(block + 0x11 + 6 * tr, 0xff, 5);
+            }
+            vdrive_image_write(image, 40, se, block);
+        }
+    }
+    else
+    {
+        block[0] = 18; block[1] = 1; block[2] = 'A';
+        block[3] = (image->type == vdrive_d71) ? 0x80 : 0x00;
+        for(tr = 1; tr <= 35; tr++)
+        {
+            n = sectors_of_track(image->type, tr);
+            block[4 * tr] = (unsigned char) n;
+            block[4 * tr + 1] = 0xff;
+            block[4 * tr + 2] = 0xff;
+            block[4 * tr + 3] = (unsigned char) ((1 << (n - 16)) - 1);
+        }
+        memset(block + 0x90, 0xa0, 0x1b);
+        memcpy(block + 0x90, name, name_length > 16 ? 16 : name_length);
+        block[0xa2] = id[0]; block[0xa3] = id[1];
+        block[0xa5] = '2'; block[0xa6] = 'A';
+        if(image->type == vdrive_d71)
+        {
+            for(tr = 36; tr <= 70; tr++)
+            {
+                block[0xdd + tr - 36] = (unsigned char) sectors_of_track(image->type, tr);
+            }
+        }
+        vdrive_image_write(image, 18, 0, block);
+
+        if(image->type == vdrive_d71)
+        {
+            memset(block, 0, sizeof(block));
+            for(tr = 36; tr <= 70; tr++)
+            {
+                n = sectors_of_track(image->type, tr);
+                block[3 * (tr - 36)]     = 0xff;
+                block[3 * (tr - 36) + 1] = 0xff;
+                block[3 * (tr - 36) + 2] = (unsigned char) ((1 << (n - 16)) - 1);
+            }
+            vdrive_image_write(image, 53, 0, block);
+
+            /* the 1571 reserves track 53 completely */
+            for(se = 0; se < sectors_of_track(image->type, 53); se++)
+            {
+                vdrive_bam_allocate(image, 53, se);
+            }
+        }
+    }
+
+    /* empty first directory block */
+    memset(block, 0, sizeof(block));
+    block[1] = 0xff;
+    se = (image->type == vdrive_d81) ? 3 : 1;
+    vdrive_image_write(image, image->dir_track, se, block);
+
+    for(n = 0; n <= se; n++)
+    {
+        vdrive_bam_allocate(image, image->dir_track, n);
+    }
+    return 0;
+}
+
+/*-------------------------------------------------------------------*/
+/*--------- DIRECTORY -----------------------------------------------*/
+
+/*! \brief Match a file name against a CBM DOS pattern
+
+ \return
+   1 if the name (16 bytes, padded with $A0) matches, 0 otherwise.
+*/
+int
+vdrive_name_match(const unsigned char *pattern, size_t pattern_length, const unsigned char *name)
+{
+    size_t i;
+
+    for(i = 0; i < 16; i++)
+    {
+        if(i == pattern_length)
+        {
+            return name[i] == 0xa0;
+        }
+        if(pattern[i] == '*')
+        {
+            return 1;
+        }
+        if(pattern[i] != '?' && pattern[i] != name[i])
+        {
+            return 0;
+        }
+    }
+    return i == pattern_length || pattern[i] == '*';
+}
+
+/*! \brief Iterate over the directory entries
+
+ \param entry
+   NULL to start the iteration, the last returned entry otherwise.
+
+ \return
+   Pointer to the next directory entry (starting with the file
+   type byte), NULL at the end of the directory.
+*/
+static unsigned char *
+dir_next(vdrive_image_t *image, unsigned char *entry, unsigned int *blocks_seen)
+{
+    unsigned char *block;
+    unsigned int offset;
+
+    if(entry == NULL)
+    {
+        *blocks_seen = 1;
+        block = vdrive_image_block(image, image->dir_track,
+                                   image->type == vdrive_d81 ? 3 : 1);
+        return block ? block + 2 : NULL;
+    }
+
+    offset = (unsigned int)((entry - image->data) % VDRIVE_BLOCKSIZE);
+    block  = entry - offset;
+    if(offset + 32 < VDRIVE_BLOCKSIZE)
+    {
+        return entry + 32;
+    }
+
+    /* follow the link to the next directory block, guard against loops */
+    if(block[0] == 0 || ++*blocks_seen > image->blocks)
+    {
+        return NULL;
+    }
+    block = vdrive_image_block(image, block[0], block[1]);
+    return block ? block + 2 : NULL;
+}
+
+/*! \brief Find a file in the directory
+
+ \return
+   Pointer to the directory entry (starting with the file type
+   byte), NULL if no file matches.
+*/
+unsigned char *
+vdrive_image_find_file(vdrive_image_t *image, const unsigned char *pattern, size_t pattern_length)
+{
+    unsigned char *entry = NULL;
+    unsigned int seen;
+
+    while((entry = dir_next(image, entry, &seen)) != NULL)
+    {
+        if((entry[0] & 0x07) && vdrive_name_match(pattern, pattern_length, entry + 3))
+        {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/*! \brief Follow a block chain
+
+ \param chain
+   Returns a malloc()ed array of track/sector pairs.
+
+ \param blocks
+   Returns the number of valid blocks in the chain.
+
+ \return
+   0 if the chain is intact, else the DOS error code (66) of
+   the broken link after the last valid block.
+*/
+int
+vdrive_image_read_chain(vdrive_image_t *image, unsigned int track, unsigned int sector,
+                        unsigned char **chain, unsigned int *blocks)
+{
+    unsigned char *block;
+    unsigned int n = 0;
+
+    *chain = malloc(2 * image->blocks);
+    *blocks = 0;
+    if(*chain == NULL)
+    {
+        return 70;
+    }
+
+    while(n < image->blocks)
+    {
+        block = vdrive_image_block(image, track, sector);
+        if(block == NULL)
+        {
+            *blocks = n;
+            return 66;
+        }
+        (*chain)[2 * n]     = (unsigned char) track;
+        (*chain)[2 * n + 1] = (unsigned char) sector;
+        n++;
+        if(block[0] == 0)
+        {
+            *blocks = n;
+            return 0;
+        }
+        track  = block[0];
+        sector = block[1];
+    }
+
+    /* the chain loops */
+    *blocks = n;
+    return 66;
+}
+
+/*! \brief Load the contents of a file
+
+ \return
+   0 on success, else the DOS error code.
+*/
+int
+vdrive_image_load_file(vdrive_image_t *image, unsigned int track, unsigned int sector,
+                       unsigned char **data, size_t *length)
+{
+    unsigned char *chain, *block;
+    unsigned int blocks, i, count;
+    int rv;
+
+    *data = NULL;
+    *length = 0;
+
+    rv = vdrive_image_read_chain(image, track, sector, &chain, &blocks);
+    if(rv == 0)
+    {
+        *data = malloc(blocks * 254 + 1);
+        if(*data == NULL)
+        {
+            rv = 70;
+        }
+    }
+
+    for(i = 0; rv == 0 && i < blocks; i++)
+    {
+        block = vdrive_image_block(image, chain[2 * i], chain[2 * i + 1]);
+        count = block[0] ? 254 : (block[1] > 1 ? block[1] - 1 : 0);
+        memcpy(*data + *length, block + 2, count);
+        *length += count;
+    }
+
+    free(chain);
+    return rv;
+}
+
+/*! \brief Free all blocks of a chain in the BAM */
+static void
+free_chain(vdrive_image_t *image, unsigned int track, unsigned int sector)
+{
+    unsigned char *chain;
+    unsigned int blocks, i;
+
+    vdrive_image_read_chain(image, track, sector, &chain, &blocks);
+    if(chain)
+    {
+        for(i = 0; i < blocks; i++)
+        {
+            vdrive_bam_free(image, chain[2 * i], chain[2 * i + 1]);
+        }
+        free(chain);
+    }
+}
+
+/*! \brief Get an unused directory entry, extending the directory if needed */
+static unsigned char *
+dir_new_entry(vdrive_image_t *image)
+{
+    unsigned char *entry = NULL, *last = NULL, *block;
+    unsigned int seen, offset, n, se;
+
+    while((entry = dir_next(image, entry, &seen)) != NULL)
+    {
+        if((entry[0] & 0x07) == 0 && !(entry[0] & 0x80))
+        {
+            return entry;
+        }
+        last = entry;
+    }
+
+    if(last == NULL)
+    {
+        return NULL;
+    }
+
+    /* allocate a new directory block on the directory track */
+    offset = (unsigned int)((last - image->data) % VDRIVE_BLOCKSIZE);
+    block  = last - offset;
+    n = vdrive_image_sectors(image, image->dir_track);
+    for(se = 0; se < n; se++)
+    {
+        if(vdrive_bam_allocate(image, image->dir_track, se) == 0)
+        {
+            block[0] = image->dir_track;
+            block[1] = (unsigned char) se;
+            block = vdrive_image_block(image, image->dir_track, se);
+            memset(block, 0, VDRIVE_BLOCKSIZE);
+            block[1] = 0xff;
+            image->dirty = 1;
+            return block + 2;
+        }
+    }
+    return NULL;
+}
+
+/*! \brief Write a file and its directory entry
+
+ \return
+   0 on success, else the DOS error code.
+*/
+int
+vdrive_image_save_file(vdrive_image_t *image, const unsigned char *name, size_t name_length,
+                       unsigned char file_type, int replace, const unsigned char *data, size_t length)
+{
+    unsigned char *entry, *block, *prev;
+    unsigned char tr, se, first_tr, first_se;
+    unsigned int blocks, i, count;
+    int rv;
+
+    if(image->read_only)
+    {
+        return 26;
+    }
+
+    entry = vdrive_image_find_file(image, name, name_length);
+    if(entry && !replace)
+    {
+        return 63;
+    }
+
+    blocks = length ? (unsigned int)((length + 253) / 254) : 1;
+    if(blocks > vdrive_bam_blocks_free(image) + (entry ? (entry[28] | entry[29] << 8) : 0))
+    {
+        return 72;
+    }
+
+    if(entry)
+    {
+        free_chain(image, entry[1], entry[2]);
+    }
+    else
+    {
+        entry = dir_new_entry(image);
+        if(entry == NULL)
+        {
+            return 72;
+        }
+    }
+
+    tr = se = 0;
+    prev = NULL;
+    first_tr = first_se = 0;
+    for(i = 0; i < blocks; i++)
+    {
+        rv = bam_allocate_next(image, &tr, &se);
+        if(rv)
+        {
+            return rv;
+        }
+        if(prev)
+        {
+            prev[0] = tr;
+            prev[1] = se;
+        }
+        else
+        {
+            first_tr = tr;
+            first_se = se;
+        }
+
+        block = vdrive_image_block(image, tr, se);
+        memset(block, 0, VDRIVE_BLOCKSIZE);
+        count = (length > 254) ? 254 : (unsigned int) length;
+        memcpy(block + 2, data, count);
+        data   += count;
+        length -= count;
+        block[0] = 0;
+        block[1] = (unsigned char) (count + 1);
+        prev = block;
+    }
+
+    memset(entry, 0, 30);
+    entry[0] = (unsigned char) (0x80 | file_type);
+    entry[1] = first_tr;
+    entry[2] = first_se;
+    memset(entry + 3, 0xa0, 16);
+    memcpy(entry + 3, name, name_length > 16 ? 16 : name_length);
+    entry[28] = (unsigned char) blocks;
+    entry[29] = (unsigned char) (blocks >> 8);
+
+    image->dirty = 1;
+    return 0;
+}
+
+/*! \brief Scratch files
+
+ \return
+   The number of scratched files.
+*/
+int
+vdrive_image_scratch(vdrive_image_t *image, const unsigned char *pattern, size_t pattern_length)
+{
+    unsigned char *entry = NULL;
+    unsigned int seen;
+    int files = 0;
+
+    while((entry = dir_next(image, entry, &seen)) != NULL)
+    {
+        /* locked files are not scratched */
+        if(!(entry[0] & 0x07) || (entry[0] & 0x40)
+           || !vdrive_name_match(pattern, pattern_length, entry + 3))
+        {
+            continue;
+        }
+        free_chain(image, entry[1], entry[2]);
+        entry[0] = 0;
+        image->dirty = 1;
+        files++;
+    }
+    return files;
+}
+
+/*! \brief Rename a file
+
+ \return
+   0 on success, else the DOS error code.
+*/
+int
+vdrive_image_rename(vdrive_image_t *image, const unsigned char *new_name, size_t new_length,
+                    const unsigned char *old_name, size_t old_length)
+{
+    unsigned char *entry;
+
+    if(vdrive_image_find_file(image, new_name, new_length))
+    {
+        return 63;
+    }
+    entry = vdrive_image_find_file(image, old_name, old_length);
+    if(entry == NULL)
+    {
+        return 62;
+    }
+    memset(entry + 3, 0xa0, 16);
+    memcpy(entry + 3, new_name, new_length > 16 ? 16 : new_length);
+    image->dirty = 1;
+    return 0;
+}
+
+/*! \brief Append one line of the directory listing */
+static size_t
+dir_line(unsigned char *p, unsigned int number, const unsigned char *text, size_t length)
+{
+    p[0] = 1;
+    p[1] = 1;
+    p[2] = (unsigned char) number;
+    p[3] = (unsigned char) (number >> 8);
+    memcpy(p + 4, text, length);
+    p[4 + length] = 0;
+    return length + 5;
+}
+
+/*! \brief Build the directory listing as loaded with LOAD"$",8
+
+ \return
+   0 on success, else the DOS error code.
+*/
+int
+vdrive_image_directory(vdrive_image_t *image, unsigned char **data, size_t *length)
+{
+    unsigned char line[40];
+    unsigned char *entry = NULL, *header, *p;
+    unsigned int seen, entries = 0, blocks, i;
+    size_t n;
+
+    while((entry = dir_next(image, entry, &seen)) != NULL)
+    {
+        entries++;
+    }
+
+    p = *data = malloc(2 + 32 * (entries + 2) + 2);
+    if(p == NULL)
+    {
+        return 70;
+    }
+
+    *p++ = 0x01;
+    *p++ = 0x04;
+
+    header = vdrive_image_block(image, image->dir_track, 0);
+    header += (image->type == vdrive_d81) ? 0x04 : 0x90;
+    n = 0;
+    line[n++] = 0x12;
+    line[n++] = '"';
+    for(i = 0; i < 16; i++)
+    {
+        line[n++] = header[i] == 0xa0 ? ' ' : header[i];
+    }
+    line[n++] = '"';
+    for(i = 17; i < 23; i++)
+    {
+        line[n++] = header[i] == 0xa0 ? ' ' : header[i];
+    }
+    p += dir_line(p, 0, line, n);
+
+    while((entry = dir_next(image, entry, &seen)) != NULL)
+    {
+        if((entry[0] & 0x07) == 0 && !(entry[0] & 0x80))
+        {
+            continue;
+        }
+        blocks = entry[28] | (entry[29] << 8);
+        n = 0;
+        line[n++] = ' ';
+        if(blocks < 100) line[n++] = ' ';
+        if(blocks < 10)  line[n++] = ' ';
+        line[n++] = '"';
+        for(i = 0; i < 16 && entry[3 + i] != 0xa0; i++)
+        {
+            line[n++] = entry[3 + i];
+        }
+        line[n++] = '"';
+        for(; i < 16; i++)
+        {
+            line[n++] = ' ';
+        }
+        line[n++] = (entry[0] & 0x80) ? ' ' : '*';
+        memcpy(line + n, file_types[entry[0] & 0x07], 3);
+        n += 3;
+        line[n++] = (entry[0] & 0x40) ? '<' : ' ';
+        p += dir_line(p, blocks, line, n);
+    }
+
+    p += dir_line(p, vdrive_bam_blocks_free(image), (const unsigned char *) "BLOCKS FREE.", 12);
+    *p++ = 0;
+    *p++ = 0;
+
+    *length = p - *data;
+    return 0;
+}
@@ -0,0 +1,1464 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version
+ *  2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 The OpenCBM project
+ */
+
+/*! **************************************************************
+** \file lib/plugin/vdrive/machine.c \n
+** \n
+** \brief Image backed virtual drive: 1541/1571 hardware
+**
+** The drive runs its own DOS ROM on the 6502 core, so uploaded
+** drive code (turbo and warp routines) is executed as on a real
+** drive. The host side of the IEC bus is bit-banged here the way
+** the xum1541 firmware does it (iec.c, s1.c, s2.c, pp.c there);
+** every wait of the host lets the drive run, so drive and host
+** are kept in lock step on a 1 MHz time base.
+**
+** The disk is a GCR stream per track, built from the image (or
+** loaded from a G64) and decoded back into the image on flush.
+**
+****************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vdrive.h"
+
+/*! cycles (1.5 s) until a handshake of the host gives up, like XUM1541_TIMEOUT */
+#define MACHINE_TIMEOUT     1500000ul
+
+/*! cycles (15 s) for the waits the firmware does "forever" */
+#define MACHINE_FOREVER     15000000ul
+
+/*! cycles every call from the host takes at least */
+#define HOST_CALL_CYCLES    10
+
+/*! settle time of the IEC lines, as IEC_DELAY() of the firmware */
+#define IEC_DELAY           2
+
+/* IEC timing constants of the xum1541 firmware, in cycles */
+#define IEC_T_NE    40
+#define IEC_T_S     20
+#define IEC_T_V     20
+#define IEC_T_R     20
+#define IEC_T_BB    100
+#define IEC_T_TK    20
+
+/*! sync, header, gap, sync and data block of a sector on disk */
+#define SECTOR_GCR_SIZE     (5 + 10 + 9 + 5 + 325)
+
+/*! the highest half track the head can step to */
+#define MAX_HALFTRACK       (2 * 42)
+
+/*! bytes per track by density (speed zone) */
+static const unsigned int track_length[4] = { 6250, 6666, 7142, 7692 };
+
+static int
+is_1571(const vdrive_machine_t *m)
+{
+    return m->rom_size == 0x8000;
+}
+
+/*! \brief The density (speed zone) the DOS uses for a track */
+static unsigned int
+track_density(unsigned int track)
+{
+    if(track > 35 && track <= 70)
+    {
+        track -= 35;
+    }
+    return (track <= 17) ? 3 : (track <= 24) ? 2 : (track <= 30) ? 1 : 0;
+}
+
+/*-------------------------------------------------------------------*/
+/*--------- BUS AND MEMORY MAP --------------------------------------*/
+
+/*! \brief Combine the lines of host and drive and feed VIA1 with the result
+
+ The drive outputs pass the 7406 inverters; an output port bit
+ which is not set to output floats high and pulls its line. DATA
+ is also pulled as long as ATN and the ATNA bit disagree (the ATN
+ acknowledge XOR gate).
+*/
+static void
+update_bus(vdrive_t *vd)
+{
+    vdrive_machine_t *m = vd->machine;
+    unsigned char pb = vdrive_via_port_b(&m->via1);
+    int atn, clk, data;
+
+    atn  = (vd->host_lines & IEC_ATN) != 0;
+    clk  = (vd->host_lines & IEC_CLOCK) || (pb & 0x08);
+    data = (vd->host_lines & IEC_DATA) || (pb & 0x02) || (atn != ((pb & 0x10) != 0));
+
+    m->lines = (data ? IEC_DATA : 0) | (clk ? IEC_CLOCK : 0) | (atn ? IEC_ATN : 0)
+             | (vd->host_lines & IEC_RESET);
+
+    m->via1.pb_in = (unsigned char) (0x1a | (((vd->device - 8) & 3) << 5)
+                  | (data ? 0x01 : 0) | (clk ? 0x04 : 0) | (atn ? 0x80 : 0));
+    vdrive_via_set_ca1(&m->via1, atn);
+}
+
+/*! \brief Feed the parallel port of the drive with the byte of the host */
+static void
+update_pp(vdrive_t *vd)
+{
+    vdrive_machine_t *m = vd->machine;
+
+    if(!is_1571(m))
+    {
+        m->via1.pa_in = vd->xp1541 ? m->pp_host : 0xff;
+    }
+}
+
+/*! \brief The level of the parallel cable, as the host reads it */
+static unsigned char
+drive_pp(vdrive_t *vd)
+{
+    vdrive_machine_t *m = vd->machine;
+    unsigned char host = m->pp_host;
+
+    if(!vd->xp1541)
+    {
+        return 0xff;
+    }
+    if(is_1571(m))
+    {
+        return (unsigned char) ((m->cia_port[1] & m->cia_port[3]) | (host & ~m->cia_port[3]));
+    }
+    return vdrive_via_port_a(&m->via1);
+}
+
+/*! \brief Step the head if the stepper phase of VIA2 changed */
+static void
+disk_control(vdrive_t *vd)
+{
+    vdrive_machine_t *m = vd->machine;
+    unsigned char phase = vdrive_via_port_b(&m->via2) & 3;
+
+    switch((phase - m->stepper) & 3)
+    {
+        case 1:
+            if(m->halftrack < MAX_HALFTRACK)
+            {
+                m->halftrack++;
+            }
+            break;
+        case 3:
+            if(m->halftrack > 2)
+            {
+                m->halftrack--;
+            }
+            break;
+    }
+    m->stepper = phase;
+}
+
+static unsigned char
+machine_read(void *context, unsigned short address)
+{
+    vdrive_t *vd = context;
+    vdrive_machine_t *m = vd->machine;
+
+    if(address < 0x1000)
+    {
+        return m->ram[address & 0x7ff];
+    }
+    switch(address & 0xfc00)
+    {
+        case 0x1800:
+            return vdrive_via_read(&m->via1, address);
+        case 0x1c00:
+            return vdrive_via_read(&m->via2, address);
+    }
+    if(address >= 0x8000)
+    {
+        /* a 1541 sees its 16 KB ROM at $8000, too */
+        return m->rom[address & (m->rom_size - 1)];
+    }
+    if(is_1571(m) && (address & 0xe000) == 0x4000)
+    {
+        switch(address & 0x0f)
+        {
+            case 0x1:
+                return (unsigned char) ((m->cia_port[1] & m->cia_port[3])
+                                        | ((vd->xp1541 ? m->pp_host : 0xff) & ~m->cia_port[3]));
+            case 0x0: case 0x2: case 0x3:
+                return m->cia_port[address & 3];
+        }
+        return 0;
+    }
+    /* open bus */
+    return (unsigned char) (address >> 8);
+}
+
+static void
+machine_write(void *context, unsigned short address, unsigned char value)
+{
+    vdrive_t *vd = context;
+    vdrive_machine_t *m = vd->machine;
+
+    if(address < 0x1000)
+    {
+        m->ram[address & 0x7ff] = value;
+        return;
+    }
+    switch(address & 0xfc00)
+    {
+        case 0x1800:
+            vdrive_via_write(&m->via1, address, value);
+            update_bus(vd);
+            return;
+        case 0x1c00:
+            vdrive_via_write(&m->via2, address, value);
+            disk_control(vd);
+            return;
+    }
+    if(is_1571(m) && (address & 0xe000) == 0x4000 && (address & 0x0f) < 4)
+    {
+        m->cia_port[address & 3] = value;
+    }
+}
+
+/*-------------------------------------------------------------------*/
+/*--------- DISK ----------------------------------------------------*/
+
+/*! \brief The index into gcr[] of the track under the head, 0 if between two tracks */
+static unsigned int
+head_track(vdrive_machine_t *m)
+{
+    unsigned int track;
+
+    if(m->halftrack & 1)
+    {
+        return 0;
+    }
+    track = m->halftrack / 2;
+    if(is_1571(m) && (vdrive_via_port_a(&m->via1) & 0x04))
+    {
+        track += 35;
+    }
+    return track;
+}
+
+/*! \brief Let the disk turn under the head for some cycles
+
+ Every byte passing the head signals "byte ready" (VIA2 CA1 and,
+ if enabled with CA2, the SO input of the CPU) unless it is part of
+ a sync mark. In write mode, the port A output is written instead.
+*/
+static void
+disk_clock(vdrive_t *vd, int cycles)
+{
+    vdrive_machine_t *m = vd->machine;
+    unsigned char pb = vdrive_via_port_b(&m->via2);
+    unsigned int track, length;
+    unsigned char b;
+
+    if(pb & 0x04)
+    {
+        m->byte_cycles -= cycles;
+        while(m->byte_cycles <= 0)
+        {
+            m->byte_cycles += 32 - 2 * ((pb >> 5) & 3);
+
+            track  = head_track(m);
+            length = m->gcr[track] ? m->gcr_length[track] : track_length[3];
+            m->head_pos %= length;
+
+            if((m->via2.pcr & 0xe0) == 0xc0)
+            {
+                b = vdrive_via_port_a(&m->via2);
+                if(m->gcr[track] && !vd->image.read_only)
+                {
+                    m->gcr[track][m->head_pos] = b;
+                    m->gcr_dirty[track] = 1;
+                }
+                m->sync = 0;
+            }
+            else
+            {
+                b = m->gcr[track] ? m->gcr[track][m->head_pos] : 0;
+                m->sync = (b == 0xff && m->last_byte == 0xff);
+                if(!m->sync)
+                {
+                    m->via2.pa_in = b;
+                }
+            }
+            m->last_byte = b;
+            m->head_pos++;
+
+            if(!m->sync)
+            {
+                /* byte ready: CA1 flag, and SO if enabled by CA2 */
+                m->via2.ifr |= 0x02;
+                if((m->via2.pcr & 0x0e) == 0x0e)
+                {
+                    vdrive_cpu_set_overflow(&m->cpu);
+                }
+            }
+        }
+    }
+    else
+    {
+        m->sync = 0;
+    }
+
+    m->via2.pb_in = (unsigned char) ((m->sync ? 0 : 0x80) | (vd->image.read_only ? 0 : 0x10) | 0x6f);
+}
+
+/*! \brief Build the GCR stream of a track from the image
+
+ The error info of the image is reproduced on the disk, so the DOS
+ reports the same errors as for the original disk.
+*/
+static int
+track_from_image(vdrive_t *vd, unsigned int track)
+{
+    vdrive_machine_t *m = vd->machine;
+    unsigned int sectors, length, gap, sector, i;
+    unsigned char raw[260], header[8], *p, *bam;
+    int code;
+
+    sectors = vdrive_image_sectors(&vd->image, track);
+    length  = track_length[track_density(track)];
+    if(sectors == 0 || (p = malloc(length)) == NULL)
+    {
+        return sectors ? 1 : 0;
+    }
+    memset(p, 0x55, length);
+    m->gcr[track]        = p;
+    m->gcr_length[track] = length;
+
+    bam = vdrive_image_block(&vd->image, vd->image.dir_track, 0);
+    gap = (length - sectors * SECTOR_GCR_SIZE) / sectors;
+
+    for(sector = 0; sector < sectors; sector++)
+    {
+        code = vdrive_image_job_code(&vd->image, track, sector);
+
+        header[0] = (code == 2) ? 0x00 : 0x08;
+        header[2] = (unsigned char) sector;
+        header[3] = (unsigned char) track;
+        header[4] = bam ? bam[0xa3] : 0;
+        header[5] = bam ? bam[0xa2] : 0;
+        header[6] = header[7] = 0x0f;
+        header[1] = (unsigned char) (header[2] ^ header[3] ^ header[4] ^ header[5]);
+        if(code == 9)
+        {
+            header[1] ^= 0xff;
+        }
+        if(code == 11)
+        {
+            header[5] ^= 0xff;
+        }
+
+        raw[0] = (code == 4) ? 0x00 : 0x07;
+        vdrive_image_read(&vd->image, track, sector, raw + 1);
+        raw[257] = 0;
+        for(i = 1; i <= VDRIVE_BLOCKSIZE; i++)
+        {
+            raw[257] ^= raw[i];
+        }
+        if(code == 5)
+        {
+            raw[257] ^= 0xff;
+        }
+        raw[258] = raw[259] = 0;
+
+        memset(p, (code == 3) ? 0x55 : 0xff, 5);
+        vdrive_gcr_encode_group(header, p + 5);
+        vdrive_gcr_encode_group(header + 4, p + 10);
+        memset(p + 24, (code == 3) ? 0x55 : 0xff, 5);
+        for(i = 0; i < sizeof(raw); i += 4)
+        {
+            vdrive_gcr_encode_group(raw + i, p + 29 + i / 4 * 5);
+        }
+        p += SECTOR_GCR_SIZE + gap;
+    }
+    return 0;
+}
+
+/*! \brief Copy bytes from a circular track buffer */
+static void
+track_copy(const vdrive_machine_t *m, unsigned int track, unsigned int pos, unsigned char *out, unsigned int count)
+{
+    while(count--)
+    {
+        *out++ = m->gcr[track][pos++ % m->gcr_length[track]];
+    }
+}
+
+/*! \brief Is pos the first byte after a sync mark? */
+static int
+sync_end(const vdrive_machine_t *m, unsigned int track, unsigned int pos)
+{
+    unsigned int length = m->gcr_length[track];
+    const unsigned char *p = m->gcr[track];
+
+    return p[pos % length] != 0xff
+        && p[(pos + length - 1) % length] == 0xff
+        && p[(pos + length - 2) % length] == 0xff;
+}
+
+/*! \brief Decode the sectors of a track the drive wrote back into the image */
+static void
+track_to_image(vdrive_t *vd, unsigned int track)
+{
+    vdrive_machine_t *m = vd->machine;
+    unsigned char gcr[325], header[8], block[VDRIVE_BLOCKSIZE], *old;
+    unsigned int pos, data;
+
+    for(pos = 0; pos < m->gcr_length[track]; pos++)
+    {
+        if(!sync_end(m, track, pos))
+        {
+            continue;
+        }
+        track_copy(m, track, pos, gcr, 10);
+        if(vdrive_gcr_decode_group(gcr, header) || vdrive_gcr_decode_group(gcr + 5, header + 4)
+           || header[0] != 0x08 || header[3] != track)
+        {
+            continue;
+        }
+
+        /* the data block follows the next sync */
+        for(data = pos + 10; data < pos + 10 + 64 && !sync_end(m, track, data); data++)
+            ;
+        if(data == pos + 10 + 64)
+        {
+            continue;
+        }
+        track_copy(m, track, data, gcr, sizeof(gcr));
+        old = vdrive_image_block(&vd->image, track, header[2]);
+        if(old && vdrive_gcr_decode(gcr, block) == 0
+           && (memcmp(old, block, VDRIVE_BLOCKSIZE) || vdrive_image_job_code(&vd->image, track, header[2])))
+        {
+            vdrive_image_write(&vd->image, track, header[2], block);
+        }
+    }
+}
+
+static unsigned long
+get_le(const unsigned char *p, int count)
+{
+    unsigned long value = 0;
+
+    while(count--)
+    {
+        value = (value << 8) | p[count];
+    }
+    return value;
+}
+
+/*! \brief Load the tracks of a G64 file; half tracks are ignored */
+static int
+g64_load(vdrive_t *vd, const char *filename)
+{
+    vdrive_machine_t *m = vd->machine;
+    unsigned char head[12], entry[4];
+    unsigned int halftracks, i, track, length;
+    unsigned long offset;
+    FILE *f;
+    int rv = 1;
+
+    f = fopen(filename, "rb");
+    if(f == NULL)
+    {
+        return 1;
+    }
+    if(fread(head, sizeof(head), 1, f) == 1 && memcmp(head, "GCR-1541", 8) == 0)
+    {
+        halftracks = head[9];
+        rv = 0;
+        for(i = 0; i < halftracks && rv == 0; i += 2)
+        {
+            track = i / 2 + 1;
+            if(fseek(f, 12 + 4 * i, SEEK_SET) || fread(entry, 4, 1, f) != 1)
+            {
+                rv = 1;
+                break;
+            }
+            offset = get_le(entry, 4);
+            if(offset == 0 || track > VDRIVE_MAX_TRACKS)
+            {
+                continue;
+            }
+            if(fseek(f, offset, SEEK_SET) || fread(entry, 2, 1, f) != 1)
+            {
+                rv = 1;
+                break;
+            }
+            length = get_le(entry, 2);
+            m->gcr[track] = malloc(length ? length : 1);
+            if(m->gcr[track] == NULL || length == 0 || fread(m->gcr[track], length, 1, f) != 1)
+            {
+                rv = 1;
+                break;
+            }
+            m->gcr_length[track] = length;
+            m->g64_offset[track] = offset + 2;
+        }
+    }
+    fclose(f);
+
+    if(rv == 0)
+    {
+        m->g64_file = malloc(strlen(filename) + 1);
+        if(m->g64_file == NULL)
+        {
+            return 1;
+        }
+        strcpy(m->g64_file, filename);
+    }
+    return rv;
+}
+
+/*! \brief Write the changed tracks back into the G64 file */
+static int
+g64_save(vdrive_t *vd)
+{
+    vdrive_machine_t *m = vd->machine;
+    unsigned int track;
+    FILE *f;
+    int rv = 0;
+
+    f = fopen(m->g64_file, "r+b");
+    if(f == NULL)
+    {
+        return 1;
+    }
+    for(track = 1; track <= VDRIVE_MAX_TRACKS; track++)
+    {
+        if(m->gcr_dirty[track] && m->g64_offset[track])
+        {
+            if(fseek(f, m->g64_offset[track], SEEK_SET)
+               || fwrite(m->gcr[track], m->gcr_length[track], 1, f) != 1)
+            {
+                rv = 1;
+            }
+        }
+    }
+    if(fclose(f))
+    {
+        rv = 1;
+    }
+    return rv;
+}
+
+/*-------------------------------------------------------------------*/
+/*--------- EXECUTION -----------------------------------------------*/
+
+/*! \brief Execute one instruction and clock the rest of the drive
+
+ \return
+   The number of cycles used.
+*/
+static int
+machine_step(vdrive_t *vd)
+{
+    vdrive_machine_t *m = vd->machine;
+    int cycles;
+
+    if(vd->host_lines & IEC_RESET)
+    {
+        /* the drive is held in reset */
+        m->cpu.cycles += 2;
+        return 2;
+    }
+
+    cycles = vdrive_cpu_step(&m->cpu);
+    vdrive_via_clock(&m->via1, cycles);
+    vdrive_via_clock(&m->via2, cycles);
+    disk_clock(vd, cycles);
+    m->cpu.irq = vdrive_via_irq(&m->via1) || vdrive_via_irq(&m->via2);
+    return cycles;
+}
+
+/*! \brief Let the drive run for (at least) some cycles */
+static void
+machine_run(vdrive_t *vd, unsigned long cycles)
+{
+    unsigned long long end = vd->machine->cpu.cycles + cycles;
+
+    while(vd->machine->cpu.cycles < end)
+    {
+        machine_step(vd);
+    }
+}
+
+/*-------------------------------------------------------------------*/
+/*--------- HOST SIDE OF THE BUS ------------------------------------*/
+
+static void
+host_setrelease(vdrive_t *vd, int set, int release)
+{
+    vdrive_machine_t *m = vd->machine;
+    int old = vd->host_lines;
+
+    vd->host_lines = (vd->host_lines & ~release) | set;
+
+    if((old ^ vd->host_lines) & IEC_RESET)
+    {
+        if(vd->host_lines & IEC_RESET)
+        {
+            vdrive_via_reset(&m->via1);
+            vdrive_via_reset(&m->via2);
+            memset(m->cia_port, 0, sizeof(m->cia_port));
+        }
+        else
+        {
+            vdrive_cpu_reset(&m->cpu);
+        }
+    }
+    update_bus(vd);
+}
+
+#define host_set(_vd, _l)       host_setrelease(_vd, _l, 0)
+#define host_release(_vd, _l)   host_setrelease(_vd, 0, _l)
+#define host_get(_vd, _l)       (((_vd)->machine->lines & (_l)) != 0)
+#define host_delay(_vd, _us)    machine_run(_vd, _us)
+
+/*! \brief Let the drive run while the masked lines are in a state
+
+ \return
+   1 if the lines changed, 0 if the timeout hit.
+*/
+static int
+host_wait_while(vdrive_t *vd, int mask, int state, unsigned long timeout)
+{
+    vdrive_machine_t *m = vd->machine;
+    unsigned long long end = m->cpu.cycles + timeout;
+
+    while((m->lines & mask) == state)
+    {
+        if(m->cpu.cycles >= end)
+        {
+            return 0;
+        }
+        machine_step(vd);
+    }
+    return 1;
+}
+
+/*! \brief A handshake of a transfer protocol: a timeout means the protocols raced */
+static int
+handshake(vdrive_t *vd, int line, int active)
+{
+    vdrive_machine_t *m = vd->machine;
+
+    if(host_wait_while(vd, line, active ? 0 : line, MACHINE_TIMEOUT))
+    {
+        return 1;
+    }
+    m->handshake_timeouts++;
+    vdrive_dbg(0, "handshake timeout: waited for line %d to become %s, drive at $%04X",
+               line, active ? "active" : "inactive", m->cpu.pc);
+    return 0;
+}
+
+/*! \brief Wait up to 2 ms for the masked lines to leave a state, like the firmware */
+static int
+iec_wait_timeout_2ms(vdrive_t *vd, int mask, int state)
+{
+    return host_wait_while(vd, mask, state, 2000);
+}
+
+/*! \brief Does a drive answer an ATN? See check_if_bus_free() of the firmware */
+static int
+check_if_bus_free(vdrive_t *vd)
+{
+    host_release(vd, IEC_ATN | IEC_CLOCK | IEC_DATA | IEC_RESET);
+    host_delay(vd, 50);
+
+    if(host_get(vd, IEC_DATA))
+    {
+        host_delay(vd, 150);
+        return 0;
+    }
+
+    host_delay(vd, 50);
+    if(host_get(vd, IEC_DATA))
+    {
+        host_delay(vd, 100);
+        return 0;
+    }
+
+    host_set(vd, IEC_ATN);
+    host_delay(vd, 100);
+
+    if(!host_get(vd, IEC_DATA))
+    {
+        host_release(vd, IEC_ATN);
+        return 0;
+    }
+
+    host_release(vd, IEC_ATN);
+    host_delay(vd, 100);
+
+    return !host_get(vd, IEC_DATA);
+}
+
+/*! \brief Wait up to 1.5 s for the drive to answer an ATN */
+static int
+wait_for_free_bus(vdrive_t *vd)
+{
+    unsigned int i;
+
+    for(i = MACHINE_TIMEOUT / 200; i != 0; i--)
+    {
+        if(check_if_bus_free(vd))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*! \brief Send a byte with the standard serial protocol */
+static int
+send_byte(vdrive_t *vd, unsigned char b)
+{
+    int i;
+
+    for(i = 8; i != 0; i--)
+    {
+        host_delay(vd, IEC_T_S + 55);
+
+        if(!(b & 1))
+        {
+            host_set(vd, IEC_DATA);
+            host_delay(vd, IEC_DELAY);
+        }
+
+        host_release(vd, IEC_CLOCK);
+        host_delay(vd, IEC_T_V);
+
+        host_setrelease(vd, IEC_CLOCK, IEC_DATA);
+        b >>= 1;
+    }
+
+    return iec_wait_timeout_2ms(vd, IEC_DATA, 0);
+}
+
+/*! \brief Write bytes with the standard serial protocol
+
+ This is iec_raw_write() of the xum1541 firmware.
+
+ \return
+   The number of bytes written, 0 on error.
+*/
+static int
+raw_write(vdrive_t *vd, const unsigned char *data, size_t count, int atn, int talk)
+{
+    size_t len = count;
+    int rv = 1;
+
+    vd->eoi = 0;
+    if(count == 0)
+    {
+        return 0;
+    }
+
+    if(!iec_wait_timeout_2ms(vd, IEC_ATN | IEC_RESET, IEC_ATN | IEC_RESET))
+    {
+        return 0;
+    }
+
+    host_release(vd, IEC_DATA);
+    host_set(vd, IEC_CLOCK | (atn ? IEC_ATN : 0));
+    host_delay(vd, IEC_DELAY);
+
+    if(!iec_wait_timeout_2ms(vd, IEC_DATA, 0))
+    {
+        host_release(vd, IEC_CLOCK | IEC_ATN);
+        return 0;
+    }
+
+    host_delay(vd, IEC_T_NE);
+
+    while(len != 0)
+    {
+        if(!host_get(vd, IEC_DATA))
+        {
+            rv = 0;
+            break;
+        }
+
+        /* release CLK and wait for the listener to release DATA */
+        host_release(vd, IEC_CLOCK);
+        if(!host_wait_while(vd, IEC_DATA, IEC_DATA, MACHINE_FOREVER))
+        {
+            vd->machine->handshake_timeouts++;
+            rv = 0;
+            break;
+        }
+
+        /* EOI: wait until the listener acknowledges it */
+        if(len == 1 && !atn)
+        {
+            iec_wait_timeout_2ms(vd, IEC_DATA, 0);
+            iec_wait_timeout_2ms(vd, IEC_DATA, IEC_DATA);
+        }
+        host_set(vd, IEC_CLOCK);
+
+        if(!send_byte(vd, *data++))
+        {
+            rv = 0;
+            break;
+        }
+        len--;
+        host_delay(vd, IEC_T_BB);
+    }
+
+    if(rv)
+    {
+        if(talk)
+        {
+            /* talk-ATN turn around */
+            host_setrelease(vd, IEC_DATA, IEC_ATN);
+            host_delay(vd, IEC_T_TK);
+            host_release(vd, IEC_CLOCK);
+            host_delay(vd, IEC_DELAY);
+
+            if(!host_wait_while(vd, IEC_CLOCK, 0, MACHINE_FOREVER))
+            {
+                rv = 0;
+            }
+        }
+        else
+        {
+            host_release(vd, IEC_ATN);
+        }
+    }
+    else
+    {
+        host_delay(vd, IEC_T_R);
+        host_release(vd, IEC_CLOCK | IEC_ATN);
+    }
+
+    return rv ? (int) count : 0;
+}
+
+/*-------------------------------------------------------------------*/
+/*--------- FAST PROTOCOLS ------------------------------------------*/
+
+static int
+s1_write_byte(vdrive_t *vd, unsigned char c)
+{
+    int i;
+
+    for(i = 8; i != 0; i--, c <<= 1)
+    {
+        host_setrelease(vd, (c & 0x80) ? IEC_DATA : 0, (c & 0x80) ? 0 : IEC_DATA);
+        host_delay(vd, IEC_DELAY);
+        host_release(vd, IEC_CLOCK);
+        host_delay(vd, IEC_DELAY);
+        if(!handshake(vd, IEC_CLOCK, 1))
+        {
+            return 0;
+        }
+
+        host_setrelease(vd, (c & 0x80) ? 0 : IEC_DATA, (c & 0x80) ? IEC_DATA : 0);
+        if(!handshake(vd, IEC_CLOCK, 0))
+        {
+            return 0;
+        }
+
+        host_setrelease(vd, IEC_CLOCK, IEC_DATA);
+        host_delay(vd, IEC_DELAY);
+        if(!handshake(vd, IEC_DATA, 1))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int
+s1_read_byte(vdrive_t *vd, unsigned char *data)
+{
+    unsigned char c = 0;
+    int i, b;
+
+    for(i = 8; i != 0; i--)
+    {
+        if(!handshake(vd, IEC_DATA, 0))
+        {
+            return 0;
+        }
+        host_release(vd, IEC_CLOCK);
+        host_delay(vd, IEC_DELAY);
+        b = host_get(vd, IEC_CLOCK);
+        c = (unsigned char) ((c >> 1) | (b ? 0x80 : 0));
+        host_set(vd, IEC_DATA);
+        if(!handshake(vd, IEC_CLOCK, !b))
+        {
+            return 0;
+        }
+
+        host_release(vd, IEC_DATA);
+        host_delay(vd, IEC_DELAY);
+        if(!handshake(vd, IEC_DATA, 1))
+        {
+            return 0;
+        }
+        host_set(vd, IEC_CLOCK);
+    }
+    *data = c;
+    return 1;
+}
+
+static int
+s2_write_byte(vdrive_t *vd, unsigned char c)
+{
+    int i;
+
+    for(i = 4; i != 0; i--)
+    {
+        host_setrelease(vd, (c & 1) ? IEC_DATA : 0, (c & 1) ? 0 : IEC_DATA);
+        host_delay(vd, IEC_DELAY);
+        c >>= 1;
+        host_release(vd, IEC_ATN);
+        if(!handshake(vd, IEC_CLOCK, 0))
+        {
+            return 0;
+        }
+
+        host_setrelease(vd, (c & 1) ? IEC_DATA : 0, (c & 1) ? 0 : IEC_DATA);
+        host_delay(vd, IEC_DELAY);
+        c >>= 1;
+        host_set(vd, IEC_ATN);
+        if(!handshake(vd, IEC_CLOCK, 1))
+        {
+            return 0;
+        }
+    }
+
+    host_release(vd, IEC_DATA);
+    host_delay(vd, IEC_DELAY);
+    return 1;
+}
+
+static int
+s2_read_byte(vdrive_t *vd, unsigned char *data)
+{
+    unsigned char c = 0;
+    int i;
+
+    for(i = 4; i != 0; i--)
+    {
+        if(!handshake(vd, IEC_CLOCK, 0))
+        {
+            return 0;
+        }
+        host_delay(vd, IEC_DELAY);
+        c = (unsigned char) ((c >> 1) | (host_get(vd, IEC_DATA) ? 0x80 : 0));
+        host_release(vd, IEC_ATN);
+
+        if(!handshake(vd, IEC_CLOCK, 1))
+        {
+            return 0;
+        }
+        host_delay(vd, IEC_DELAY);
+        c = (unsigned char) ((c >> 1) | (host_get(vd, IEC_DATA) ? 0x80 : 0));
+        host_set(vd, IEC_ATN);
+    }
+    *data = c;
+    return 1;
+}
+
+/*! \brief Two bytes of the d64copy parallel protocol, like pp_write_2_bytes() */
+static int
+pp_dc_write_2_bytes(vdrive_t *vd, const unsigned char *c)
+{
+    if(!handshake(vd, IEC_DATA, 1))
+    {
+        return 0;
+    }
+    vd->machine->pp_host = *c++;
+    update_pp(vd);
+    host_delay(vd, 1);
+    host_release(vd, IEC_CLOCK);
+
+    if(!handshake(vd, IEC_DATA, 0))
+    {
+        return 0;
+    }
+    vd->machine->pp_host = *c;
+    update_pp(vd);
+    host_delay(vd, 1);
+    host_set(vd, IEC_CLOCK);
+    return 1;
+}
+
+/*! \brief Two bytes of the d64copy parallel protocol, like pp_read_2_bytes() */
+static int
+pp_dc_read_2_bytes(vdrive_t *vd, unsigned char *c)
+{
+    vd->machine->pp_host = 0xff;
+    update_pp(vd);
+
+    if(!handshake(vd, IEC_DATA, 1))
+    {
+        return 0;
+    }
+    *c++ = drive_pp(vd);
+    host_release(vd, IEC_CLOCK);
+
+    if(!handshake(vd, IEC_DATA, 0))
+    {
+        return 0;
+    }
+    *c = drive_pp(vd);
+    host_set(vd, IEC_CLOCK);
+    return 1;
+}
+
+/*! \brief A byte of the cbmcopy parallel protocol, like write_byte() of libcbmcopy */
+static int
+pp_cc_write_byte(vdrive_t *vd, unsigned char c)
+{
+    vd->machine->pp_host = c;
+    update_pp(vd);
+    host_release(vd, IEC_CLOCK);
+    if(!handshake(vd, IEC_DATA, 0))
+    {
+        return 0;
+    }
+    host_set(vd, IEC_CLOCK);
+    return handshake(vd, IEC_DATA, 1);
+}
+
+/*! \brief A byte of the cbmcopy parallel protocol, like read_byte() of libcbmcopy */
+static int
+pp_cc_read_byte(vdrive_t *vd, unsigned char *c)
+{
+    vd->machine->pp_host = 0xff;
+    update_pp(vd);
+    host_release(vd, IEC_CLOCK);
+    if(!handshake(vd, IEC_DATA, 0))
+    {
+        return 0;
+    }
+    *c = drive_pp(vd);
+    host_set(vd, IEC_CLOCK);
+    return handshake(vd, IEC_DATA, 1);
+}
+
+/*! \brief Account the drive cycles of a host operation */
+static void
+account(vdrive_t *vd, enum vdrive_proto_e proto, unsigned long long start, size_t bytes)
+{
+    vdrive_machine_t *m = vd->machine;
+
+    m->proto_cycles[proto] += m->cpu.cycles - start;
+    m->proto_bytes[proto]  += bytes;
+}
+
+/*-------------------------------------------------------------------*/
+/*--------- INTERFACE -----------------------------------------------*/
+
+/*! \brief Load the ROM and the disk, and boot the drive
+
+ \param rom_file
+   The DOS ROM: 16 KB (1541, at $C000) or 32 KB (1571, at $8000).
+
+ \param g64_file
+   If not NULL, the disk is loaded from this G64 file instead of
+   being built from the image; changes are written back into it.
+
+ \return
+   0 on success, else failure.
+*/
+int
+vdrive_machine_open(vdrive_t *vd, const char *rom_file, const char *g64_file)
+{
+    vdrive_machine_t *m;
+    unsigned int track;
+    long size;
+    FILE *f;
+
+    if(vd->image.type == vdrive_d81)
+    {
+        fprintf(stderr, "vdrive: no hardware emulation for a 1581\n");
+        return 1;
+    }
+
+    m = calloc(1, sizeof(*m));
+    if(m == NULL)
+    {
+        return 1;
+    }
+    vd->machine = m;
+
+    f = fopen(rom_file, "rb");
+    if(f == NULL)
+    {
+        fprintf(stderr, "vdrive: cannot open ROM '%s'\n", rom_file);
+        vdrive_machine_close(vd);
+        return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if(size == 0x4000 || size == 0x8000)
+    {
+        m->rom_size = (unsigned int) size;
+        m->rom = malloc(m->rom_size);
+    }
+    if(m->rom == NULL || fread(m->rom, m->rom_size, 1, f) != 1)
+    {
+        fprintf(stderr, "vdrive: '%s' is no 16 KB (1541) or 32 KB (1571) ROM\n", rom_file);
+        fclose(f);
+        vdrive_machine_close(vd);
+        return 1;
+    }
+    fclose(f);
+
+    if(g64_file)
+    {
+        if(g64_load(vd, g64_file))
+        {
+            fprintf(stderr, "vdrive: cannot load G64 '%s'\n", g64_file);
+            vdrive_machine_close(vd);
+            return 1;
+        }
+    }
+    else
+    {
+        for(track = 1; track <= vd->image.tracks; track++)
+        {
+            if(track_from_image(vd, track))
+            {
+                vdrive_machine_close(vd);
+                return 1;
+            }
+        }
+    }
+
+    m->cpu.context = vd;
+    m->cpu.read    = machine_read;
+    m->cpu.write   = machine_write;
+    m->halftrack   = 36;
+    m->pp_host     = 0xff;
+    m->via1.pa_in  = 0xff;
+    m->via2.pa_in  = 0xff;
+    vd->host_lines = 0;
+    vdrive_cpu_reset(&m->cpu);
+
+    vdrive_machine_reset(vd);
+    if(m->handshake_timeouts)
+    {
+        fprintf(stderr, "vdrive: the drive does not answer after a reset, wrong ROM?\n");
+        vdrive_machine_close(vd);
+        return 1;
+    }
+    if(m->cpu.jammed)
+    {
+        vdrive_dbg(1, "undocumented opcode $%02X executed", m->cpu.jammed & 0xff);
+    }
+    return 0;
+}
+
+/*! \brief Write back what the drive changed on the disk
+
+ \return
+   0 on success, else failure.
+*/
+int
+vdrive_machine_flush(vdrive_t *vd)
+{
+    vdrive_machine_t *m = vd->machine;
+    unsigned int track;
+    int rv = 0;
+
+    if(m->g64_file)
+    {
+        rv = g64_save(vd);
+    }
+    else
+    {
+        for(track = 1; track <= vd->image.tracks; track++)
+        {
+            if(m->gcr_dirty[track])
+            {
+                track_to_image(vd, track);
+            }
+        }
+    }
+    memset(m->gcr_dirty, 0, sizeof(m->gcr_dirty));
+    return rv;
+}
+
+/*! \brief Free the drive; vdrive_machine_flush() must be called before */
+void
+vdrive_machine_close(vdrive_t *vd)
+{
+    vdrive_machine_t *m = vd->machine;
+    unsigned int track;
+
+    if(m == NULL)
+    {
+        return;
+    }
+    for(track = 0; track < sizeof(m->gcr) / sizeof(m->gcr[0]); track++)
+    {
+        free(m->gcr[track]);
+    }
+    free(m->g64_file);
+    free(m->rom);
+    free(m);
+    vd->machine = NULL;
+}
+
+/*! \brief Pull RESET, like iec_reset() of the firmware
+
+ A drive which does not answer the following ATN within 1.5 s
+ is counted as a handshake timeout.
+*/
+void
+vdrive_machine_reset(vdrive_t *vd)
+{
+    host_release(vd, IEC_DATA | IEC_ATN | IEC_CLOCK);
+    host_set(vd, IEC_RESET);
+    host_delay(vd, 100000);
+    host_release(vd, IEC_RESET);
+
+    if(!wait_for_free_bus(vd))
+    {
+        vd->machine->handshake_timeouts++;
+        vdrive_dbg(0, "drive does not answer after reset, drive at $%04X", vd->machine->cpu.pc);
+    }
+}
+
+/*! \brief Send bytes under ATN (LISTEN, TALK, ...)
+
+ \param talk
+   Do the talk-ATN turn around afterwards.
+
+ \return
+   The number of bytes written, 0 on error.
+*/
+int
+vdrive_machine_atn_write(vdrive_t *vd, const unsigned char *data, size_t count, int talk)
+{
+    unsigned long long start = vd->machine->cpu.cycles;
+    int rv;
+
+    rv = raw_write(vd, data, count, 1, talk);
+    account(vd, vdrive_proto_bus, start, rv);
+    return rv;
+}
+
+/*! \brief Write bytes with the standard serial protocol, the last one with EOI
+
+ \return
+   The number of bytes written, 0 on error.
+*/
+int
+vdrive_machine_raw_write(vdrive_t *vd, const unsigned char *data, size_t count)
+{
+    unsigned long long start = vd->machine->cpu.cycles;
+    int rv;
+
+    rv = raw_write(vd, data, count, 0, 0);
+    account(vd, vdrive_proto_iec, start, rv);
+    return rv;
+}
+
+/*! \brief Read bytes with the standard serial protocol, like iec_raw_read() of the firmware
+
+ \return
+   The number of bytes read; 0 on error or if the talker had
+   nothing to send.
+*/
+int
+vdrive_machine_raw_read(vdrive_t *vd, unsigned char *data, size_t count)
+{
+    unsigned long long start = vd->machine->cpu.cycles;
+    unsigned char b;
+    size_t received = 0;
+    int ok, bit;
+
+    do
+    {
+        /* wait for the talker to release CLK */
+        if(!host_wait_while(vd, IEC_CLOCK, IEC_CLOCK, 1000000))
+        {
+            received = 0;
+            break;
+        }
+        if(vd->eoi)
+        {
+            break;
+        }
+
+        host_release(vd, IEC_DATA);
+        host_wait_while(vd, IEC_CLOCK, 0, 400);
+
+        if(!host_get(vd, IEC_CLOCK))
+        {
+            /* EOI: acknowledge it */
+            vd->eoi = 1;
+            host_set(vd, IEC_DATA);
+            host_delay(vd, 70);
+            host_release(vd, IEC_DATA);
+        }
+
+        ok = iec_wait_timeout_2ms(vd, IEC_CLOCK, 0);
+        for(bit = b = 0; bit < 8 && ok; bit++)
+        {
+            ok = iec_wait_timeout_2ms(vd, IEC_CLOCK, IEC_CLOCK);
+            if(ok)
+            {
+                b >>= 1;
+                if(!host_get(vd, IEC_DATA))
+                {
+                    b |= 0x80;
+                }
+                ok = iec_wait_timeout_2ms(vd, IEC_CLOCK, 0);
+            }
+        }
+
+        if(!ok)
+        {
+            received = 0;
+            break;
+        }
+        host_set(vd, IEC_DATA);
+        data[received++] = b;
+        host_delay(vd, 50);
+    }
+    while(received != count && !vd->eoi);
+
+    account(vd, vdrive_proto_iec, start, received);
+    return (int) received;
+}
+
+/*! \brief The state of the IEC lines, as cbm_iec_poll() */
+int
+vdrive_machine_iec_poll(vdrive_t *vd)
+{
+    machine_run(vd, HOST_CALL_CYCLES);
+    return vd->machine->lines & (IEC_DATA | IEC_CLOCK | IEC_ATN);
+}
+
+/*! \brief Set and release lines of the host */
+void
+vdrive_machine_iec_setrelease(vdrive_t *vd, int set, int release)
+{
+    host_setrelease(vd, set, release);
+    machine_run(vd, HOST_CALL_CYCLES);
+}
+
+/*! \brief Wait for a line to reach a state, like iec_wait() of the firmware
+
+ \return
+   The state of the lines on return.
+*/
+int
+vdrive_machine_iec_wait(vdrive_t *vd, int line, int state)
+{
+    if(!host_wait_while(vd, line, state ? 0 : line, MACHINE_FOREVER))
+    {
+        vd->machine->handshake_timeouts++;
+        vdrive_dbg(0, "cbm_iec_wait() timeout, drive at $%04X", vd->machine->cpu.pc);
+    }
+    return vdrive_machine_iec_poll(vd);
+}
+
+/*! \brief Read the parallel cable; the host port is switched to input */
+unsigned char
+vdrive_machine_pp_read(vdrive_t *vd)
+{
+    vd->machine->pp_host = 0xff;
+    update_pp(vd);
+    machine_run(vd, HOST_CALL_CYCLES);
+    return drive_pp(vd);
+}
+
+/*! \brief Drive a byte on the parallel cable */
+void
+vdrive_machine_pp_write(vdrive_t *vd, unsigned char value)
+{
+    vd->machine->pp_host = value;
+    update_pp(vd);
+    machine_run(vd, HOST_CALL_CYCLES);
+}
+
+/*! \brief Receive bytes with a fast protocol
+
+ \param unit
+   2 for the byte pairs of the d64copy parallel protocol, else 1.
+
+ \return
+   The number of bytes read; less than requested if a handshake
+   timed out.
+*/
+int
+vdrive_machine_read_n(vdrive_t *vd, enum vdrive_proto_e proto, int unit, unsigned char *data, size_t count)
+{
+    unsigned long long start = vd->machine->cpu.cycles;
+    size_t i;
+    int ok = 1;
+
+    for(i = 0; ok && i + unit <= count; i += ok ? unit : 0)
+    {
+        switch(proto)
+        {
+            case vdrive_proto_s1:
+                ok = s1_read_byte(vd, data + i);
+                break;
+            case vdrive_proto_s2:
+                ok = s2_read_byte(vd, data + i);
+                break;
+            default:
+                ok = (unit == 2) ? pp_dc_read_2_bytes(vd, data + i) : pp_cc_read_byte(vd, data + i);
+                break;
+        }
+    }
+    account(vd, proto, start, i);
+    return (int) i;
+}
+
+/*! \brief Send bytes with a fast protocol
+
+ \param unit
+   2 for the byte pairs of the d64copy parallel protocol, else 1.
+
+ \return
+   The number of bytes written; less than requested if a handshake
+   timed out.
+*/
+int
+vdrive_machine_write_n(vdrive_t *vd, enum vdrive_proto_e proto, int unit, const unsigned char *data, size_t count)
+{
+    unsigned long long start = vd->machine->cpu.cycles;
+    size_t i;
+    int ok = 1;
+
+    for(i = 0; ok && i + unit <= count; i += ok ? unit : 0)
+    {
+        switch(proto)
+        {
+            case vdrive_proto_s1:
+                ok = s1_write_byte(vd, data[i]);
+                break;
+            case vdrive_proto_s2:
+                ok = s2_write_byte(vd, data[i]);
+                break;
+            default:
+                ok = (unit == 2) ? pp_dc_write_2_bytes(vd, data + i) : pp_cc_write_byte(vd, data[i]);
+                break;
+        }
+    }
+    account(vd, proto, start, i);
+    return (int) i;
+}
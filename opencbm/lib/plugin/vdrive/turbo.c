@@ -0,0 +1,579 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version
+ *  2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 The OpenCBM project
+ */
+
+/*! **************************************************************
+** \file lib/plugin/vdrive/turbo.c \n
+** \n
+** \brief Image backed virtual drive: emulation of the uploaded drive code
+**
+** The drive code of libd64copy, libimgcopy and libcbmcopy is not
+** executed. Instead, the byte streams the transfer modules exchange
+** with it are served directly from the image:
+**
+** - a "U3".."U8" or "M-E" after an upload to $0700 starts the block
+**   server of d64copy/imgcopy (track, sector, status, data, and the
+**   track map/GCR sectors of warp mode)
+** - after an upload to $0680, cbmcopy's file turbo is started: it
+**   sends (or receives) a count byte followed by the block data for
+**   every block of the file chain.
+**
+** The handshake on the IEC lines is answered immediately, so the
+** polling loops of the transfer modules never block.
+**
+****************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "vdrive.h"
+
+/*! 4 bit to 5 bit GCR code */
+static const unsigned char gcr_encode_table[16] =
+{
+    0x0a, 0x0b, 0x12, 0x13, 0x0e, 0x0f, 0x16, 0x17,
+    0x09, 0x19, 0x1a, 0x1b, 0x0d, 0x1d, 0x1e, 0x15
+};
+
+/*! \brief GCR encode 4 bytes into 5 */
+void
+vdrive_gcr_encode_group(const unsigned char *in, unsigned char *out)
+{
+    unsigned long long bits = 0;
+    int i;
+
+    for(i = 0; i < 4; i++)
+    {
+        bits = (bits << 10)
+             | (gcr_encode_table[in[i] >> 4] << 5)
+             | gcr_encode_table[in[i] & 0x0f];
+    }
+    for(i = 4; i >= 0; i--)
+    {
+        out[i] = (unsigned char) bits;
+        bits >>= 8;
+    }
+}
+
+/*! \brief GCR decode 5 bytes into 4
+
+ \return
+   != 0 if the input contains illegal GCR codes.
+*/
+int
+vdrive_gcr_decode_group(const unsigned char *in, unsigned char *out)
+{
+    unsigned long long bits = 0;
+    int i, j, nybble[2], illegal = 0;
+
+    for(i = 0; i < 5; i++)
+    {
+        bits = (bits << 8) | in[i];
+    }
+    for(i = 0; i < 4; i++)
+    {
+        for(j = 0; j < 2; j++)
+        {
+            unsigned char code = (unsigned char) ((bits >> (35 - 10 * i - 5 * j)) & 0x1f);
+
+            for(nybble[j] = 0; nybble[j] < 16 && gcr_encode_table[nybble[j]] != code; nybble[j]++)
+                ;
+            if(nybble[j] == 16)
+            {
+                nybble[j] = 0;
+                illegal = 1;
+            }
+        }
+        out[i] = (unsigned char) ((nybble[0] << 4) | nybble[1]);
+    }
+    return illegal;
+}
+
+/*! \brief GCR encode a data block like libd64copy's gcr_encode()
+
+ \param gcr
+   Buffer for the 325 encoded bytes: data block marker, 256 data
+   bytes, checksum and two zero bytes.
+*/
+void
+vdrive_gcr_encode(const unsigned char *block, unsigned char *gcr)
+{
+    unsigned char group[4];
+    unsigned char chksum = 0;
+    int i;
+
+    for(i = 0; i < VDRIVE_BLOCKSIZE; i++)
+    {
+        chksum ^= block[i];
+    }
+
+    group[0] = 0x07;
+    memcpy(group + 1, block, 3);
+    vdrive_gcr_encode_group(group, gcr);
+
+    for(i = 3; i < VDRIVE_BLOCKSIZE - 1; i += 4)
+    {
+        gcr += 5;
+        vdrive_gcr_encode_group(block + i, gcr);
+    }
+
+    group[0] = block[VDRIVE_BLOCKSIZE - 1];
+    group[1] = chksum;
+    group[2] = group[3] = 0;
+    vdrive_gcr_encode_group(group, gcr + 5);
+}
+
+/*! \brief GCR decode a data block like libd64copy's gcr_decode()
+
+ \return
+   0 on success, 4 if the data block marker is wrong or the
+   data contains illegal GCR codes, 5 on a checksum error.
+*/
+int
+vdrive_gcr_decode(const unsigned char *gcr, unsigned char *block)
+{
+    unsigned char group[4];
+    unsigned char chksum = 0;
+    int i, illegal;
+
+    illegal = vdrive_gcr_decode_group(gcr, group);
+    if(group[0] != 0x07)
+    {
+        return 4;
+    }
+    memcpy(block, group + 1, 3);
+
+    for(i = 3; i < VDRIVE_BLOCKSIZE - 1; i += 4)
+    {
+        gcr += 5;
+        illegal |= vdrive_gcr_decode_group(gcr, block + i);
+    }
+
+    illegal |= vdrive_gcr_decode_group(gcr + 5, group);
+    block[VDRIVE_BLOCKSIZE - 1] = group[0];
+
+    if(illegal)
+    {
+        return 4;
+    }
+    for(i = 0; i < VDRIVE_BLOCKSIZE; i++)
+    {
+        chksum ^= block[i];
+    }
+    return (chksum != group[1]) ? 5 : 0;
+}
+
+/*! \brief Stop the drive code, the drive is back in DOS */
+void
+vdrive_turbo_stop(vdrive_t *vd)
+{
+    free(vd->file_chain);
+    vd->file_chain  = NULL;
+    vd->file_blocks = vd->file_next = 0;
+    vd->file_error  = 0;
+    vd->file_count  = -1;
+
+    vd->turbo       = vdrive_turbo_none;
+    vd->block_state = vdrive_bs_idle;
+    vd->in_length   = 0;
+    vd->out_length  = vd->out_pos = 0;
+    vd->line_phase  = 0;
+}
+
+static int
+page_uploaded(const vdrive_t *vd, unsigned int page)
+{
+    return (vd->upload_pages[page >> 3] & (1 << (page & 7))) != 0;
+}
+
+/*! \brief Start drive code uploaded before
+
+ \param address
+   The start address (from U3..U8 or M-E).
+
+ \param param
+   The bytes following the "Ux:" command; cbmcopy gives the
+   track and sector of the file to read there.
+*/
+void
+vdrive_turbo_start(vdrive_t *vd, unsigned int address, const unsigned char *param, size_t param_length)
+{
+    int sa;
+    unsigned int track, sector;
+
+    vdrive_turbo_stop(vd);
+
+    if(page_uploaded(vd, 7))
+    {
+        /* the d64copy/imgcopy transfer routines reside at $0700 */
+        vd->turbo = vdrive_turbo_block;
+        vd->unit  = 1;
+    }
+    else if(page_uploaded(vd, 6))
+    {
+        /* the cbmcopy transfer routines reside at $0680 */
+        sa = vdrive_dos_find_channel(vd, vdrive_ch_write);
+        if(sa >= 0)
+        {
+            vd->turbo = vdrive_turbo_file_write;
+            vd->write_channel = sa;
+        }
+        else
+        {
+            if(param_length >= 2 && param[0] != 0)
+            {
+                track  = param[0];
+                sector = param[1];
+            }
+            else
+            {
+                sa = vdrive_dos_find_channel(vd, vdrive_ch_read);
+                track  = (sa >= 0) ? vd->channel[sa].start_track : 0;
+                sector = (sa >= 0) ? vd->channel[sa].start_sector : 0;
+            }
+            vd->turbo = vdrive_turbo_file_read;
+            vd->file_error = vdrive_image_read_chain(&vd->image, track, sector,
+                                                     &vd->file_chain, &vd->file_blocks);
+        }
+    }
+
+    /* the uploaded code is consumed */
+    memset(vd->upload_pages, 0, sizeof(vd->upload_pages));
+}
+
+/*! \brief Queue a value for the host, doubled for the pp_dc protocol */
+static void
+put_value(vdrive_t *vd, unsigned char value)
+{
+    vd->out[vd->out_length++] = value;
+    if(vd->unit == 2)
+    {
+        vd->out[vd->out_length++] = value;
+    }
+}
+
+/*! \brief A block written by the host is complete, write it to the image */
+static int
+block_write(vdrive_t *vd)
+{
+    unsigned char block[VDRIVE_BLOCKSIZE];
+    unsigned char gcr[VDRIVE_GCRBUFSIZE];
+    int rv;
+
+    vdrive_latency(vd, vdrive_proto_disk, 0);
+
+    if(vd->in_length == VDRIVE_BLOCKSIZE)
+    {
+        memcpy(block, vd->in, VDRIVE_BLOCKSIZE);
+    }
+    else if(vd->in_length == VDRIVE_GCRBUFSIZE - 1 && vd->unit == 1)
+    {
+        rv = vdrive_gcr_decode(vd->in, block);
+        if(rv)
+        {
+            return rv;
+        }
+    }
+    else if(vd->in_length == VDRIVE_GCRBUFSIZE && vd->unit == 2)
+    {
+        /* pp sends the first byte twice to make the length even */
+        gcr[0] = vd->in[0];
+        memcpy(gcr + 1, vd->in + 2, VDRIVE_GCRBUFSIZE - 2);
+        rv = vdrive_gcr_decode(gcr, block);
+        if(rv)
+        {
+            return rv;
+        }
+    }
+    else
+    {
+        return 4;
+    }
+
+    rv = vdrive_image_write(&vd->image, vd->turbo_track, vd->turbo_sector, block);
+    return rv ? 8 : 0;
+}
+
+/*! \brief Produce the next answer of the drive code */
+static void
+turbo_generate(vdrive_t *vd)
+{
+    unsigned char block[VDRIVE_BLOCKSIZE];
+    unsigned int n, i, se;
+    int status;
+
+    vd->out_length = vd->out_pos = 0;
+
+    switch(vd->turbo)
+    {
+        case vdrive_turbo_block:
+            switch(vd->block_state)
+            {
+                case vdrive_bs_header:
+                    /* a track and sector, followed by a read: read_block() */
+                    vdrive_latency(vd, vdrive_proto_disk, 0);
+                    status = vdrive_image_read(&vd->image, vd->turbo_track, vd->turbo_sector, block);
+                    put_value(vd, (unsigned char) (status ? vdrive_image_job_code(&vd->image,
+                                                   vd->turbo_track, vd->turbo_sector) : 0));
+                    if(status == 66)
+                    {
+                        vd->out[vd->out_length - 1] = 2;
+                        memset(block, 0, sizeof(block));
+                    }
+                    memcpy(vd->out + vd->out_length, block, VDRIVE_BLOCKSIZE);
+                    vd->out_length += VDRIVE_BLOCKSIZE;
+                    vd->block_state = vdrive_bs_idle;
+                    break;
+
+                case vdrive_bs_data:
+                    /* a block was received, the host asks for the status: write_block() */
+                    put_value(vd, (unsigned char) block_write(vd));
+                    vd->in_length = 0;
+                    vd->block_state = vdrive_bs_idle;
+                    break;
+
+                case vdrive_bs_warp:
+                    /* send the next needed sector passing under the head */
+                    n = vdrive_image_sectors(&vd->image, vd->turbo_track);
+                    for(i = 0; i < n; i++)
+                    {
+                        se = (vd->rotation + i) % n;
+                        if(!vd->warp_map[se])
+                        {
+                            break;
+                        }
+                    }
+                    if(n == 0 || i == n)
+                    {
+                        put_value(vd, 0);
+                        put_value(vd, 2);
+                        vd->block_state = vdrive_bs_idle;
+                        break;
+                    }
+                    se = (vd->rotation + i) % n;
+                    vd->warp_map[se] = 1;
+                    vd->rotation = (se + 1) % n;
+
+                    vdrive_latency(vd, vdrive_proto_disk, 0);
+                    vdrive_image_read(&vd->image, vd->turbo_track, se, block);
+                    status = vdrive_image_job_code(&vd->image, vd->turbo_track, se);
+                    put_value(vd, (unsigned char) se);
+                    put_value(vd, (unsigned char) status);
+                    if(status == 0)
+                    {
+                        vdrive_gcr_encode(block, vd->out + vd->out_length);
+                        vd->out[vd->out_length + VDRIVE_GCRBUFSIZE - 1] = 0;
+                        vd->out_length += VDRIVE_GCRBUFSIZE;
+                    }
+                    if(status || --vd->warp_count == 0)
+                    {
+                        /* a read error ends the track, a new track map follows */
+                        vd->block_state = vdrive_bs_idle;
+                    }
+                    break;
+
+                default:
+                    break;
+            }
+            break;
+
+        case vdrive_turbo_file_read:
+            if(vd->file_next < vd->file_blocks)
+            {
+                const unsigned char *p;
+
+                vdrive_latency(vd, vdrive_proto_disk, 0);
+                p = vdrive_image_block(&vd->image, vd->file_chain[2 * vd->file_next],
+                                       vd->file_chain[2 * vd->file_next + 1]);
+                n = p[0] ? 254 : (p[1] > 1 ? p[1] - 1 : 0);
+                vd->out[0] = (unsigned char) (p[0] ? 255 : n);
+                memcpy(vd->out + 1, p + 2, n);
+                vd->out_length = n + 1;
+                vd->file_next++;
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+/*! \brief Bytes sent by the host to the drive code
+
+ \param unit
+   2 if the protocol transfers byte pairs (pp_dc), else 1.
+
+ \return
+   The number of bytes accepted.
+*/
+int
+vdrive_turbo_write(vdrive_t *vd, int unit, const unsigned char *data, size_t count)
+{
+    size_t i, n;
+
+    switch(vd->turbo)
+    {
+        case vdrive_turbo_block:
+            vd->unit = unit;
+            if(vd->block_state == vdrive_bs_idle && vd->in_length == 0 && count > 2)
+            {
+                /* track, count and the map of sectors not to send: send_track_map() */
+                vd->turbo_track = data[0];
+                vd->warp_count  = data[1];
+                n = vdrive_image_sectors(&vd->image, data[0]);
+                memset(vd->warp_map, 1, sizeof(vd->warp_map));
+                for(i = 0; i < n && 2 + unit * i < count; i++)
+                {
+                    vd->warp_map[i] = data[2 + unit * i];
+                }
+                vd->block_state = vd->warp_count ? vdrive_bs_warp : vdrive_bs_idle;
+                return (int) count;
+            }
+
+            for(i = 0; i < count; i++)
+            {
+                switch(vd->block_state)
+                {
+                    case vdrive_bs_idle:
+                        vd->in[vd->in_length++] = data[i];
+                        if(vd->in_length == 2)
+                        {
+                            vd->in_length = 0;
+                            vd->turbo_track  = vd->in[0];
+                            vd->turbo_sector = vd->in[1];
+                            if(vd->turbo_track == 0)
+                            {
+                                /* track 0 quits the block server */
+                                vdrive_turbo_stop(vd);
+                                return (int) count;
+                            }
+                            vd->block_state = vdrive_bs_header;
+                        }
+                        break;
+
+                    case vdrive_bs_header:
+                        vd->block_state = vdrive_bs_data;
+                        /* fall through */
+                    case vdrive_bs_data:
+                        if(vd->in_length < sizeof(vd->in))
+                        {
+                            vd->in[vd->in_length++] = data[i];
+                        }
+                        break;
+
+                    default:
+                        break;
+                }
+            }
+            return (int) count;
+
+        case vdrive_turbo_file_write:
+            for(i = 0; i < count; i++)
+            {
+                if(vd->file_count < 0)
+                {
+                    vd->file_count = data[i];
+                    vd->in_length  = 0;
+                }
+                else
+                {
+                    vd->in[vd->in_length++] = data[i];
+                }
+
+                n = (vd->file_count == 255) ? 254 : (size_t) vd->file_count;
+                if(vd->in_length == n)
+                {
+                    vdrive_latency(vd, vdrive_proto_disk, 0);
+                    vdrive_dos_append(vd, (unsigned char) vd->write_channel, vd->in, n);
+                    vd->file_count = -1;
+                    vd->in_length  = 0;
+                }
+            }
+            return (int) count;
+
+        default:
+            return (int) count;
+    }
+}
+
+/*! \brief Bytes read by the host from the drive code
+
+ \return
+   The number of bytes read; less than requested if the drive
+   code has nothing more to send.
+*/
+int
+vdrive_turbo_read(vdrive_t *vd, int unit, unsigned char *data, size_t count)
+{
+    size_t i;
+
+    vd->unit = unit;
+
+    for(i = 0; i < count; i++)
+    {
+        if(vd->out_pos == vd->out_length)
+        {
+            turbo_generate(vd);
+            if(vd->out_length == 0)
+            {
+                break;
+            }
+        }
+        data[i] = vd->out[vd->out_pos++];
+    }
+    return (int) i;
+}
+
+/*! \brief The IEC lines driven by the drive
+
+ While drive code runs, the drive toggles DATA and CLOCK on every
+ poll, so every handshake loop of the host terminates after two
+ polls at most. A broken file chain is signalled to cbmcopy's
+ check_error() by a released CLOCK line.
+*/
+int
+vdrive_turbo_lines(vdrive_t *vd)
+{
+    int lines;
+
+    if(vd->turbo == vdrive_turbo_none)
+    {
+        return vd->host_lines;
+    }
+
+    vd->line_phase ^= 1;
+    lines = vd->line_phase ? (IEC_DATA | IEC_CLOCK) : 0;
+
+    if(vd->turbo == vdrive_turbo_file_read && vd->file_error
+       && vd->file_next == vd->file_blocks && vd->out_pos == vd->out_length)
+    {
+        lines &= ~IEC_CLOCK;
+    }
+    return lines;
+}
+
+/*! \brief Wait for a line state, see vdrive_turbo_lines()
+
+ \return
+   The state of the IEC bus on return.
+*/
+int
+vdrive_turbo_wait(vdrive_t *vd, int line, int state)
+{
+    if(vd->turbo == vdrive_turbo_none)
+    {
+        return vd->host_lines;
+    }
+
+    /*
+     * position the phase such that the next poll yields the requested
+     * state; a CLOCK line held released by an error does not block
+     */
+    vd->line_phase = state ? 0 : 1;
+    return vdrive_turbo_lines(vd);
+}
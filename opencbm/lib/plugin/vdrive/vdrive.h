@@ -0,0 +1,347 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version
+ *  2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 The OpenCBM project
+ */
+
+/*! **************************************************************
+** \file lib/plugin/vdrive/vdrive.h \n
+** \n
+** \brief Image backed virtual drive: internal definitions
+**
+****************************************************************/
+
+#ifndef VDRIVE_H
+#define VDRIVE_H
+
+#include <stddef.h>
+
+#include "opencbm.h"
+
+/*
+ * Compile-time assert to make sure CBM_FILE is large enough.
+ */
+#ifndef CTASSERT
+#define CTASSERT(x)         _CTASSERT(x, __LINE__)
+#define _CTASSERT(x, y)     __CTASSERT(x, y)
+#define __CTASSERT(x, y)    typedef char __assert ## y[(x) ? 1 : -1]
+#endif
+
+#define VDRIVE_BLOCKSIZE        256
+#define VDRIVE_GCRBUFSIZE       326     /*!< GCR encoded data block as sent by the warp routines */
+#define VDRIVE_MAX_TRACKS       80
+#define VDRIVE_MAX_SECTORS      40
+#define VDRIVE_CHANNELS         16
+#define VDRIVE_BUFFERS          5       /*!< number of DOS buffers at $0300-$07FF */
+#define VDRIVE_CMD_SIZE         64      /*!< size of the command buffer, like the 1541 $0200 buffer */
+#define VDRIVE_STATUS_SIZE      300     /*!< room for a full M-R answer plus trailing CR */
+
+/*! the image formats (and with them, the emulated drives) */
+enum vdrive_image_type_e
+{
+    vdrive_d64,
+    vdrive_d71,
+    vdrive_d81
+};
+
+/*! the transfer protocols for which the latency model is kept */
+enum vdrive_proto_e
+{
+    vdrive_proto_bus,   /*!< ATN sequences (listen, talk, ...) and IEC line access */
+    vdrive_proto_iec,   /*!< raw_read/raw_write of the standard serial protocol */
+    vdrive_proto_s1,
+    vdrive_proto_s2,
+    vdrive_proto_pp,    /*!< pp_read/pp_write, pp_dc_*_n, pp_cc_*_n */
+    vdrive_proto_disk,  /*!< one sector access of the emulated mechanics */
+    vdrive_proto_count
+};
+
+/*! the state of a secondary address */
+enum vdrive_channel_mode_e
+{
+    vdrive_ch_closed,
+    vdrive_ch_buffer,   /*!< direct access channel, opened as "#" */
+    vdrive_ch_read,     /*!< file or directory opened for reading */
+    vdrive_ch_write     /*!< file opened for writing, written to disk on close */
+};
+
+/*! the kind of drive code the emulated drive executes */
+enum vdrive_turbo_e
+{
+    vdrive_turbo_none,
+    vdrive_turbo_block,       /*!< d64copy/imgcopy: track/sector block server at $0700 */
+    vdrive_turbo_file_read,   /*!< cbmcopy: read a file chain at $0680 */
+    vdrive_turbo_file_write   /*!< cbmcopy: write a file at $0680 */
+};
+
+/*! the state of the block server while the block turbo runs */
+enum vdrive_block_state_e
+{
+    vdrive_bs_idle,     /*!< waiting for track and sector */
+    vdrive_bs_header,   /*!< got track and sector, next is data or a read */
+    vdrive_bs_data,     /*!< receiving a block to write */
+    vdrive_bs_warp      /*!< got a track map, sending GCR sectors */
+};
+
+/*! a loaded disk image */
+typedef struct vdrive_image_s
+{
+    enum vdrive_image_type_e type;
+    char *filename;
+    unsigned char *data;            /*!< the block data */
+    unsigned char *errors;          /*!< the error info, NULL if the image has none */
+    unsigned int tracks;
+    unsigned int blocks;
+    unsigned int track_offset[VDRIVE_MAX_TRACKS + 2];   /*!< first block number of a track */
+    unsigned char dir_track;
+    unsigned char interleave;
+    int read_only;
+    int dirty;
+    int has_error_info;             /*!< errors must be written back to the file */
+} vdrive_image_t;
+
+/*! a secondary address of the emulated drive */
+typedef struct vdrive_channel_s
+{
+    enum vdrive_channel_mode_e mode;
+    int buffer;                     /*!< DOS buffer of a "#" channel, -1 otherwise */
+    unsigned char *data;            /*!< contents of a read or write channel */
+    size_t length;
+    size_t size;
+    size_t pos;
+    unsigned char start_track;      /*!< first block of a file opened for reading */
+    unsigned char start_sector;
+    unsigned char name[16];
+    unsigned char name_length;
+    unsigned char file_type;        /*!< directory entry type of a file opened for writing */
+    int replace;                    /*!< "@:" was given */
+} vdrive_channel_t;
+
+/*! the latency model of one protocol */
+typedef struct vdrive_latency_s
+{
+    double call_us;                 /*!< fixed cost of a call */
+    double byte_us;                 /*!< cost of every transferred byte */
+    unsigned long calls;            /*!< statistics: number of calls */
+    unsigned long bytes;            /*!< statistics: number of bytes */
+    double total_us;                /*!< statistics: accumulated virtual time */
+} vdrive_latency_t;
+
+/*! the 6502 CPU of the drive */
+typedef struct vdrive_cpu_s
+{
+    unsigned short pc;
+    unsigned char a, x, y, sp, p;
+    unsigned long long cycles;      /*!< cycles executed since power on */
+    int irq;                        /*!< level of the IRQ input */
+    int jammed;                     /*!< first undocumented opcode executed (| 0x100), for debugging */
+    void *context;
+    unsigned char (*read)(void *context, unsigned short address);
+    void (*write)(void *context, unsigned short address, unsigned char value);
+} vdrive_cpu_t;
+
+/*! a 6522 VIA */
+typedef struct vdrive_via_s
+{
+    unsigned char orb, ora, ddrb, ddra;
+    unsigned char pb_in, pa_in;     /*!< levels driven into the ports from outside */
+    long t1_counter;
+    unsigned short t1_latch;
+    long t2_counter;
+    unsigned char t2_latch_lo;
+    int t1_armed;                   /*!< T1 sets its IRQ flag on the next underflow */
+    int t2_armed;
+    unsigned char sr, acr, pcr, ifr, ier;
+    int ca1, cb1;                   /*!< levels of the edge inputs */
+} vdrive_via_t;
+
+/*! the hardware of a 1541 or 1571 executing the drive code */
+typedef struct vdrive_machine_s
+{
+    vdrive_cpu_t cpu;
+    vdrive_via_t via1;              /*!< $1800: serial bus (and XP1541 port) */
+    vdrive_via_t via2;              /*!< $1C00: disk controller */
+    unsigned char ram[0x800];
+    unsigned char *rom;             /*!< 16 KB ($C000) for a 1541, 32 KB ($8000) for a 1571 */
+    unsigned int rom_size;
+    unsigned char cia_port[4];      /*!< 1571: PRA, PRB, DDRA, DDRB of the CIA at $4000 (XP1571 port) */
+    unsigned char pp_host;          /*!< byte the host drives on the parallel cable, 0xff if it reads */
+
+    int lines;                      /*!< IEC lines as seen on the bus (IEC_DATA, ...) */
+
+    /* the disk: GCR bit stream of every track, as the head sees it */
+    unsigned char *gcr[2 * VDRIVE_MAX_TRACKS + 1];  /*!< index: track number (D71: 36-70 is side 2) */
+    unsigned int gcr_length[2 * VDRIVE_MAX_TRACKS + 1];
+    unsigned char gcr_dirty[2 * VDRIVE_MAX_TRACKS + 1]; /*!< the drive wrote to the track */
+    char *g64_file;                 /*!< the disk was loaded from this G64, NULL if from the image */
+    unsigned long g64_offset[2 * VDRIVE_MAX_TRACKS + 1]; /*!< file offset of a track in the G64 */
+    unsigned int halftrack;         /*!< head position, 2 = track 1 */
+    unsigned int head_pos;          /*!< byte under the head */
+    long byte_cycles;               /*!< cycles until the next byte passes the head */
+    int sync;
+    unsigned char last_byte;
+    unsigned char stepper;
+
+    /* statistics */
+    unsigned long long proto_cycles[vdrive_proto_count];    /*!< drive cycles spent in a protocol */
+    unsigned long long proto_bytes[vdrive_proto_count];     /*!< bytes transferred by a protocol */
+    unsigned long handshake_timeouts;
+} vdrive_machine_t;
+
+/*! the emulated drive */
+typedef struct vdrive_s
+{
+    vdrive_image_t image;
+    unsigned char device;           /*!< primary address of the drive */
+
+    unsigned char mem[0x10000];     /*!< drive address space: RAM, I/O and ROM footprints */
+    unsigned int ram_size;
+    unsigned char upload_pages[0x100 / 8];  /*!< pages in which an upload started since the last execution */
+    unsigned int upload_next;       /*!< address following the last M-W */
+
+    vdrive_channel_t channel[VDRIVE_CHANNELS];
+    unsigned char buffer_used[VDRIVE_BUFFERS];
+
+    /* IEC bus state */
+    int listening;                  /*!< secondary address we are listening on, -1 if not */
+    int talking;                    /*!< secondary address we are talking on, -1 if not */
+    int opening;                    /*!< we are receiving a file name */
+    int eoi;
+    unsigned char cmd[VDRIVE_CMD_SIZE];
+    size_t cmd_length;
+    int host_lines;                 /*!< IEC lines held by the host */
+    int line_phase;                 /*!< alternating drive side lines while a turbo runs */
+    unsigned char pp_out;           /*!< last byte the host wrote to the parallel port */
+
+    /* error channel */
+    int status;
+    unsigned char status_track;
+    unsigned char status_sector;
+    unsigned char status_buffer[VDRIVE_STATUS_SIZE];
+    size_t status_length;
+    size_t status_pos;
+
+    /* emulated drive code */
+    enum vdrive_turbo_e turbo;
+    enum vdrive_block_state_e block_state;
+    unsigned char in[2 * VDRIVE_GCRBUFSIZE + 2];  /*!< bytes received by the drive code */
+    size_t in_length;
+    unsigned char out[2 * VDRIVE_GCRBUFSIZE + 4]; /*!< bytes to be sent by the drive code */
+    size_t out_length;
+    size_t out_pos;
+    int unit;                       /*!< 2 for the byte doubling pp_dc protocol, else 1 */
+    unsigned char turbo_track;
+    unsigned char turbo_sector;
+    unsigned char warp_map[VDRIVE_MAX_SECTORS];
+    unsigned int warp_count;
+    unsigned int rotation;          /*!< sector under the head */
+    unsigned char *file_chain;      /*!< track/sector pairs of a file to send */
+    unsigned int file_blocks;
+    unsigned int file_next;
+    int file_error;                 /*!< the chain is broken after the last entry */
+    int file_count;                 /*!< byte count of the block currently received, -1 if none */
+    int write_channel;
+
+    /* latency model */
+    vdrive_latency_t latency[vdrive_proto_count];
+    double latency_debt_us;
+    int print_stats;
+    int xp1541;                     /*!< emulate a parallel cable at the VIA/CIA port */
+
+    vdrive_machine_t *machine;      /*!< the 6502 drive, NULL if no ROM is given */
+} vdrive_t;
+
+CTASSERT(sizeof(CBM_FILE) >= sizeof(vdrive_t *));
+
+/* image.c */
+int  vdrive_image_open(vdrive_image_t *image, const char *filename);
+int  vdrive_image_flush(vdrive_image_t *image);
+void vdrive_image_close(vdrive_image_t *image);
+unsigned int vdrive_image_sectors(const vdrive_image_t *image, unsigned int track);
+int  vdrive_image_check_ts(const vdrive_image_t *image, unsigned int track, unsigned int sector);
+unsigned char *vdrive_image_block(vdrive_image_t *image, unsigned int track, unsigned int sector);
+int  vdrive_image_read(vdrive_image_t *image, unsigned int track, unsigned int sector, unsigned char *block);
+int  vdrive_image_write(vdrive_image_t *image, unsigned int track, unsigned int sector, const unsigned char *block);
+int  vdrive_image_job_code(const vdrive_image_t *image, unsigned int track, unsigned int sector);
+int  vdrive_bam_allocate(vdrive_image_t *image, unsigned int track, unsigned int sector);
+int  vdrive_bam_free(vdrive_image_t *image, unsigned int track, unsigned int sector);
+unsigned int vdrive_bam_blocks_free(vdrive_image_t *image);
+int  vdrive_image_format(vdrive_image_t *image, const unsigned char *name, size_t name_length, const unsigned char *id);
+unsigned char *vdrive_image_find_file(vdrive_image_t *image, const unsigned char *pattern, size_t pattern_length);
+int  vdrive_image_read_chain(vdrive_image_t *image, unsigned int track, unsigned int sector,
+                             unsigned char **chain, unsigned int *blocks);
+int  vdrive_image_load_file(vdrive_image_t *image, unsigned int track, unsigned int sector,
+                            unsigned char **data, size_t *length);
+int  vdrive_image_save_file(vdrive_image_t *image, const unsigned char *name, size_t name_length,
+                            unsigned char file_type, int replace, const unsigned char *data, size_t length);
+int  vdrive_image_scratch(vdrive_image_t *image, const unsigned char *pattern, size_t pattern_length);
+int  vdrive_image_rename(vdrive_image_t *image, const unsigned char *new_name, size_t new_length,
+                         const unsigned char *old_name, size_t old_length);
+int  vdrive_image_directory(vdrive_image_t *image, unsigned char **data, size_t *length);
+int  vdrive_name_match(const unsigned char *pattern, size_t pattern_length, const unsigned char *name);
+
+/* dos.c */
+void vdrive_dos_reset(vdrive_t *vd);
+void vdrive_dos_set_status(vdrive_t *vd, int status, unsigned int track, unsigned int sector);
+int  vdrive_dos_listen(vdrive_t *vd, unsigned char sa);
+int  vdrive_dos_talk(vdrive_t *vd, unsigned char sa);
+int  vdrive_dos_open(vdrive_t *vd, unsigned char sa);
+int  vdrive_dos_close(vdrive_t *vd, unsigned char sa);
+int  vdrive_dos_unlisten(vdrive_t *vd);
+int  vdrive_dos_untalk(vdrive_t *vd);
+int  vdrive_dos_write(vdrive_t *vd, const unsigned char *data, size_t count);
+int  vdrive_dos_append(vdrive_t *vd, unsigned char sa, const unsigned char *data, size_t count);
+int  vdrive_dos_find_channel(vdrive_t *vd, enum vdrive_channel_mode_e mode);
+int  vdrive_dos_read(vdrive_t *vd, unsigned char *data, size_t count);
+
+/* turbo.c */
+void vdrive_turbo_start(vdrive_t *vd, unsigned int address, const unsigned char *param, size_t param_length);
+void vdrive_turbo_stop(vdrive_t *vd);
+int  vdrive_turbo_write(vdrive_t *vd, int unit, const unsigned char *data, size_t count);
+int  vdrive_turbo_read(vdrive_t *vd, int unit, unsigned char *data, size_t count);
+int  vdrive_turbo_lines(vdrive_t *vd);
+int  vdrive_turbo_wait(vdrive_t *vd, int line, int state);
+void vdrive_gcr_encode(const unsigned char *block, unsigned char *gcr);
+int  vdrive_gcr_decode(const unsigned char *gcr, unsigned char *block);
+void vdrive_gcr_encode_group(const unsigned char *in, unsigned char *out);
+int  vdrive_gcr_decode_group(const unsigned char *in, unsigned char *out);
+
+/* cpu6502.c */
+void vdrive_cpu_reset(vdrive_cpu_t *cpu);
+int  vdrive_cpu_step(vdrive_cpu_t *cpu);
+void vdrive_cpu_set_overflow(vdrive_cpu_t *cpu);
+
+/* via6522.c */
+void vdrive_via_reset(vdrive_via_t *via);
+unsigned char vdrive_via_read(vdrive_via_t *via, unsigned int reg);
+void vdrive_via_write(vdrive_via_t *via, unsigned int reg, unsigned char value);
+void vdrive_via_clock(vdrive_via_t *via, int cycles);
+void vdrive_via_set_ca1(vdrive_via_t *via, int level);
+int  vdrive_via_irq(const vdrive_via_t *via);
+unsigned char vdrive_via_port_a(const vdrive_via_t *via);
+unsigned char vdrive_via_port_b(const vdrive_via_t *via);
+
+/* machine.c */
+int  vdrive_machine_open(vdrive_t *vd, const char *rom_file, const char *g64_file);
+void vdrive_machine_close(vdrive_t *vd);
+int  vdrive_machine_flush(vdrive_t *vd);
+void vdrive_machine_reset(vdrive_t *vd);
+int  vdrive_machine_atn_write(vdrive_t *vd, const unsigned char *data, size_t count, int talk);
+int  vdrive_machine_raw_write(vdrive_t *vd, const unsigned char *data, size_t count);
+int  vdrive_machine_raw_read(vdrive_t *vd, unsigned char *data, size_t count);
+int  vdrive_machine_iec_poll(vdrive_t *vd);
+void vdrive_machine_iec_setrelease(vdrive_t *vd, int set, int release);
+int  vdrive_machine_iec_wait(vdrive_t *vd, int line, int state);
+unsigned char vdrive_machine_pp_read(vdrive_t *vd);
+void vdrive_machine_pp_write(vdrive_t *vd, unsigned char value);
+int  vdrive_machine_read_n(vdrive_t *vd, enum vdrive_proto_e proto, int unit, unsigned char *data, size_t count);
+int  vdrive_machine_write_n(vdrive_t *vd, enum vdrive_proto_e proto, int unit, const unsigned char *data, size_t count);
+
+/* archlib.c */
+void vdrive_dbg(int level, char *msg, ...);
+void vdrive_latency(vdrive_t *vd, enum vdrive_proto_e proto, size_t bytes);
+
+#endif /* #ifndef VDRIVE_H */
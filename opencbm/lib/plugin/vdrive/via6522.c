@@ -0,0 +1,235 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version
+ *  2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 The OpenCBM project
+ */
+
+/*! **************************************************************
+** \file lib/plugin/vdrive/via6522.c \n
+** \n
+** \brief Image backed virtual drive: 6522 VIA
+**
+** Ports, both timers, the interrupt logic and the CA1 edge input
+** are emulated; that is what the drive ROM and the transfer
+** routines use. The shift register only holds its value.
+**
+****************************************************************/
+
+#include <string.h>
+
+#include "vdrive.h"
+
+#define VIA_IFR_CA2     0x01
+#define VIA_IFR_CA1     0x02
+#define VIA_IFR_SR      0x04
+#define VIA_IFR_CB2     0x08
+#define VIA_IFR_CB1     0x10
+#define VIA_IFR_T2      0x20
+#define VIA_IFR_T1      0x40
+
+/*! \brief Power on state of a VIA: all ports inputs, IRQs disabled */
+void
+vdrive_via_reset(vdrive_via_t *via)
+{
+    unsigned char pa_in = via->pa_in, pb_in = via->pb_in;
+
+    memset(via, 0, sizeof(*via));
+    via->pa_in      = pa_in;
+    via->pb_in      = pb_in;
+    via->t1_counter = 0xffff;
+    via->t1_latch   = 0xffff;
+    via->t2_counter = 0xffff;
+}
+
+/*! \brief The level of the port A pins */
+unsigned char
+vdrive_via_port_a(const vdrive_via_t *via)
+{
+    return (unsigned char) ((via->ora & via->ddra) | (via->pa_in & ~via->ddra));
+}
+
+/*! \brief The level of the port B pins */
+unsigned char
+vdrive_via_port_b(const vdrive_via_t *via)
+{
+    return (unsigned char) ((via->orb & via->ddrb) | (via->pb_in & ~via->ddrb));
+}
+
+/*! \brief Read a register; reading may acknowledge interrupts */
+unsigned char
+vdrive_via_read(vdrive_via_t *via, unsigned int reg)
+{
+    switch(reg & 0x0f)
+    {
+        case 0x0:
+            via->ifr &= ~(VIA_IFR_CB1 | VIA_IFR_CB2);
+            return vdrive_via_port_b(via);
+        case 0x1:
+            via->ifr &= ~(VIA_IFR_CA1 | VIA_IFR_CA2);
+            /* fall through */
+        case 0xf:
+            return vdrive_via_port_a(via);
+        case 0x2:
+            return via->ddrb;
+        case 0x3:
+            return via->ddra;
+        case 0x4:
+            via->ifr &= ~VIA_IFR_T1;
+            return (unsigned char) via->t1_counter;
+        case 0x5:
+            return (unsigned char) (via->t1_counter >> 8);
+        case 0x6:
+            return (unsigned char) via->t1_latch;
+        case 0x7:
+            return (unsigned char) (via->t1_latch >> 8);
+        case 0x8:
+            via->ifr &= ~VIA_IFR_T2;
+            return (unsigned char) via->t2_counter;
+        case 0x9:
+            return (unsigned char) (via->t2_counter >> 8);
+        case 0xa:
+            via->ifr &= ~VIA_IFR_SR;
+            return via->sr;
+        case 0xb:
+            return via->acr;
+        case 0xc:
+            return via->pcr;
+        case 0xd:
+            return (unsigned char) (via->ifr | (vdrive_via_irq(via) ? 0x80 : 0));
+        default: /* 0xe */
+            return (unsigned char) (via->ier | 0x80);
+    }
+}
+
+/*! \brief Write a register */
+void
+vdrive_via_write(vdrive_via_t *via, unsigned int reg, unsigned char value)
+{
+    switch(reg & 0x0f)
+    {
+        case 0x0:
+            via->ifr &= ~(VIA_IFR_CB1 | VIA_IFR_CB2);
+            via->orb = value;
+            break;
+        case 0x1:
+            via->ifr &= ~(VIA_IFR_CA1 | VIA_IFR_CA2);
+            /* fall through */
+        case 0xf:
+            via->ora = value;
+            break;
+        case 0x2:
+            via->ddrb = value;
+            break;
+        case 0x3:
+            via->ddra = value;
+            break;
+        case 0x4:
+        case 0x6:
+            via->t1_latch = (unsigned short) ((via->t1_latch & 0xff00) | value);
+            break;
+        case 0x5:
+            via->t1_latch   = (unsigned short) ((via->t1_latch & 0x00ff) | (value << 8));
+            via->t1_counter = via->t1_latch;
+            via->t1_armed   = 1;
+            via->ifr &= ~VIA_IFR_T1;
+            break;
+        case 0x7:
+            via->t1_latch = (unsigned short) ((via->t1_latch & 0x00ff) | (value << 8));
+            via->ifr &= ~VIA_IFR_T1;
+            break;
+        case 0x8:
+            via->t2_latch_lo = value;
+            break;
+        case 0x9:
+            via->t2_counter = via->t2_latch_lo | (value << 8);
+            via->t2_armed   = 1;
+            via->ifr &= ~VIA_IFR_T2;
+            break;
+        case 0xa:
+            via->ifr &= ~VIA_IFR_SR;
+            via->sr = value;
+            break;
+        case 0xb:
+            via->acr = value;
+            break;
+        case 0xc:
+            via->pcr = value;
+            break;
+        case 0xd:
+            via->ifr &= ~value;
+            break;
+        default: /* 0xe */
+            if(value & 0x80)
+            {
+                via->ier |= value & 0x7f;
+            }
+            else
+            {
+                via->ier &= ~value;
+            }
+            break;
+    }
+}
+
+/*! \brief Let the timers run for some cycles */
+void
+vdrive_via_clock(vdrive_via_t *via, int cycles)
+{
+    via->t1_counter -= cycles;
+    while(via->t1_counter < 0)
+    {
+        if(via->t1_armed)
+        {
+            via->ifr |= VIA_IFR_T1;
+        }
+        if(via->acr & 0x40)
+        {
+            /* free running: reload from the latch (N + 2 cycles period) */
+            via->t1_counter += via->t1_latch + 2;
+        }
+        else
+        {
+            via->t1_armed = 0;
+            via->t1_counter += 0x10000;
+        }
+    }
+
+    if(!(via->acr & 0x20))
+    {
+        via->t2_counter -= cycles;
+        while(via->t2_counter < 0)
+        {
+            if(via->t2_armed)
+            {
+                via->ifr |= VIA_IFR_T2;
+                via->t2_armed = 0;
+            }
+            via->t2_counter += 0x10000;
+        }
+    }
+}
+
+/*! \brief Change the level of the CA1 input; the active edge is selected in the PCR */
+void
+vdrive_via_set_ca1(vdrive_via_t *via, int level)
+{
+    level = level ? 1 : 0;
+    if(level != via->ca1)
+    {
+        if(level == (via->pcr & 0x01))
+        {
+            via->ifr |= VIA_IFR_CA1;
+        }
+        via->ca1 = level;
+    }
+}
+
+/*! \brief State of the IRQ output */
+int
+vdrive_via_irq(const vdrive_via_t *via)
+{
+    return (via->ifr & via->ier & 0x7f) != 0;
+}
@@ -438,6 +438,233 @@ opencbm_plugin_untalk(CBM_FILE HandleDevice)
 }
 
 
+/*! \internal \brief Get the command bytes of a batch operation
+
+ \param Operation
+   The operation.
+
+ \param ModeFlags
+   Receives the protocol flags to send the bytes with.
+
+ \param Buffer
+   Buffer of at least 2 bytes, used for the ATN commands.
+
+ \param Data
+   Receives a pointer to the bytes to send.
+
+ \return
+   The number of bytes to send. For raw_read, the number of bytes
+   to read.
+*/
+
+static size_t
+batch_op_data(const opencbm_plugin_batch_op_t *Operation, unsigned char *ModeFlags,
+              unsigned char *Buffer, const unsigned char **Data)
+{
+    *ModeFlags = XUM1541_CBM | XUM_WRITE_ATN;
+    *Data = Buffer;
+
+    switch (Operation->Operation)
+    {
+    case opencbm_batch_listen:
+        Buffer[0] = 0x20 | Operation->DeviceAddress;
+        Buffer[1] = 0x60 | Operation->SecondaryAddress;
+        return 2;
+
+    case opencbm_batch_talk:
+        *ModeFlags = XUM1541_CBM | XUM_WRITE_ATN | XUM_WRITE_TALK;
+        Buffer[0] = 0x40 | Operation->DeviceAddress;
+        Buffer[1] = 0x60 | Operation->SecondaryAddress;
+        return 2;
+
+    case opencbm_batch_unlisten:
+        Buffer[0] = 0x3f;
+        return 1;
+
+    case opencbm_batch_untalk:
+        Buffer[0] = 0x5f;
+        return 1;
+
+    case opencbm_batch_raw_write:
+        *ModeFlags = XUM1541_CBM;
+        *Data = Operation->Buffer;
+        return Operation->Count;
+
+    default:
+        *ModeFlags = XUM1541_CBM;
+        *Data = NULL;
+        return Operation->Count;
+    }
+}
+
+/*! \brief Execute a batch of IEC operations
+
+ Several operations are sent to the xum1541 in one USB transfer,
+ which saves a round trip for every operation. After a listen or
+ talk, the transfer ends, as the following operations must not be
+ executed if it failed.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Operations
+   Pointer to the operations to execute. The Result member is filled
+   in for each executed operation.
+
+ \param Count
+   The number of operations
+
+ \return
+   The number of operations executed successfully, or -1 if the
+   firmware cannot execute batches.
+
+ If cbm_driver_open() did not succeed, it is illegal to 
+ call this function.
+*/
+
+int CBMAPIDECL
+opencbm_plugin_batch(CBM_FILE HandleDevice, opencbm_plugin_batch_op_t *Operations, unsigned int Count)
+{
+    usb_dev_handle *handle = (usb_dev_handle *)HandleDevice;
+    opencbm_plugin_batch_op_t *op;
+    unsigned char cmdBuf[XUM_BATCH_SIZE], atnBuf[2], modeFlags;
+    const unsigned char *data;
+    unsigned int first, last, executed, i;
+    size_t len, size, needed;
+    int failed, ret;
+
+    // Without framed writes, the data of a write cannot follow its command
+    if ((xum1541_capabilities(handle) & XUM1541_CAP_FRAMED) == 0)
+        return -1;
+
+    failed = 0;
+    executed = 0;
+    for (first = 0; first < Count && !failed; first = last)
+    {
+        // Collect as many operations as fit into one transfer
+
+        len = 0;
+        for (last = first; last < Count; )
+        {
+            op = &Operations[last];
+            size = batch_op_data(op, &modeFlags, atnBuf, &data);
+
+            needed = XUM_CMDBUF_SIZE;
+            if (op->Operation != opencbm_batch_raw_read)
+                needed += size;
+            if (len + needed > sizeof(cmdBuf))
+                break;
+
+            len += xum1541_build_cmd(&cmdBuf[len],
+                (unsigned char) (op->Operation == opencbm_batch_raw_read ? XUM1541_READ : XUM1541_WRITE),
+                modeFlags, data, size);
+            last++;
+
+            if (op->Operation == opencbm_batch_listen || op->Operation == opencbm_batch_talk)
+                break;
+        }
+
+        if (last == first)
+        {
+            // This one is too big to be batched, execute it on its own
+
+            op = &Operations[last++];
+            if (op->Operation == opencbm_batch_raw_write)
+                op->Result = opencbm_plugin_raw_write(HandleDevice, op->Buffer, op->Count);
+            else
+                op->Result = opencbm_plugin_raw_read(HandleDevice, op->Buffer, op->Count);
+
+            if (op->Result < 0)
+                break;
+            executed = last;
+            continue;
+        }
+
+        ret = xum1541_send_cmds(handle, cmdBuf, len);
+        if (ret < 0)
+            return (first == 0) ? -1 : (int) executed;
+
+        // Collect the responses in the order the commands were sent.
+        // Once an operation failed, the rest only has to be drained.
+
+        for (i = first; i < last; i++)
+        {
+            op = &Operations[i];
+
+            if (op->Operation == opencbm_batch_raw_read)
+                ret = xum1541_read_data(handle, op->Buffer, op->Count);
+            else
+                ret = xum1541_wait_status(handle);
+
+            switch (op->Operation)
+            {
+            case opencbm_batch_raw_write:
+            case opencbm_batch_raw_read:
+                op->Result = ret;
+                break;
+
+            default:
+                op->Result = !ret;
+                break;
+            }
+
+            if (failed)
+            {
+                op->Result = -1;
+            }
+            else if (op->Result < 0 || (op->Result != 0 &&
+                     (op->Operation == opencbm_batch_listen || op->Operation == opencbm_batch_talk)))
+            {
+                failed = 1;
+            }
+            else
+            {
+                executed = i + 1;
+            }
+        }
+    }
+
+    return (int) executed;
+}
+
+
+/*! \brief Read the error channel of a device
+
+ The xum1541 does the talk, the read and the untalk on its own, so
+ this takes only one round trip.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param DeviceAddress
+   The address of the device on the IEC serial bus.
+
+ \param Buffer
+   Pointer to a buffer which receives the status.
+
+ \param BufferLength
+   The size of Buffer, in bytes.
+
+ \return
+   The number of bytes read, -2 if the device did not talk, or -1
+   if the firmware cannot read the status this way.
+
+ If cbm_driver_open() did not succeed, it is illegal to 
+ call this function.
+*/
+
+int CBMAPIDECL
+opencbm_plugin_device_status(CBM_FILE HandleDevice, unsigned char DeviceAddress, void *Buffer, size_t BufferLength)
+{
+    int ret;
+
+    ret = xum1541_device_status((usb_dev_handle *)HandleDevice, DeviceAddress, Buffer, BufferLength);
+    if (ret < 0 && ret != -2)
+        ret = -1;
+    return ret;
+}
+
+
 /*! \brief Get EOI flag after bus read
 
  This function gets the EOI ("End of Information") flag 
@@ -260,3 +260,76 @@ opencbm_plugin_nib_write_n(CBM_FILE HandleDevice, const unsigned char *data, uns
 {
     return xum1541_write((usb_dev_handle *)HandleDevice, XUM1541_NIB, data, size);
 }
+
+/*! \brief Load an IEC micro-sequence
+
+  \param HandleDevice
+    A CBM_FILE which contains the file handle of the driver.
+
+  \param program
+    Pointer to the IEC_SEQ_* program. The encoding is the same as the
+    firmware's XUM_SEQ_* one, so it is passed on unchanged.
+
+  \param size
+    The length of the program.
+
+  \return
+    0 on success, -1 if the firmware rejected the program or does not
+    support micro-sequences.
+*/
+int CBMAPIDECL
+opencbm_plugin_iec_seq_load(CBM_FILE HandleDevice, const unsigned char *program, unsigned int size)
+{
+    int status, written;
+
+    if ((xum1541_capabilities((usb_dev_handle *)HandleDevice) & XUM1541_CAP_SEQ) == 0 || size > XUM_SEQ_MAX_SIZE)
+        return -1;
+
+    if (xum1541_write_ext((usb_dev_handle *)HandleDevice, XUM1541_SEQ_LOAD,
+        program, size, &status, &written) != 1 || status != (int) size)
+        return -1;
+
+    return 0;
+}
+
+/*! \brief Read data with the loaded IEC micro-sequence
+
+  \param HandleDevice
+    A CBM_FILE which contains the file handle of the driver.
+
+  \param data
+    Pointer to the data buffer which will hold the read bytes.
+
+  \param size
+    The size of the data buffer the read bytes will be written to.
+
+  \return
+    The number of bytes actually read, 0 on device error. If there is a
+    fatal error, returns -1.
+*/
+int CBMAPIDECL
+opencbm_plugin_iec_seq_read_n(CBM_FILE HandleDevice, unsigned char *data, unsigned int size)
+{
+    return xum1541_read((usb_dev_handle *)HandleDevice, XUM1541_SEQ, data, size);
+}
+
+/*! \brief Write data with the loaded IEC micro-sequence
+
+  \param HandleDevice
+    A CBM_FILE which contains the file handle of the driver.
+
+  \param data
+    Pointer to the data buffer to be written
+
+  \param size
+    The size of the data buffer to be written
+
+  \return
+    The number of bytes actually written, 0 on device error. If there is a
+    fatal error, returns -1.
+*/
+int CBMAPIDECL
+opencbm_plugin_iec_seq_write_n(CBM_FILE HandleDevice, const unsigned char *data, unsigned int size)
+{
+    return xum1541_write((usb_dev_handle *)HandleDevice, XUM1541_SEQ, data, size);
+}
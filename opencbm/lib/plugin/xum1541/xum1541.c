@@ -43,7 +43,57 @@
 
 static int debug_level = -1; /*!< \internal \brief the debugging level for debugging output */
 
-unsigned char DeviceDriveMode; // Temporary disk/tape mode hack until usb device handle context is there.
+/*! \internal \brief The state of one opened xum1541
+
+ Several xum1541 can be opened at the same time, each with its own
+ disk/tape mode and capabilities.
+*/
+typedef struct xum1541_device_s {
+    usb_dev_handle *Handle;         /*!< the USB handle of the device */
+    int DriveMode;                  /*!< one of the DeviceDriveMode_... values */
+    unsigned char Capabilities;     /*!< the capabilities reported by XUM1541_INIT */
+    struct xum1541_device_s *Next;  /*!< the next opened device */
+} xum1541_device_t;
+
+static xum1541_device_t *xum1541_devices; /*!< \internal \brief all opened devices */
+
+/*! \internal \brief The state of a device that is not (yet) opened */
+static xum1541_device_t xum1541_no_device = { NULL, DeviceDriveMode_Uninit, 0, NULL };
+
+/*! \internal \brief Get the state of an opened xum1541
+
+ \param HandleXum1541
+   A XUM1541_HANDLE which contains the file handle of the USB device.
+
+ \return
+   The state of the device. If it is not opened, a state with no mode
+   set and no capabilities.
+*/
+static xum1541_device_t *
+xum1541_device(usb_dev_handle *HandleXum1541)
+{
+    xum1541_device_t *device;
+
+    for (device = xum1541_devices; device != NULL; device = device->Next) {
+        if (device->Handle == HandleXum1541)
+            return device;
+    }
+    return &xum1541_no_device;
+}
+
+/*! \brief Get the capabilities of an opened xum1541
+
+ \param HandleXum1541
+   A XUM1541_HANDLE which contains the file handle of the USB device.
+
+ \return
+   The XUM1541_CAP_... flags the firmware reported when it was opened.
+*/
+unsigned char
+xum1541_capabilities(usb_dev_handle *HandleXum1541)
+{
+    return xum1541_device(HandleXum1541)->Capabilities;
+}
 
 /*! \internal \brief Output debugging information for the xum1541
 
@@ -316,9 +366,9 @@ xum1541_check_version(int version)
 {
     xum1541_dbg(0, "firmware version %d, library version %d", version,
         XUM1541_VERSION);
-    if (version < XUM1541_VERSION) {
+    if (version < XUM1541_VERSION_MIN) {
         fprintf(stderr, "xum1541 firmware version too low (%d < %d)\n",
-            version, XUM1541_VERSION);
+            version, XUM1541_VERSION_MIN);
         fprintf(stderr, "please update your xum1541 firmware\n");
         return -1;
     } else if (version > XUM1541_VERSION) {
@@ -437,10 +487,8 @@ int
 xum1541_init(usb_dev_handle **HandleXum1541, int PortNumber)
 {
     unsigned char devInfo[XUM_DEVINFO_SIZE], devStatus;
-    int len;
-
-    // Place after "xum1541_usb_handle" allocation:
-    /*uh->*/DeviceDriveMode = DeviceDriveMode_Uninit;
+    xum1541_device_t *device;
+    int len, driveMode;
 
     xum1541_enumerate(HandleXum1541, PortNumber);
 
@@ -500,21 +548,38 @@ xum1541_init(usb_dev_handle **HandleXum1541, int PortNumber)
 	{
 		if (devInfo[2] & XUM1541_TAPE_PRESENT)
 		{
-			/*uh->*/DeviceDriveMode = DeviceDriveMode_Tape;
+			driveMode = DeviceDriveMode_Tape;
             xum1541_dbg(1, "[xum1541_init] Tape supported, tape mode entered.");
 		}
 		else
 		{
-			/*uh->*/DeviceDriveMode = DeviceDriveMode_Disk;
+			driveMode = DeviceDriveMode_Disk;
             xum1541_dbg(1, "[xum1541_init] Tape supported, disk mode entered.");
 		}
 	}
 	else
 	{
-		DeviceDriveMode = (unsigned char) DeviceDriveMode_NoTapeSupport;
+		driveMode = DeviceDriveMode_NoTapeSupport;
         xum1541_dbg(1, "[xum1541_init] No tape support.");
 	}
 
+    // Remember the state of this device
+    device = malloc(sizeof(*device));
+    if (device == NULL) {
+        fprintf(stderr, "out of memory\n");
+        xum1541_close(*HandleXum1541);
+        return -1;
+    }
+    device->Handle = *HandleXum1541;
+    device->DriveMode = driveMode;
+    device->Capabilities = devInfo[1];
+    if (devInfo[0] < 8) {
+        // Older firmware may have used these bits for something else
+        device->Capabilities &= ~XUM1541_CAP_VERSION_8;
+    }
+    device->Next = xum1541_devices;
+    xum1541_devices = device;
+
     return 0;
 }
 /*! \brief close the xum1541 device
@@ -528,10 +593,20 @@ xum1541_init(usb_dev_handle **HandleXum1541, int PortNumber)
 void
 xum1541_close(usb_dev_handle *HandleXum1541)
 {
+    xum1541_device_t **pprev, *device;
     int ret;
 
     xum1541_dbg(0, "Closing USB link");
 
+    for (pprev = &xum1541_devices; *pprev != NULL; pprev = &(*pprev)->Next) {
+        if ((*pprev)->Handle == HandleXum1541) {
+            device = *pprev;
+            *pprev = device->Next;
+            free(device);
+            break;
+        }
+    }
+
     ret = usb.control_msg(HandleXum1541, USB_TYPE_CLASS | USB_ENDPOINT_OUT,
         XUM1541_SHUTDOWN, 0, 0, NULL, 0, 1000);
     if (ret < 0) {
@@ -576,7 +651,16 @@ xum1541_control_msg(usb_dev_handle *HandleXum1541, unsigned int cmd)
     return nBytes;
 }
 
-static int
+/*! \brief Wait for the status of a command from the xum1541 device
+
+ \param HandleXum1541
+   A XUM1541_HANDLE which contains the file handle of the USB device.
+
+ \return
+   The extended status value sent by the device, or -1 if the device
+   reported an error.
+*/
+int
 xum1541_wait_status(usb_dev_handle *HandleXum1541)
 {
     int nBytes, deviceBusy, ret;
@@ -625,7 +709,7 @@ xum1541_wait_status(usb_dev_handle *HandleXum1541)
 // Checks if xum1541_ioctl/xum1541_read/xum1541_write command is allowed in currently set disk/tape mode.
 #define RefuseToWorkInWrongMode \
     {                                                                                                    \
-        if (/*uh->*/DeviceDriveMode == DeviceDriveMode_Uninit)                                               \
+        if (xum1541_device(HandleXum1541)->DriveMode == DeviceDriveMode_Uninit)                          \
         {                                                                                                \
             xum1541_dbg(1, "[RefuseToWorkInWrongMode] cmd blocked - No disk or tape mode set.");         \
             return XUM1541_Error_NoDiskTapeMode;                                                         \
@@ -633,13 +717,13 @@ xum1541_wait_status(usb_dev_handle *HandleXum1541)
                                                                                                          \
         if (isTapeCmd)                                                                                   \
         {                                                                                                \
-            if (/*uh->*/DeviceDriveMode == DeviceDriveMode_NoTapeSupport)                                \
+            if (xum1541_device(HandleXum1541)->DriveMode == DeviceDriveMode_NoTapeSupport)               \
             {                                                                                            \
                 xum1541_dbg(1, "[RefuseToWorkInWrongMode] cmd blocked - Firmware has no tape support."); \
                 return XUM1541_Error_NoTapeSupport;                                                      \
             }                                                                                            \
                                                                                                          \
-            if (/*uh->*/DeviceDriveMode == DeviceDriveMode_Disk)                                             \
+            if (xum1541_device(HandleXum1541)->DriveMode == DeviceDriveMode_Disk)                        \
             {                                                                                            \
                 xum1541_dbg(1, "[RefuseToWorkInWrongMode] cmd blocked - Tape cmd in disk mode.");        \
                 return XUM1541_Error_TapeCmdInDiskMode;                                                  \
@@ -647,7 +731,7 @@ xum1541_wait_status(usb_dev_handle *HandleXum1541)
         }                                                                                                \
         else /*isDiskCmd*/                                                                               \
         {                                                                                                \
-            if (/*uh->*/DeviceDriveMode == DeviceDriveMode_Tape)                                             \
+            if (xum1541_device(HandleXum1541)->DriveMode == DeviceDriveMode_Tape)                        \
             {                                                                                            \
                 xum1541_dbg(1, "[RefuseToWorkInWrongMode] cmd blocked - Disk cmd in tape mode.");        \
                 return XUM1541_Error_DiskCmdInTapeMode;                                                  \
@@ -749,8 +833,8 @@ int
 xum1541_write(usb_dev_handle *HandleXum1541, unsigned char modeFlags, const unsigned char *data, size_t size)
 {
     int wr, mode, ret;
-    size_t bytesWritten, bytes2write;
-    unsigned char cmdBuf[XUM_CMDBUF_SIZE];
+    size_t bytesWritten, bytes2write, framed;
+    unsigned char cmdBuf[XUM_CMDBUF_SIZE + XUM_FRAMED_DATA_SIZE];
     BOOL isTapeCmd = ((modeFlags == XUM1541_TAP) || (modeFlags == XUM1541_TAP_CONFIG));
 
     mode = modeFlags & 0xf0;
@@ -759,6 +843,19 @@ xum1541_write(usb_dev_handle *HandleXum1541, unsigned char modeFlags, const unsi
 
     RefuseToWorkInWrongMode; // Check if command allowed in current disk/tape mode.
 
+    /*
+     * If the firmware allows it, send the start of the data in the same
+     * transfer as the command block. The tape code handles stalls on the
+     * data transfer itself, so keep it separate there.
+     */
+    framed = 0;
+    if ((xum1541_capabilities(HandleXum1541) & XUM1541_CAP_FRAMED) != 0 && !isTapeCmd) {
+        framed = size;
+        if (framed > XUM_FRAMED_DATA_SIZE)
+            framed = XUM_FRAMED_DATA_SIZE;
+        memcpy(cmdBuf + XUM_CMDBUF_SIZE, data, framed);
+    }
+
     // Send the write command
     cmdBuf[0] = XUM1541_WRITE;
     cmdBuf[1] = modeFlags;
@@ -766,14 +863,18 @@ xum1541_write(usb_dev_handle *HandleXum1541, unsigned char modeFlags, const unsi
     cmdBuf[3] = (size >> 8) & 0xff;
     wr = usb.bulk_write(HandleXum1541,
         XUM_BULK_OUT_ENDPOINT | USB_ENDPOINT_OUT,
-        (char *)cmdBuf, sizeof(cmdBuf), LIBUSB_NO_TIMEOUT);
+        (char *)cmdBuf, XUM_CMDBUF_SIZE + framed, LIBUSB_NO_TIMEOUT);
     if (wr < 0) {
         fprintf(stderr, "USB error in write cmd: %s\n",
             usb.strerror());
         return -1;
     }
 
-    bytesWritten = 0;
+    if (framed != 0) {
+        xum1541_print_data(2, "wrote", data, framed);
+        data += framed;
+    }
+    bytesWritten = framed;
     while (bytesWritten < size) {
         bytes2write = size - bytesWritten;
         if (bytes2write > XUM_MAX_XFER_SIZE)
@@ -874,15 +975,15 @@ xum1541_read_ext(usb_dev_handle *HandleXum1541, unsigned char mode, unsigned cha
     return 1;
 }
 
-/*! \brief Read data from the xum1541 device
+/*! \brief Read the data phase of a read command from the xum1541 device
+
+ This reads the data the xum1541 sends back after a XUM1541_READ
+ command block. Use xum1541_read() unless the command block has
+ already been sent with xum1541_send_cmds().
 
  \param HandleXum1541
    A XUM1541_HANDLE which contains the file handle of the USB device.
 
- \param mode
-    Drive protocol to use to read the data from the device (e.g,
-    XUM1541_CBM is normal IEC wire protocol).
-
  \param data
     Pointer to a buffer which will contain the data read from the xum1541
 
@@ -894,33 +995,18 @@ xum1541_read_ext(usb_dev_handle *HandleXum1541, unsigned char mode, unsigned cha
     fatal error, returns -1.
 */
 int
-xum1541_read(usb_dev_handle *HandleXum1541, unsigned char mode, unsigned char *data, size_t size)
+xum1541_read_data(usb_dev_handle *HandleXum1541, unsigned char *data, size_t size)
 {
     int rd;
     size_t bytesRead, bytes2read;
-    unsigned char cmdBuf[XUM_CMDBUF_SIZE];
-    BOOL isTapeCmd = ((mode == XUM1541_TAP) || (mode == XUM1541_TAP_CONFIG));
-
-    xum1541_dbg(1, "read %d %d bytes to address %p",
-               mode, size, data);
 
-    RefuseToWorkInWrongMode; // Check if command allowed in current disk/tape mode.
-
-    // Send the read command
-    cmdBuf[0] = XUM1541_READ;
-    cmdBuf[1] = mode;
-    cmdBuf[2] = size & 0xff;
-    cmdBuf[3] = (size >> 8) & 0xff;
-    rd = usb.bulk_write(HandleXum1541,
-        XUM_BULK_OUT_ENDPOINT | USB_ENDPOINT_OUT,
-        (char *)cmdBuf, sizeof(cmdBuf), LIBUSB_NO_TIMEOUT);
-    if (rd < 0) {
-        fprintf(stderr, "USB error in read cmd: %s\n",
-            usb.strerror());
-        return -1;
-    }
-
-    // Read the actual data now that it's ready.
+    /*
+     * The reads are synchronous: libusb 0.1 has no asynchronous
+     * transfers on Linux and macOS. The IN endpoint is only left
+     * unprimed between two chunks of XUM_MAX_XFER_SIZE bytes, not
+     * between the packets of one chunk. Overlapping the chunks as well
+     * would need the plugin ported to libusb-1.0.
+     */
     bytesRead = 0;
     while (bytesRead < size) {
         bytes2read = size - bytesRead;
@@ -948,6 +1034,223 @@ xum1541_read(usb_dev_handle *HandleXum1541, unsigned char mode, unsigned char *d
             break;
     }
 
-    xum1541_dbg(2, "read done, got %d bytes", bytesRead);
     return bytesRead;
 }
+
+/*! \brief Build a command block, for sending it with xum1541_send_cmds()
+
+ For XUM1541_WRITE, the data is appended to the command block, which
+ requires XUM1541_CAP_FRAMED.
+
+ \param cmdBuf
+    Pointer to the buffer which receives the command block. It must have
+    room for XUM_CMDBUF_SIZE bytes, plus size bytes for XUM1541_WRITE.
+
+ \param cmd
+    XUM1541_READ or XUM1541_WRITE
+
+ \param modeFlags
+    Drive protocol and flags, as for xum1541_read() or xum1541_write()
+
+ \param data
+    For XUM1541_WRITE, the data to write; else, ignored.
+
+ \param size
+    The number of bytes to read or write
+
+ \return
+    The number of bytes used in cmdBuf
+*/
+size_t
+xum1541_build_cmd(unsigned char *cmdBuf, unsigned char cmd, unsigned char modeFlags, const unsigned char *data, size_t size)
+{
+    cmdBuf[0] = cmd;
+    cmdBuf[1] = modeFlags;
+    cmdBuf[2] = size & 0xff;
+    cmdBuf[3] = (size >> 8) & 0xff;
+    if (cmd != XUM1541_WRITE)
+        return XUM_CMDBUF_SIZE;
+
+    memcpy(cmdBuf + XUM_CMDBUF_SIZE, data, size);
+    return XUM_CMDBUF_SIZE + size;
+}
+
+/*! \brief Send several command blocks to the xum1541 in one transfer
+
+ The firmware executes the commands one after the other. The caller
+ then has to collect the responses in the same order: the status for
+ every XUM1541_CBM write (xum1541_wait_status()) and the data for
+ every read (xum1541_read_data()).
+
+ The commands must fit into one USB packet (XUM_BATCH_SIZE bytes);
+ otherwise, the firmware could block sending a response while the
+ rest of the transfer is still pending.
+
+ \param HandleXum1541
+   A XUM1541_HANDLE which contains the file handle of the USB device.
+
+ \param cmds
+    The command blocks, as built with xum1541_build_cmd()
+
+ \param len
+    The length of cmds
+
+ \return
+    0 on success. If there is a fatal error, returns -1. If the xum1541
+    is not in disk mode, returns a (negative) XUM1541_Error_... value.
+*/
+int
+xum1541_send_cmds(usb_dev_handle *HandleXum1541, const unsigned char *cmds, size_t len)
+{
+    int wr;
+    BOOL isTapeCmd = FALSE;
+
+    xum1541_dbg(1, "send %d bytes of commands", len);
+
+    RefuseToWorkInWrongMode; // Check if command allowed in current disk/tape mode.
+
+    wr = usb.bulk_write(HandleXum1541,
+        XUM_BULK_OUT_ENDPOINT | USB_ENDPOINT_OUT,
+        (char *)cmds, len, LIBUSB_NO_TIMEOUT);
+    if (wr < 0) {
+        fprintf(stderr, "USB error in send cmds: %s\n",
+            usb.strerror());
+        return -1;
+    }
+
+    xum1541_print_data(2, "sent", cmds, len);
+    return 0;
+}
+
+/*! \brief Read the error channel of a device in one round trip
+
+ The xum1541 talks to the device, reads its status until EOI and
+ untalks it. The command block goes out in one transfer, and the
+ result comes back in one packet.
+
+ \param HandleXum1541
+   A XUM1541_HANDLE which contains the file handle of the USB device.
+
+ \param device
+    The address of the device on the IEC serial bus
+
+ \param data
+    Pointer to a buffer which will contain the status read
+
+ \param size
+    The size of data, in bytes. At most XUM_DEVSTATUS_MAX bytes are read.
+
+ \return
+    The number of bytes read. If the device did not talk, returns -2.
+    If the firmware cannot read the status this way or there is a fatal
+    error, returns -1.
+*/
+int
+xum1541_device_status(usb_dev_handle *HandleXum1541, unsigned char device, unsigned char *data, size_t size)
+{
+    int rd;
+    unsigned char cmdBuf[XUM_CMDBUF_SIZE];
+    unsigned char statusBuf[XUM_STATUSBUF_SIZE + XUM_DEVSTATUS_MAX];
+    BOOL isTapeCmd = FALSE;
+
+    xum1541_dbg(1, "device status %d, %d bytes to address %p",
+               device, size, data);
+
+    if ((xum1541_capabilities(HandleXum1541) & XUM1541_CAP_STATUS) == 0)
+        return -1;
+
+    RefuseToWorkInWrongMode; // Check if command allowed in current disk/tape mode.
+
+    if (size > XUM_DEVSTATUS_MAX)
+        size = XUM_DEVSTATUS_MAX;
+
+    cmdBuf[0] = XUM1541_DEVICE_STATUS;
+    cmdBuf[1] = device;
+    cmdBuf[2] = size & 0xff;
+    cmdBuf[3] = (size >> 8) & 0xff;
+    rd = usb.bulk_write(HandleXum1541,
+        XUM_BULK_OUT_ENDPOINT | USB_ENDPOINT_OUT,
+        (char *)cmdBuf, sizeof(cmdBuf), LIBUSB_NO_TIMEOUT);
+    if (rd < 0) {
+        fprintf(stderr, "USB error in device status cmd: %s\n",
+            usb.strerror());
+        return -1;
+    }
+
+    // The response is always shorter than a packet, so it is read at once
+    rd = usb.bulk_read(HandleXum1541,
+        XUM_BULK_IN_ENDPOINT | USB_ENDPOINT_IN,
+        (char *)statusBuf, sizeof(statusBuf), LIBUSB_NO_TIMEOUT);
+    if (rd < XUM_STATUSBUF_SIZE) {
+        fprintf(stderr, "USB error in device status: %s\n",
+            usb.strerror());
+        return -1;
+    }
+
+    xum1541_print_data(2, "status", statusBuf, rd);
+
+    if (XUM_GET_STATUS(statusBuf) != XUM1541_IO_READY)
+        return -2;
+
+    rd -= XUM_STATUSBUF_SIZE;
+    if (rd > XUM_GET_STATUS_VAL(statusBuf))
+        rd = XUM_GET_STATUS_VAL(statusBuf);
+    if (rd > (int)size)
+        rd = size;
+    memcpy(data, statusBuf + XUM_STATUSBUF_SIZE, rd);
+
+    xum1541_dbg(2, "device status done, got %d bytes", rd);
+    return rd;
+}
+
+/*! \brief Read data from the xum1541 device
+
+ \param HandleXum1541
+   A XUM1541_HANDLE which contains the file handle of the USB device.
+
+ \param mode
+    Drive protocol to use to read the data from the device (e.g,
+    XUM1541_CBM is normal IEC wire protocol).
+
+ \param data
+    Pointer to a buffer which will contain the data read from the xum1541
+
+ \param size
+    The number of bytes to read from the xum1541
+
+ \return
+    The number of bytes actually read, 0 on device error. If there is a
+    fatal error, returns -1.
+*/
+int
+xum1541_read(usb_dev_handle *HandleXum1541, unsigned char mode, unsigned char *data, size_t size)
+{
+    int rd;
+    unsigned char cmdBuf[XUM_CMDBUF_SIZE];
+    BOOL isTapeCmd = ((mode == XUM1541_TAP) || (mode == XUM1541_TAP_CONFIG));
+
+    xum1541_dbg(1, "read %d %d bytes to address %p",
+               mode, size, data);
+
+    RefuseToWorkInWrongMode; // Check if command allowed in current disk/tape mode.
+
+    // Send the read command
+    cmdBuf[0] = XUM1541_READ;
+    cmdBuf[1] = mode;
+    cmdBuf[2] = size & 0xff;
+    cmdBuf[3] = (size >> 8) & 0xff;
+    rd = usb.bulk_write(HandleXum1541,
+        XUM_BULK_OUT_ENDPOINT | USB_ENDPOINT_OUT,
+        (char *)cmdBuf, sizeof(cmdBuf), LIBUSB_NO_TIMEOUT);
+    if (rd < 0) {
+        fprintf(stderr, "USB error in read cmd: %s\n",
+            usb.strerror());
+        return -1;
+    }
+
+    // Read the actual data now that it's ready.
+    rd = xum1541_read_data(HandleXum1541, data, size);
+
+    xum1541_dbg(2, "read done, got %d bytes", rd);
+    return rd;
+}
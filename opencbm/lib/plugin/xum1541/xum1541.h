@@ -40,6 +40,12 @@ CTASSERT(sizeof(CBM_FILE) >= sizeof(usb_dev_handle *));
 // the maximum value for all allowed xum1541 serial numbers
 #define MAX_ALLOWED_XUM1541_SERIALNUM 255
 
+// the maximum number of data bytes sent along with a write command block
+#define XUM_FRAMED_DATA_SIZE 1024
+
+// the maximum size of several command blocks sent in one transfer (one packet)
+#define XUM_BATCH_SIZE 32
+
 // Disk/tape mode
 #define DeviceDriveMode_NoTapeSupport  -1 // Firmware has no tape support
 #define DeviceDriveMode_Uninit          0 // Uninitialized
@@ -50,6 +56,7 @@ const char *xum1541_device_path(int PortNumber);
 int xum1541_init(usb_dev_handle **HandleXum1541, int PortNumber);
 void xum1541_close(usb_dev_handle *HandleXum1541);
 int xum1541_control_msg(usb_dev_handle *HandleXum1541, unsigned int cmd);
+unsigned char xum1541_capabilities(usb_dev_handle *HandleXum1541);
 int xum1541_ioctl(usb_dev_handle *HandleXum1541, unsigned int cmd,
     unsigned int addr, unsigned int secaddr);
 
@@ -62,6 +69,17 @@ int xum1541_read(usb_dev_handle *HandleXum1541, unsigned char mode,
     unsigned char *data, size_t size);
 int xum1541_read_ext(usb_dev_handle *HandleXum1541, unsigned char mode,
     unsigned char *data, size_t size, int *Status, int *BytesRead);
+int xum1541_device_status(usb_dev_handle *HandleXum1541, unsigned char device,
+    unsigned char *data, size_t size);
+
+// Send several commands in one transfer and collect the responses
+size_t xum1541_build_cmd(unsigned char *cmdBuf, unsigned char cmd,
+    unsigned char modeFlags, const unsigned char *data, size_t size);
+int xum1541_send_cmds(usb_dev_handle *HandleXum1541,
+    const unsigned char *cmds, size_t len);
+int xum1541_wait_status(usb_dev_handle *HandleXum1541);
+int xum1541_read_data(usb_dev_handle *HandleXum1541, unsigned char *data,
+    size_t size);
 
 int xum1541_tap_break(usb_dev_handle *HandleXum1541);
 
@@ -26,11 +26,16 @@
 #include "debug.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 //! mark: We are building the DLL */
 #define DLL
 #include "opencbm.h"
+#include "opencbm-plugin.h"
 #include "archlib.h"
+#include "cbm_int.h"
+
+#include "arch.h"
 
 
 /*-------------------------------------------------------------------*/
@@ -136,6 +141,8 @@ cbm_upload(CBM_FILE HandleDevice, unsigned char DeviceAddress,
     const char *bufferToProgram = Program;
 
     unsigned char command[] = { 'M', '-', 'W', ' ', ' ', ' ' };
+    CBM_BATCH batch;
+    int *written;
     size_t i;
     int rv = 0;
     int c;
@@ -144,12 +151,21 @@ cbm_upload(CBM_FILE HandleDevice, unsigned char DeviceAddress,
 
     DBG_ASSERT(sizeof(command) == 6);
 
-    for(i = 0; i < Size; i += 32)
+    // Queue all M-W commands in one batch, so that the plugin
+    // can send them with as few round trips as possible.
+    // For every command, we remember the result of both writes
+
+    written = malloc(((Size + 31) / 32) * 2 * sizeof(*written) + 1);
+    batch = written ? cbm_batch_begin(HandleDevice) : NULL;
+
+    if (batch == NULL)
     {
-        if ( cbm_listen(HandleDevice, DeviceAddress, 15) ) {
-            return -1;
-        }
+        free(written);
+        FUNC_LEAVE_INT(-1);
+    }
 
+    for(i = 0; i < Size; i += 32)
+    {
         // Calculate how many bytes are left
 
         c = Size - i;
@@ -168,40 +184,481 @@ cbm_upload(CBM_FILE HandleDevice, unsigned char DeviceAddress,
         StoreAddressAndCount(&command[3], DriveMemAddress, c);
 
         // Write the M-W command to the drive...
+        // ... as well as the (up to 32) data bytes.
+        // The UNLISTEN is the signal for the drive 
+        // to start execution of the command
+
+        cbm_batch_listen(batch, DeviceAddress, 15);
+        cbm_batch_raw_write(batch, command, sizeof(command), &written[i / 16]);
+        cbm_batch_raw_write(batch, bufferToProgram, c, &written[i / 16 + 1]);
+        cbm_batch_unlisten(batch);
+
+        // Now, advance the pointer into drive memory
+        // as well to the program in PC's memory in case we
+        // might need to use it again for another M-W command
+
+        DriveMemAddress += c;
+        bufferToProgram += c;
+    }
+
+    if (cbm_batch_submit(batch) != 0)
+    {
+        rv = -1;
+    }
+
+    // Count the bytes which were sent; any short write is an error
+
+    for(i = 0; rv >= 0 && i < Size; i += 32)
+    {
+        c = Size - i;
+
+        if (c > 32)
+        {
+            c = 32;
+        }
 
-        if ( cbm_raw_write(HandleDevice, command, sizeof(command)) != sizeof command) {
+        if (written[i / 16] != sizeof(command) || written[i / 16 + 1] != c)
+        {
             rv = -1;
-            break;
         }
+        else
+        {
+            rv += c;
+        }
+    }
 
+    free(written);
 
-        // ... as well as the (up to 32) data bytes
+    FUNC_LEAVE_INT(rv);
+}
 
-        if ( cbm_raw_write(HandleDevice, bufferToProgram, c) != c ) {
-            rv = -1;
+/*! \brief Minimum program size for which cbm_upload_fast() uses the bootstrap loader */
+#define UPLOAD_FAST_MINIMUM 0x100
+
+/*! \brief Time (in ms) the bootstrap loader of cbm_upload_fast() gets to answer */
+#define UPLOAD_FAST_TIMEOUT 1000
+
+/*! \brief Time (in ms) a drive gets to come back after a failed fast upload */
+#define UPLOAD_RESET_TIMEOUT 3000
+
+/*! \internal \brief The bootstrap loader of cbm_upload_fast() */
+static const unsigned char upload_boot[] = {
+#include "uploadboot.inc"
+};
+
+/*! \internal \brief Check if the bootstrap loader of cbm_upload_fast() may be used
+
+ \return
+   1 if the configuration entry "fast" in section "upload" is set
+   to a value other than 0, 0 otherwise.
+*/
+
+static int
+upload_fast_enabled(void)
+{
+    char value[16];
+
+    return cbm_get_config_value("upload", "fast", value, sizeof(value)) == 0
+        && atoi(value) != 0;
+}
+
+/*! \internal \brief Upload with "M-W" after the bootstrap loader failed
+
+ The loader might still be running in the drive, so the drive is
+ reset first. After the reset, the drive is given some time to
+ answer again before the program is uploaded with cbm_upload().
+
+ The parameters are the same as for cbm_upload_fast().
+*/
+
+static int
+upload_fast_fallback(CBM_FILE HandleDevice, unsigned char DeviceAddress,
+                     int DriveMemAddress, const void *Program, size_t Size)
+{
+    char status[40];
+    unsigned long start;
+
+    DBG_WARN((DBG_PREFIX "fast upload failed, resetting the drive"));
+
+    cbm_iec_release(HandleDevice, IEC_ATN | IEC_DATA | IEC_CLOCK);
+    cbm_reset(HandleDevice);
+
+    for (start = arch_time_ms();
+         cbm_device_status(HandleDevice, DeviceAddress, status, sizeof(status)) == 99; )
+    {
+        if (arch_time_ms() - start > UPLOAD_RESET_TIMEOUT)
+        {
             break;
         }
+        arch_usleep(100000);
+    }
 
-        // Now, advance the pointer into drive memory
-        // as well to the program in PC's memory in case we
-        // might need to use it again for another M-W command
+    return cbm_upload(HandleDevice, DeviceAddress, DriveMemAddress, Program, Size);
+}
 
-        DriveMemAddress += c;
-        bufferToProgram += c;
+/*! \brief Upload a program into a floppy's drive memory, using a fast protocol.
 
-        // Advance the return value of send bytes, too.
+ This function writes a program into the drive's memory, like
+ cbm_upload(). For larger programs on a 1541, 1570 or 1571, it
+ first uploads a small bootstrap loader with "M-W" and then
+ transfers the program with the s2 protocol, if the plugin
+ provides it natively (opencbm_plugin_s2_write_n). In all other
+ cases, it falls back to cbm_upload().
 
-        rv += c;
+ The bootstrap loader is only used if it has been enabled with
+ the configuration entry "fast" in section "upload". If it
+ fails, the drive is reset and the program is uploaded again
+ with cbm_upload().
 
-        // The UNLISTEN is the signal for the drive 
-        // to start execution of the command
+ The bootstrap loader is placed into a page between $0300 and
+ $07ff which is not overwritten by the program itself. It uses
+ the zero page locations $30-$33 and $86.
 
-        if ( cbm_unlisten(HandleDevice) ) {
-            rv = -1;
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param DeviceAddress
+   The address of the device on the IEC serial bus. This
+   is known as primary address, too.
+
+ \param DriveMemAddress
+   The address in the drive's memory where the program is to be
+   stored.
+   
+ \param Program
+   Pointer to a byte buffer which holds the program in the 
+   caller's address space.
+
+ \param Size
+   The size of the program to be stored, in bytes.
+
+ \return
+   Returns the number of bytes written into program memory.
+   If it does not equal Size, than an error occurred.
+
+ If cbm_driver_open() did not succeed, it is illegal to 
+ call this function.
+*/
+
+int CBMAPIDECL
+cbm_upload_fast(CBM_FILE HandleDevice, unsigned char DeviceAddress, 
+                int DriveMemAddress, const void *Program, size_t Size)
+{
+    opencbm_plugin_s2_write_n_t *s2_write_n;
+    enum cbm_device_type_e deviceType;
+    unsigned char command[] = { 'M', '-', 'E', ' ', ' ' };
+    unsigned char *data;
+    unsigned long start;
+    int bootAddress;
+    int end;
+    int rv;
+
+    FUNC_ENTER();
+
+    end = DriveMemAddress + (int) Size;
+
+    s2_write_n = cbm_get_plugin_function_address_ex(HandleDevice, "opencbm_plugin_s2_write_n");
+
+    if (!upload_fast_enabled()
+        || Size < UPLOAD_FAST_MINIMUM || Size > 0xffff || s2_write_n == NULL
+        || cbm_identify_cached(HandleDevice, DeviceAddress, &deviceType) != 0
+        || (deviceType != cbm_dt_cbm1541 && deviceType != cbm_dt_cbm1570
+            && deviceType != cbm_dt_cbm1571))
+    {
+        FUNC_LEAVE_INT(cbm_upload(HandleDevice, DeviceAddress,
+            DriveMemAddress, Program, Size));
+    }
+
+    // Find a page for the bootstrap loader which the program does not use
+
+    for (bootAddress = 0x300; bootAddress < 0x800; bootAddress += 0x100)
+    {
+        if (end <= bootAddress
+            || DriveMemAddress >= bootAddress + (int) sizeof(upload_boot))
+        {
             break;
         }
     }
 
+    data = malloc(Size + 4);
+
+    if (bootAddress >= 0x800 || data == NULL)
+    {
+        free(data);
+        FUNC_LEAVE_INT(cbm_upload(HandleDevice, DeviceAddress,
+            DriveMemAddress, Program, Size));
+    }
+
+    if (cbm_upload(HandleDevice, DeviceAddress, bootAddress,
+            upload_boot, sizeof(upload_boot)) != sizeof(upload_boot))
+    {
+        free(data);
+        FUNC_LEAVE_INT(upload_fast_fallback(HandleDevice, DeviceAddress,
+            DriveMemAddress, Program, Size));
+    }
+
+    // The header tells the bootstrap loader where to store how many bytes
+
+    data[0] = (unsigned char) (DriveMemAddress & 0xff);
+    data[1] = (unsigned char) ((DriveMemAddress >> 8) & 0xff);
+    data[2] = (unsigned char) (Size & 0xff);
+    data[3] = (unsigned char) ((Size >> 8) & 0xff);
+    memcpy(data + 4, Program, Size);
+
+    command[3] = (unsigned char) (bootAddress & 0xff);
+    command[4] = (unsigned char) ((bootAddress >> 8) & 0xff);
+
+    if (cbm_exec_command(HandleDevice, DeviceAddress, command, sizeof(command)) != 0)
+    {
+        free(data);
+        FUNC_LEAVE_INT(upload_fast_fallback(HandleDevice, DeviceAddress,
+            DriveMemAddress, Program, Size));
+    }
+
+    // Same handshake as the s2 transfer routines of d64copy
+
+    cbm_iec_release(HandleDevice, IEC_CLOCK);
+
+    // Do not hang if the loader does not start; it answers within a few ms
+
+    for (start = arch_time_ms(); !cbm_iec_get(HandleDevice, IEC_CLOCK); )
+    {
+        if (arch_time_ms() - start > UPLOAD_FAST_TIMEOUT)
+        {
+            DBG_ERROR((DBG_PREFIX "the bootstrap loader did not answer"));
+            free(data);
+            FUNC_LEAVE_INT(upload_fast_fallback(HandleDevice, DeviceAddress,
+                DriveMemAddress, Program, Size));
+        }
+        arch_usleep(100);
+    }
+
+    cbm_iec_set(HandleDevice, IEC_ATN);
+    arch_usleep(20000);
+
+    rv = s2_write_n(HandleDevice, data, (unsigned int) (Size + 4));
+
+    cbm_iec_release(HandleDevice, IEC_DATA);
+    cbm_iec_release(HandleDevice, IEC_ATN);
+    cbm_iec_set(HandleDevice, IEC_CLOCK);
+    arch_usleep(1000);
+
+    free(data);
+
+    if (rv != (int) (Size + 4))
+    {
+        FUNC_LEAVE_INT(upload_fast_fallback(HandleDevice, DeviceAddress,
+            DriveMemAddress, Program, Size));
+    }
+
+    FUNC_LEAVE_INT((int) Size);
+}
+
+/*! \brief Number of bytes of a cache signature */
+#define UPLOAD_SIGNATURE_SIZE 4
+
+/*! \brief Number of bytes compared at the end of every program page */
+#define UPLOAD_SAMPLE_SIZE 16
+
+/*! \internal \brief Calculate the signature of a program
+
+ The signature is a 32 bit FNV-1a hash over the load address,
+ the size and the contents of the program.
+
+ \param DriveMemAddress
+   The address in the drive's memory where the program is to be
+   stored.
+
+ \param Program
+   Pointer to the program in the caller's address space.
+
+ \param Size
+   The size of the program, in bytes.
+
+ \param Signature
+   Pointer to a buffer of UPLOAD_SIGNATURE_SIZE bytes which
+   gets the signature.
+*/
+
+static void
+upload_signature(int DriveMemAddress, const unsigned char *Program,
+                 size_t Size, unsigned char *Signature)
+{
+    unsigned long hash = 2166136261ul;
+    unsigned char head[4];
+    size_t i;
+
+    head[0] = (unsigned char) (DriveMemAddress & 0xff);
+    head[1] = (unsigned char) ((DriveMemAddress >> 8) & 0xff);
+    head[2] = (unsigned char) (Size & 0xff);
+    head[3] = (unsigned char) ((Size >> 8) & 0xff);
+
+    for (i = 0; i < sizeof(head); i++)
+    {
+        hash = ((hash ^ head[i]) * 16777619ul) & 0xfffffffful;
+    }
+
+    for (i = 0; i < Size; i++)
+    {
+        hash = ((hash ^ Program[i]) * 16777619ul) & 0xfffffffful;
+    }
+
+    for (i = 0; i < UPLOAD_SIGNATURE_SIZE; i++)
+    {
+        Signature[i] = (unsigned char) (hash >> (8 * i));
+    }
+}
+
+/*! \internal \brief Compare a part of the drive's memory with the program
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param DeviceAddress
+   The address of the device on the IEC serial bus.
+
+ \param DriveMemAddress
+   The address in the drive's memory where the part starts.
+
+ \param Expected
+   Pointer to the bytes which are expected at DriveMemAddress.
+
+ \param Size
+   The number of bytes to compare; at most UPLOAD_SAMPLE_SIZE.
+
+ \return
+   1 if the drive's memory holds the expected bytes, 0 otherwise.
+*/
+
+static int
+upload_compare(CBM_FILE HandleDevice, unsigned char DeviceAddress,
+               int DriveMemAddress, const unsigned char *Expected, int Size)
+{
+    unsigned char compare[UPLOAD_SAMPLE_SIZE];
+
+    DBG_ASSERT(Size <= UPLOAD_SAMPLE_SIZE);
+
+    return cbm_download(HandleDevice, DeviceAddress, DriveMemAddress,
+        compare, Size) == Size && memcmp(compare, Expected, Size) == 0;
+}
+
+/*! \brief Upload a program into a floppy's drive memory, unless it is already there.
+
+ This function works like cbm_upload_fast(), but it additionally
+ stores a signature of the program in the last
+ UPLOAD_SIGNATURE_SIZE bytes of the page the program ends in.
+ If a later call finds the same signature there, and the first
+ bytes of the program as well as the last bytes of every page
+ the program occupies still match, the upload is skipped.
+
+ There is no explicit invalidation: Whatever overwrites the
+ drive's memory - a reset (which clears the RAM), an "I0" (which
+ reads the BAM into the buffer at $0700), another upload or any
+ other use of the DOS buffers - destroys either the signature
+ or the sampled bytes, and the next call uploads the program
+ again.
+
+ If the program reaches into the signature area, this function
+ behaves exactly like cbm_upload_fast().
+
+ Only use this function for programs which do not rely on
+ initial values of bytes they modify themselves.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param DeviceAddress
+   The address of the device on the IEC serial bus. This
+   is known as primary address, too.
+
+ \param DriveMemAddress
+   The address in the drive's memory where the program is to be
+   stored.
+   
+ \param Program
+   Pointer to a byte buffer which holds the program in the 
+   caller's address space.
+
+ \param Size
+   The size of the program to be stored, in bytes.
+
+ \return
+   Returns Size if the program is in the drive's memory, either
+   because it was already there or because it was uploaded.
+   Otherwise, the return value is the same as of cbm_upload().
+
+ If cbm_driver_open() did not succeed, it is illegal to 
+ call this function.
+*/
+
+int CBMAPIDECL
+cbm_upload_cached(CBM_FILE HandleDevice, unsigned char DeviceAddress, 
+                  int DriveMemAddress, const void *Program, size_t Size)
+{
+    const unsigned char *bufferToProgram = Program;
+    unsigned char signature[UPLOAD_SIGNATURE_SIZE];
+    int signatureAddress;
+    int end;
+    int page;
+    int start;
+    int c;
+    int rv;
+
+    FUNC_ENTER();
+
+    end = DriveMemAddress + (int) Size;
+    signatureAddress = ((end - 1) | 0xff) + 1 - UPLOAD_SIGNATURE_SIZE;
+
+    if (Size == 0 || end > signatureAddress)
+    {
+        FUNC_LEAVE_INT(cbm_upload_fast(HandleDevice, DeviceAddress,
+            DriveMemAddress, Program, Size));
+    }
+
+    upload_signature(DriveMemAddress, bufferToProgram, Size, signature);
+
+    // Check the signature, then the start of the program,
+    // then the end of every page the program occupies
+
+    c = Size < UPLOAD_SAMPLE_SIZE ? (int) Size : UPLOAD_SAMPLE_SIZE;
+
+    rv = upload_compare(HandleDevice, DeviceAddress, signatureAddress,
+            signature, UPLOAD_SIGNATURE_SIZE)
+        && upload_compare(HandleDevice, DeviceAddress, DriveMemAddress,
+            bufferToProgram, c);
+
+    for (page = DriveMemAddress & ~0xff; rv && page < end; page += 0x100)
+    {
+        start = (page + 0x100 < end ? page + 0x100 : end) - UPLOAD_SAMPLE_SIZE;
+
+        if (start < DriveMemAddress + c)
+        {
+            // already compared as the start of the program
+            continue;
+        }
+
+        rv = upload_compare(HandleDevice, DeviceAddress, start,
+            bufferToProgram + (start - DriveMemAddress), UPLOAD_SAMPLE_SIZE);
+    }
+
+    if (rv)
+    {
+        DBG_PRINT((DBG_PREFIX "program at $%04x is already resident", DriveMemAddress));
+        FUNC_LEAVE_INT((int) Size);
+    }
+
+    // Upload the program, and only then its signature
+
+    rv = cbm_upload_fast(HandleDevice, DeviceAddress, DriveMemAddress,
+        Program, Size);
+
+    if (rv == (int) Size
+        && cbm_upload(HandleDevice, DeviceAddress, signatureAddress,
+               signature, UPLOAD_SIGNATURE_SIZE) != UPLOAD_SIGNATURE_SIZE)
+    {
+        rv = -1;
+    }
+
     FUNC_LEAVE_INT(rv);
 }
 
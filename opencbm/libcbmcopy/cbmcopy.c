@@ -61,6 +61,9 @@ transfers[] =
     { NULL, NULL, NULL }
 };
 
+/* interleave of host planned block chains, per transfer mode (1541 only) */
+static const int default_interleave[] = { 10, 10, 8, 6, -1 };
+
 static int check_drive_type(CBM_FILE fd, unsigned char drive,
                             cbmcopy_settings *settings,
                             cbmcopy_message_cb msg_cb)
@@ -99,7 +102,7 @@ static int send_turbo(CBM_FILE fd, unsigned char drive, int write,
     {
         if(turbo_size)
         {
-            cbm_upload( fd, drive, 0x500, turbo, turbo_size );
+            cbm_upload_cached( fd, drive, 0x500, turbo, turbo_size );
             msg_cb( sev_debug, "uploading %d bytes turbo code", turbo_size );
             if(trf->upload_turbo(fd, drive, settings->drive_type, write) == 0)
             {
@@ -133,33 +136,14 @@ static int send_turbo(CBM_FILE fd, unsigned char drive, int write,
 }
 
 
-static int cbmcopy_read(CBM_FILE fd,
-                        cbmcopy_settings *settings,
-                        unsigned char drive,
-                        int track, int sector,
-                        const char *cbmname,
-                        int cbmname_len,
-                        unsigned char **filedata,
-                        size_t *filedata_size,
-                        cbmcopy_message_cb msg_cb,
-                        cbmcopy_status_cb status_cb)
+/* find out which read turbo to use, and prepare the drive for it */
+static int select_read_turbo(CBM_FILE fd,
+                             cbmcopy_settings *settings,
+                             unsigned char drive,
+                             const unsigned char **turbo,
+                             int *turbo_size,
+                             cbmcopy_message_cb msg_cb)
 {
-    int rv;
-    int i;
-    int turbo_size;
-    int error;
-    unsigned char buf[48];
-    const unsigned char *turbo;
-    const transfer_funcs *trf;
-    int blocks_read;
-
-    *filedata = NULL;
-    *filedata_size = 0;
-
-    msg_cb( sev_debug, "using transfer mode '%s'",
-            transfers[settings->transfer_mode].name);
-    trf = transfers[settings->transfer_mode].trf;
-
     if(check_drive_type( fd, drive, settings, msg_cb ))
     {
         return -1;
@@ -168,18 +152,18 @@ static int cbmcopy_read(CBM_FILE fd,
     switch(settings->drive_type)
     {
         case cbm_dt_cbm1541:
-            turbo = turboread1541;
-            turbo_size = sizeof(turboread1541);
+            *turbo = turboread1541;
+            *turbo_size = sizeof(turboread1541);
             break;
         case cbm_dt_cbm1570:
         case cbm_dt_cbm1571:
             cbm_exec_command( fd, drive, "U0>M1", 0 );
-            turbo = turboread1571;
-            turbo_size = sizeof(turboread1571);
+            *turbo = turboread1571;
+            *turbo_size = sizeof(turboread1571);
             break;
         case cbm_dt_cbm1581:
-            turbo = turboread1581;
-            turbo_size = sizeof(turboread1581);
+            *turbo = turboread1581;
+            *turbo_size = sizeof(turboread1581);
             break;
         default: /* unreachable */
             msg_cb( sev_warning, "*** unknown drive type" );
@@ -188,17 +172,47 @@ static int cbmcopy_read(CBM_FILE fd,
         case cbm_dt_cbm8050:
         case cbm_dt_cbm8250:
         case cbm_dt_sfd1001:
-            turbo = NULL;
-            turbo_size = 0;
+            *turbo = NULL;
+            *turbo_size = 0;
             break;
     }
 
     if(transfers[settings->transfer_mode].abbrev[0] == 'o')
     {
         /* if "original" transfer mode - no drive code can be used */
-        turbo = NULL;
-        turbo_size = 0;
+        *turbo = NULL;
+        *turbo_size = 0;
     }
+    return 0;
+}
+
+
+/* read a file (by name) or a block chain (by track/sector) */
+static int read_chain(CBM_FILE fd,
+                      cbmcopy_settings *settings,
+                      unsigned char drive,
+                      const unsigned char *turbo,
+                      int turbo_size,
+                      int track, int sector,
+                      const char *cbmname,
+                      int cbmname_len,
+                      cbmcopy_sink_cb sink,
+                      void *sink_context,
+                      cbmcopy_message_cb msg_cb,
+                      cbmcopy_status_cb status_cb)
+{
+    int rv;
+    int i;
+    int error;
+    int sink_rv;
+    unsigned char buf[48];
+    unsigned char block[254];
+    const transfer_funcs *trf;
+    int blocks_read;
+
+    msg_cb( sev_debug, "using transfer mode '%s'",
+            transfers[settings->transfer_mode].name);
+    trf = transfers[settings->transfer_mode].trf;
 
     if(cbmname)
     {
@@ -225,6 +239,7 @@ static int cbmcopy_read(CBM_FILE fd,
 
     blocks_read = 0;
     error = 0;
+    sink_rv = 0;
 
     if(track)
     {
@@ -254,68 +269,57 @@ static int cbmcopy_read(CBM_FILE fd,
         while( (error = trf->check_error(fd, 0)) == 0 )
         {
             SETSTATEDEBUG((void)0); // after check_error condition
-            arch_usleep(1000);      // fix for Tim's environment
+            arch_usleep(settings->block_delay);  // fix for Tim's environment
 
             SETSTATEDEBUG(DebugBlockCount++);    // preset condition
 
-            /* @SRT: FIXME! the next statement is dangerous: If there 
-             * is no memory block large enough for reallocating, the
-             * memory block is not freed, but realloc() returns NULL,
-             * thus, we have a memory leak.
-             */
-             /* reserve additional memory to hold to up an additional full block */
-            *filedata = realloc(*filedata, *filedata_size + 254);
-            SETSTATEDEBUG((void)0);    // after check_error condition
-            if(*filedata)
-            {
-                /* read block, let the block reader also handle the initial length byte */
-                i = trf->read_blk( fd, (*filedata) + blocks_read * 254, 254, msg_cb);
-                msg_cb( sev_debug, "number of bytes read for block %d: %d", blocks_read, i );
+            /* read block, let the block reader also handle the initial length byte */
+            i = trf->read_blk( fd, block, sizeof(block), msg_cb);
+            msg_cb( sev_debug, "number of bytes read for block %d: %d", blocks_read, i );
 
-                SETSTATEDEBUG((void)0);    // afterread condition
+            SETSTATEDEBUG((void)0);    // afterread condition
 
-                /*
-                 * FIXME: Find and eliminate the real protocol races to
-                 *        eliminate the rare hangups with the 1581 based
-                 *        turbo routines (bugs suspected in 6502 code)
-                 *
-                 * Hotfix proposion for the 1581 protocols:
-                 *    add a little delay at the end of the loop
-                 *       "hmmmm, if we know that the drive is busy
-                 *        now, shouldn't we wait for it then?"
-                 *    add a little delay after the turbo start
-                 */
-                arch_usleep(1000);
+            /*
+             * FIXME: Find and eliminate the real protocol races to
+             *        eliminate the rare hangups with the 1581 based
+             *        turbo routines (bugs suspected in 6502 code)
+             *
+             * Hotfix proposion for the 1581 protocols:
+             *    add a little delay at the end of the loop
+             *       "hmmmm, if we know that the drive is busy
+             *        now, shouldn't we wait for it then?"
+             *    add a little delay after the turbo start
+             */
+            arch_usleep(1000);
 
-                if( i < 255)
+            if( i < 255)
+            {
+                if( i >= 0 )
                 {
-                    if( i >= 0 )
+                    /* in case of original transfers, there is no extra length byte transfer,    */
+                    /* whenever 254 bytes are read from a block a count value of 255 is returned */
+                    /* and if this was the last block, 0 bytes are read with the next block call */
+                    if( i > 0 && sink_rv == 0 )
                     {
-                        /* in case of original transfers, there is no extra length byte transfer,    */
-                        /* whenever 254 bytes are read from a block a count value of 255 is returned */
-                        /* and if this was the last block, 0 bytes are read with the next block call */
-                        *filedata_size += i;
+                        sink_rv = sink( sink_context, block, i );
                     }
-                    else
-                    {
-                        rv = -1;
-                    }
-                    break;
                 }
                 else
                 {
-                    /* more blocks are following, a full block was transferred */
-                    *filedata_size += 254;
+                    rv = -1;
                 }
-
-                SETSTATEDEBUG((void)0);    // afterread condition
-                status_cb( ++blocks_read );
+                break;
             }
-            else
+
+            /* more blocks are following, a full block was transferred */
+            if( sink_rv == 0 )
             {
-                SETSTATEDEBUG((void)0);    // afterread condition
-                /* FIXME */
+                /* once the sink failed, the rest of the file is only drained */
+                sink_rv = sink( sink_context, block, 254 );
             }
+
+            SETSTATEDEBUG((void)0);    // afterread condition
+            status_cb( ++blocks_read );
         }
         msg_cb( sev_debug, "done" );
         SETSTATEDEBUG(DebugBlockCount=-1);   // turbo sent condition
@@ -340,6 +344,11 @@ static int cbmcopy_read(CBM_FILE fd,
         {
             msg_cb( sev_warning, "file copy ended with error status: %s", buf );
         }
+        if( sink_rv && rv == 0 )
+        {
+            msg_cb( sev_warning, "the received data could not be stored" );
+            rv = -1;
+        }
     }
 
     cbm_close( fd, drive, SA_READ );
@@ -347,6 +356,113 @@ static int cbmcopy_read(CBM_FILE fd,
 }
 
 
+static int cbmcopy_read(CBM_FILE fd,
+                        cbmcopy_settings *settings,
+                        unsigned char drive,
+                        int track, int sector,
+                        const char *cbmname,
+                        int cbmname_len,
+                        cbmcopy_sink_cb sink,
+                        void *sink_context,
+                        cbmcopy_message_cb msg_cb,
+                        cbmcopy_status_cb status_cb)
+{
+    const unsigned char *turbo;
+    int turbo_size;
+
+    if(select_read_turbo(fd, settings, drive, &turbo, &turbo_size, msg_cb))
+    {
+        return -1;
+    }
+
+    return read_chain(fd, settings, drive, turbo, turbo_size,
+                      track, sector, cbmname, cbmname_len,
+                      sink, sink_context, msg_cb, status_cb);
+}
+
+
+static int no_status(int blocks_processed)
+{
+    return 0;
+}
+
+
+/* collects the file data in a malloc()'d buffer */
+typedef struct
+{
+    unsigned char *data;
+    size_t size;
+    size_t allocated;
+} buffer_sink;
+
+static int buffer_sink_write(void *context, const unsigned char *data, size_t size)
+{
+    buffer_sink *buffer = context;
+    unsigned char *p;
+    size_t allocated;
+
+    if(buffer->size + size > buffer->allocated)
+    {
+        /* grow geometrically, so the data is copied only O(size) times */
+        allocated = buffer->allocated ? buffer->allocated : 16 * 254;
+        while(allocated < buffer->size + size)
+        {
+            allocated *= 2;
+        }
+        p = realloc(buffer->data, allocated);
+        if(p == NULL)
+        {
+            return -1;
+        }
+        buffer->data = p;
+        buffer->allocated = allocated;
+    }
+    memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+    return 0;
+}
+
+static int cbmcopy_read_buffer(CBM_FILE fd,
+                               cbmcopy_settings *settings,
+                               unsigned char drive,
+                               int track, int sector,
+                               const char *cbmname,
+                               int cbmname_len,
+                               unsigned char **filedata,
+                               size_t *filedata_size,
+                               cbmcopy_message_cb msg_cb,
+                               cbmcopy_status_cb status_cb)
+{
+    buffer_sink buffer;
+    int rv;
+
+    buffer.data = NULL;
+    buffer.size = 0;
+    buffer.allocated = 0;
+
+    rv = cbmcopy_read(fd, settings, drive, track, sector,
+                      cbmname, cbmname_len,
+                      buffer_sink_write, &buffer,
+                      msg_cb, status_cb);
+    if(rv)
+    {
+        free(buffer.data);
+        buffer.data = NULL;
+        buffer.size = 0;
+    }
+
+    *filedata = buffer.data;
+    *filedata_size = buffer.size;
+    return rv;
+}
+
+
+int cbmcopy_file_sink(void *context, const unsigned char *data, size_t size)
+{
+    return fwrite(data, size, 1, (FILE *) context) == 1 ? 0 : -1;
+}
+
+
 char *cbmcopy_get_transfer_modes()
 {
     const struct _transfers *t;
@@ -508,12 +624,162 @@ cbmcopy_settings *cbmcopy_get_default_settings(void)
     {
         settings->drive_type    = cbm_dt_unknown; /* auto detect later on */
         settings->transfer_mode = 0;
+        settings->block_delay   = 1000;           /* usec */
+        settings->interleave    = -1;             /* default of the transfer mode */
     }
     return settings;
 }
 
 
 
+/*
+ * 1541 DOS internals used to plan the block chain of a file on the host.
+ * The write turbo always uses channel 1, its buffer (buf0/buf1 of the
+ * channel) holds the track and sector of the first block, and the BAM
+ * is kept in buffer 4.
+ */
+#define DIR_TRACK       18
+#define MAX_TRACK       35
+#define CHANNEL_BUFFERS 0xa8    /* buf0 of channel 1, buf1 is 7 bytes later */
+#define BUFFER_TS       0x06    /* track/sector of the buffers, 2 bytes each */
+#define BAM_ADDRESS     0x0700
+
+static int sectors_1541(int track)
+{
+    return track < 18 ? 21 : track < 25 ? 19 : track < 31 ? 18 : 17;
+}
+
+static int bam_is_free(const unsigned char *bam, int track, int sector)
+{
+    return bam[4 * track + 1 + sector / 8] & (1 << (sector & 7));
+}
+
+static void bam_allocate(unsigned char *bam, int track, int sector)
+{
+    if(bam_is_free(bam, track, sector))
+    {
+        bam[4 * track + 1 + sector / 8] &= ~(1 << (sector & 7));
+        bam[4 * track]--;
+    }
+}
+
+static int bam_track_free(const unsigned char *bam, int track)
+{
+    int sector;
+    int count = 0;
+
+    for(sector = 0; sector < sectors_1541(track); sector++)
+    {
+        if(bam_is_free(bam, track, sector))
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+/*
+ * Plan the links of the blocks following the first one of the file
+ * opened for writing. The drive's BAM is read once; the blocks are laid
+ * out like DOS does (moving away from the directory track, switching to
+ * the other half of the disk when an edge is reached), but with the
+ * interleave of the transfer mode. The sector position is carried over
+ * to the next track, so that the head can go on without waiting for a
+ * whole revolution.
+ *
+ * On return, links holds count track/sector pairs. If anything does not
+ * look as expected, or if the disk is too full, -1 is returned and the
+ * drive allocates the blocks itself.
+ */
+static int plan_chain(CBM_FILE fd,
+                      cbmcopy_settings *settings,
+                      unsigned char drive,
+                      unsigned char *links,
+                      int count,
+                      cbmcopy_message_cb msg_cb)
+{
+    unsigned char bam[256];
+    unsigned char bufs[8];
+    unsigned char ts[2];
+    int buf;
+    int track;
+    int sector;
+    int direction;
+    int interleave;
+    int free_blocks;
+    int i;
+
+    interleave = settings->interleave > 0 ?
+        settings->interleave : default_interleave[settings->transfer_mode];
+    if(interleave < 1)
+    {
+        return -1;
+    }
+
+    if(cbm_download(fd, drive, CHANNEL_BUFFERS, bufs, sizeof(bufs)) != sizeof(bufs))
+    {
+        return -1;
+    }
+    buf = ((bufs[0] & 0x80) ? bufs[7] : bufs[0]) & 0xbf;
+    if(buf > 4 ||
+       cbm_download(fd, drive, BUFFER_TS + 2 * buf, ts, sizeof(ts)) != sizeof(ts) ||
+       cbm_download(fd, drive, BAM_ADDRESS, bam, sizeof(bam)) != sizeof(bam))
+    {
+        return -1;
+    }
+
+    track = ts[0];
+    sector = ts[1];
+    if(track < 1 || track > MAX_TRACK || track == DIR_TRACK ||
+       sector >= sectors_1541(track))
+    {
+        msg_cb( sev_debug, "unexpected first block %d/%d", track, sector );
+        return -1;
+    }
+    bam_allocate(bam, track, sector);
+
+    free_blocks = 0;
+    for(i = 1; i <= MAX_TRACK; i++)
+    {
+        if(i != DIR_TRACK)
+        {
+            free_blocks += bam_track_free(bam, i);
+        }
+    }
+    if(free_blocks < count)
+    {
+        return -1;
+    }
+
+    msg_cb( sev_debug, "planning %d blocks from %d/%d, interleave %d",
+            count, track, sector, interleave );
+
+    direction = track < DIR_TRACK ? -1 : 1;
+    for(i = 0; i < count; i++)
+    {
+        while(bam_track_free(bam, track) == 0)
+        {
+            track += direction;
+            if(track < 1 || track > MAX_TRACK)
+            {
+                direction = -direction;
+                track = DIR_TRACK + direction;
+            }
+        }
+        sector = (sector + interleave) % sectors_1541(track);
+        while(!bam_is_free(bam, track, sector))
+        {
+            sector = (sector + 1) % sectors_1541(track);
+        }
+        bam_allocate(bam, track, sector);
+
+        links[2 * i]     = (unsigned char) track;
+        links[2 * i + 1] = (unsigned char) sector;
+    }
+    return 0;
+}
+
+
 int cbmcopy_write_file(CBM_FILE fd,
                        cbmcopy_settings *settings,
                        int drivei,
@@ -533,6 +799,9 @@ int cbmcopy_write_file(CBM_FILE fd,
     const unsigned char *turbo;
     const transfer_funcs *trf;
     int blocks_written;
+    int more;
+    unsigned char *links;
+    unsigned char *chain_turbo;
 
     msg_cb( sev_debug, "using transfer mode `%s'",
             transfers[settings->transfer_mode].name);
@@ -593,6 +862,32 @@ int cbmcopy_write_file(CBM_FILE fd,
     blocks_written = 0;
     error = 0;
 
+    /*
+     * With the 1541, let the host plan the block chain instead of
+     * searching the BAM in the drive for every block. The turbo is told
+     * so by its last byte, and gets the link of each block from the host.
+     */
+    links = NULL;
+    chain_turbo = NULL;
+    if(turbo && settings->drive_type == cbm_dt_cbm1541 && filedata_size > 254)
+    {
+        i = (filedata_size - 1) / 254;
+        links = malloc(2 * i);
+        chain_turbo = malloc(turbo_size);
+        if(links && chain_turbo && plan_chain(fd, settings, drive, links, i, msg_cb) == 0)
+        {
+            memcpy(chain_turbo, turbo, turbo_size);
+            chain_turbo[turbo_size - 1] = 1;
+            turbo = chain_turbo;
+        }
+        else
+        {
+            msg_cb( sev_debug, "letting the drive allocate the blocks" );
+            free(links);
+            links = NULL;
+        }
+    }
+
     SETSTATEDEBUG((void)0);    // pre send_turbo condition
     if(send_turbo(fd, drive, 1, settings,
                   turbo, turbo_size, (unsigned char*)"U4:", 3, msg_cb) == 0)
@@ -615,7 +910,8 @@ int cbmcopy_write_file(CBM_FILE fd,
         while( filedata_size > 0 )
         {
             /* if more blocks are following (more than 254 bytes) set the count value to 255 */
-            i = filedata_size <= 254 ? filedata_size : 255;
+            more = filedata_size > 254;
+            i = more ? 255 : filedata_size;
 
             SETSTATEDEBUG(DebugBlockCount++);
 
@@ -629,6 +925,14 @@ int cbmcopy_write_file(CBM_FILE fd,
                 break;
             }
 
+            /* the planned link of this block, as a block of its own */
+            if ( links && more &&
+                 trf->write_blk( fd, links + 2 * blocks_written, 2, msg_cb ) != 2 )
+            {
+                rv = -1;
+                break;
+            }
+
             SETSTATEDEBUG((void)0);
             if ( trf->check_error( fd, 1 ) != 0 )
             {
@@ -667,6 +971,8 @@ int cbmcopy_write_file(CBM_FILE fd,
             msg_cb( sev_warning, "file copy ended with error status: %s", buf );
         }
     }
+    free(links);
+    free(chain_turbo);
     cbm_close( fd, drive, SA_WRITE );
     return rv;
 }
@@ -682,11 +988,11 @@ int cbmcopy_read_file_ts(CBM_FILE fd,
                          cbmcopy_message_cb msg_cb,
                          cbmcopy_status_cb status_cb)
 {
-    return cbmcopy_read(fd, settings, (unsigned char) drive,
-                        track, sector,
-                        NULL, 0,
-                        filedata, filedata_size,
-                        msg_cb, status_cb);
+    return cbmcopy_read_buffer(fd, settings, (unsigned char) drive,
+                               track, sector,
+                               NULL, 0,
+                               filedata, filedata_size,
+                               msg_cb, status_cb);
 }
 
 
@@ -700,14 +1006,452 @@ int cbmcopy_read_file(CBM_FILE fd,
                       size_t *filedata_size,
                       cbmcopy_message_cb msg_cb,
                       cbmcopy_status_cb status_cb)
+{
+    return cbmcopy_read_buffer(fd, settings, (unsigned char) drive,
+                               0, 0,
+                               cbmname, cbmname_len,
+                               filedata, filedata_size,
+                               msg_cb, status_cb);
+}
+
+
+/* just a wrapper */
+int cbmcopy_read_file_ts_stream(CBM_FILE fd,
+                                cbmcopy_settings *settings,
+                                int drive,
+                                int track, int sector,
+                                cbmcopy_sink_cb sink,
+                                void *sink_context,
+                                cbmcopy_message_cb msg_cb,
+                                cbmcopy_status_cb status_cb)
+{
+    return cbmcopy_read(fd, settings, (unsigned char) drive,
+                        track, sector,
+                        NULL, 0,
+                        sink, sink_context,
+                        msg_cb, status_cb);
+}
+
+
+/* just a wrapper */
+int cbmcopy_read_file_stream(CBM_FILE fd,
+                             cbmcopy_settings *settings,
+                             int drive,
+                             const char *cbmname,
+                             int cbmname_len,
+                             cbmcopy_sink_cb sink,
+                             void *sink_context,
+                             cbmcopy_message_cb msg_cb,
+                             cbmcopy_status_cb status_cb)
 {
     return cbmcopy_read(fd, settings, (unsigned char) drive,
                         0, 0,
                         cbmname, cbmname_len,
-                        filedata, filedata_size,
+                        sink, sink_context,
                         msg_cb, status_cb);
 }
 
+/* a cbmcopy session: the drive is identified and prepared only once */
+struct cbmcopy_session_s
+{
+    CBM_FILE fd;
+    cbmcopy_settings *settings;
+    unsigned char drive;
+    const unsigned char *turbo;
+    int turbo_size;
+    cbmcopy_message_cb msg_cb;
+    cbmcopy_dir_entry *entries;
+    int num_entries;
+};
+
+
+cbmcopy_session *cbmcopy_session_open(CBM_FILE fd,
+                                      cbmcopy_settings *settings,
+                                      int drive,
+                                      cbmcopy_message_cb msg_cb)
+{
+    cbmcopy_session *session;
+
+    session = calloc(1, sizeof(*session));
+    if(session == NULL)
+    {
+        msg_cb( sev_fatal, "Out of memory" );
+        return NULL;
+    }
+
+    session->fd = fd;
+    session->settings = settings;
+    session->drive = (unsigned char) drive;
+    session->msg_cb = msg_cb;
+
+    if(select_read_turbo(fd, settings, session->drive,
+                         &session->turbo, &session->turbo_size, msg_cb))
+    {
+        free(session);
+        return NULL;
+    }
+    return session;
+}
+
+
+void cbmcopy_session_close(cbmcopy_session *session)
+{
+    if(session)
+    {
+        free(session->entries);
+        free(session);
+    }
+}
+
+
+/* reads the directory listing ("$"), as the DOS sends it on LOAD */
+static int read_listing(cbmcopy_session *session, buffer_sink *dir)
+{
+    unsigned char buf[48];
+    int rd;
+    int rv;
+
+    cbm_open( session->fd, session->drive, SA_READ, "$", 1 );
+    rv = cbm_device_status( session->fd, session->drive, (char*)buf, sizeof(buf) );
+    if(rv == 0)
+    {
+        cbm_talk( session->fd, session->drive, SA_READ );
+        do
+        {
+            rd = cbm_raw_read( session->fd, buf, sizeof(buf) );
+            if(rd > 0 && buffer_sink_write( dir, buf, rd ))
+            {
+                rv = -1;
+            }
+        } while(rv == 0 && rd == sizeof(buf));
+        cbm_untalk( session->fd );
+    }
+    cbm_close( session->fd, session->drive, SA_READ );
+    return rv;
+}
+
+
+/*
+ * parses a directory listing into session->entries. Every line starts
+ * with the link and the blocks as line number, followed by
+ * '"NAME"  PRG', with a '*' before the type if the file is not closed,
+ * and a '<' after it if it is locked.
+ */
+static int parse_listing(cbmcopy_session *session, const unsigned char *data, size_t size)
+{
+    static const char types[] = "DELSEQPRGUSRREL";
+    cbmcopy_dir_entry *entry;
+    cbmcopy_dir_entry *p;
+    const unsigned char *line;
+    const unsigned char *end;
+    const unsigned char *name;
+    int allocated;
+    int type;
+    int header;
+    int i;
+
+    allocated = 0;
+    header = 1;
+
+    /* skip the load address */
+    for(line = data + 2; line + 4 < data + size && (line[0] || line[1]); line = end + 1)
+    {
+        end = memchr(line + 4, 0, size - (line + 4 - data));
+        if(end == NULL)
+        {
+            break;
+        }
+        name = memchr(line + 4, '"', end - (line + 4));
+        if(header || name == NULL)
+        {
+            /* the disk name, and the number of free blocks */
+            header = 0;
+            continue;
+        }
+        name++;
+
+        if(session->num_entries == allocated)
+        {
+            allocated = allocated ? allocated * 2 : 144;
+            p = realloc(session->entries, allocated * sizeof(*session->entries));
+            if(p == NULL)
+            {
+                return -1;
+            }
+            session->entries = p;
+        }
+        entry = &session->entries[session->num_entries];
+
+        memset(entry, 0, sizeof(*entry));
+        for(i = 0; name < end && *name != '"' && i < 16; i++)
+        {
+            entry->name[i] = *name++;
+        }
+        while(name < end && (*name == '"' || *name == ' '))
+        {
+            name++;
+        }
+
+        /* only closed SEQ, PRG, USR and REL files, as in the directory blocks */
+        if(end - name < 3 || *name == '*')
+        {
+            continue;
+        }
+        for(type = 0; type < 5 && memcmp(types + 3 * type, name, 3); type++)
+        {
+            ;
+        }
+        if(type == 0 || type == 5)
+        {
+            continue;
+        }
+
+        entry->type = (unsigned char) (0x80 | type);
+        if(end - name > 3 && name[3] == '<')
+        {
+            entry->type |= 0x40;
+        }
+        entry->blocks = line[2] | (line[3] << 8);
+        session->num_entries++;
+    }
+    return 0;
+}
+
+
+int cbmcopy_session_read_dir(cbmcopy_session *session,
+                             const cbmcopy_dir_entry **entries,
+                             int *num_entries)
+{
+    buffer_sink dir;
+    const unsigned char *e;
+    cbmcopy_dir_entry *entry;
+    int track, sector;
+    size_t block;
+    size_t ofs;
+    int i;
+    int rv;
+
+    if(session->entries == NULL && session->turbo == NULL)
+    {
+        /*
+         * without drive code, U4 cannot follow a block chain, so the
+         * files are found by name in the listing the DOS sends.
+         */
+        dir.data = NULL;
+        dir.size = 0;
+        dir.allocated = 0;
+
+        rv = read_listing(session, &dir);
+        if(rv == 0)
+        {
+            rv = parse_listing(session, dir.data, dir.size);
+        }
+        free(dir.data);
+        if(rv)
+        {
+            session->msg_cb( sev_warning, "could not read the directory" );
+            return rv;
+        }
+        if(session->entries == NULL)
+        {
+            /* an empty disk; read the listing only once */
+            session->entries = malloc(sizeof(*session->entries));
+            if(session->entries == NULL)
+            {
+                session->msg_cb( sev_fatal, "Out of memory" );
+                return -1;
+            }
+        }
+    }
+    else if(session->entries == NULL)
+    {
+        switch(session->settings->drive_type)
+        {
+            case cbm_dt_cbm1581:
+                track = 40; sector = 3;
+                break;
+            case cbm_dt_cbm8050:
+            case cbm_dt_cbm8250:
+            case cbm_dt_sfd1001:
+                track = 39; sector = 1;
+                break;
+            default:
+                track = 18; sector = 1;
+                break;
+        }
+
+        dir.data = NULL;
+        dir.size = 0;
+        dir.allocated = 0;
+
+        /* the directory is a block chain like any file */
+        rv = read_chain(session->fd, session->settings, session->drive,
+                        session->turbo, session->turbo_size,
+                        track, sector, NULL, 0,
+                        buffer_sink_write, &dir,
+                        session->msg_cb, no_status);
+        if(rv)
+        {
+            free(dir.data);
+            session->msg_cb( sev_warning, "could not read the directory" );
+            return rv;
+        }
+
+        /*
+         * without the link bytes, each block holds 8 entries which
+         * start every 32 bytes with their file type.
+         */
+        session->entries = malloc((dir.size / 254 + 1) * 8 * sizeof(*session->entries));
+        if(session->entries == NULL)
+        {
+            free(dir.data);
+            session->msg_cb( sev_fatal, "Out of memory" );
+            return -1;
+        }
+
+        for(block = 0; block < dir.size; block += 254)
+        {
+            for(ofs = block; ofs < block + 254 && ofs + 30 <= dir.size; ofs += 32)
+            {
+                e = dir.data + ofs;
+
+                /* only closed SEQ, PRG, USR and REL files */
+                if((e[0] & 0x80) == 0 || (e[0] & 0x07) == 0 || (e[0] & 0x07) > 4)
+                {
+                    continue;
+                }
+
+                entry = &session->entries[session->num_entries++];
+                entry->type = e[0];
+                entry->track = e[1];
+                entry->sector = e[2];
+                entry->blocks = e[28] | (e[29] << 8);
+
+                memcpy(entry->name, e + 3, 16);
+                entry->name[16] = '\0';
+                for(i = 15; i >= 0 && (unsigned char) entry->name[i] == 0xa0; i--)
+                {
+                    entry->name[i] = '\0';
+                }
+            }
+        }
+        free(dir.data);
+    }
+
+    *entries = session->entries;
+    *num_entries = session->num_entries;
+    return 0;
+}
+
+
+int cbmcopy_match_name(const char *pattern, const char *name)
+{
+    for(;;)
+    {
+        if(*pattern == '*')
+        {
+            /* as with the CBM DOS, the rest of the pattern is ignored */
+            return 1;
+        }
+        if(*pattern == '\0' || *name == '\0')
+        {
+            return *pattern == *name;
+        }
+        if(*pattern != '?' && *pattern != *name)
+        {
+            return 0;
+        }
+        pattern++;
+        name++;
+    }
+}
+
+
+int cbmcopy_session_read_entry(cbmcopy_session *session,
+                               const cbmcopy_dir_entry *entry,
+                               cbmcopy_sink_cb sink,
+                               void *sink_context,
+                               cbmcopy_status_cb status_cb)
+{
+    char name[19];
+    size_t len;
+
+    if(session->turbo == NULL)
+    {
+        /* by name and type, as there is no drive code to follow the chain */
+        if((entry->type & 0x07) == 4)
+        {
+            session->msg_cb( sev_warning, "REL files cannot be read without a turbo" );
+            return -1;
+        }
+        len = strlen(entry->name);
+        memcpy(name, entry->name, len);
+        name[len++] = ',';
+        name[len++] = "DSPUR"[entry->type & 0x07];
+        return read_chain(session->fd, session->settings, session->drive,
+                          NULL, 0, 0, 0, name, (int) len,
+                          sink, sink_context, session->msg_cb, status_cb);
+    }
+
+    /* by track/sector, so the drive does not need to look it up */
+    return read_chain(session->fd, session->settings, session->drive,
+                      session->turbo, session->turbo_size,
+                      entry->track, entry->sector, NULL, 0,
+                      sink, sink_context, session->msg_cb, status_cb);
+}
+
+
+int cbmcopy_session_read_files(cbmcopy_session *session,
+                               const char *pattern,
+                               cbmcopy_file_begin_cb begin_cb,
+                               cbmcopy_file_end_cb end_cb,
+                               cbmcopy_sink_cb sink,
+                               void *context,
+                               cbmcopy_status_cb status_cb)
+{
+    const cbmcopy_dir_entry *entries;
+    int num_entries;
+    int errors;
+    int i;
+    int rv;
+
+    rv = cbmcopy_session_read_dir(session, &entries, &num_entries);
+    if(rv)
+    {
+        return rv;
+    }
+
+    errors = 0;
+    for(i = 0; i < num_entries; i++)
+    {
+        if(!cbmcopy_match_name(pattern, entries[i].name))
+        {
+            continue;
+        }
+
+        rv = begin_cb(context, &entries[i]);
+        if(rv < 0)
+        {
+            break;
+        }
+        if(rv > 0)
+        {
+            /* skipped */
+            continue;
+        }
+
+        rv = cbmcopy_session_read_entry(session, &entries[i],
+                                        sink, context, status_cb);
+        end_cb(context, &entries[i], rv);
+        if(rv)
+        {
+            errors++;
+        }
+    }
+    return errors ? -1 : 0;
+}
+
+
 /*! \brief write a data block of a file with a sequence of byte transfers
 
  \param HandleDevice  
@@ -127,6 +127,10 @@ SOURCE=..\d64copy_int.h
 
 SOURCE=..\gcr.h
 # End Source File
+# Begin Source File
+
+SOURCE=..\s1seq.h
+# End Source File
 # End Group
 # Begin Group "CA65"
 
@@ -319,6 +323,68 @@ InputName=turboread1571
 # End Source File
 # Begin Source File
 
+SOURCE=..\turbosum1541.a65
+
+!IF  "$(CFG)" == "libd64copy - Win32 Release"
+
+# Begin Custom Build
+InputDir=\cygwin\home\tri\cbm\opencbm\libd64copy
+InputPath=..\turbosum1541.a65
+InputName=turbosum1541
+
+"$(InputDir)\$(InputName).inc" : $(SOURCE) "$(INTDIR)" "$(OUTDIR)"
+	..\..\WINDOWS\buildoneinc ..\.. $(InputPath)
+
+# End Custom Build
+
+!ELSEIF  "$(CFG)" == "libd64copy - Win32 Debug"
+
+# Begin Custom Build
+InputDir=\cygwin\home\tri\cbm\opencbm\libd64copy
+InputPath=..\turbosum1541.a65
+InputName=turbosum1541
+
+"$(InputDir)\$(InputName).inc" : $(SOURCE) "$(INTDIR)" "$(OUTDIR)"
+	..\..\WINDOWS\buildoneinc ..\.. $(InputPath)
+
+# End Custom Build
+
+!ENDIF 
+
+# End Source File
+# Begin Source File
+
+SOURCE=..\turbosum1571.a65
+
+!IF  "$(CFG)" == "libd64copy - Win32 Release"
+
+# Begin Custom Build
+InputDir=\cygwin\home\tri\cbm\opencbm\libd64copy
+InputPath=..\turbosum1571.a65
+InputName=turbosum1571
+
+"$(InputDir)\$(InputName).inc" : $(SOURCE) "$(INTDIR)" "$(OUTDIR)"
+	..\..\WINDOWS\buildoneinc ..\.. $(InputPath)
+
+# End Custom Build
+
+!ELSEIF  "$(CFG)" == "libd64copy - Win32 Debug"
+
+# Begin Custom Build
+InputDir=\cygwin\home\tri\cbm\opencbm\libd64copy
+InputPath=..\turbosum1571.a65
+InputName=turbosum1571
+
+"$(InputDir)\$(InputName).inc" : $(SOURCE) "$(INTDIR)" "$(OUTDIR)"
+	..\..\WINDOWS\buildoneinc ..\.. $(InputPath)
+
+# End Custom Build
+
+!ENDIF 
+
+# End Source File
+# Begin Source File
+
 SOURCE=..\turbowrite1541.a65
 
 !IF  "$(CFG)" == "libd64copy - Win32 Release"
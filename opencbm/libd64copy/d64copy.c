@@ -77,6 +77,22 @@ static const unsigned char turbo_write_1571[] =
 #include "turbowrite1571.inc"
 };
 
+static const unsigned char turbo_sum_1541[] =
+{
+#include "turbosum1541.inc"
+};
+
+static const unsigned char turbo_sum_1571[] =
+{
+#include "turbosum1571.inc"
+};
+
+/* the same drive program as "cbmctrl change" */
+static const unsigned char tdchange[] =
+{
+#include "../cbmctrl/tdchange.inc"
+};
+
 static const struct drive_prog
 {
     int size;
@@ -99,10 +115,9 @@ static const int warp_write_interleave[] = { -1, 0, 6, 12, 4, -1 };
 
 
 /*
- * Variables to make sure writing a block is an atomary process
+ * the context used by the functions without a context argument
  */
-static int atom_mustcleanup = 0;
-static const transfer_funcs *atom_dst;
+static d64copy_context default_context;
 
 
 #ifdef LIBD64COPY_DEBUG
@@ -128,18 +143,26 @@ static int send_turbo(CBM_FILE fd, unsigned char drv, int write, int warp, int d
     prog = &drive_progs[drv_type * 4 + warp * 2 + write];
 
     SETSTATEDEBUG((void)0);
-    return cbm_upload(fd, drv, 0x500, prog->prog, prog->size);
+    return cbm_upload_cached(fd, drv, 0x500, prog->prog, prog->size);
+}
+
+static int send_sum_turbo(CBM_FILE fd, unsigned char drv, int drv_type)
+{
+    SETSTATEDEBUG((void)0);
+    if(drv_type)
+    {
+        return cbm_upload_cached(fd, drv, 0x500, turbo_sum_1571, sizeof(turbo_sum_1571));
+    }
+    return cbm_upload_cached(fd, drv, 0x500, turbo_sum_1541, sizeof(turbo_sum_1541));
 }
 
 extern transfer_funcs d64copy_fs_transfer,
+                      d64copy_fs_src_transfer,
                       d64copy_std_transfer,
                       d64copy_pp_transfer,
                       d64copy_s1_transfer,
                       d64copy_s2_transfer;
 
-static d64copy_message_cb message_cb;
-static d64copy_status_cb status_cb;
-
 int d64copy_sector_count(int two_sided, int track)
 {
     if(two_sided)
@@ -176,6 +199,11 @@ d64copy_settings *d64copy_get_default_settings(void)
         settings->drive_type  = cbm_dt_unknown; /* auto detect later on */
         settings->two_sided   = 0;
         settings->error_mode  = em_on_error;
+        settings->resume      = 0;
+        settings->diff        = 0;
+        settings->verify      = 0;
+        settings->tune_interleave = 0;
+        settings->adapter     = NULL;
     }
     return settings;
 }
@@ -188,30 +216,554 @@ static int start_turbo(CBM_FILE fd, unsigned char drive)
 }
 
 
-static int copy_disk(CBM_FILE fd_cbm, d64copy_settings *settings,
+/*
+ * the part of the state of copy_disk() which is updated whenever a
+ * sector is finished. In warp read mode, this is done by a helper
+ * thread, see copy_pipe below.
+ */
+typedef struct
+{
+    d64copy_context *ctx;
+    const transfer_funcs *dst;
+    d64copy_status status;
+    char trackmap[MAX_SECTORS+1];
+    unsigned char errors;
+    int retry_count;
+    int cnt;
+} copy_state;
+
+/* one sector on its way from the drive to the image */
+typedef struct
+{
+    unsigned char tr;
+    unsigned char se;
+    int read_result;
+    unsigned char gcr[GCRBUFSIZE];
+    unsigned char block[BLOCKSIZE];
+} pipe_slot;
+
+/* number of sectors which may be received ahead of the image writes */
+#define PIPE_SLOTS 8
+
+/*
+ * In warp read mode, the drive sends the sectors of a track as they pass
+ * by the head. While copy_disk() waits for the next one, a helper thread
+ * decodes the previous ones, writes them to the image and updates the
+ * state. copy_disk() only owns the slot between pipe_get() and
+ * pipe_put()/pipe_unget(); after pipe_drain(), the helper thread is idle
+ * and copy_state may be accessed again.
+ */
+typedef struct
+{
+    copy_state *cs;
+    ARCH_SEMAPHORE free_slots;
+    ARCH_SEMAPHORE used_slots;
+    ARCH_THREAD thread;
+    int head;
+    int tail;
+    int held;
+    int quit;
+    pipe_slot slot[PIPE_SLOTS];
+} copy_pipe;
+
+static void report_progress(copy_state *cs, d64copy_event_type type)
+{
+    d64copy_context *ctx = cs->ctx;
+    d64copy_event event;
+
+    if(ctx->event_cb)
+    {
+        event.type              = type;
+        event.track             = cs->status.track;
+        event.sector            = cs->status.sector;
+        event.read_result       = cs->status.read_result;
+        event.write_result      = cs->status.write_result;
+        event.sectors_processed = cs->status.sectors_processed;
+        event.total_sectors     = cs->status.total_sectors;
+
+        ctx->event_cb(ctx, &event, ctx->event_arg);
+    }
+
+    /* the status callback has never been told when the copy is done */
+    if(ctx->status_cb && type != d64copy_ev_done)
+    {
+        ctx->status_cb(cs->status);
+    }
+}
+
+static void finish_sector(copy_state *cs, unsigned char tr, unsigned char se)
+{
+    if(cs->status.read_result)
+    {
+        /* read error */
+        cs->trackmap[se] = bs_error;
+        cs->errors++;
+        if(cs->retry_count == 0)
+        {
+            cs->status.sectors_processed++;
+            /* FIXME: shall we get rid of this? */
+            cs->ctx->message_cb( 1, "read error: %02x/%02x: %d",
+                                 tr, se, cs->status.read_result );
+        }
+    }
+    else
+    {
+        /* successfull read */
+        if(cs->status.write_result)
+        {
+            /* write error */
+            cs->trackmap[se] = bs_error;
+            cs->errors++;
+            if(cs->retry_count == 0)
+            {
+                cs->status.sectors_processed++;
+                /* FIXME: shall we get rid of this? */
+                cs->ctx->message_cb(1, "write error: %02x/%02x: %d",
+                                    tr, se, cs->status.write_result);
+            }
+        }
+        else
+        {
+            /* successfull read and write, mark sector */
+            cs->trackmap[se] = bs_copied;
+            cs->cnt++;
+            cs->status.sectors_processed++;
+        }
+    }
+
+    cs->status.track = tr;
+    cs->status.sector= se;
+    cs->status.bam[tr-1][se] = cs->trackmap[se];
+    if(cs->ctx->journal)
+    {
+        cbmlibmisc_journal_update(cs->ctx->journal,
+            &cs->status.bam[tr-1][se] - &cs->status.bam[0][0],
+            cs->trackmap[se]);
+    }
+
+    report_progress(cs, d64copy_ev_sector);
+}
+
+static void pipe_thread(void *context)
+{
+    copy_pipe *pipe = context;
+    copy_state *cs = pipe->cs;
+    pipe_slot *slot;
+
+    for(;;)
+    {
+        arch_semaphore_wait(pipe->used_slots);
+        if(pipe->quit)
+        {
+            break;
+        }
+        slot = &pipe->slot[pipe->tail];
+
+        SETSTATEDEBUG((void)0);
+        cs->status.read_result = gcr_decode(slot->gcr, slot->block);
+        SETSTATEDEBUG(DebugBlockCount++);
+        cs->status.write_result =
+            cs->dst->write_block(cs->ctx, slot->tr, slot->se, slot->block,
+                                 BLOCKSIZE, cs->status.read_result);
+        SETSTATEDEBUG((void)0);
+
+        finish_sector(cs, slot->tr, slot->se);
+
+        pipe->tail = (pipe->tail + 1) % PIPE_SLOTS;
+        arch_semaphore_post(pipe->free_slots);
+    }
+}
+
+static copy_pipe *pipe_create(copy_state *cs)
+{
+    copy_pipe *pipe;
+
+    pipe = calloc(1, sizeof(*pipe));
+    if(pipe)
+    {
+        pipe->cs = cs;
+        pipe->free_slots = arch_semaphore_create(PIPE_SLOTS);
+        pipe->used_slots = arch_semaphore_create(0);
+        if(pipe->free_slots && pipe->used_slots)
+        {
+            pipe->thread = arch_thread_create(pipe_thread, pipe);
+        }
+        if(pipe->thread == NULL)
+        {
+            if(pipe->free_slots) arch_semaphore_destroy(pipe->free_slots);
+            if(pipe->used_slots) arch_semaphore_destroy(pipe->used_slots);
+            free(pipe);
+            pipe = NULL;
+        }
+    }
+    return pipe;
+}
+
+static void pipe_destroy(copy_pipe *pipe)
+{
+    pipe->quit = 1;
+    arch_semaphore_post(pipe->used_slots);
+    arch_thread_join(pipe->thread);
+
+    arch_semaphore_destroy(pipe->free_slots);
+    arch_semaphore_destroy(pipe->used_slots);
+    free(pipe);
+}
+
+/* get the next free slot, waiting for the helper thread if necessary */
+static pipe_slot *pipe_get(copy_pipe *pipe)
+{
+    arch_semaphore_wait(pipe->free_slots);
+    pipe->held = 1;
+    return &pipe->slot[pipe->head];
+}
+
+/* hand the slot from pipe_get() to the helper thread */
+static void pipe_put(copy_pipe *pipe)
+{
+    pipe->head = (pipe->head + 1) % PIPE_SLOTS;
+    pipe->held = 0;
+    arch_semaphore_post(pipe->used_slots);
+}
+
+/* give back the slot from pipe_get() without processing it */
+static void pipe_unget(copy_pipe *pipe)
+{
+    pipe->held = 0;
+    arch_semaphore_post(pipe->free_slots);
+}
+
+/* wait until the helper thread has processed all slots handed to it */
+static void pipe_drain(copy_pipe *pipe)
+{
+    int i;
+    int n = PIPE_SLOTS - pipe->held;
+
+    for(i = 0; i < n; i++)
+    {
+        arch_semaphore_wait(pipe->free_slots);
+    }
+    for(i = 0; i < n; i++)
+    {
+        arch_semaphore_post(pipe->free_slots);
+    }
+}
+
+
+/*
+ * When reading a disk into an image, the sector map is kept in a journal
+ * next to the image. If resume is set, the sectors an interrupted copy
+ * has already finished are taken from there and are not read again.
+ * disk identifies the source disk (NULL if its BAM could not be read);
+ * a journal written for another disk is never resumed.
+ * Returns the number of these sectors, or -1 if the copy must not go on.
+ */
+static int journal_start(copy_state *cs, const char *image, int resume,
+                         const char *disk)
+{
+    d64copy_context *ctx = cs->ctx;
+    char old_bam[MAX_TRACKS][MAX_SECTORS+1];
+    char id[40];
+    int tr, se;
+    int restored = 0;
+
+    sprintf(id, "d64copy %dx%d %s", MAX_TRACKS, MAX_SECTORS+1,
+            cs->status.settings->two_sided ? "d71" : "d64");
+
+    if(resume && disk == NULL)
+    {
+        ctx->message_cb(0, "can't identify the disk without its BAM, refusing to resume");
+        return -1;
+    }
+
+    if(resume)
+    {
+        switch(cbmlibmisc_journal_load(image, id, disk, old_bam, sizeof(old_bam)))
+        {
+            case 0:
+                for(tr = 0; tr < MAX_TRACKS; tr++)
+                {
+                    for(se = 0; se < MAX_SECTORS+1; se++)
+                    {
+                        if(old_bam[tr][se] == bs_copied &&
+                           cs->status.bam[tr][se] == bs_must_copy)
+                        {
+                            cs->status.bam[tr][se] = bs_copied;
+                            restored++;
+                        }
+                    }
+                }
+                ctx->message_cb(2, "resuming, %d sectors copied already", restored);
+                break;
+            case 1:
+                ctx->message_cb(1, "no journal found, copying all sectors");
+                break;
+            case -2:
+                ctx->message_cb(0, "the journal was written for another disk, refusing to resume");
+                return -1;
+            default:
+                ctx->message_cb(1, "journal does not match, copying all sectors");
+                break;
+        }
+    }
+
+    ctx->journal = cbmlibmisc_journal_create(image, id, disk ? disk : "unknown",
+                                             cs->status.bam,
+                                             sizeof(cs->status.bam));
+    if(ctx->journal == NULL)
+    {
+        ctx->message_cb(1, "could not create journal, copy cannot be resumed");
+    }
+    return restored;
+}
+
+/*
+ * the checksum the turbo checksum program computes: the Fletcher sums
+ * A and B, both modulo 256
+ */
+static void block_sum(const unsigned char *block, unsigned char *sum)
+{
+    unsigned char a = 0, b = 0;
+    int i;
+
+    for(i = 0; i < BLOCKSIZE; i++)
+    {
+        a = (unsigned char) (a + block[i]);
+        b = (unsigned char) (b + a);
+    }
+    sum[0] = a;
+    sum[1] = b;
+}
+
+/*
+ * Compare the sectors in state "select" on the disk with the image. Those
+ * which are equal are put into state "same", the others (and those which
+ * cannot be read) into state "differ". With a turbo transfer, the drive
+ * only sends a checksum of every sector, else the sectors are read.
+ * This is used to skip unchanged sectors before writing a disk (diff) and
+ * to check the sectors after writing it (verify).
+ * Returns the number of sectors which are equal.
+ */
+static int compare_disk(copy_state *cs, const transfer_funcs *src,
+                        const transfer_funcs *dst, const char *sector_map,
+                        int max_tracks, char select, char same, char differ)
+{
+    d64copy_context *ctx = cs->ctx;
+    unsigned char block[BLOCKSIZE];
+    unsigned char disk_sum[SUMSIZE];
+    unsigned char image_sum[SUMSIZE];
+    char pending[MAX_SECTORS+1];
+    unsigned char tr, se;
+    int scnt, st;
+    int equal = 0;
+
+    for(tr = 1; tr <= max_tracks; tr++)
+    {
+        scnt = 0;
+        for(se = 0; se < sector_map[tr]; se++)
+        {
+            pending[se] = (cs->status.bam[tr-1][se] == select);
+            scnt += pending[se];
+        }
+
+        se = 0;
+        while(scnt)
+        {
+            while(!pending[se])
+            {
+                if(++se >= sector_map[tr]) se = 0;
+            }
+            pending[se] = 0;
+            scnt--;
+
+            SETSTATEDEBUG(DebugBlockCount++);
+            if(dst->read_sum)
+            {
+                st = dst->read_sum(ctx, tr, se, disk_sum);
+            }
+            else
+            {
+                st = dst->read_block(ctx, tr, se, block);
+                block_sum(block, disk_sum);
+            }
+
+            cs->status.bam[tr-1][se] = differ;
+            if(st == 0 && src->read_block(ctx, tr, se, block) == 0)
+            {
+                block_sum(block, image_sum);
+                if(memcmp(disk_sum, image_sum, SUMSIZE) == 0)
+                {
+                    cs->status.bam[tr-1][se] = same;
+                    equal++;
+                }
+            }
+
+            se += (unsigned char) cs->status.settings->interleave;
+            if(se >= sector_map[tr]) se -= sector_map[tr];
+        }
+    }
+    return equal;
+}
+
+/*
+ * replace the drive program of an open destination drive, e.g. the
+ * checksum program by the write program
+ */
+static int reopen_drive(d64copy_context *ctx, CBM_FILE fd_cbm,
+                        d64copy_settings *settings, const transfer_funcs *dst,
+                        const void *dst_arg, unsigned char cbm_drive, int sum)
+{
+    int drv_type = settings->drive_type == cbm_dt_cbm1541 ? 0 : 1;
+
+    dst->close_disk(ctx);
+    SETSTATEDEBUG((void)0);
+    if(sum)
+    {
+        send_sum_turbo(fd_cbm, cbm_drive, drv_type);
+    }
+    else
+    {
+        send_turbo(fd_cbm, cbm_drive, 1, settings->warp, drv_type);
+    }
+    if(dst->open_disk(ctx, fd_cbm, settings, dst_arg, 1,
+                      start_turbo, ctx->message_cb) != 0)
+    {
+        ctx->message_cb(0, "can't open destination");
+        return -1;
+    }
+    return 0;
+}
+
+/* check if all sectors of the image have been copied */
+static int copy_complete(const d64copy_status *status)
+{
+    int tr, se;
+
+    for(tr = 0; tr < MAX_TRACKS; tr++)
+    {
+        for(se = 0; se < MAX_SECTORS+1; se++)
+        {
+            if(NEED_SECTOR(status->bam[tr][se]))
+            {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/* number of interleave values tried by --tune-interleave */
+#define TUNE_CANDIDATES 5
+
+static const char *transfer_mode_name(int transfer_mode);
+
+/*
+ * the name under which the tuned interleave for this adapter, drive,
+ * transfer mode and direction is kept in the configuration file
+ */
+static void interleave_key(const d64copy_settings *settings, int read,
+                           char *key, size_t size)
+{
+    arch_snprintf(key, size, "interleave:%s:%s:%s:%s%s",
+                  settings->adapter ? settings->adapter : "default",
+                  settings->drive_type == cbm_dt_cbm1541 ? "1541" : "1571",
+                  transfer_mode_name(settings->transfer_mode),
+                  read ? "read" : "write",
+                  settings->warp ? ":warp" : "");
+    key[size-1] = '\0';
+}
+
+/*
+ * the interleave values tried when tuning: the default one and its
+ * neighbours. Returns the number of candidates.
+ */
+static int tune_candidates(int interleave, int *cand)
+{
+    static const int offset[TUNE_CANDIDATES] = { 0, -1, 1, -2, 2 };
+    int lowest = interleave < 1 ? interleave : 1;
+    int i, cnt = 0;
+
+    for(i = 0; i < TUNE_CANDIDATES; i++)
+    {
+        if(interleave + offset[i] >= lowest && interleave + offset[i] <= 17)
+        {
+            cand[cnt++] = interleave + offset[i];
+        }
+    }
+    return cnt;
+}
+
+/*
+ * pick the candidate which needed the least time for its track and
+ * remember it for the next runs
+ */
+static int tune_finish(d64copy_context *ctx, const char *key,
+                       const int *cand, const unsigned long *ms, int cnt)
+{
+    char value[8];
+    int i, best = 0;
+
+    for(i = 0; i < cnt; i++)
+    {
+        ctx->message_cb(3, "interleave %d: %lu ms per track", cand[i], ms[i]);
+        if(ms[i] < ms[best])
+        {
+            best = i;
+        }
+    }
+    ctx->message_cb(2, "tuned interleave: %d", cand[best]);
+
+    arch_snprintf(value, sizeof(value), "%d", cand[best]);
+    if(cbm_set_config_value("d64copy", key, value) != 0)
+    {
+        ctx->message_cb(1, "could not store the tuned interleave in the per-user configuration file");
+    }
+    return cand[best];
+}
+
+static int copy_disk(d64copy_context *ctx, CBM_FILE fd_cbm, d64copy_settings *settings,
               const transfer_funcs *src, const void *src_arg,
               const transfer_funcs *dst, const void *dst_arg, unsigned char cbm_drive)
 {
     unsigned char tr = 0;
     unsigned char se = 0;
     int st;
-    int cnt  = 0;
     unsigned char scnt = 0;
-    unsigned char errors;
-    int retry_count;
     int resend_trackmap;
     int max_tracks;
-    char trackmap[MAX_SECTORS+1];
     char buf[40];
     unsigned const char *bam_ptr;
     unsigned char bam[BLOCKSIZE];
     unsigned char bam2[BLOCKSIZE];
+    unsigned char bam_sum[4];
+    char disk[40];
+    int bam_read = 0;
     unsigned char block[BLOCKSIZE];
     unsigned char gcr[GCRBUFSIZE];
     const transfer_funcs *cbm_transf = NULL;
-    d64copy_status status;
+    copy_state cs;
+    copy_pipe *pipe = NULL;
+    pipe_slot *slot;
     const char *sector_map;
     const char *type_str = "*unknown*";
+    off_t filesize;
+    int resume;
+    int diff;
+    int interleave_given = settings->interleave != -1;
+    int have_drive = src->is_cbm_drive || dst->is_cbm_drive;
+    int default_il;
+    int tune_cand[TUNE_CANDIDATES];
+    unsigned long tune_ms[TUNE_CANDIDATES];
+    unsigned long tune_start = 0;
+    int tune_cnt = 0;
+    int tune_next = 0;
+    int tuning = 0;
+    char tune_key[80];
+    char value[8];
+
+    memset(&cs, 0, sizeof(cs));
+    cs.ctx = ctx;
+    cs.dst = dst;
 
     if(settings->two_sided)
     {
@@ -225,14 +777,14 @@ static int copy_disk(CBM_FILE fd_cbm, d64copy_settings *settings,
     if(settings->interleave != -1 &&
            (settings->interleave < 1 || settings->interleave > 17))
     {
-        message_cb(0,
+        ctx->message_cb(0,
                 "invalid value (%d) for interleave", settings->interleave);
         return -1;
     }
 
     if(settings->start_track < 1 || settings->start_track > max_tracks)
     {
-        message_cb(0,
+        ctx->message_cb(0,
                 "invalid value (%d) for start track", settings->start_track);
         return -1;
     }
@@ -241,12 +793,17 @@ static int copy_disk(CBM_FILE fd_cbm, d64copy_settings *settings,
        (settings->end_track < settings->start_track ||
         settings->end_track > max_tracks))
     {
-        message_cb(0,
+        ctx->message_cb(0,
                 "invalid value (%d) for end track", settings->end_track);
         return -1;
     }
 
-    if(settings->interleave == -1)
+    if(settings->interleave == -1 && !have_drive)
+    {
+        /* there is no timing to care about, copy the sectors in order */
+        settings->interleave = 1;
+    }
+    else if(settings->interleave == -1)
     {
         settings->interleave = (dst->is_cbm_drive && settings->warp) ?
             warp_write_interleave[settings->transfer_mode] :
@@ -256,12 +813,12 @@ static int copy_disk(CBM_FILE fd_cbm, d64copy_settings *settings,
     }
 
 
-    if(settings->drive_type == cbm_dt_unknown )
+    if(have_drive && settings->drive_type == cbm_dt_unknown )
     {
-        message_cb( 2, "Trying to identify drive type" );
+        ctx->message_cb( 2, "Trying to identify drive type" );
         if( cbm_identify( fd_cbm, cbm_drive, &settings->drive_type, NULL ) )
         {
-            message_cb( 0, "could not identify device" );
+            ctx->message_cb( 0, "could not identify device" );
         }
 
         switch( settings->drive_type )
@@ -272,10 +829,10 @@ static int copy_disk(CBM_FILE fd_cbm, d64copy_settings *settings,
                 /* fine */
                 break;
             case cbm_dt_cbm1581:
-                message_cb( 0, "1581 drives are not supported" );
+                ctx->message_cb( 0, "1581 drives are not supported" );
                 return -1;
             default:
-                message_cb( 1, "Unknown drive, assuming 1541" );
+                ctx->message_cb( 1, "Unknown drive, assuming 1541" );
                 settings->drive_type = cbm_dt_cbm1541;
                 break;
         }
@@ -283,43 +840,41 @@ static int copy_disk(CBM_FILE fd_cbm, d64copy_settings *settings,
 
     sector_map = settings->two_sided ? d71_sector_map : d64_sector_map;
 
-    SETSTATEDEBUG((void)0);
-    cbm_exec_command(fd_cbm, cbm_drive, "I0:", 0);
-    SETSTATEDEBUG((void)0);
-    cnt = cbm_device_status(fd_cbm, cbm_drive, buf, sizeof(buf));
-    SETSTATEDEBUG((void)0);
-
-    switch( settings->drive_type )
+    /* an image to image copy has no drive to set up */
+    if(have_drive)
     {
-        case cbm_dt_cbm1541: type_str = "1541"; break;
-        case cbm_dt_cbm1570: type_str = "1570"; break;
-        case cbm_dt_cbm1571: type_str = "1571"; break;
-        default: /* impossible */ break;
-    }
+        SETSTATEDEBUG((void)0);
+        cbm_exec_command(fd_cbm, cbm_drive, "I0:", 0);
+        SETSTATEDEBUG((void)0);
+        st = cbm_device_status(fd_cbm, cbm_drive, buf, sizeof(buf));
+        SETSTATEDEBUG((void)0);
 
-    message_cb(cnt != 0 ? 0 : 2, "drive %02d (%s): %s",
-               cbm_drive, type_str, buf );
+        switch( settings->drive_type )
+        {
+            case cbm_dt_cbm1541: type_str = "1541"; break;
+            case cbm_dt_cbm1570: type_str = "1570"; break;
+            case cbm_dt_cbm1571: type_str = "1571"; break;
+            default: /* impossible */ break;
+        }
 
-    if(cnt)
-    {
-        return -1;
-    }
+        ctx->message_cb(st != 0 ? 0 : 2, "drive %02d (%s): %s",
+                        cbm_drive, type_str, buf );
 
-    if(settings->two_sided)
-    {
-        if(settings->drive_type != cbm_dt_cbm1571)
+        if(st)
         {
-            message_cb(0, ".d71 transfer requires a 1571 drive");
             return -1;
         }
-        if(settings->warp)
+
+        if(settings->two_sided)
         {
-            if(settings->warp>0)
-                message_cb(1, "`-w' for .d71 transfer in warp mode ignored");
-            settings->warp = 0;
+            if(settings->drive_type != cbm_dt_cbm1571)
+            {
+                ctx->message_cb(0, ".d71 transfer requires a 1571 drive");
+                return -1;
+            }
+            SETSTATEDEBUG((void)0);
+            cbm_exec_command(fd_cbm, cbm_drive, "U0>M1", 0);
         }
-        SETSTATEDEBUG((void)0);
-        cbm_exec_command(fd_cbm, cbm_drive, "U0>M1", 0);
     }
 
     SETSTATEDEBUG((void)0);
@@ -328,22 +883,67 @@ static int copy_disk(CBM_FILE fd_cbm, d64copy_settings *settings,
     if(settings->warp && (cbm_transf->read_gcr_block == NULL))
     {
         if(settings->warp>0)
-            message_cb(1, "`-w' for this transfer mode ignored");
+            ctx->message_cb(1, "`-w' for this transfer mode ignored");
         settings->warp = 0;
     }
 
     settings->warp = settings->warp ? 1 : 0;
 
+    /*
+     * Unless an interleave has been given, use the one found by an
+     * earlier --tune-interleave run, or find one now. In warp read
+     * mode, the drive sends the sectors in the order they pass by.
+     */
+    default_il = settings->interleave;
+    if(have_drive && !interleave_given && !(settings->warp && src->is_cbm_drive))
+    {
+        interleave_key(settings, src->is_cbm_drive, tune_key, sizeof(tune_key));
+        if(settings->tune_interleave)
+        {
+            tune_cnt = tune_candidates(settings->interleave, tune_cand);
+        }
+        else if(cbm_get_config_value("d64copy", tune_key,
+                                     value, sizeof(value)) == 0)
+        {
+            st = atoi(value);
+            if(st >= 0 && st <= 17)
+            {
+                settings->interleave = default_il = st;
+                ctx->message_cb(2, "using tuned interleave %d", st);
+            }
+        }
+    }
+
+    /* only compare with the disk if there is a disk to write to */
+    diff = settings->diff && dst->is_cbm_drive;
+
     if(cbm_transf->needs_turbo)
     {
         SETSTATEDEBUG((void)0);
-        send_turbo(fd_cbm, cbm_drive, dst->is_cbm_drive, settings->warp,
-                   settings->drive_type == cbm_dt_cbm1541 ? 0 : 1);
+        if(diff)
+        {
+            /* the write program is sent after comparing, see below */
+            send_sum_turbo(fd_cbm, cbm_drive,
+                           settings->drive_type == cbm_dt_cbm1541 ? 0 : 1);
+        }
+        else
+        {
+            send_turbo(fd_cbm, cbm_drive, dst->is_cbm_drive, settings->warp,
+                       settings->drive_type == cbm_dt_cbm1541 ? 0 : 1);
+        }
+    }
+
+    /* only resume if there is something to resume */
+    resume = settings->resume && !dst->is_cbm_drive;
+    if(resume && arch_filesize((const char *) dst_arg, &filesize) != 0)
+    {
+        ctx->message_cb(1, "no image to resume, copying all sectors");
+        resume = 0;
     }
 
     SETSTATEDEBUG((void)0);
-    if(src->open_disk(fd_cbm, settings, src_arg, 0,
-                      start_turbo, message_cb) == 0)
+    if(src->open_disk(ctx, fd_cbm, settings, src_arg, 0,
+                      start_turbo, ctx->message_cb) == 0)
     {
         if(settings->end_track == -1)
         {
@@ -351,62 +951,75 @@ static int copy_disk(CBM_FILE fd_cbm, d64copy_settings *settings,
                 settings->two_sided ? D71_TRACKS : STD_TRACKS;
         }
         SETSTATEDEBUG((void)0);
-        if(dst->open_disk(fd_cbm, settings, dst_arg, 1,
-                          start_turbo, message_cb) != 0)
+        if(dst->open_disk(ctx, fd_cbm, settings, dst_arg, 1,
+                          start_turbo, ctx->message_cb) != 0)
         {
-            message_cb(0, "can't open destination");
+            ctx->message_cb(0, "can't open destination");
             return -1;
         }
     }
     else
     {
-        message_cb(0, "can't open source");
+        ctx->message_cb(0, "can't open source");
         return -1;
     }
 
-    memset(status.bam, bs_invalid, MAX_TRACKS * MAX_SECTORS);
+    memset(cs.status.bam, bs_invalid, MAX_TRACKS * MAX_SECTORS);
 
-    if(settings->bam_mode != bm_ignore)
+    /* the journal of an image needs the BAM to identify the disk */
+    if(settings->bam_mode != bm_ignore || !dst->is_cbm_drive)
     {
         if(settings->warp && src->is_cbm_drive)
         {
-            memset(trackmap, bs_dont_copy, sector_map[18]);
-            trackmap[0] = bs_must_copy;
+            memset(cs.trackmap, bs_dont_copy, sector_map[18]);
+            cs.trackmap[0] = bs_must_copy;
             scnt = 1;
             SETSTATEDEBUG((void)0);
-            src->send_track_map(18, trackmap, scnt);
+            src->send_track_map(ctx, 18, cs.trackmap, scnt);
             SETSTATEDEBUG(DebugBlockCount=0);
-            st = src->read_gcr_block(&se, gcr);
-            SETSTATEDEBUG(DebugBlockCount=-1);
+            st = src->read_gcr_block(ctx, &se, gcr);
             if(st == 0) st = gcr_decode(gcr, bam);
+            if(settings->two_sided && (st == 0))
+            {
+                SETSTATEDEBUG((void)0);
+                src->send_track_map(ctx, 53, cs.trackmap, scnt);
+                SETSTATEDEBUG(DebugBlockCount=1);
+                st = src->read_gcr_block(ctx, &se, gcr);
+                if(st == 0) st = gcr_decode(gcr, bam2);
+            }
+            SETSTATEDEBUG(DebugBlockCount=-1);
         }
         else
         {
             SETSTATEDEBUG(DebugBlockCount=0);
-            st = src->read_block(18, 0, bam);
+            st = src->read_block(ctx, 18, 0, bam);
             if(settings->two_sided && (st == 0))
             {
                 SETSTATEDEBUG(DebugBlockCount=1);
-                st = src->read_block(53, 0, bam2);
+                st = src->read_block(ctx, 53, 0, bam2);
             }
             SETSTATEDEBUG(DebugBlockCount=-1);
         }
         if(st)
         {
-            message_cb(1, "failed to read BAM (%d)", st);
+            ctx->message_cb(1, "failed to read BAM (%d)", st);
             settings->bam_mode = bm_ignore;
         }
+        else
+        {
+            bam_read = 1;
+        }
     }
     SETSTATEDEBUG((void)0);
 
-    memset(&status, 0, sizeof(status));
+    memset(&cs.status, 0, sizeof(cs.status));
 
     /* setup BAM */
     for(tr = 1; tr <= max_tracks; tr++)
     {
         if(tr < settings->start_track || tr > settings->end_track)
         {
-            memset(status.bam[tr-1], bs_dont_copy, sector_map[tr]);
+            memset(cs.status.bam[tr-1], bs_dont_copy, sector_map[tr]);
         }
         else if(settings->bam_mode == bm_allocated ||
                 (settings->bam_mode == bm_save && (tr % 35 != 18)))
@@ -423,28 +1036,76 @@ static int copy_disk(CBM_FILE fd_cbm, d64copy_settings *settings,
                 }
                 if(bam_ptr[se/8]&(1<<(se&0x07)))
                 {
-                    status.bam[tr-1][se] = bs_dont_copy;
+                    cs.status.bam[tr-1][se] = bs_dont_copy;
                 }
                 else
                 {
-                    status.bam[tr-1][se] = bs_must_copy;
-                    status.total_sectors++;
+                    cs.status.bam[tr-1][se] = bs_must_copy;
+                    cs.status.total_sectors++;
                 }
             }
         }
         else
         {
-            status.total_sectors += sector_map[tr];
-            memset(status.bam[tr-1], bs_must_copy, sector_map[tr]);
+            cs.status.total_sectors += sector_map[tr];
+            memset(cs.status.bam[tr-1], bs_must_copy, sector_map[tr]);
+        }
+    }
+
+    cs.status.settings = settings;
+    ctx->status = &cs.status;
+
+    if(diff)
+    {
+        ctx->message_cb(2, "comparing %d sectors with the disk",
+                        cs.status.total_sectors);
+        st = compare_disk(&cs, src, dst, sector_map, max_tracks,
+                          bs_must_copy, bs_dont_copy, bs_must_copy);
+        cs.status.total_sectors -= st;
+        ctx->message_cb(2, "%d sectors unchanged", st);
+
+        /* replace the checksum program with the write program */
+        if(cbm_transf->needs_turbo &&
+           reopen_drive(ctx, fd_cbm, settings, dst, dst_arg, cbm_drive, 0) != 0)
+        {
+            ctx->status = NULL;
+            return -1;
         }
     }
 
-    status.settings = settings;
+    if(!dst->is_cbm_drive)
+    {
+        /* the disk ID and the checksums of the BAM identify the disk */
+        if(bam_read)
+        {
+            block_sum(bam, bam_sum);
+            block_sum(settings->two_sided ? bam2 : bam, bam_sum + 2);
+            sprintf(disk, "id %02x%02x bam %02x%02x%02x%02x",
+                    bam[0xa2], bam[0xa3],
+                    bam_sum[0], bam_sum[1], bam_sum[2], bam_sum[3]);
+        }
+        st = journal_start(&cs, (const char *) dst_arg, resume,
+                           bam_read ? disk : NULL);
+        if(st < 0)
+        {
+            dst->close_disk(ctx);
+            src->close_disk(ctx);
+            ctx->status = NULL;
+            return -1;
+        }
+        cs.status.sectors_processed = st;
+    }
 
-    status_cb(status);
+    report_progress(&cs, d64copy_ev_start);
 
-    message_cb(2, "copying tracks %d-%d (%d sectors)",
-            settings->start_track, settings->end_track, status.total_sectors);
+    ctx->message_cb(2, "copying tracks %d-%d (%d sectors)",
+            settings->start_track, settings->end_track, cs.status.total_sectors);
+
+    if(settings->warp && src->is_cbm_drive && !dst->is_cbm_drive)
+    {
+        /* if this fails, we just do everything ourselves */
+        pipe = pipe_create(&cs);
+    }
 
     SETSTATEDEBUG(DebugBlockCount=0);
     for(tr = 1; tr <= max_tracks; tr++)
@@ -452,53 +1113,82 @@ static int copy_disk(CBM_FILE fd_cbm, d64copy_settings *settings,
         if(tr >= settings->start_track && tr <= settings->end_track)
         {
             scnt = sector_map[tr];
-            memcpy(trackmap, status.bam[tr-1], scnt);
-            if(settings->bam_mode != bm_ignore)
+            memcpy(cs.trackmap, cs.status.bam[tr-1], scnt);
+            for(se = 0; se < sector_map[tr]; se++)
             {
-                for(se = 0; se < sector_map[tr]; se++)
+                if(cs.trackmap[se] != bs_must_copy)
                 {
-                    if(trackmap[se] != bs_must_copy)
-                    {
-                        scnt--;
-                    }
+                    scnt--;
                 }
             }
 
-            retry_count = settings->retries;
+            /* every candidate is timed on a complete track of the same zone */
+            tuning = tune_next < tune_cnt &&
+                     scnt == sector_map[tr] && sector_map[tr] == sector_map[1];
+            if(tuning)
+            {
+                settings->interleave = tune_cand[tune_next];
+                tune_start = arch_time_ms();
+            }
+
+            cs.retry_count = settings->retries;
+            /* retries go on from the current head position */
+            se = 0;
             do
             {
-                errors = resend_trackmap = 0;
+                cs.errors = resend_trackmap = 0;
                 if(scnt && settings->warp && src->is_cbm_drive)
                 {
                     SETSTATEDEBUG((void)0);
-                    src->send_track_map(tr, trackmap, scnt);
-                }
-                else
-                {
-                    se = 0;
+                    src->send_track_map(ctx, tr, cs.trackmap, scnt);
                 }
                 while(scnt && !resend_trackmap)
                 {
                     if(settings->warp && src->is_cbm_drive)
                     {
-                        SETSTATEDEBUG((void)0);
-                        status.read_result = src->read_gcr_block(&se, gcr);
-                        if(status.read_result == 0)
+                        if(pipe)
+                        {
+                            SETSTATEDEBUG((void)0);
+                            slot = pipe_get(pipe);
+                            slot->tr = tr;
+                            slot->read_result =
+                                src->read_gcr_block(ctx, &slot->se, slot->gcr);
+                            if(slot->read_result == 0)
+                            {
+                                /* the helper thread decodes and writes this
+                                 * sector while we wait for the next one */
+                                pipe_put(pipe);
+                                scnt--;
+                                continue;
+                            }
+                            /* the trackmap must be up to date before the
+                             * error handling below looks at it */
+                            pipe_drain(pipe);
+                            se = slot->se;
+                            cs.status.read_result = slot->read_result;
+                            pipe_unget(pipe);
+                        }
+                        else
                         {
                             SETSTATEDEBUG((void)0);
-                            status.read_result = gcr_decode(gcr, block);
+                            cs.status.read_result = src->read_gcr_block(ctx, &se, gcr);
+                        }
+                        if(cs.status.read_result == 0)
+                        {
+                            SETSTATEDEBUG((void)0);
+                            cs.status.read_result = gcr_decode(gcr, block);
                         }
                         else
                         {
                             /* mark all sectors not received so far */
                             /* ugly */
-                            errors = 0;
+                            cs.errors = 0;
                             for(scnt = 0; scnt < sector_map[tr]; scnt++)
                             {
-                                if(NEED_SECTOR(trackmap[scnt]) && scnt != se)
+                                if(NEED_SECTOR(cs.trackmap[scnt]) && scnt != se)
                                 {
-                                    trackmap[scnt] = bs_error;
-                                    errors++;
+                                    cs.trackmap[scnt] = bs_error;
+                                    cs.errors++;
                                 }
                             }
                             resend_trackmap = 1;
@@ -506,12 +1196,12 @@ static int copy_disk(CBM_FILE fd_cbm, d64copy_settings *settings,
                     }
                     else
                     {
-                        while(!NEED_SECTOR(trackmap[se]))
+                        while(!NEED_SECTOR(cs.trackmap[se]))
                         {
                             if(++se >= sector_map[tr]) se = 0;
                         }
                         SETSTATEDEBUG(DebugBlockCount++);
-                        status.read_result = src->read_block(tr, se, block);
+                        cs.status.read_result = src->read_block(ctx, tr, se, block);
                     }
 
                     if(settings->warp && dst->is_cbm_drive)
@@ -519,84 +1209,65 @@ static int copy_disk(CBM_FILE fd_cbm, d64copy_settings *settings,
                         SETSTATEDEBUG((void)0);
                         gcr_encode(block, gcr);
                         SETSTATEDEBUG(DebugBlockCount++);
-                        status.write_result = 
-                            dst->write_block(tr, se, gcr, GCRBUFSIZE-1,
-                                             status.read_result);
+                        cs.status.write_result = 
+                            dst->write_block(ctx, WARP_TRACK(settings->two_sided, tr),
+                                             se, gcr, GCRBUFSIZE-1,
+                                             cs.status.read_result);
                     }
                     else
                     {
                         SETSTATEDEBUG(DebugBlockCount++);
-                        status.write_result = 
-                            dst->write_block(tr, se, block, BLOCKSIZE,
-                                             status.read_result);
+                        cs.status.write_result = 
+                            dst->write_block(ctx, tr, se, block, BLOCKSIZE,
+                                             cs.status.read_result);
                     }
                     SETSTATEDEBUG((void)0);
 
-                    if(status.read_result)
-                    {
-                        /* read error */
-                        trackmap[se] = bs_error;
-                        errors++;
-                        if(retry_count == 0)
-                        {
-                            status.sectors_processed++;
-                            /* FIXME: shall we get rid of this? */
-                            message_cb( 1, "read error: %02x/%02x: %d",
-                                        tr, se, status.read_result );
-                        }
-                    }
-                    else
-                    {
-                        /* successfull read */
-                        if(status.write_result)
-                        {
-                            /* write error */
-                            trackmap[se] = bs_error;
-                            errors++;
-                            if(retry_count == 0)
-                            {
-                                status.sectors_processed++;
-                                /* FIXME: shall we get rid of this? */
-                                message_cb(1, "write error: %02x/%02x: %d",
-                                           tr, se, status.write_result);
-                            }
-                        }
-                        else
-                        {
-                            /* successfull read and write, mark sector */
-                            trackmap[se] = bs_copied;
-                            cnt++;
-                            status.sectors_processed++;
-                        }
-                    }
+                    finish_sector(&cs, tr, se);
+
                     /* remaining sectors on this track */
                     if(!resend_trackmap)
                     {
                         scnt--;
                     }
 
-                    status.track = tr;
-                    status.sector= se;
-
-                    status_cb(status);
-
                     if(dst->is_cbm_drive || !settings->warp)
                     {
                         se += (unsigned char) settings->interleave;
                         if(se >= sector_map[tr]) se -= sector_map[tr];
                     }
                 }
-                if(errors > 0 && settings->retries >= 0)
+                if(pipe)
+                {
+                    /* the retry decision needs the results of all sectors */
+                    pipe_drain(pipe);
+                }
+                if(cs.errors > 0)
                 {
-                    retry_count--;
-                    scnt = errors;
+                    /* a track with retries says nothing about the timing */
+                    tuning = 0;
                 }
+                if(cs.errors > 0 && settings->retries >= 0)
+                {
+                    cs.retry_count--;
+                    scnt = cs.errors;
+                }
+            }
+            while(cs.retry_count >= 0 && cs.errors > 0);
+            if(cs.errors)
+            {
+                ctx->message_cb(1, "giving up...");
             }
-            while(retry_count >= 0 && errors > 0);
-            if(errors)
+            if(tuning)
             {
-                message_cb(1, "giving up...");
+                tune_ms[tune_next++] = arch_time_ms() - tune_start;
+                if(tune_next == tune_cnt)
+                {
+                    default_il = tune_finish(ctx, tune_key, tune_cand,
+                                             tune_ms, tune_cnt);
+                }
             }
+            settings->interleave = default_il;
         }
         if(settings->two_sided)
         {
@@ -615,12 +1286,48 @@ static int copy_disk(CBM_FILE fd_cbm, d64copy_settings *settings,
     }
     SETSTATEDEBUG(DebugBlockCount=-1);
 
-    dst->close_disk();
+    if(tune_next < tune_cnt)
+    {
+        ctx->message_cb(1, "not enough complete tracks to tune the interleave");
+    }
+
+    if(pipe)
+    {
+        pipe_destroy(pipe);
+    }
+
+    if(settings->verify && dst->is_cbm_drive && cs.cnt > 0)
+    {
+        ctx->message_cb(2, "verifying %d sectors", cs.cnt);
+        if(!cbm_transf->needs_turbo ||
+           reopen_drive(ctx, fd_cbm, settings, dst, dst_arg, cbm_drive, 1) == 0)
+        {
+            st = compare_disk(&cs, src, dst, sector_map, max_tracks,
+                              bs_copied, bs_copied, bs_error);
+            if(st != cs.cnt)
+            {
+                ctx->message_cb(1, "verify: %d sectors differ", cs.cnt - st);
+            }
+            cs.cnt = st;
+        }
+    }
+
+    report_progress(&cs, d64copy_ev_done);
+    ctx->status = NULL;
+
+    dst->close_disk(ctx);
     SETSTATEDEBUG((void)0);
-    src->close_disk();
+    src->close_disk(ctx);
+
+    if(ctx->journal)
+    {
+        /* keep the journal if there are sectors left to retry */
+        cbmlibmisc_journal_close(ctx->journal, copy_complete(&cs.status));
+        ctx->journal = NULL;
+    }
 
     SETSTATEDEBUG((void)0);
-    return cnt;
+    return cs.cnt;
 }
 
 
@@ -639,6 +1346,11 @@ transfers[] =
     { NULL, NULL, NULL }
 };
 
+static const char *transfer_mode_name(int transfer_mode)
+{
+    return transfers[transfer_mode].name;
+}
+
 char *d64copy_get_transfer_modes()
 {
     const struct _transfers *t;
@@ -781,65 +1493,210 @@ int d64copy_check_auto_transfer_mode(CBM_FILE cbm_fd, int auto_transfermode, int
     return transfermode;
 }
 
-int d64copy_read_image(CBM_FILE cbm_fd,
-                       d64copy_settings *settings,
-                       int src_drive,
-                       const char *dst_image,
-                       d64copy_message_cb msg_cb,
-                       d64copy_status_cb stat_cb)
+d64copy_context *d64copy_create_context(void)
+{
+    return calloc(1, sizeof(d64copy_context));
+}
+
+void d64copy_free_context(d64copy_context *ctx)
+{
+    free(ctx);
+}
+
+int d64copy_read_image_ctx(d64copy_context *ctx,
+                           CBM_FILE cbm_fd,
+                           d64copy_settings *settings,
+                           int src_drive,
+                           const char *dst_image,
+                           d64copy_message_cb msg_cb,
+                           d64copy_status_cb stat_cb)
 {
     const transfer_funcs *src;
     const transfer_funcs *dst;
     int ret;
 
-    message_cb = msg_cb;
-    status_cb = stat_cb;
+    ctx->message_cb = msg_cb;
+    ctx->status_cb = stat_cb;
 
     src = transfers[settings->transfer_mode].trf;
     dst = &d64copy_fs_transfer;
 
-    atom_dst = dst;
-    atom_mustcleanup = 1;
+    ctx->atom_dst = dst;
+    ctx->atom_mustcleanup = 1;
 
     SETSTATEDEBUG((void)0);
-    ret = copy_disk(cbm_fd, settings,
+    ret = copy_disk(ctx, cbm_fd, settings,
             src, (void*)(ULONG_PTR)src_drive, dst, (void*)dst_image, (unsigned char) src_drive);
 
-    atom_mustcleanup = 0;
+    ctx->atom_mustcleanup = 0;
 
     return ret;
 }
 
-int d64copy_write_image(CBM_FILE cbm_fd,
-                        d64copy_settings *settings,
-                        const char *src_image,
-                        int dst_drive,
-                        d64copy_message_cb msg_cb,
-                        d64copy_status_cb stat_cb)
+int d64copy_write_image_ctx(d64copy_context *ctx,
+                            CBM_FILE cbm_fd,
+                            d64copy_settings *settings,
+                            const char *src_image,
+                            int dst_drive,
+                            d64copy_message_cb msg_cb,
+                            d64copy_status_cb stat_cb)
 {
     const transfer_funcs *src;
     const transfer_funcs *dst;
 
-    message_cb = msg_cb;
-    status_cb = stat_cb;
+    ctx->message_cb = msg_cb;
+    ctx->status_cb = stat_cb;
 
     src = &d64copy_fs_transfer;
     dst = transfers[settings->transfer_mode].trf;
 
     SETSTATEDEBUG((void)0);
-    return copy_disk(cbm_fd, settings,
+    return copy_disk(ctx, cbm_fd, settings,
             src, (void*)src_image, dst, (void*)(ULONG_PTR)dst_drive, (unsigned char) dst_drive);
 }
 
-void d64copy_cleanup(void)
+int d64copy_copy_image_ctx(d64copy_context *ctx,
+                           d64copy_settings *settings,
+                           const char *src_image,
+                           const char *dst_image,
+                           d64copy_message_cb msg_cb,
+                           d64copy_status_cb stat_cb)
+{
+    const transfer_funcs *src;
+    const transfer_funcs *dst;
+    int ret;
+
+    ctx->message_cb = msg_cb;
+    ctx->status_cb = stat_cb;
+
+    src = &d64copy_fs_src_transfer;
+    dst = &d64copy_fs_transfer;
+
+    ctx->atom_dst = dst;
+    ctx->atom_mustcleanup = 1;
+
+    SETSTATEDEBUG((void)0);
+    ret = copy_disk(ctx, CBM_FILE_INVALID, settings,
+            src, (void*)src_image, dst, (void*)dst_image, 0);
+
+    ctx->atom_mustcleanup = 0;
+
+    return ret;
+}
+
+void d64copy_cleanup_ctx(d64copy_context *ctx)
 {
     /* if we were interrupted writing to the fs, make sure to
      * write anything that has already been started
      */
 
-    if (atom_mustcleanup)
+    if (ctx->atom_mustcleanup)
     {
-        atom_dst->close_disk();
-        atom_mustcleanup = 0;
+        ctx->atom_dst->close_disk(ctx);
+        ctx->atom_mustcleanup = 0;
     }
+
+    /* keep the journal, so the copy can be resumed */
+    if (ctx->journal)
+    {
+        cbmlibmisc_journal_close(ctx->journal, 0);
+        ctx->journal = NULL;
+    }
+}
+
+void d64copy_set_event_cb(d64copy_context *ctx,
+                          d64copy_event_cb event_cb,
+                          void *arg)
+{
+    ctx->event_cb = event_cb;
+    ctx->event_arg = arg;
+}
+
+const char *d64copy_get_bam(d64copy_context *ctx, int track)
+{
+    if(ctx->status == NULL || track < 1 || track > MAX_TRACKS)
+    {
+        return NULL;
+    }
+    return ctx->status->bam[track-1];
+}
+
+int d64copy_read_image(CBM_FILE cbm_fd,
+                       d64copy_settings *settings,
+                       int src_drive,
+                       const char *dst_image,
+                       d64copy_message_cb msg_cb,
+                       d64copy_status_cb stat_cb)
+{
+    return d64copy_read_image_ctx(&default_context, cbm_fd, settings,
+                                  src_drive, dst_image, msg_cb, stat_cb);
+}
+
+int d64copy_write_image(CBM_FILE cbm_fd,
+                        d64copy_settings *settings,
+                        const char *src_image,
+                        int dst_drive,
+                        d64copy_message_cb msg_cb,
+                        d64copy_status_cb stat_cb)
+{
+    return d64copy_write_image_ctx(&default_context, cbm_fd, settings,
+                                   src_image, dst_drive, msg_cb, stat_cb);
+}
+
+/*
+ * wait until line has the given state, polling stop_cb meanwhile.
+ * returns 0, or 1 if stop_cb asked to stop.
+ */
+static int wait_line(CBM_FILE cbm_fd, int line, int state,
+                     d64copy_stop_cb stop_cb)
+{
+    while(((cbm_iec_poll(cbm_fd) & line) != 0) != (state != 0))
+    {
+        if(stop_cb && stop_cb())
+        {
+            return 1;
+        }
+        arch_usleep(20000);
+    }
+    return 0;
+}
+
+int d64copy_wait_disk_change(CBM_FILE cbm_fd, int drive,
+                             d64copy_stop_cb stop_cb)
+{
+    SETSTATEDEBUG((void)0);
+    /* the drive program expects the head on the directory track */
+    if(cbm_exec_command(cbm_fd, (unsigned char) drive, "I0:", 0) != 0)
+    {
+        return -1;
+    }
+    if(cbm_upload(cbm_fd, (unsigned char) drive, 0x500,
+                  tdchange, sizeof(tdchange)) != sizeof(tdchange))
+    {
+        return -1;
+    }
+    SETSTATEDEBUG((void)0);
+    cbm_exec_command(cbm_fd, (unsigned char) drive, "U3:", 0);
+    cbm_iec_release(cbm_fd, IEC_ATN | IEC_DATA | IEC_CLOCK | IEC_RESET);
+
+    /* DATA: the drive program runs, CLOCK: a new disk has been read */
+    if(wait_line(cbm_fd, IEC_DATA, 1, stop_cb) != 0 ||
+       wait_line(cbm_fd, IEC_CLOCK, 1, stop_cb) != 0)
+    {
+        /* the drive program waits forever, end it */
+        cbm_reset(cbm_fd);
+        return 1;
+    }
+
+    /* acknowledge, and wait for the drive program to end */
+    cbm_iec_set(cbm_fd, IEC_ATN);
+    cbm_iec_wait(cbm_fd, IEC_CLOCK, 0);
+    cbm_iec_release(cbm_fd, IEC_ATN);
+    SETSTATEDEBUG((void)0);
+    return 0;
+}
+
+void d64copy_cleanup(void)
+{
+    d64copy_cleanup_ctx(&default_context);
 }
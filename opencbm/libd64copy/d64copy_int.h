@@ -11,10 +11,14 @@
 #define D64COPY_INT_H
 
 #include "opencbm.h"
+#include "opencbm-plugin.h"
 #include "d64copy.h"
 #include "gcr.h"
 
+#include <stdio.h>
+
 #include "arch.h"
+#include "journal.h"
 
 #ifdef LIBD64COPY_DEBUG
 # define DEBUG_STATEDEBUG
@@ -36,22 +40,110 @@
 
 #define MAX_SECTORS  21
 
+/* the highest track number any image can have */
+#define FS_MAX_TRACKS  (D71_TRACKS > TOT_TRACKS ? D71_TRACKS : TOT_TRACKS)
+
+/* size of the sector checksum sent by the turbo checksum program */
+#define SUMSIZE      2
+
 #define NEED_SECTOR(b) ((((b)==bs_error)||((b)==bs_must_copy))?1:0)
 
+/*
+ * the track number as sent to the warp drive programs. These select the
+ * head themselves: a track on the second side of a .d71 is sent as the
+ * track on the first side, with bit 7 set.
+ */
+#define WARP_TRACK(two_sided, tr) \
+    ((unsigned char) (((two_sided) && (tr) > STD_TRACKS) ? (((tr) - STD_TRACKS) | 0x80) : (tr)))
+
 typedef int(*turbo_start)(CBM_FILE,unsigned char);
 
 typedef struct {
-    int  (*open_disk)(CBM_FILE,d64copy_settings*,const void*,int,
+    int  (*open_disk)(d64copy_context*,CBM_FILE,d64copy_settings*,const void*,int,
                       turbo_start,d64copy_message_cb);
-    int  (*read_block)(unsigned char,unsigned char,unsigned char*);
-    int  (*write_block)(unsigned char,unsigned char,const unsigned char*,int,int);
-    void (*close_disk)(void);
+    int  (*read_block)(d64copy_context*,unsigned char,unsigned char,unsigned char*);
+    int  (*write_block)(d64copy_context*,unsigned char,unsigned char,const unsigned char*,int,int);
+    void (*close_disk)(d64copy_context*);
     int  is_cbm_drive;
     int  needs_turbo;
-    int  (*send_track_map)(unsigned char,const char*,unsigned char);
-    int  (*read_gcr_block)(unsigned char*,unsigned char*);
+    int  (*send_track_map)(d64copy_context*,unsigned char,const char*,unsigned char);
+    int  (*read_gcr_block)(d64copy_context*,unsigned char*,unsigned char*);
+    int  (*read_sum)(d64copy_context*,unsigned char,unsigned char,unsigned char*);
 } transfer_funcs;
 
+/* an image file, see fs.c */
+typedef struct
+{
+    d64copy_settings *settings;
+    FILE *the_file;
+    ARCH_MAPPING mapping;
+    unsigned char *image;
+    char *error_map;
+    int block_count;
+
+    /* first block of each track, see setup_track_offsets() */
+    int track_offset[FS_MAX_TRACKS + 2];
+    int track_count;
+
+    /* make sure writing the block is an atomary process */
+    int atom_execute;
+    unsigned char atom_tr;
+    unsigned char atom_se;
+    const unsigned char *atom_blk;
+    int atom_size;
+    int atom_read_status;
+} d64copy_fs;
+
+/*
+ * everything one copy operation needs. A copy has an image file on one
+ * side (fs.c) and a drive on the other (std.c, s1.c, s2.c, pp.c), or an
+ * image on both sides (d64copy_copy_image_ctx()). Each side gets its own
+ * part.
+ */
+struct d64copy_context_s
+{
+    d64copy_message_cb message_cb;
+    d64copy_status_cb status_cb;
+    d64copy_event_cb event_cb;
+    void *event_arg;
+
+    /* the status of the copy in progress, NULL if there is none */
+    const d64copy_status *status;
+
+    /* the journal of the image being written, see journal_start() */
+    cbmlibmisc_journal *journal;
+
+    /* the destination must be closed if the copy is interrupted */
+    int atom_mustcleanup;
+    const transfer_funcs *atom_dst;
+
+    /* the image; the destination of an image to image copy */
+    d64copy_fs fs;
+
+    /* the source of an image to image copy */
+    d64copy_fs src_fs;
+
+    struct
+    {
+        CBM_FILE fd_cbm;
+        unsigned char drive;
+        int two_sided;
+        int pp_direction;
+
+        opencbm_plugin_s1_read_n_t *s1_read_n;
+        opencbm_plugin_s1_write_n_t *s1_write_n;
+        opencbm_plugin_s2_read_n_t *s2_read_n;
+        opencbm_plugin_s2_write_n_t *s2_write_n;
+        opencbm_plugin_pp_dc_read_n_t *pp_dc_read_n;
+        opencbm_plugin_pp_dc_write_n_t *pp_dc_write_n;
+        opencbm_plugin_iec_seq_load_t *iec_seq_load;
+        opencbm_plugin_iec_seq_read_n_t *iec_seq_read_n;
+        opencbm_plugin_iec_seq_write_n_t *iec_seq_write_n;
+        int seq_write_loaded;
+        int seq_read_loaded;
+    } cbm;
+};
+
 #define DECLARE_TRANSFER_FUNCS(x,c,t) \
     transfer_funcs d64copy_ ## x = {open_disk, \
                         read_block, \
@@ -60,6 +152,7 @@ typedef struct {
                         c, \
                         t, \
                         NULL, \
+                        NULL, \
                         NULL}
 
 #define DECLARE_TRANSFER_FUNCS_EX(x,c,t) \
@@ -70,6 +163,7 @@ typedef struct {
                         c, \
                         t, \
                         send_track_map, \
-                        read_gcr_block}
+                        read_gcr_block, \
+                        read_sum}
 
 #endif
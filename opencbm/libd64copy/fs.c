@@ -15,85 +15,123 @@
 
 #include "arch.h"
 
-static d64copy_settings *fs_settings;
+/* fill the table of the first block of each track */
+static void setup_track_offsets(d64copy_fs *fs)
+{
+    int tr, sectors;
 
-static FILE *the_file;
-static char *error_map;
-static int block_count;
+    fs->track_offset[1] = 0;
+    for(tr = 1; tr <= FS_MAX_TRACKS; tr++)
+    {
+        sectors = d64copy_sector_count(fs->settings->two_sided, tr);
+        if(sectors < 0)
+        {
+            break;
+        }
+        fs->track_offset[tr + 1] = fs->track_offset[tr] + sectors;
+    }
+    fs->track_count = tr - 1;
+}
 
-/* always use maximum size for error map */
-#define ERROR_MAP_LENGTH D71_BLOCKS
+/* the number of the block tr/se in the image, or -1 if there is none */
+static int block_index(d64copy_fs *fs, int tr, int se)
+{
+    int index;
 
-static int block_offset(int tr, int se)
+    if(tr < 1 || tr > fs->track_count)
+    {
+        return -1;
+    }
+    index = fs->track_offset[tr] + se;
+    if(index >= fs->block_count)
+    {
+        return -1;
+    }
+    return index;
+}
+
+/* map the image (and, for writing, the error map behind it) */
+static int map_image(d64copy_fs *fs, int for_writing)
 {
-    int sectors = 0, i;
-    for(i = 1; i < tr; i++)
+    size_t size = (size_t) fs->block_count *
+                  (for_writing ? BLOCKSIZE + 1 : BLOCKSIZE);
+    void *address;
+
+    fs->mapping = arch_mmap(arch_fileno(fs->the_file), size,
+                                for_writing, &address);
+    if(fs->mapping == NULL)
     {
-        sectors += d64copy_sector_count(fs_settings->two_sided, i);
+        return 1;
     }
-    return (sectors + se) * BLOCKSIZE;
+    fs->image = address;
+    fs->error_map = for_writing ?
+        (char *) fs->image + fs->block_count * BLOCKSIZE : NULL;
+    return 0;
 }
 
-static int read_block(unsigned char tr, unsigned char se, unsigned char *block)
+static int image_read_block(d64copy_fs *fs, unsigned char tr, unsigned char se, unsigned char *block)
 {
-    if(fseek(the_file, block_offset(tr, se), SEEK_SET) == 0)
+    int index = block_index(fs, tr, se);
+
+    if(index < 0)
     {
-        return fread(block, BLOCKSIZE, 1, the_file) != 1;
+        return 1;
     }
-    return 1;
+    memcpy(block, fs->image + index * BLOCKSIZE, BLOCKSIZE);
+    return 0;
 }
 
-/*
- * Variables to make sure writing the block is an atomary process
- */
-static int atom_execute = 0;
-static unsigned char atom_tr;
-static unsigned char atom_se;
-static const unsigned char *atom_blk;
-static int atom_size;
-static int atom_read_status;
-
-static int write_block(unsigned char tr, unsigned char se, const unsigned char *blk, int size, int read_status)
+static int image_write_block(d64copy_fs *fs, unsigned char tr, unsigned char se, const unsigned char *blk, int size, int read_status)
 {
-    long ofs;
-    int ret;
+    int index;
 
-    atom_tr = tr;
-    atom_se = se;
-    atom_blk = blk;
-    atom_size = size;
-    atom_read_status = read_status;
+    fs->atom_tr = tr;
+    fs->atom_se = se;
+    fs->atom_blk = blk;
+    fs->atom_size = size;
+    fs->atom_read_status = read_status;
 
-    atom_execute = 1;
+    fs->atom_execute = 1;
 
-    ofs = block_offset(tr, se);
-    if(fseek(the_file, ofs, SEEK_SET) == 0)
+    index = block_index(fs, tr, se);
+    if(index >= 0 && size <= BLOCKSIZE)
     {
-        error_map[ofs / BLOCKSIZE] = (char) ((read_status == 0) ? 1 : read_status);
-        ret = fwrite(blk, size, 1, the_file) != 1;
-    }
-    else
-    {
-        ret = 1;
+        fs->error_map[index] = (char) ((read_status == 0) ? 1 : read_status);
+        memcpy(fs->image + index * BLOCKSIZE, blk, size);
     }
 
-    atom_execute = 0;
+    fs->atom_execute = 0;
 
-    return ret;
+    return index < 0 || size > BLOCKSIZE;
 }
 
-static int open_disk(CBM_FILE fd, d64copy_settings *settings,
-                     const void *arg, int for_writing,
-                     turbo_start start, d64copy_message_cb message_cb)
+/*
+ * Write everything to the image file. Before this, it is only
+ * guaranteed to be in the page cache.
+ */
+static int flush_image(d64copy_fs *fs)
+{
+    return fs->mapping ? arch_msync(fs->mapping) : 0;
+}
+
+static int image_open(d64copy_fs *fs, d64copy_settings *settings,
+                      const void *arg, int for_writing,
+                      d64copy_message_cb message_cb)
 {
     off_t filesize;
     int stat_ok, is_image, error_info;
     int tr = 0;
     char *name = (char*)arg;
+    char *old_error_map = NULL;
+    int old_block_count = 0;
 
-    the_file = NULL;
-    fs_settings = settings;
-    block_count = 0;
+    fs->the_file = NULL;
+    fs->mapping = NULL;
+    fs->image = NULL;
+    fs->error_map = NULL;
+    fs->settings = settings;
+    fs->block_count = 0;
+    setup_track_offsets(fs);
 
     stat_ok = arch_filesize(name, &filesize) == 0;
     is_image = error_info = 0;
@@ -103,30 +141,30 @@ static int open_disk(CBM_FILE fd, d64copy_settings *settings,
         if(filesize == D71_BLOCKS * BLOCKSIZE)
         {
             is_image = 1;
-            block_count = D71_BLOCKS;
+            fs->block_count = D71_BLOCKS;
             tr = D71_TRACKS;
         }
         else if(filesize == D71_BLOCKS * (BLOCKSIZE + 1))
         {
             is_image = 1;
             error_info = 1;
-            block_count = D71_BLOCKS;
+            fs->block_count = D71_BLOCKS;
             tr = D71_TRACKS;
         }
         else
         {
-            block_count = STD_BLOCKS;
+            fs->block_count = STD_BLOCKS;
             for( tr = STD_TRACKS; !is_image && tr <= TOT_TRACKS; )
             {
-                is_image = filesize == block_count * BLOCKSIZE;
+                is_image = filesize == fs->block_count * BLOCKSIZE;
                 if(!is_image)
                 {
                     error_info = is_image =
-                        filesize == block_count * (BLOCKSIZE + 1);
+                        filesize == fs->block_count * (BLOCKSIZE + 1);
                 }
                 if(!is_image)
                 {
-                    block_count += d64copy_sector_count( 0, tr++ );
+                    fs->block_count += d64copy_sector_count( 0, tr++ );
                 }
             }
             if( is_image && tr != STD_TRACKS )
@@ -142,11 +180,17 @@ static int open_disk(CBM_FILE fd, d64copy_settings *settings,
         {
             if(is_image)
             {
-                the_file = fopen(name, "rb");
-                if(the_file == NULL)
+                fs->the_file = fopen(name, "rb");
+                if(fs->the_file == NULL)
                 {
                     message_cb(0, "could not open %s", name);
                 }
+                else if(map_image(fs, 0))
+                {
+                    message_cb(0, "could not map %s", name);
+                    fclose(fs->the_file);
+                    fs->the_file = NULL;
+                }
                 if(error_info)
                 {
                     message_cb(1, "image contains error information");
@@ -174,8 +218,8 @@ static int open_disk(CBM_FILE fd, d64copy_settings *settings,
     }
     else
     {
-        the_file = fopen(name, is_image ? "r+b" : "wb");
-        if(the_file)
+        fs->the_file = fopen(name, is_image ? "r+b" : "w+b");
+        if(fs->the_file)
         {
             /* check whether we must resize or create an image file */
             int new_tr;
@@ -196,35 +240,19 @@ static int open_disk(CBM_FILE fd, d64copy_settings *settings,
                 new_tr = TOT_TRACKS;
             }
 
-            /* always use maximum size for error map */
-            error_map = calloc(ERROR_MAP_LENGTH, 1);
-            if(!error_map)
-            {
-                message_cb(0, "no memory for error map");
-                fclose(the_file);
-                if(!is_image)
-                {
-                    arch_unlink(name);
-                }
-                return 1;
-            }
-
-            if(is_image)
+            if(is_image && error_info && new_tr > tr)
             {
-                if(error_info)
+                /* the error map moves when the image grows */
+                old_error_map = malloc(fs->block_count);
+                old_block_count = fs->block_count;
+                if(!old_error_map ||
+                   fseek(fs->the_file, fs->block_count * BLOCKSIZE, SEEK_SET) != 0 ||
+                   fread(old_error_map, fs->block_count, 1, fs->the_file) != 1)
                 {
-                    if(fseek(the_file, block_count * BLOCKSIZE, SEEK_SET) != 0 ||
-                       fread(error_map, block_count, 1, the_file) != 1)
-                    {
-                        message_cb(0, "%s: could not read error map", name);
-                        fclose(the_file);
-                        return 1;
-                    }
-                }
-                if(fseek(the_file, block_count * BLOCKSIZE, SEEK_SET) != 0)
-                {
-                    message_cb(0, "%s: could not seek to end of file", name);
-                    fclose(the_file);
+                    message_cb(0, "%s: could not read error map", name);
+                    free(old_error_map);
+                    fclose(fs->the_file);
+                    fs->the_file = NULL;
                     return 1;
                 }
             }
@@ -234,19 +262,33 @@ static int open_disk(CBM_FILE fd, d64copy_settings *settings,
                 /* grow image */
                 while(tr < new_tr)
                 {
-                    block_count += d64copy_sector_count(settings->two_sided, ++tr);
+                    fs->block_count += d64copy_sector_count(settings->two_sided, ++tr);
                 }
 
-                message_cb(1, "growing image file to %d blocks", block_count);
+                message_cb(1, "growing image file to %d blocks", fs->block_count);
+            }
 
-                if (arch_ftruncate(arch_fileno(the_file), block_count * BLOCKSIZE) != 0)
-                {
-                    message_cb(0, "%s: could not extend image file", name);
-                    fclose(the_file);
-                    if(!is_image)
-                        arch_unlink(name);
-                    return 1;
-                }
+            /*
+             * the error map is kept behind the image while we are
+             * writing; close_disk() removes it again if it is not needed
+             */
+            if (arch_ftruncate(arch_fileno(fs->the_file), fs->block_count * (BLOCKSIZE + 1)) != 0 ||
+                map_image(fs, 1) != 0)
+            {
+                message_cb(0, "%s: could not extend or map image file", name);
+                free(old_error_map);
+                fclose(fs->the_file);
+                fs->the_file = NULL;
+                if(!is_image)
+                    arch_unlink(name);
+                return 1;
+            }
+
+            if(old_error_map)
+            {
+                memset(fs->error_map, 0, fs->block_count);
+                memcpy(fs->error_map, old_error_map, old_block_count);
+                free(old_error_map);
             }
         }
         else
@@ -254,10 +296,10 @@ static int open_disk(CBM_FILE fd, d64copy_settings *settings,
             message_cb(0, "could not open %s", name);
         }
     }
-    return the_file == NULL;
+    return fs->the_file == NULL;
 }
 
-static void close_disk(void)
+static void image_close(d64copy_fs *fs)
 {
     int i, has_errors = 0;
 
@@ -265,15 +307,15 @@ static void close_disk(void)
      * redone before closing the disk 
      */
 
-    if (the_file && atom_execute)
+    if (fs->the_file && fs->atom_execute)
     {
-        atom_execute = 0;
-        write_block(atom_tr, atom_se, atom_blk, atom_size, atom_read_status);
+        fs->atom_execute = 0;
+        image_write_block(fs, fs->atom_tr, fs->atom_se, fs->atom_blk, fs->atom_size, fs->atom_read_status);
     }
 
-    if (fs_settings)
+    if (fs->settings)
     {
-        switch(fs_settings->error_mode)
+        switch(fs->settings->error_mode)
         {
             case em_always:
                 has_errors = 1;
@@ -282,42 +324,94 @@ static void close_disk(void)
                 has_errors = 0;
                 break;
             default:
-                if(error_map)
+                if(fs->error_map)
                 {
-                    for(i = 0; !has_errors && i < block_count; i++)
+                    for(i = 0; !has_errors && i < fs->block_count; i++)
                     {
-                        has_errors = error_map[i] != 1;
+                        has_errors = fs->error_map[i] != 1;
                     }
                 }
                 break;
         }
     }
 
-    if(the_file)
+    if(fs->mapping)
     {
-        if(has_errors)
-        {
-            if(fseek(the_file, block_count * BLOCKSIZE, SEEK_SET) == 0)
-            {
-                fwrite(error_map, block_count, 1, the_file);
-            }
-        } 
-        else
-        {
-            arch_ftruncate(arch_fileno(the_file), block_count * BLOCKSIZE);
-        }
+        flush_image(fs);
+        arch_munmap(fs->mapping);
+        fs->mapping = NULL;
+        fs->image = NULL;
     }
 
-    if(error_map)
+    if(fs->the_file && fs->error_map && !has_errors)
     {
-        free(error_map);
-        error_map = NULL;
+        arch_ftruncate(arch_fileno(fs->the_file), fs->block_count * BLOCKSIZE);
     }
-    if(the_file)
+    fs->error_map = NULL;
+
+    if(fs->the_file)
     {
-        fclose(the_file);
-        the_file = NULL;
+        fclose(fs->the_file);
+        fs->the_file = NULL;
     }
 }
 
+/* the image the copy writes to or reads from */
+
+static int open_disk(d64copy_context *ctx, CBM_FILE fd, d64copy_settings *settings,
+                     const void *arg, int for_writing,
+                     turbo_start start, d64copy_message_cb message_cb)
+{
+    return image_open(&ctx->fs, settings, arg, for_writing, message_cb);
+}
+
+static int read_block(d64copy_context *ctx, unsigned char tr, unsigned char se, unsigned char *block)
+{
+    return image_read_block(&ctx->fs, tr, se, block);
+}
+
+static int write_block(d64copy_context *ctx, unsigned char tr, unsigned char se, const unsigned char *blk, int size, int read_status)
+{
+    return image_write_block(&ctx->fs, tr, se, blk, size, read_status);
+}
+
+static void close_disk(d64copy_context *ctx)
+{
+    image_close(&ctx->fs);
+}
+
 DECLARE_TRANSFER_FUNCS(fs_transfer, 0, 0);
+
+/* the source image of an image to image copy */
+
+static int open_src_disk(d64copy_context *ctx, CBM_FILE fd, d64copy_settings *settings,
+                         const void *arg, int for_writing,
+                         turbo_start start, d64copy_message_cb message_cb)
+{
+    return image_open(&ctx->src_fs, settings, arg, for_writing, message_cb);
+}
+
+static int read_src_block(d64copy_context *ctx, unsigned char tr, unsigned char se, unsigned char *block)
+{
+    return image_read_block(&ctx->src_fs, tr, se, block);
+}
+
+static int write_src_block(d64copy_context *ctx, unsigned char tr, unsigned char se, const unsigned char *blk, int size, int read_status)
+{
+    return image_write_block(&ctx->src_fs, tr, se, blk, size, read_status);
+}
+
+static void close_src_disk(d64copy_context *ctx)
+{
+    image_close(&ctx->src_fs);
+}
+
+transfer_funcs d64copy_fs_src_transfer = {open_src_disk,
+                        read_src_block,
+                        write_src_block,
+                        close_src_disk,
+                        0,
+                        0,
+                        NULL,
+                        NULL,
+                        NULL};
@@ -17,17 +17,11 @@
 
 #include "opencbm-plugin.h"
 
-static opencbm_plugin_pp_dc_read_n_t * opencbm_plugin_pp_dc_read_n = NULL;
-
-static opencbm_plugin_pp_dc_write_n_t * opencbm_plugin_pp_dc_write_n = NULL;
-
 enum pp_direction_e
 {
     PP_READ, PP_WRITE
 };
 
-static CBM_FILE fd_cbm;
-static int two_sided;
 
 static const unsigned char pp1541_drive_prog[] = {
 #include "pp1541.inc"
@@ -37,20 +31,21 @@ static const unsigned char pp1571_drive_prog[] = {
 #include "pp1571.inc"
 };
 
-static void pp_check_direction(enum pp_direction_e dir)
+static void pp_check_direction(d64copy_context *ctx, enum pp_direction_e dir)
 {
-    static enum pp_direction_e direction = PP_READ;
-    if(direction != dir)
+    if(ctx->cbm.pp_direction != dir)
     {
         arch_usleep(100);
-        direction = dir;
+        ctx->cbm.pp_direction = dir;
     }
 }
 
-static int pp_write(CBM_FILE fd, char c1, char c2)
+static int pp_write(d64copy_context *ctx, char c1, char c2)
 {
+    CBM_FILE fd = ctx->cbm.fd_cbm;
+
                                                                         SETSTATEDEBUG((void)0);
-    pp_check_direction(PP_WRITE);
+    pp_check_direction(ctx, PP_WRITE);
                                                                         SETSTATEDEBUG((void)0);
 #ifndef USE_CBM_IEC_WAIT
     while(!cbm_iec_get(fd, IEC_DATA));
@@ -78,24 +73,26 @@ static int pp_write(CBM_FILE fd, char c1, char c2)
 }
 
 /* write_n redirects USB writes to the external reader if required */
-static void write_n(const unsigned char *data, int size) 
+static void write_n(d64copy_context *ctx, const unsigned char *data, int size)
 {
     int i;
 
-    if (opencbm_plugin_pp_dc_write_n)
+    if (ctx->cbm.pp_dc_write_n)
     {
-        opencbm_plugin_pp_dc_write_n(fd_cbm, data, size);
+        ctx->cbm.pp_dc_write_n(ctx->cbm.fd_cbm, data, size);
         return;
     }
 
     for(i=0;i<size/2;i++,data+=2)
-	pp_write(fd_cbm, data[0], data[1]);
+	pp_write(ctx, data[0], data[1]);
 }
 
-static int pp_read(CBM_FILE fd, unsigned char *c1, unsigned char *c2)
+static int pp_read(d64copy_context *ctx, unsigned char *c1, unsigned char *c2)
 {
+    CBM_FILE fd = ctx->cbm.fd_cbm;
+
                                                                         SETSTATEDEBUG((void)0);
-    pp_check_direction(PP_READ);
+    pp_check_direction(ctx, PP_READ);
                                                                         SETSTATEDEBUG((void)0);
 #ifndef USE_CBM_IEC_WAIT
     while(!cbm_iec_get(fd, IEC_DATA));
@@ -123,59 +120,59 @@ static int pp_read(CBM_FILE fd, unsigned char *c1, unsigned char *c2)
 }
 
 /* read_n redirects USB reads to the external reader if required */
-static void read_n(unsigned char *data, int size) 
+static void read_n(d64copy_context *ctx, unsigned char *data, int size)
 {
     int i;
 
-    if (opencbm_plugin_pp_dc_read_n)
+    if (ctx->cbm.pp_dc_read_n)
     {
-        opencbm_plugin_pp_dc_read_n(fd_cbm, data, size);
+        ctx->cbm.pp_dc_read_n(ctx->cbm.fd_cbm, data, size);
         return;
     }
 
     for(i=0;i<size/2;i++,data+=2)
-	pp_read(fd_cbm, data, data+1);
+	pp_read(ctx, data, data+1);
 }
 
-static int read_block(unsigned char tr, unsigned char se, unsigned char *block)
+static int read_block(d64copy_context *ctx, unsigned char tr, unsigned char se, unsigned char *block)
 {
     unsigned char status[2];
                                                                         SETSTATEDEBUG((void)0);
 
     status[0] = tr; status[1] = se;
-    write_n(status, 2);
+    write_n(ctx, status, 2);
 
 #ifndef USE_CBM_IEC_WAIT    
     arch_usleep(20000);
 #endif
                                                                         SETSTATEDEBUG((void)0);
-    read_n(status, 2);
+    read_n(ctx, status, 2);
 
                                                                         SETSTATEDEBUG(DebugByteCount=0);
-    read_n(block, BLOCKSIZE);
+    read_n(ctx, block, BLOCKSIZE);
                                                                         SETSTATEDEBUG(DebugByteCount=-1);
 
                                                                         SETSTATEDEBUG((void)0);
     return status[1];
 }
 
-static int write_block(unsigned char tr, unsigned char se, const unsigned char *blk, int size, int read_status)
+static int write_block(d64copy_context *ctx, unsigned char tr, unsigned char se, const unsigned char *blk, int size, int read_status)
 {
     int i = 0;
     unsigned char status[2];
 
                                                                         SETSTATEDEBUG((void)0);
     status[0] = tr; status[1] = se;
-    write_n(status, 2);
+    write_n(ctx, status, 2);
 
                                                                         SETSTATEDEBUG((void)0);
     /* send first byte twice if length is odd */
     if(size % 2) {
-        write_n(blk, 2);
+        write_n(ctx, blk, 2);
         i = 1;
     }
                                                                         SETSTATEDEBUG(DebugByteCount=0);
-    write_n(blk+i, size-i);
+    write_n(ctx, blk+i, size-i);
 
                                                                         SETSTATEDEBUG(DebugByteCount=-1);
 #ifndef USE_CBM_IEC_WAIT    
@@ -185,13 +182,43 @@ static int write_block(unsigned char tr, unsigned char se, const unsigned char *
 #endif
 
                                                                         SETSTATEDEBUG((void)0);
-    read_n(status, 2);
+    read_n(ctx, status, 2);
+
+                                                                        SETSTATEDEBUG((void)0);
+    return status[1];
+}
+
+/*
+ * like read_block(), but the turbo checksum program only sends the checksum.
+ * Single bytes are sent twice, see read_block().
+ */
+static int read_sum(d64copy_context *ctx, unsigned char tr, unsigned char se, unsigned char *sum)
+{
+    unsigned char status[2];
+    unsigned char pair[2];
+    int i;
+
+                                                                        SETSTATEDEBUG((void)0);
+    status[0] = tr; status[1] = se;
+    write_n(ctx, status, 2);
+
+#ifndef USE_CBM_IEC_WAIT    
+    arch_usleep(20000);
+#endif
+                                                                        SETSTATEDEBUG((void)0);
+    read_n(ctx, status, 2);
 
+    for(i = 0; i < SUMSIZE; i++)
+    {
+        read_n(ctx, pair, 2);
+        sum[i] = pair[1];
+    }
                                                                         SETSTATEDEBUG((void)0);
+
     return status[1];
 }
 
-static int open_disk(CBM_FILE fd, d64copy_settings *settings,
+static int open_disk(d64copy_context *ctx, CBM_FILE fd, d64copy_settings *settings,
                      const void *arg, int for_writing,
                      turbo_start start, d64copy_message_cb message_cb)
 {
@@ -199,12 +226,13 @@ static int open_disk(CBM_FILE fd, d64copy_settings *settings,
     const unsigned char *drive_prog;
     int prog_size;
 
-    fd_cbm    = fd;
-    two_sided = settings->two_sided;
+    ctx->cbm.fd_cbm    = fd;
+    ctx->cbm.two_sided = settings->two_sided;
+    ctx->cbm.pp_direction = PP_READ;
 
-    opencbm_plugin_pp_dc_read_n = cbm_get_plugin_function_address("opencbm_plugin_pp_dc_read_n");
+    ctx->cbm.pp_dc_read_n = cbm_get_plugin_function_address_ex(fd, "opencbm_plugin_pp_dc_read_n");
 
-    opencbm_plugin_pp_dc_write_n = cbm_get_plugin_function_address("opencbm_plugin_pp_dc_write_n");
+    ctx->cbm.pp_dc_write_n = cbm_get_plugin_function_address_ex(fd, "opencbm_plugin_pp_dc_write_n");
 
     if(settings->drive_type != cbm_dt_cbm1541)
     {
@@ -219,75 +247,75 @@ static int open_disk(CBM_FILE fd, d64copy_settings *settings,
 
                                                                         SETSTATEDEBUG((void)0);
     /* make sure the XP1541 portion of the cable is in input mode */
-    cbm_pp_read(fd_cbm);
+    cbm_pp_read(ctx->cbm.fd_cbm);
 
                                                                         SETSTATEDEBUG((void)0);
-    cbm_upload(fd_cbm, d, 0x700, drive_prog, prog_size);
+    cbm_upload(ctx->cbm.fd_cbm, d, 0x700, drive_prog, prog_size);
                                                                         SETSTATEDEBUG((void)0);
     start(fd, d);
                                                                         SETSTATEDEBUG((void)0);
-    pp_check_direction(PP_READ);
+    pp_check_direction(ctx, PP_READ);
                                                                         SETSTATEDEBUG((void)0);
-    cbm_iec_set(fd_cbm, IEC_CLOCK);
+    cbm_iec_set(ctx->cbm.fd_cbm, IEC_CLOCK);
                                                                         SETSTATEDEBUG((void)0);
-    cbm_iec_wait(fd_cbm, IEC_DATA, 1);
+    cbm_iec_wait(ctx->cbm.fd_cbm, IEC_DATA, 1);
                                                                         SETSTATEDEBUG((void)0);
     return 0;
 }
 
-static void close_disk(void)
+static void close_disk(d64copy_context *ctx)
 {
                                                                         SETSTATEDEBUG((void)0);
-    pp_write(fd_cbm, 0, 0);
+    pp_write(ctx, 0, 0);
     arch_usleep(100);
                                                                         SETSTATEDEBUG((void)0);
-    cbm_iec_wait(fd_cbm, IEC_DATA, 0);
+    cbm_iec_wait(ctx->cbm.fd_cbm, IEC_DATA, 0);
 
     /* make sure the XP1541 portion of the cable is in input mode */
                                                                         SETSTATEDEBUG((void)0);
-    cbm_pp_read(fd_cbm);
+    cbm_pp_read(ctx->cbm.fd_cbm);
                                                                         SETSTATEDEBUG((void)0);
 
-    opencbm_plugin_pp_dc_read_n = NULL;
+    ctx->cbm.pp_dc_read_n = NULL;
 
-    opencbm_plugin_pp_dc_write_n = NULL;
+    ctx->cbm.pp_dc_write_n = NULL;
 }
 
-static int send_track_map(unsigned char tr, const char *trackmap, unsigned char count)
+static int send_track_map(d64copy_context *ctx, unsigned char tr, const char *trackmap, unsigned char count)
 {
     int i, size;
     unsigned char *data;
 
-    size = d64copy_sector_count(two_sided, tr);
+    size = d64copy_sector_count(ctx->cbm.two_sided, tr);
     data = malloc(2+2*size);
 
-    data[0] = tr;
+    data[0] = WARP_TRACK(ctx->cbm.two_sided, tr);
     data[1] = count;
 
     /* build track map */
     for(i = 0; i < size; i++)
 	data[2+2*i] = data[2+2*i+1] = !NEED_SECTOR(trackmap[i]);
     
-    write_n(data, 2*size+2);
+    write_n(ctx, data, 2*size+2);
     free(data);
                                                                         SETSTATEDEBUG((void)0);
     return 0;
 }
 
-static int read_gcr_block(unsigned char *se, unsigned char *gcrbuf)
+static int read_gcr_block(d64copy_context *ctx, unsigned char *se, unsigned char *gcrbuf)
 {
     unsigned char s[2];
                                                                         SETSTATEDEBUG((void)0);
-    read_n(s, 2);
+    read_n(ctx, s, 2);
     *se = s[1];
                                                                         SETSTATEDEBUG((void)0);
-    read_n(s, 2);
+    read_n(ctx, s, 2);
 
     if(s[1]) {
         return s[1];
     }
                                                                         SETSTATEDEBUG(DebugByteCount=0);
-    read_n(gcrbuf, GCRBUFSIZE);
+    read_n(ctx, gcrbuf, GCRBUFSIZE);
                                                                         SETSTATEDEBUG(DebugByteCount=-1);
 
                                                                         SETSTATEDEBUG((void)0);
@@ -16,17 +16,35 @@
 #include "arch.h"
 
 #include "opencbm-plugin.h"
-
-static opencbm_plugin_s1_read_n_t * opencbm_plugin_s1_read_n = NULL;
-
-static opencbm_plugin_s1_write_n_t * opencbm_plugin_s1_write_n = NULL;
+#include "s1seq.h"
 
 static const unsigned char s1_drive_prog[] = {
 #include "s1.inc"
 };
 
-static CBM_FILE fd_cbm;
-static int two_sided;
+
+/*
+ * load prog for its direction unless that has been done in this transfer;
+ * returns 0 if it can be used. The backend keeps one program per
+ * direction, so switching between reading and writing needs no reload.
+ */
+static int seq_select(d64copy_context *ctx, const unsigned char *prog, unsigned int size, int *loaded)
+{
+    if (ctx->cbm.iec_seq_load == NULL)
+        return -1;
+
+    if (!*loaded)
+    {
+        if (ctx->cbm.iec_seq_load(ctx->cbm.fd_cbm, prog, size) != 0)
+        {
+            /* backend can't do it, don't try again */
+            ctx->cbm.iec_seq_load = NULL;
+            return -1;
+        }
+        *loaded = 1;
+    }
+    return 0;
+}
 
 static int s1_write_byte_nohs(CBM_FILE fd, unsigned char c)
 {
@@ -85,18 +103,25 @@ static int s1_write_byte(CBM_FILE fd, unsigned char c)
 }
 
 /* write_n redirects USB writes to the external reader if required */
-static void write_n(const unsigned char *data, int size) 
+static void write_n(d64copy_context *ctx, const unsigned char *data, int size)
 {
     int i;
 
-    if (opencbm_plugin_s1_write_n)
+    if (ctx->cbm.s1_write_n)
+    {
+        ctx->cbm.s1_write_n(ctx->cbm.fd_cbm, data, size);
+        return;
+    }
+
+    if (ctx->cbm.iec_seq_write_n &&
+        seq_select(ctx, s1_seq_write, sizeof(s1_seq_write), &ctx->cbm.seq_write_loaded) == 0)
     {
-        opencbm_plugin_s1_write_n(fd_cbm, data, size);
+        ctx->cbm.iec_seq_write_n(ctx->cbm.fd_cbm, data, size);
         return;
     }
 
     for(i=0;i<size;i++)
-	s1_write_byte(fd_cbm, *data++);
+	s1_write_byte(ctx->cbm.fd_cbm, *data++);
 }
 
 static int s1_read_byte(CBM_FILE fd, unsigned char *c)
@@ -139,54 +164,65 @@ static int s1_read_byte(CBM_FILE fd, unsigned char *c)
 }
 
 /* read_n redirects USB reads to the external reader if required */
-static void read_n(unsigned char *data, int size) 
+static void read_n(d64copy_context *ctx, unsigned char *data, int size)
 {
     int i;
 
-    if (opencbm_plugin_s1_read_n)
+    if (ctx->cbm.s1_read_n)
     {
-        opencbm_plugin_s1_read_n(fd_cbm, data, size);
+        ctx->cbm.s1_read_n(ctx->cbm.fd_cbm, data, size);
+        return;
+    }
+
+    if (ctx->cbm.iec_seq_read_n &&
+        seq_select(ctx, s1_seq_read, sizeof(s1_seq_read), &ctx->cbm.seq_read_loaded) == 0)
+    {
+        ctx->cbm.iec_seq_read_n(ctx->cbm.fd_cbm, data, size);
         return;
     }
 
     for(i=0;i<size;i++)
-	s1_read_byte(fd_cbm, data++);
+	s1_read_byte(ctx->cbm.fd_cbm, data++);
 }
 
-static int read_block(unsigned char tr, unsigned char se, unsigned char *block)
+static int read_block(d64copy_context *ctx, unsigned char tr, unsigned char se, unsigned char *block)
 {
     unsigned char status;
+    unsigned char ts[2];
 
                                                                         SETSTATEDEBUG((void)0);
-    write_n(&tr, 1);
-                                                                        SETSTATEDEBUG((void)0);
-    write_n(&se, 1);
+    /* one backend transaction for both */
+    ts[0] = tr;
+    ts[1] = se;
+    write_n(ctx, ts, 2);
                                                                         SETSTATEDEBUG((void)0);
 #ifndef USE_CBM_IEC_WAIT    
     arch_usleep(20000);
 #endif    
                                                                         SETSTATEDEBUG((void)0);
-    read_n(&status, 1);
+    read_n(ctx, &status, 1);
                                                                         SETSTATEDEBUG(DebugByteCount=0);
     // removed from loop: SETSTATEDEBUG(DebugByteCount++);
-    read_n(block, 256);
+    read_n(ctx, block, 256);
                                                                         SETSTATEDEBUG(DebugByteCount=-1);
-    cbm_iec_release(fd_cbm, IEC_DATA);
+    cbm_iec_release(ctx->cbm.fd_cbm, IEC_DATA);
                                                                         SETSTATEDEBUG((void)0);
     return status;
 }
 
-static int write_block(unsigned char tr, unsigned char se, const unsigned char *blk, int size, int read_status)
+static int write_block(d64copy_context *ctx, unsigned char tr, unsigned char se, const unsigned char *blk, int size, int read_status)
 {
     unsigned char status;
+    unsigned char ts[2];
                                                                         SETSTATEDEBUG((void)0);
-    write_n(&tr, 1);
-                                                                        SETSTATEDEBUG((void)0);
-    write_n(&se, 1);
+    /* one backend transaction for both */
+    ts[0] = tr;
+    ts[1] = se;
+    write_n(ctx, ts, 2);
                                                                         SETSTATEDEBUG(DebugByteCount=0);
 
     // removed from loop: SETSTATEDEBUG(DebugByteCount++);
-    write_n(blk, size);
+    write_n(ctx, blk, size);
                                                                         SETSTATEDEBUG(DebugByteCount=-1);
 #ifndef USE_CBM_IEC_WAIT    
     if(size == BLOCKSIZE) {
@@ -195,82 +231,123 @@ static int write_block(unsigned char tr, unsigned char se, const unsigned char *
     }
 #endif    
                                                                         SETSTATEDEBUG((void)0);
-    read_n(&status, 1);
+    read_n(ctx, &status, 1);
                                                                         SETSTATEDEBUG((void)0);
-    cbm_iec_release(fd_cbm, IEC_DATA);
+    cbm_iec_release(ctx->cbm.fd_cbm, IEC_DATA);
                                                                         SETSTATEDEBUG((void)0);
 
     return status;
 }
 
-static int open_disk(CBM_FILE fd, d64copy_settings *settings,
+/* like read_block(), but the turbo checksum program only sends the checksum */
+static int read_sum(d64copy_context *ctx, unsigned char tr, unsigned char se, unsigned char *sum)
+{
+    unsigned char status;
+    unsigned char ts[2];
+
+                                                                        SETSTATEDEBUG((void)0);
+    /* one backend transaction for both */
+    ts[0] = tr;
+    ts[1] = se;
+    write_n(ctx, ts, 2);
+                                                                        SETSTATEDEBUG((void)0);
+#ifndef USE_CBM_IEC_WAIT    
+    arch_usleep(20000);
+#endif    
+                                                                        SETSTATEDEBUG((void)0);
+    read_n(ctx, &status, 1);
+                                                                        SETSTATEDEBUG((void)0);
+    read_n(ctx, sum, SUMSIZE);
+                                                                        SETSTATEDEBUG((void)0);
+    cbm_iec_release(ctx->cbm.fd_cbm, IEC_DATA);
+                                                                        SETSTATEDEBUG((void)0);
+    return status;
+}
+
+static int open_disk(d64copy_context *ctx, CBM_FILE fd, d64copy_settings *settings,
                      const void *arg, int for_writing,
                      turbo_start start, d64copy_message_cb message_cb)
 {
     unsigned char d = (unsigned char)(ULONG_PTR)arg;
 
-    fd_cbm = fd;
-    two_sided = settings->two_sided;
+    ctx->cbm.fd_cbm = fd;
+    ctx->cbm.two_sided = settings->two_sided;
+
+    ctx->cbm.s1_read_n = cbm_get_plugin_function_address_ex(fd, "opencbm_plugin_s1_read_n");
+
+    ctx->cbm.s1_write_n = cbm_get_plugin_function_address_ex(fd, "opencbm_plugin_s1_write_n");
+
+    ctx->cbm.iec_seq_load = cbm_get_plugin_function_address_ex(fd, "opencbm_plugin_iec_seq_load");
 
-    opencbm_plugin_s1_read_n = cbm_get_plugin_function_address("opencbm_plugin_s1_read_n");
+    ctx->cbm.iec_seq_read_n = cbm_get_plugin_function_address_ex(fd, "opencbm_plugin_iec_seq_read_n");
 
-    opencbm_plugin_s1_write_n = cbm_get_plugin_function_address("opencbm_plugin_s1_write_n");
+    ctx->cbm.iec_seq_write_n = cbm_get_plugin_function_address_ex(fd, "opencbm_plugin_iec_seq_write_n");
+
+    ctx->cbm.seq_write_loaded = 0;
+
+    ctx->cbm.seq_read_loaded = 0;
 
                                                                         SETSTATEDEBUG((void)0);
-    cbm_upload(fd_cbm, d, 0x700, s1_drive_prog, sizeof(s1_drive_prog));
+    cbm_upload(ctx->cbm.fd_cbm, d, 0x700, s1_drive_prog, sizeof(s1_drive_prog));
                                                                         SETSTATEDEBUG((void)0);
     start(fd, d);
                                                                         SETSTATEDEBUG((void)0);
-    while(!cbm_iec_get(fd_cbm, IEC_DATA));
+    while(!cbm_iec_get(ctx->cbm.fd_cbm, IEC_DATA));
                                                                         SETSTATEDEBUG((void)0);
     return 0;
 }
 
-static void close_disk(void)
+static void close_disk(d64copy_context *ctx)
 {
                                                                         SETSTATEDEBUG((void)0);
-    s1_write_byte(fd_cbm, 0);
+    s1_write_byte(ctx->cbm.fd_cbm, 0);
                                                                         SETSTATEDEBUG((void)0);
-    s1_write_byte_nohs(fd_cbm, 0);
+    s1_write_byte_nohs(ctx->cbm.fd_cbm, 0);
                                                                         SETSTATEDEBUG((void)0);
     arch_usleep(100);
                                                                         SETSTATEDEBUG(DebugBitCount=-1);
 
-    opencbm_plugin_s1_read_n = NULL;
+    ctx->cbm.s1_read_n = NULL;
+
+    ctx->cbm.s1_write_n = NULL;
+
+    ctx->cbm.iec_seq_load = NULL;
+
+    ctx->cbm.iec_seq_read_n = NULL;
 
-    opencbm_plugin_s1_write_n = NULL;
+    ctx->cbm.iec_seq_write_n = NULL;
 }
 
-static int send_track_map(unsigned char tr, const char *trackmap, unsigned char count)
+static int send_track_map(d64copy_context *ctx, unsigned char tr, const char *trackmap, unsigned char count)
 {
     int i, size;
     unsigned char *data;
                                                                         SETSTATEDEBUG((void)0);
-    size = d64copy_sector_count(two_sided, tr);
+    size = d64copy_sector_count(ctx->cbm.two_sided, tr);
     data = malloc(size+2);
 
-    data[0] = tr;
+    data[0] = WARP_TRACK(ctx->cbm.two_sided, tr);
     data[1] = count;
 
     /* build track map */
     for(i = 0; i < size; i++)
 	data[2+i] = !NEED_SECTOR(trackmap[i]);
                                                                         SETSTATEDEBUG((void)0);
-    write_n(data, size+2);
+    write_n(ctx, data, size+2);
     free(data);
                                                                         SETSTATEDEBUG((void)0);
     return 0;
 }
 
-static int read_gcr_block(unsigned char *se, unsigned char *gcrbuf)
+static int read_gcr_block(d64copy_context *ctx, unsigned char *se, unsigned char *gcrbuf)
 {
     unsigned char s;
 
                                                                         SETSTATEDEBUG((void)0);
-    read_n(&s, 1);
+    read_n(ctx, &s, 1);
                                                                         SETSTATEDEBUG((void)0);
     *se = s;
-    read_n(&s, 1);
+    read_n(ctx, &s, 1);
                                                                         SETSTATEDEBUG((void)0);
 
     if(s) {
@@ -278,7 +355,7 @@ static int read_gcr_block(unsigned char *se, unsigned char *gcrbuf)
     }
 
                                                                         SETSTATEDEBUG(DebugByteCount=0);
-    read_n(gcrbuf, GCRBUFSIZE);
+    read_n(ctx, gcrbuf, GCRBUFSIZE);
                                                                         SETSTATEDEBUG(DebugByteCount=-1);
     return 0;
 }
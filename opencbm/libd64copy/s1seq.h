@@ -0,0 +1,57 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version
+ *  2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 The OpenCBM project
+ */
+
+/*
+ * s1_write_byte() and s1_read_byte() of s1.c as IEC micro-sequences, for
+ * backends which can run those but have no native s1 transfer. Kept apart from s1.c so that xum1541/misc/seqcheck.c can run them
+ * against a model of the drive side of s1.a65.
+ */
+
+#ifndef S1SEQ_H
+#define S1SEQ_H
+
+#include "opencbm-plugin.h"
+
+static const unsigned char s1_seq_write[] = {
+    IEC_SEQ_RECV,
+    IEC_SEQ_REPEAT, 8,
+        IEC_SEQ_PUT_BIT7 | IEC_SEQ_DATA,
+        IEC_SEQ_DELAY, 2,
+        IEC_SEQ_RELEASE | IEC_SEQ_CLOCK,
+        IEC_SEQ_DELAY, 2,
+        IEC_SEQ_WAIT_SET | IEC_SEQ_CLOCK,
+        IEC_SEQ_PUT_BIT7 | IEC_SEQ_INV | IEC_SEQ_DATA,
+        IEC_SEQ_WAIT_RELEASE | IEC_SEQ_CLOCK,
+        IEC_SEQ_SET | IEC_SEQ_CLOCK,
+        IEC_SEQ_RELEASE | IEC_SEQ_DATA,
+        IEC_SEQ_DELAY, 2,
+        IEC_SEQ_WAIT_SET | IEC_SEQ_DATA,
+        IEC_SEQ_SHIFT,
+    IEC_SEQ_NEXT,
+    IEC_SEQ_END
+};
+
+static const unsigned char s1_seq_read[] = {
+    IEC_SEQ_REPEAT, 8,
+        IEC_SEQ_WAIT_RELEASE | IEC_SEQ_DATA,
+        IEC_SEQ_RELEASE | IEC_SEQ_CLOCK,
+        IEC_SEQ_DELAY, 2,
+        IEC_SEQ_GET | IEC_SEQ_CLOCK,
+        IEC_SEQ_SET | IEC_SEQ_DATA,
+        IEC_SEQ_WAIT_BIT7 | IEC_SEQ_CLOCK,
+        IEC_SEQ_RELEASE | IEC_SEQ_DATA,
+        IEC_SEQ_DELAY, 2,
+        IEC_SEQ_WAIT_SET | IEC_SEQ_DATA,
+        IEC_SEQ_SET | IEC_SEQ_CLOCK,
+    IEC_SEQ_NEXT,
+    IEC_SEQ_SEND,
+    IEC_SEQ_END
+};
+
+#endif
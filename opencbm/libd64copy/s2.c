@@ -17,16 +17,10 @@
 
 #include "opencbm-plugin.h"
 
-static opencbm_plugin_s2_read_n_t * opencbm_plugin_s2_read_n = NULL;
-
-static opencbm_plugin_s2_write_n_t * opencbm_plugin_s2_write_n = NULL;
-
 static const unsigned char s2_drive_prog[] = {
 #include "s2.inc"
 };
 
-static CBM_FILE fd_cbm;
-static int two_sided;
 
 static int s2_read_byte(CBM_FILE fd, unsigned char *c)
 {
@@ -90,18 +84,18 @@ static int s2_write_byte_nohs(CBM_FILE fd, unsigned char c)
 }
 
 /* read_n redirects USB reads to the external reader if required */
-static void read_n(unsigned char *data, int size) 
+static void read_n(d64copy_context *ctx, unsigned char *data, int size)
 {
     int i;
 
-    if (opencbm_plugin_s2_read_n)
+    if (ctx->cbm.s2_read_n)
     {
-        opencbm_plugin_s2_read_n(fd_cbm, data, size);
+        ctx->cbm.s2_read_n(ctx->cbm.fd_cbm, data, size);
         return;
     }
 
     for(i=0;i<size;i++)
-	s2_read_byte(fd_cbm, data++);
+	s2_read_byte(ctx->cbm.fd_cbm, data++);
 }
 
 static int s2_write_byte(CBM_FILE fd, unsigned char c)
@@ -121,49 +115,49 @@ static int s2_write_byte(CBM_FILE fd, unsigned char c)
 }
 
 /* write_n redirects USB writes to the external reader if required */
-static void write_n(const unsigned char *data, int size) 
+static void write_n(d64copy_context *ctx, const unsigned char *data, int size)
 {
     int i;
 
-    if (opencbm_plugin_s2_write_n)
+    if (ctx->cbm.s2_write_n)
     {
-        opencbm_plugin_s2_write_n(fd_cbm, data, size);
+        ctx->cbm.s2_write_n(ctx->cbm.fd_cbm, data, size);
         return;
     }
 
     for(i=0;i<size;i++)
-	s2_write_byte(fd_cbm, *data++);
+	s2_write_byte(ctx->cbm.fd_cbm, *data++);
 }
 
-static int read_block(unsigned char tr, unsigned char se, unsigned char *block)
+static int read_block(d64copy_context *ctx, unsigned char tr, unsigned char se, unsigned char *block)
 {
     unsigned char status;
 
                                                                         SETSTATEDEBUG((void)0);
-    write_n(&tr, 1);
+    write_n(ctx, &tr, 1);
                                                                         SETSTATEDEBUG((void)0);
-    write_n(&se, 1);
+    write_n(ctx, &se, 1);
 #ifndef USE_CBM_IEC_WAIT
     arch_usleep(20000);
 #endif
                                                                         SETSTATEDEBUG((void)0);
-    read_n(&status, 1);
+    read_n(ctx, &status, 1);
                                                                         SETSTATEDEBUG(DebugByteCount=0);
-    read_n(block, BLOCKSIZE);
+    read_n(ctx, block, BLOCKSIZE);
                                                                         SETSTATEDEBUG(DebugByteCount=-1);
 
     return status;
 }
 
-static int write_block(unsigned char tr, unsigned char se, const unsigned char *blk, int size, int read_status)
+static int write_block(d64copy_context *ctx, unsigned char tr, unsigned char se, const unsigned char *blk, int size, int read_status)
 {
     unsigned char status;
                                                                         SETSTATEDEBUG((void)0);
-    write_n(&tr, 1);
+    write_n(ctx, &tr, 1);
                                                                         SETSTATEDEBUG((void)0);
-    write_n(&se, 1);
+    write_n(ctx, &se, 1);
                                                                         SETSTATEDEBUG(DebugByteCount=0);
-    write_n(blk, size);
+    write_n(ctx, blk, size);
                                                                         SETSTATEDEBUG(DebugByteCount=-1);
 #ifndef USE_CBM_IEC_WAIT
     if(size == BLOCKSIZE) {
@@ -171,98 +165,119 @@ static int write_block(unsigned char tr, unsigned char se, const unsigned char *
     }
 #endif
                                                                         SETSTATEDEBUG((void)0);
-    read_n(&status, 1);
+    read_n(ctx, &status, 1);
+                                                                        SETSTATEDEBUG((void)0);
+    return status;
+}
+
+/* like read_block(), but the turbo checksum program only sends the checksum */
+static int read_sum(d64copy_context *ctx, unsigned char tr, unsigned char se, unsigned char *sum)
+{
+    unsigned char status;
+
                                                                         SETSTATEDEBUG((void)0);
+    write_n(ctx, &tr, 1);
+                                                                        SETSTATEDEBUG((void)0);
+    write_n(ctx, &se, 1);
+#ifndef USE_CBM_IEC_WAIT
+    arch_usleep(20000);
+#endif
+                                                                        SETSTATEDEBUG((void)0);
+    read_n(ctx, &status, 1);
+                                                                        SETSTATEDEBUG((void)0);
+    read_n(ctx, sum, SUMSIZE);
+                                                                        SETSTATEDEBUG((void)0);
+
     return status;
 }
 
-static int open_disk(CBM_FILE fd, d64copy_settings *settings,
+static int open_disk(d64copy_context *ctx, CBM_FILE fd, d64copy_settings *settings,
                      const void *arg, int for_writing,
                      turbo_start start, d64copy_message_cb message_cb)
 {
     unsigned char d = (unsigned char)(ULONG_PTR)arg;
 
-    fd_cbm = fd;
-    two_sided = settings->two_sided;
+    ctx->cbm.fd_cbm = fd;
+    ctx->cbm.two_sided = settings->two_sided;
 
-    opencbm_plugin_s2_read_n = cbm_get_plugin_function_address("opencbm_plugin_s2_read_n");
+    ctx->cbm.s2_read_n = cbm_get_plugin_function_address_ex(fd, "opencbm_plugin_s2_read_n");
 
-    opencbm_plugin_s2_write_n = cbm_get_plugin_function_address("opencbm_plugin_s2_write_n");
+    ctx->cbm.s2_write_n = cbm_get_plugin_function_address_ex(fd, "opencbm_plugin_s2_write_n");
 
                                                                         SETSTATEDEBUG((void)0);
-    cbm_upload(fd_cbm, d, 0x700, s2_drive_prog, sizeof(s2_drive_prog));
+    cbm_upload(ctx->cbm.fd_cbm, d, 0x700, s2_drive_prog, sizeof(s2_drive_prog));
                                                                         SETSTATEDEBUG((void)0);
     start(fd, d);
                                                                         SETSTATEDEBUG((void)0);
-    cbm_iec_release(fd_cbm, IEC_CLOCK);
+    cbm_iec_release(ctx->cbm.fd_cbm, IEC_CLOCK);
                                                                         SETSTATEDEBUG((void)0);
-    while(!cbm_iec_get(fd_cbm, IEC_CLOCK));
+    while(!cbm_iec_get(ctx->cbm.fd_cbm, IEC_CLOCK));
                                                                         SETSTATEDEBUG((void)0);
-    cbm_iec_set(fd_cbm, IEC_ATN);
+    cbm_iec_set(ctx->cbm.fd_cbm, IEC_ATN);
     arch_usleep(20000);
     
                                                                         SETSTATEDEBUG((void)0);
     return 0;
 }
 
-static void close_disk(void)
+static void close_disk(d64copy_context *ctx)
 {
                                                                         SETSTATEDEBUG((void)0);
-    s2_write_byte(fd_cbm, 0);
+    s2_write_byte(ctx->cbm.fd_cbm, 0);
                                                                         SETSTATEDEBUG((void)0);
-    s2_write_byte_nohs(fd_cbm, 0);
+    s2_write_byte_nohs(ctx->cbm.fd_cbm, 0);
     arch_usleep(100);
                                                                         SETSTATEDEBUG(DebugBitCount=-1);
-    cbm_iec_release(fd_cbm, IEC_DATA);
+    cbm_iec_release(ctx->cbm.fd_cbm, IEC_DATA);
                                                                         SETSTATEDEBUG((void)0);
-    cbm_iec_release(fd_cbm, IEC_ATN);
+    cbm_iec_release(ctx->cbm.fd_cbm, IEC_ATN);
                                                                         SETSTATEDEBUG((void)0);
-    cbm_iec_set(fd_cbm, IEC_CLOCK);
+    cbm_iec_set(ctx->cbm.fd_cbm, IEC_CLOCK);
                                                                         SETSTATEDEBUG((void)0);
 
-    opencbm_plugin_s2_read_n = NULL;
+    ctx->cbm.s2_read_n = NULL;
 
-    opencbm_plugin_s2_write_n = NULL;
+    ctx->cbm.s2_write_n = NULL;
 }
 
-static int send_track_map(unsigned char tr, const char *trackmap, unsigned char count)
+static int send_track_map(d64copy_context *ctx, unsigned char tr, const char *trackmap, unsigned char count)
 {
     int i;
     int size;
     unsigned char *data;
 
                                                                         SETSTATEDEBUG((void)0);
-    size = d64copy_sector_count(two_sided, tr);
+    size = d64copy_sector_count(ctx->cbm.two_sided, tr);
     data = malloc(2+size);
 
-    data[0] = tr;
+    data[0] = WARP_TRACK(ctx->cbm.two_sided, tr);
     data[1] = count;
 
     /* build track map */
     for(i = 0; i < size; i++)
 	data[2+i] = !NEED_SECTOR(trackmap[i]);
     
-    write_n(data, size+2);
+    write_n(ctx, data, size+2);
     free(data);
                                                                         SETSTATEDEBUG((void)0);
     return 0;
 }
 
-static int read_gcr_block(unsigned char *se, unsigned char *gcrbuf)
+static int read_gcr_block(d64copy_context *ctx, unsigned char *se, unsigned char *gcrbuf)
 {
     unsigned char s;
 
                                                                         SETSTATEDEBUG((void)0);
-    read_n(&s, 1);
+    read_n(ctx, &s, 1);
     *se = s;
                                                                         SETSTATEDEBUG((void)0);
-    read_n(&s, 1);
+    read_n(ctx, &s, 1);
 
     if(s) {
         return s;
     }
                                                                         SETSTATEDEBUG(DebugByteCount=0);
-    read_n(gcrbuf, GCRBUFSIZE);									
+    read_n(ctx, gcrbuf, GCRBUFSIZE);									
                                                                         SETSTATEDEBUG(DebugByteCount=-1);
     return 0;
 }
@@ -13,24 +13,21 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-static unsigned char drive = 0;
-static CBM_FILE fd_cbm = (CBM_FILE) -1;
-
-static int read_block(unsigned char tr, unsigned char se, unsigned char *block)
+static int read_block(d64copy_context *ctx, unsigned char tr, unsigned char se, unsigned char *block)
 {
     char cmd[48];
     int rv = 1;
 
     sprintf(cmd, "U1:2 0 %d %d", tr, se);
-    if(cbm_exec_command(fd_cbm, drive, cmd, 0) == 0) {
-        rv = cbm_device_status(fd_cbm, drive, cmd, sizeof(cmd));
+    if(cbm_exec_command(ctx->cbm.fd_cbm, ctx->cbm.drive, cmd, 0) == 0) {
+        rv = cbm_device_status(ctx->cbm.fd_cbm, ctx->cbm.drive, cmd, sizeof(cmd));
         if(rv == 0) {
-            if(cbm_exec_command(fd_cbm, drive, "B-P2 0", 0) == 0) {
-                if(cbm_talk(fd_cbm, drive, 2) == 0) {
+            if(cbm_exec_command(ctx->cbm.fd_cbm, ctx->cbm.drive, "B-P2 0", 0) == 0) {
+                if(cbm_talk(ctx->cbm.fd_cbm, ctx->cbm.drive, 2) == 0) {
                                                                         SETSTATEDEBUG(DebugByteCount=0);
-                    rv = cbm_raw_read(fd_cbm, block, BLOCKSIZE) != BLOCKSIZE;
+                    rv = cbm_raw_read(ctx->cbm.fd_cbm, block, BLOCKSIZE) != BLOCKSIZE;
                                                                         SETSTATEDEBUG(DebugByteCount=-1);
-                    cbm_untalk(fd_cbm);
+                    cbm_untalk(ctx->cbm.fd_cbm);
                 }
             }
         }
@@ -38,31 +35,31 @@ static int read_block(unsigned char tr, unsigned char se, unsigned char *block)
     return rv;
 }
 
-static int write_block(unsigned char tr, unsigned char se, const unsigned char *blk, int size, int read_status)
+static int write_block(d64copy_context *ctx, unsigned char tr, unsigned char se, const unsigned char *blk, int size, int read_status)
 {
     char cmd[48];
     int  rv = 1;
 
-    if(cbm_exec_command(fd_cbm, drive, "B-P2 0", 0) == 0)
+    if(cbm_exec_command(ctx->cbm.fd_cbm, ctx->cbm.drive, "B-P2 0", 0) == 0)
     {
-        if(cbm_listen(fd_cbm, drive, 2) == 0)
+        if(cbm_listen(ctx->cbm.fd_cbm, ctx->cbm.drive, 2) == 0)
         {
                                                                         SETSTATEDEBUG(DebugByteCount=0);
-            rv = cbm_raw_write(fd_cbm, blk, size) != size;
+            rv = cbm_raw_write(ctx->cbm.fd_cbm, blk, size) != size;
                                                                         SETSTATEDEBUG(DebugByteCount=-1);
-            cbm_unlisten(fd_cbm);
+            cbm_unlisten(ctx->cbm.fd_cbm);
             if(rv == 0)
             {
                 sprintf(cmd ,"U2:2 0 %d %d", tr, se);
-                cbm_exec_command(fd_cbm, drive, cmd, 0);
-                rv = cbm_device_status(fd_cbm, drive, cmd, sizeof(cmd));
+                cbm_exec_command(ctx->cbm.fd_cbm, ctx->cbm.drive, cmd, 0);
+                rv = cbm_device_status(ctx->cbm.fd_cbm, ctx->cbm.drive, cmd, sizeof(cmd));
             }
         }
     }
     return rv;
 }
 
-static int open_disk(CBM_FILE fd, d64copy_settings *settings,
+static int open_disk(d64copy_context *ctx, CBM_FILE fd, d64copy_settings *settings,
                      const void *arg, int for_writing,
                      turbo_start start, d64copy_message_cb message_cb)
 {
@@ -76,23 +73,23 @@ static int open_disk(CBM_FILE fd, d64copy_settings *settings,
         return 99;
     }
 
-    drive = (unsigned char)(ULONG_PTR)arg;
+    ctx->cbm.drive = (unsigned char)(ULONG_PTR)arg;
 
-    fd_cbm = fd;
+    ctx->cbm.fd_cbm = fd;
 
-    cbm_open(fd_cbm, drive, 2, "#", 1);
+    cbm_open(ctx->cbm.fd_cbm, ctx->cbm.drive, 2, "#", 1);
 
-    rv = cbm_device_status(fd_cbm, drive, buf, sizeof(buf));
+    rv = cbm_device_status(ctx->cbm.fd_cbm, ctx->cbm.drive, buf, sizeof(buf));
     if(rv)
     {
-        message_cb(0, "drive %02d: %s", drive, buf);
+        message_cb(0, "ctx->cbm.drive %02d: %s", ctx->cbm.drive, buf);
     }
     return rv;
 }
 
-static void close_disk(void)
+static void close_disk(d64copy_context *ctx)
 {
-    cbm_close(fd_cbm, drive, 2);
+    cbm_close(ctx->cbm.fd_cbm, ctx->cbm.drive, 2);
 }
 
 DECLARE_TRANSFER_FUNCS(std_transfer, 1, 0);
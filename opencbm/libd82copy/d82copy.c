@@ -109,6 +109,9 @@ extern transfer_funcs d82copy_fs_transfer,
 static d82copy_message_cb message_cb;
 static d82copy_status_cb status_cb;
 
+/* the journal of the image being written, see journal_start() */
+static cbmlibmisc_journal *journal;
+
 int d82copy_sector_count(int two_sided, int track)
 {
     if(two_sided)
@@ -145,6 +148,7 @@ d82copy_settings *d82copy_get_default_settings(void)
         settings->drive_type  = cbm_dt_unknown; /* auto detect later on */
         settings->two_sided   = -1; /* set later on */
         settings->error_mode  = em_on_error;
+        settings->resume      = 0;
     }
     return settings;
 }
@@ -233,6 +237,107 @@ int ReadBAM(d82copy_settings *settings, const transfer_funcs *src, unsigned char
 	return st;
 }
 
+/*
+ * When reading a disk into an image, the sector map is kept in a journal
+ * next to the image. If resume is set, the sectors an interrupted copy
+ * has already finished are taken from there and are not read again.
+ * disk identifies the source disk (NULL if its BAM could not be read);
+ * a journal written for another disk is never resumed.
+ * Returns the number of these sectors, or -1 if the copy must not go on.
+ */
+static int journal_start(d82copy_status *status, const char *image, int resume,
+                         const char *disk)
+{
+    static char old_bam[MAX_TRACKS][MAX_SECTORS+1];
+    char id[40];
+    int tr, se;
+    int restored = 0;
+
+    sprintf(id, "d82copy %dx%d %s", MAX_TRACKS, MAX_SECTORS+1,
+            status->settings->two_sided ? "d82" : "d80");
+
+    if(resume && disk == NULL)
+    {
+        message_cb(0, "can't identify the disk without its BAM, refusing to resume");
+        return -1;
+    }
+
+    if(resume)
+    {
+        switch(cbmlibmisc_journal_load(image, id, disk, old_bam, sizeof(old_bam)))
+        {
+            case 0:
+                for(tr = 0; tr < MAX_TRACKS; tr++)
+                {
+                    for(se = 0; se < MAX_SECTORS+1; se++)
+                    {
+                        if(old_bam[tr][se] == bs_copied &&
+                           status->bam[tr][se] == bs_must_copy)
+                        {
+                            status->bam[tr][se] = bs_copied;
+                            restored++;
+                        }
+                    }
+                }
+                message_cb(2, "resuming, %d sectors copied already", restored);
+                break;
+            case 1:
+                message_cb(1, "no journal found, copying all sectors");
+                break;
+            case -2:
+                message_cb(0, "the journal was written for another disk, refusing to resume");
+                return -1;
+            default:
+                message_cb(1, "journal does not match, copying all sectors");
+                break;
+        }
+    }
+
+    journal = cbmlibmisc_journal_create(image, id, disk ? disk : "unknown",
+                                        status->bam, sizeof(status->bam));
+    if(journal == NULL)
+    {
+        message_cb(1, "could not create journal, copy cannot be resumed");
+    }
+    return restored;
+}
+
+/*
+ * identify a disk for the journal by its disk ID (in the header, 39/0)
+ * and a checksum (Fletcher sums, modulo 256) of the blocks read by ReadBAM()
+ */
+static void disk_id(const unsigned char *bam, int bam_count, char *disk)
+{
+    unsigned char a = 0, b = 0;
+    int i;
+
+    for(i = 0; i < bam_count * BLOCKSIZE; i++)
+    {
+        a = (unsigned char) (a + bam[i]);
+        b = (unsigned char) (b + a);
+    }
+
+    sprintf(disk, "id %02x%02x bam %02x%02x", bam[0x18], bam[0x19], a, b);
+}
+
+/* check if all sectors of the image have been copied */
+static int copy_complete(const d82copy_status *status)
+{
+    int tr, se;
+
+    for(tr = 0; tr < MAX_TRACKS; tr++)
+    {
+        for(se = 0; se < MAX_SECTORS+1; se++)
+        {
+            if(NEED_SECTOR(status->bam[tr][se]))
+            {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
 static int copy_disk(CBM_FILE fd_cbm, d82copy_settings *settings,
               const transfer_funcs *src, const void *src_arg,
               const transfer_funcs *dst, const void *dst_arg, unsigned char cbm_drive)
@@ -251,12 +356,16 @@ static int copy_disk(CBM_FILE fd_cbm, d82copy_settings *settings,
     //unsigned const char *bam_ptr;
     unsigned char bam[BLOCKSIZE *5];
     int bam_count;
+    int bam_read = 0;
+    char disk[40];
     unsigned char block[BLOCKSIZE];
     //unsigned char gcr[GCRBUFSIZE];
     const transfer_funcs *cbm_transf = NULL;
     d82copy_status status;
     const char *sector_map;
     const char *type_str = "*unknown*";
+    off_t filesize;
+    int resume;
 
 
     if(settings->drive_type == cbm_dt_unknown )
@@ -407,6 +516,14 @@ static int copy_disk(CBM_FILE fd_cbm, d82copy_settings *settings,
                    settings->drive_type == cbm_dt_cbm1541 ? 0 : 1);
     }
 
+    /* only resume if there is something to resume */
+    resume = settings->resume && !dst->is_cbm_drive;
+    if(resume && arch_filesize((const char *) dst_arg, &filesize) != 0)
+    {
+        message_cb(1, "no image to resume, copying all sectors");
+        resume = 0;
+    }
+
     SETSTATEDEBUG((void)0);
     if(src->open_disk(fd_cbm, settings, src_arg, 0,
                       start_turbo, message_cb) == 0)
@@ -432,7 +549,8 @@ static int copy_disk(CBM_FILE fd_cbm, d82copy_settings *settings,
 
     memset(status.bam, bs_invalid, MAX_TRACKS * MAX_SECTORS);
 
-    if(settings->bam_mode != bm_ignore)
+    /* the journal of an image needs the BAM to identify the disk */
+    if(settings->bam_mode != bm_ignore || !dst->is_cbm_drive)
     {
 	st = ReadBAM(settings, src, bam, &bam_count);
 	if(st)
@@ -440,6 +558,10 @@ static int copy_disk(CBM_FILE fd_cbm, d82copy_settings *settings,
 		message_cb(1, "failed to read BAM (%d), reading whole disk", st);
 		settings->bam_mode = bm_ignore;
 	}
+	else
+	{
+		bam_read = 1;
+	}
     }
     SETSTATEDEBUG((void)0);
 
@@ -484,6 +606,23 @@ static int copy_disk(CBM_FILE fd_cbm, d82copy_settings *settings,
 
     status.settings = settings;
 
+    if(!dst->is_cbm_drive)
+    {
+        if(bam_read)
+        {
+            disk_id(bam, bam_count, disk);
+        }
+        st = journal_start(&status, (const char *) dst_arg, resume,
+                           bam_read ? disk : NULL);
+        if(st < 0)
+        {
+            dst->close_disk();
+            src->close_disk();
+            return -1;
+        }
+        status.sectors_processed = st;
+    }
+
     status_cb(status);
 
     message_cb(2, "copying tracks %d-%d (%d sectors)",
@@ -496,14 +635,11 @@ static int copy_disk(CBM_FILE fd_cbm, d82copy_settings *settings,
         {
             scnt = sector_map[tr];
             memcpy(trackmap, status.bam[tr-1], scnt);
-            if(settings->bam_mode != bm_ignore)
+            for(se = 0; se < sector_map[tr]; se++)
             {
-                for(se = 0; se < sector_map[tr]; se++)
+                if(trackmap[se] != bs_must_copy)
                 {
-                    if(trackmap[se] != bs_must_copy)
-                    {
-                        scnt--;
-                    }
+                    scnt--;
                 }
             }
 
@@ -620,6 +756,13 @@ static int copy_disk(CBM_FILE fd_cbm, d82copy_settings *settings,
 
                     status.track = tr;
                     status.sector= se;
+                    status.bam[tr-1][se] = trackmap[se];
+                    if(journal)
+                    {
+                        cbmlibmisc_journal_update(journal,
+                            &status.bam[tr-1][se] - &status.bam[0][0],
+                            trackmap[se]);
+                    }
 
                     status_cb(status);
 
@@ -662,6 +805,13 @@ static int copy_disk(CBM_FILE fd_cbm, d82copy_settings *settings,
     SETSTATEDEBUG((void)0);
     src->close_disk();
 
+    if(journal)
+    {
+        /* keep the journal if there are sectors left to retry */
+        cbmlibmisc_journal_close(journal, copy_complete(&status));
+        journal = NULL;
+    }
+
     SETSTATEDEBUG((void)0);
     return cnt;
 }
@@ -830,4 +980,11 @@ void d82copy_cleanup(void)
         atom_dst->close_disk();
         atom_mustcleanup = 0;
     }
+
+    /* keep the journal, so the copy can be resumed */
+    if (journal)
+    {
+        cbmlibmisc_journal_close(journal, 0);
+        journal = NULL;
+    }
 }
@@ -16,6 +16,7 @@
 #include "gcr.h"
 
 #include "arch.h"
+#include "journal.h"
 
 #ifdef LIBD82COPY_DEBUG
 # define DEBUG_STATEDEBUG
@@ -19,32 +19,78 @@
 static imgcopy_settings *fs_settings;
 
 static FILE *the_file;
+static ARCH_MAPPING mapping;
+static unsigned char *image;
 static char *error_map;
 static int block_count;
 
+/* first block of each track, see setup_track_offsets() */
+static int track_offset[TOT_TRACKS+2];
+static int track_count;
 
 
-/* always use maximum size for error map */
-//#define ERROR_MAP_LENGTH D82_BLOCKS
+/* fill the table of the first block of each track */
+static void setup_track_offsets(void)
+{
+    int tr, sectors;
+
+    track_offset[1] = 0;
+    for(tr = 1; tr <= fs_settings->max_tracks && tr <= TOT_TRACKS; tr++)
+    {
+        sectors = imgcopy_sector_count(fs_settings, tr);
+        if(sectors < 0)
+        {
+            break;
+        }
+        track_offset[tr + 1] = track_offset[tr] + sectors;
+    }
+    track_count = tr - 1;
+}
+
+/* the number of the block tr/se in the image, or -1 if there is none */
+static int block_index(int tr, int se)
+{
+    int index;
 
+    if(tr < 1 || tr > track_count)
+    {
+        return -1;
+    }
+    index = track_offset[tr] + se;
+    if(index >= block_count)
+    {
+        return -1;
+    }
+    return index;
+}
 
-static int block_offset(int tr, int se)
+/* map the image (and, for writing, the error map behind it) */
+static int map_image(int for_writing)
 {
-    int sectors = 0, i;
-    for(i = 1; i < tr; i++)
+    size_t size = (size_t) block_count *
+                  (for_writing ? BLOCKSIZE + 1 : BLOCKSIZE);
+    void *address;
+
+    mapping = arch_mmap(arch_fileno(the_file), size, for_writing, &address);
+    if(mapping == NULL)
     {
-        sectors += imgcopy_sector_count(fs_settings, i);
+        return 1;
     }
-    return (sectors + se) * BLOCKSIZE;
+    image = address;
+    error_map = for_writing ? (char *) image + block_count * BLOCKSIZE : NULL;
+    return 0;
 }
 
 static int read_block(unsigned char tr, unsigned char se, unsigned char *block)
 {
-    if(fseek(the_file, block_offset(tr, se), SEEK_SET) == 0)
+    int index = block_index(tr, se);
+
+    if(index < 0)
     {
-        return fread(block, BLOCKSIZE, 1, the_file) != 1;
+        return 1;
     }
-    return 1;
+    memcpy(block, image + index * BLOCKSIZE, BLOCKSIZE);
+    return 0;
 }
 
 /*
@@ -59,8 +105,7 @@ static int atom_read_status;
 
 static int write_block(unsigned char tr, unsigned char se, const unsigned char *blk, int size, int read_status)
 {
-    long ofs;
-    int ret;
+    int index;
 
     atom_tr = tr;
     atom_se = se;
@@ -70,20 +115,25 @@ static int write_block(unsigned char tr, unsigned char se, const unsigned char *
 
     atom_execute = 1;
 
-    ofs = block_offset(tr, se);
-    if(fseek(the_file, ofs, SEEK_SET) == 0)
+    index = block_index(tr, se);
+    if(index >= 0 && size <= BLOCKSIZE)
     {
-        error_map[ofs / BLOCKSIZE] = (char) ((read_status == 0) ? 1 : read_status);
-        ret = fwrite(blk, size, 1, the_file) != 1;
-    }
-    else
-    {
-        ret = 1;
+        error_map[index] = (char) ((read_status == 0) ? 1 : read_status);
+        memcpy(image + index * BLOCKSIZE, blk, size);
     }
 
     atom_execute = 0;
 
-    return ret;
+    return index < 0 || size > BLOCKSIZE;
+}
+
+/*
+ * Write everything to the image file. Before this, it is only
+ * guaranteed to be in the page cache.
+ */
+static int flush_image(void)
+{
+    return mapping ? arch_msync(mapping) : 0;
 }
 
 static int open_disk(CBM_FILE fd, imgcopy_settings *settings,
@@ -98,8 +148,12 @@ static int open_disk(CBM_FILE fd, imgcopy_settings *settings,
     //printf("open imagefile ...\n");
 
     the_file = NULL;
+    mapping = NULL;
+    image = NULL;
+    error_map = NULL;
     fs_settings = settings;
     //block_count = 0;
+    setup_track_offsets();
 
     stat_ok = arch_filesize(name, &filesize) == 0;
     is_image = error_info = 0;
@@ -156,6 +210,12 @@ static int open_disk(CBM_FILE fd, imgcopy_settings *settings,
                 {
                     message_cb(0, "could not open %s", name);
                 }
+                else if(map_image(0))
+                {
+                    message_cb(0, "could not map %s", name);
+                    fclose(the_file);
+                    the_file = NULL;
+                }
                 if(error_info)
                 {
                     message_cb(1, "image contains error information");
@@ -183,61 +243,29 @@ static int open_disk(CBM_FILE fd, imgcopy_settings *settings,
     }
     else
     {
-        the_file = fopen(name, is_image ? "r+b" : "wb");
+        the_file = fopen(name, is_image ? "r+b" : "w+b");
         if(the_file)
         {
-            /* check whether we must resize or create an image file */
-            int new_tr;
-
-            new_tr = settings->max_tracks;
+            if(!is_image)
+            {
+                /* grow image */
+                message_cb(1, "growing image file to %d blocks", block_count);
+            }
 
-            /* always use maximum size for error map */
-            error_map = calloc(block_count, 1);
-            if(!error_map)
+            /*
+             * the error map is kept behind the image while we are
+             * writing; close_disk() removes it again if it is not needed
+             */
+            if (arch_ftruncate(arch_fileno(the_file), block_count * (BLOCKSIZE + 1)) != 0 ||
+                map_image(1) != 0)
             {
-                message_cb(0, "no memory for error map");
+                message_cb(0, "%s: could not extend or map image file", name);
                 fclose(the_file);
+                the_file = NULL;
                 if(!is_image)
-                {
                     arch_unlink(name);
-                }
                 return 1;
             }
-
-            if(is_image)
-            {
-                if(error_info)
-                {
-                    if(fseek(the_file, block_count * BLOCKSIZE, SEEK_SET) != 0 ||
-                       fread(error_map, block_count, 1, the_file) != 1)
-                    {
-                        message_cb(0, "%s: could not read error map", name);
-                        fclose(the_file);
-                        return 1;
-                    }
-                }
-                if(fseek(the_file, block_count * BLOCKSIZE, SEEK_SET) != 0)
-                {
-                    message_cb(0, "%s: could not seek to end of file", name);
-                    fclose(the_file);
-                    return 1;
-                }
-            }
-
-            if(new_tr > tr)
-            {
-                /* grow image */
-                message_cb(1, "growing image file to %d blocks", block_count);
-
-                if (arch_ftruncate(arch_fileno(the_file), block_count * BLOCKSIZE) != 0)
-                {
-                    message_cb(0, "%s: could not extend image file", name);
-                    fclose(the_file);
-                    if(!is_image)
-                        arch_unlink(name);
-                    return 1;
-                }
-            }
         }
         else
         {
@@ -284,26 +312,20 @@ static void close_disk(void)
         }
     }
 
-    if(the_file)
+    if(mapping)
     {
-        if(has_errors)
-        {
-            if(fseek(the_file, block_count * BLOCKSIZE, SEEK_SET) == 0)
-            {
-                fwrite(error_map, block_count, 1, the_file);
-            }
-        } 
-        else
-        {
-            arch_ftruncate(arch_fileno(the_file), block_count * BLOCKSIZE);
-        }
+        flush_image();
+        arch_munmap(mapping);
+        mapping = NULL;
+        image = NULL;
     }
 
-    if(error_map)
+    if(the_file && error_map && !has_errors)
     {
-        free(error_map);
-        error_map = NULL;
+        arch_ftruncate(arch_fileno(the_file), block_count * BLOCKSIZE);
     }
+    error_map = NULL;
+
     if(the_file)
     {
         fclose(the_file);
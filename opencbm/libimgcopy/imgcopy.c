@@ -64,6 +64,10 @@ static const unsigned char turbo_write_1581[] =
 {
 #include "turbowrite1581.inc"
 };
+static const unsigned char turbo_sum_1581[] =
+{
+#include "turbosum1581.inc"
+};
 
 //
 // drive code 1541
@@ -76,6 +80,10 @@ static const unsigned char turbo_write_1541[] =
 {
 #include "turbowrite1541.inc"
 };
+static const unsigned char turbo_sum_1541[] =
+{
+#include "turbosum1541.inc"
+};
 static const unsigned char warp_read_1541[] =
 {
 #include "turboread1541.inc"
@@ -96,6 +104,10 @@ static const unsigned char turbo_write_1571[] =
 {
 #include "turbowrite1571.inc"
 };
+static const unsigned char turbo_sum_1571[] =
+{
+#include "turbosum1571.inc"
+};
 static const unsigned char warp_read_1571[] =
 {
 #include "turboread1571.inc"
@@ -156,6 +168,14 @@ static const struct drive_prog
     //{sizeof(turbo_read_1541), turbo_read_1541},
 };
 
+// checksum programs for verifying, see compare_disk()
+static const struct drive_prog sum_progs[] =
+{
+	{sizeof(turbo_sum_1541), turbo_sum_1541},
+	{sizeof(turbo_sum_1571), turbo_sum_1571},
+	{sizeof(turbo_sum_1581), turbo_sum_1581},
+};
+
 
 static const int default_interleave[] = { -1, 22, -1 };
 static const int warp_write_interleave[] = { -1, 0,-1 };
@@ -187,28 +207,21 @@ static const transfer_funcs *atom_dst;
 
 
 //
-// send drive code 
+// index of the drive code for a drive type, -1 if there is none
 //
-static int send_turbo(imgcopy_settings *settings, CBM_FILE fd, unsigned char drv, int write)
+static int drive_prog_type(const imgcopy_settings *settings)
 {
-	//int warp, int drv_type :: settings->warp, settings->drive_type
-	const struct drive_prog *prog;
-	int warp, drv_type, idx;
-
 	switch(settings->drive_type)
 	{
 	   case cbm_dt_cbm1541:
-		drv_type = 0;
-		break;
+		return 0;
 
 	   case cbm_dt_cbm1570:
 	   case cbm_dt_cbm1571:
-		drv_type = 1;
-		break;
+		return 1;
 
 	   case cbm_dt_cbm1581:
-		drv_type = 2;
-		break;
+		return 2;
 
 	   case cbm_dt_cbm2040:
 	   case cbm_dt_cbm2031:
@@ -223,13 +236,47 @@ static int send_turbo(imgcopy_settings *settings, CBM_FILE fd, unsigned char drv
 		// drive type not allowed
 		return -1;
 	}
+}
+
+//
+// send drive code 
+//
+static int send_turbo(imgcopy_settings *settings, CBM_FILE fd, unsigned char drv, int write)
+{
+	//int warp, int drv_type :: settings->warp, settings->drive_type
+	const struct drive_prog *prog;
+	int warp, drv_type, idx;
+
+	drv_type = drive_prog_type(settings);
+	if(drv_type < 0)
+	{
+		return -1;
+	}
 
 	warp = settings->warp ? 1 : 0;
 	idx = drv_type * 4 + warp * 2 + write;
 	printf("uploading drivecode %d\n", idx);
 	prog = &drive_progs[idx];
 
-	return cbm_upload(fd, drv, 0x500, prog->prog, prog->size) != prog->size;
+	return cbm_upload_cached(fd, drv, 0x500, prog->prog, prog->size) != prog->size;
+}
+
+//
+// send the checksum drive code
+//
+static int send_sum_turbo(imgcopy_settings *settings, CBM_FILE fd, unsigned char drv)
+{
+	const struct drive_prog *prog;
+	int drv_type;
+
+	drv_type = drive_prog_type(settings);
+	if(drv_type < 0)
+	{
+		return -1;
+	}
+
+	prog = &sum_progs[drv_type];
+	return cbm_upload_cached(fd, drv, 0x500, prog->prog, prog->size) != prog->size;
 }
 
 extern transfer_funcs imgcopy_fs_transfer,
@@ -237,6 +284,38 @@ extern transfer_funcs imgcopy_fs_transfer,
 
 static imgcopy_message_cb message_cb;
 static imgcopy_status_cb status_cb;
+static imgcopy_event_cb event_cb;
+static void *event_arg;
+
+/* the status of the copy in progress, NULL if there is none */
+static const imgcopy_status *live_status;
+
+/* the journal of the image being written, see journal_start() */
+static cbmlibmisc_journal *journal;
+
+static void report_progress(const imgcopy_status *status, imgcopy_event_type type)
+{
+	imgcopy_event event;
+
+	if(event_cb)
+	{
+		event.type              = type;
+		event.track             = status->track;
+		event.sector            = status->sector;
+		event.read_result       = status->read_result;
+		event.write_result      = status->write_result;
+		event.sectors_processed = status->sectors_processed;
+		event.total_sectors     = status->total_sectors;
+
+		event_cb(&event, event_arg);
+	}
+
+	/* the status callback has never been told when the copy is done */
+	if(status_cb && type != imgcopy_ev_done)
+	{
+		status_cb(*status);
+	}
+}
 
 
 
@@ -478,6 +557,8 @@ imgcopy_settings *imgcopy_get_default_settings(void)
 		settings->image_type_std = cbm_it_unknown;
 		settings->two_sided   = -1; /* set later on */
 		settings->error_mode  = em_on_error;
+		settings->resume      = 0;
+		settings->verify      = 0;
 		settings->cat_track = 0;
 		settings->bam_track = 0;
 		settings->block_count = 0;
@@ -674,6 +755,204 @@ int ReadBAM(imgcopy_settings *settings, const transfer_funcs *src, unsigned char
 
 
 
+//
+// When reading a disk into an image, the sector map is kept in a journal
+// next to the image. If resume is set, the sectors an interrupted copy
+// has already finished are taken from there and are not read again.
+// disk identifies the source disk (NULL if its BAM could not be read);
+// a journal written for another disk is never resumed.
+// Returns the number of these sectors, or -1 if the copy must not go on.
+//
+static int journal_start(imgcopy_status *status, const char *image, int resume,
+                         const char *disk)
+{
+	static char old_bam[MAX_TRACKS+1][MAX_SECTORS+1];
+	char id[40];
+	int tr, se;
+	int restored = 0;
+
+	sprintf(id, "imgcopy %dx%d %d", MAX_TRACKS+1, MAX_SECTORS+1,
+	        (int) status->settings->image_type);
+
+	if(resume && disk == NULL)
+	{
+		message_cb(0, "can't identify the disk without its BAM, refusing to resume");
+		return -1;
+	}
+
+	if(resume)
+	{
+		switch(cbmlibmisc_journal_load(image, id, disk, old_bam, sizeof(old_bam)))
+		{
+			case 0:
+				for(tr = 0; tr < MAX_TRACKS+1; tr++)
+				{
+					for(se = 0; se < MAX_SECTORS+1; se++)
+					{
+						if(old_bam[tr][se] == bs_copied &&
+						   status->bam[tr][se] == bs_must_copy)
+						{
+							status->bam[tr][se] = bs_copied;
+							restored++;
+						}
+					}
+				}
+				message_cb(2, "resuming, %d sectors copied already", restored);
+				break;
+			case 1:
+				message_cb(1, "no journal found, copying all sectors");
+				break;
+			case -2:
+				message_cb(0, "the journal was written for another disk, refusing to resume");
+				return -1;
+			default:
+				message_cb(1, "journal does not match, copying all sectors");
+				break;
+		}
+	}
+
+	journal = cbmlibmisc_journal_create(image, id, disk ? disk : "unknown",
+	                                    status->bam, sizeof(status->bam));
+	if(journal == NULL)
+	{
+		message_cb(1, "could not create journal, copy cannot be resumed");
+	}
+	return restored;
+}
+
+//
+// identify a disk for the journal by its disk ID and a checksum
+// (Fletcher sums, modulo 256) of the BAM blocks read by ReadBAM()
+//
+static void disk_id(imgcopy_settings *settings, const unsigned char *bam,
+                    int bam_count, char *disk)
+{
+	unsigned char a = 0, b = 0;
+	const unsigned char *id;
+	int i;
+
+	for(i = 0; i < bam_count * BLOCKSIZE; i++)
+	{
+		a = (unsigned char) (a + bam[i]);
+		b = (unsigned char) (b + a);
+	}
+
+	// D81: in the first BAM block (40/1), D80/D82: in the header (39/0)
+	id = (settings->image_type == D81) ? &bam[0x04] : &bam[0x18];
+
+	sprintf(disk, "id %02x%02x bam %02x%02x", id[0], id[1], a, b);
+}
+
+//
+// check if all sectors of the image have been copied
+//
+static int copy_complete(const imgcopy_status *status)
+{
+	int tr, se;
+
+	for(tr = 0; tr < MAX_TRACKS+1; tr++)
+	{
+		for(se = 0; se < MAX_SECTORS+1; se++)
+		{
+			if(NEED_SECTOR(status->bam[tr][se]))
+			{
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+//
+// the checksum the turbo checksum programs compute: the Fletcher
+// sums A and B, both modulo 256
+//
+static void block_sum(const unsigned char *block, unsigned char *sum)
+{
+	unsigned char a = 0, b = 0;
+	int i;
+
+	for(i = 0; i < BLOCKSIZE; i++)
+	{
+		a = (unsigned char) (a + block[i]);
+		b = (unsigned char) (b + a);
+	}
+	sum[0] = a;
+	sum[1] = b;
+}
+
+//
+// compare the copied sectors on the disk with the image. Those which
+// differ (or cannot be read) are marked as errors. With a turbo transfer,
+// the drive only sends a checksum of every sector, else the sectors are
+// read. Returns the number of sectors which are equal.
+//
+static int compare_disk(imgcopy_status *status, const transfer_funcs *src,
+                        const transfer_funcs *dst)
+{
+	imgcopy_settings *settings = status->settings;
+	unsigned char block[BLOCKSIZE];
+	unsigned char disk_sum[SUMSIZE];
+	unsigned char image_sum[SUMSIZE];
+	char pending[MAX_SECTORS+1];
+	unsigned char tr, se, sectorCount;
+	int scnt, st;
+	int equal = 0;
+
+	for(tr = 1; tr <= settings->max_tracks; tr++)
+	{
+		sectorCount = (unsigned char) imgcopy_sector_count(settings, tr);
+
+		scnt = 0;
+		for(se = 0; se < sectorCount; se++)
+		{
+			pending[se] = (status->bam[tr-1][se] == bs_copied);
+			scnt += pending[se];
+		}
+
+		se = 0;
+		while(scnt)
+		{
+			while(!pending[se])
+			{
+				if(++se >= sectorCount) se = 0;
+			}
+			pending[se] = 0;
+			scnt--;
+
+			SETSTATEDEBUG(debugLibImgBlockCount++);
+			if(dst->read_sum)
+			{
+				st = dst->read_sum(tr, se, disk_sum);
+			}
+			else
+			{
+				st = dst->read_block(tr, se, block);
+				block_sum(block, disk_sum);
+			}
+
+			status->bam[tr-1][se] = bs_error;
+			if(st == 0 && src->read_block(tr, se, block) == 0)
+			{
+				block_sum(block, image_sum);
+				if(memcmp(disk_sum, image_sum, SUMSIZE) == 0)
+				{
+					status->bam[tr-1][se] = bs_copied;
+					equal++;
+				}
+			}
+			if(status->bam[tr-1][se] == bs_error)
+			{
+				message_cb(1, "verify error: %02x/%02x", tr, se);
+			}
+
+			se += (unsigned char) settings->interleave;
+			if(se >= sectorCount) se -= sectorCount;
+		}
+	}
+	return equal;
+}
+
 static int copy_disk(CBM_FILE fd_cbm, imgcopy_settings *settings,
               const transfer_funcs *src, const void *src_arg,
               const transfer_funcs *dst, const void *dst_arg, unsigned char cbm_drive)
@@ -691,11 +970,15 @@ static int copy_disk(CBM_FILE fd_cbm, imgcopy_settings *settings,
 	//unsigned const char *bam_ptr;
 	unsigned char bam[BLOCKSIZE *5];
 	int bam_count;
+	int bam_read = 0;
+	char disk[40];
 	unsigned char block[BLOCKSIZE];
 	//unsigned char gcr[GCRBUFSIZE];
 	const transfer_funcs *cbm_transf = NULL;
 	imgcopy_status status;
 	const char *type_str = "*unknown*";
+	off_t filesize;
+	int resume;
 
 
 	if(settings->drive_type == cbm_dt_unknown )
@@ -910,6 +1193,14 @@ static int copy_disk(CBM_FILE fd_cbm, imgcopy_settings *settings,
 	}
 
 
+	// only resume if there is something to resume
+	resume = settings->resume && !dst->is_cbm_drive;
+	if(resume && arch_filesize((const char *) dst_arg, &filesize) != 0)
+	{
+		message_cb(1, "no image to resume, copying all sectors");
+		resume = 0;
+	}
+
 	SETSTATEDEBUG((void)0);
 	message_cb(2, "open source disk.");
 	if(src->open_disk(fd_cbm, settings, src_arg, 0,
@@ -937,7 +1228,8 @@ static int copy_disk(CBM_FILE fd_cbm, imgcopy_settings *settings,
 	//message_cb(2, "set BAM buffer (%dx%d)", MAX_TRACKS, MAX_SECTORS);
 	memset(status.bam, bs_invalid, MAX_TRACKS * MAX_SECTORS);
 
-	if(settings->bam_mode != bm_ignore)
+	// the journal of an image needs the BAM to identify the disk
+	if(settings->bam_mode != bm_ignore || !dst->is_cbm_drive)
 	{
 		//message_cb(2, "reading BAM ...");
 		st = ReadBAM(settings, src, bam, &bam_count);
@@ -946,6 +1238,10 @@ static int copy_disk(CBM_FILE fd_cbm, imgcopy_settings *settings,
 			message_cb(1, "failed to read BAM (%d), reading whole disk", st);
 			settings->bam_mode = bm_ignore;
 		}
+		else
+		{
+			bam_read = 1;
+		}
 	}
 	SETSTATEDEBUG((void)0);
 
@@ -992,8 +1288,27 @@ static int copy_disk(CBM_FILE fd_cbm, imgcopy_settings *settings,
 	}
 
 	status.settings = settings;
+	live_status = &status;
 
-	status_cb(status);
+	if(!dst->is_cbm_drive)
+	{
+		if(bam_read)
+		{
+			disk_id(settings, bam, bam_count, disk);
+		}
+		st = journal_start(&status, (const char *) dst_arg, resume,
+		                   bam_read ? disk : NULL);
+		if(st < 0)
+		{
+			dst->close_disk();
+			src->close_disk();
+			live_status = NULL;
+			return -1;
+		}
+		status.sectors_processed = st;
+	}
+
+	report_progress(&status, imgcopy_ev_start);
 
 	message_cb(2, "copying tracks %d-%d (%d sectors)",
 	        settings->start_track, settings->end_track, status.total_sectors);
@@ -1017,14 +1332,11 @@ static int copy_disk(CBM_FILE fd_cbm, imgcopy_settings *settings,
 
 				// calc count of blocks to copy
 				scnt = sectorCount;
-				if(settings->bam_mode != bm_ignore)
+				for(se = 0; se < sectorCount; se++)
 				{
-				    for(se = 0; se < sectorCount; se++)
+				    if(!NEED_SECTOR(trackmap[se]))
 				    {
-				        if(trackmap[se] != bs_must_copy)
-				        {
-				            scnt--;
-				        }
+				        scnt--;
 				    }
 				}
 				//if(tr == 77)  printf("scnt=%d\n", scnt);
@@ -1032,7 +1344,20 @@ static int copy_disk(CBM_FILE fd_cbm, imgcopy_settings *settings,
 				if(scnt > 0 && settings->warp && src->is_cbm_drive)
 				{
 				    SETSTATEDEBUG((void)0);
-				    src->send_track_map(settings, tr, trackmap, scnt);
+				    if(src->send_track_map(settings, tr, trackmap, scnt) != 0)
+				    {
+				        message_cb(0, "error while sending the track map of track %d", tr);
+				        dst->close_disk();
+				        src->close_disk();
+				        if(journal)
+				        {
+				            // keep the journal, so the copy can be resumed
+				            cbmlibmisc_journal_close(journal, 0);
+				            journal = NULL;
+				        }
+				        live_status = NULL;
+				        return -1;
+				    }
 				}
 				else
 				{
@@ -1143,7 +1468,14 @@ static int copy_disk(CBM_FILE fd_cbm, imgcopy_settings *settings,
 
 					status.track = tr;
 					status.sector= se;
-					status_cb(status);
+					status.bam[tr-1][se] = trackmap[se];
+					if(journal)
+					{
+						cbmlibmisc_journal_update(journal,
+						    &status.bam[tr-1][se] - &status.bam[0][0],
+						    trackmap[se]);
+					}
+					report_progress(&status, imgcopy_ev_sector);
 
 					if(dst->is_cbm_drive || !settings->warp)
 					{
@@ -1184,6 +1516,41 @@ static int copy_disk(CBM_FILE fd_cbm, imgcopy_settings *settings,
 		}
 		//message_cb(2, "track: %d, maxtrack=%d", tr, settings->max_tracks);
 	}
+
+	if(settings->verify && dst->is_cbm_drive && cnt > 0)
+	{
+		message_cb(2, "verifying %d sectors", cnt);
+		st = 0;
+		if(cbm_transf->needs_turbo)
+		{
+			// replace the write program with the checksum program
+			dst->close_disk();
+			SETSTATEDEBUG((void)0);
+			st = send_sum_turbo(settings, fd_cbm, cbm_drive);
+			if(st == 0)
+			{
+				st = dst->open_disk(fd_cbm, settings, dst_arg, 1,
+				                    start_turbo, message_cb);
+			}
+			if(st)
+			{
+				message_cb(1, "can't verify destination");
+			}
+		}
+		if(st == 0)
+		{
+			st = compare_disk(&status, src, dst);
+			if(st != cnt)
+			{
+				message_cb(1, "verify: %d sectors differ", cnt - st);
+			}
+			cnt = st;
+		}
+	}
+
+	report_progress(&status, imgcopy_ev_done);
+	live_status = NULL;
+
 	message_cb(2, "finished imagecopy.");
 
 	SETSTATEDEBUG(debugLibImgBlockCount=-1);
@@ -1193,6 +1560,13 @@ static int copy_disk(CBM_FILE fd_cbm, imgcopy_settings *settings,
 	SETSTATEDEBUG((void)0);
 	src->close_disk();
 
+	if(journal)
+	{
+		// keep the journal if there are sectors left to retry
+		cbmlibmisc_journal_close(journal, copy_complete(&status));
+		journal = NULL;
+	}
+
 	SETSTATEDEBUG((void)0);
 	return cnt;
 }
@@ -1387,6 +1761,21 @@ int imgcopy_write_image(CBM_FILE cbm_fd,
 	        src, (void*)src_image, dst, (void*)(ULONG_PTR)dst_drive, (unsigned char) dst_drive);
 }
 
+void imgcopy_set_event_cb(imgcopy_event_cb cb, void *arg)
+{
+	event_cb = cb;
+	event_arg = arg;
+}
+
+const char *imgcopy_get_bam(int track)
+{
+	if(live_status == NULL || track < 1 || track > MAX_TRACKS + 1)
+	{
+		return NULL;
+	}
+	return live_status->bam[track-1];
+}
+
 void imgcopy_cleanup(void)
 {
     /* if we were interrupted writing to the fs, make sure to
@@ -1398,4 +1787,11 @@ void imgcopy_cleanup(void)
         atom_dst->close_disk();
         atom_mustcleanup = 0;
     }
+
+    /* keep the journal, so the copy can be resumed */
+    if (journal)
+    {
+        cbmlibmisc_journal_close(journal, 0);
+        journal = NULL;
+    }
 }
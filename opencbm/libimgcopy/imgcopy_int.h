@@ -18,6 +18,7 @@
 #include "gcr.h"
 
 #include "arch.h"
+#include "journal.h"
 
 
 /*
@@ -89,6 +90,9 @@
 
 
 
+// size of the sector checksum sent by the turbo checksum programs
+#define SUMSIZE      2
+
 #define NEED_SECTOR(b) ((((b)==bs_error)||((b)==bs_must_copy))?1:0)
 
 #ifdef LIBD82COPY_DEBUG
@@ -116,6 +120,7 @@ typedef struct {
     int  needs_turbo;
     int  (*send_track_map)(imgcopy_settings*,unsigned char,const char*,unsigned char);
     int  (*read_gcr_block)(unsigned char*,unsigned char*);
+    int  (*read_sum)(unsigned char,unsigned char,unsigned char*);
 } transfer_funcs;
 
 
@@ -225,6 +230,7 @@ typedef struct
                         c, \
                         t, \
                         NULL, \
+                        NULL, \
                         NULL}
 
 #define DECLARE_TRANSFER_FUNCS_EX(x,c,t) \
@@ -235,6 +241,7 @@ typedef struct
                         c, \
                         t, \
                         send_track_map, \
-                        read_gcr_block}
+                        read_gcr_block, \
+                        read_sum}
 
 #endif
@@ -159,6 +159,36 @@ static int read_block(unsigned char tr, unsigned char se, unsigned char *block)
     return status[1];
 }
 
+/*
+ * like read_block(), but the turbo checksum program only sends the checksum.
+ * Single bytes are sent twice, see read_block().
+ */
+static int read_sum(unsigned char tr, unsigned char se, unsigned char *sum)
+{
+    unsigned char status[2];
+    unsigned char pair[2];
+    int i;
+                                                                        SETSTATEDEBUG((void)0);
+
+    status[0] = tr; status[1] = se;
+    write_n(status, 2);
+
+#ifndef USE_CBM_IEC_WAIT    
+    arch_usleep(20000);
+#endif
+                                                                        SETSTATEDEBUG((void)0);
+    read_n(status, 2);
+
+    for(i = 0; i < SUMSIZE; i++)
+    {
+        read_n(pair, 2);
+        sum[i] = pair[1];
+    }
+                                                                        SETSTATEDEBUG((void)0);
+
+    return status[1];
+}
+
 static int write_block(unsigned char tr, unsigned char se, const unsigned char *blk, int size, int read_status)
 {
     int i = 0;
@@ -202,9 +232,9 @@ static int open_disk(CBM_FILE fd, imgcopy_settings *settings,
     fd_cbm    = fd;
     two_sided = settings->two_sided;
 
-    opencbm_plugin_pp_dc_read_n = cbm_get_plugin_function_address("opencbm_plugin_pp_dc_read_n");
+    opencbm_plugin_pp_dc_read_n = cbm_get_plugin_function_address_ex(fd, "opencbm_plugin_pp_dc_read_n");
 
-    opencbm_plugin_pp_dc_write_n = cbm_get_plugin_function_address("opencbm_plugin_pp_dc_write_n");
+    opencbm_plugin_pp_dc_write_n = cbm_get_plugin_function_address_ex(fd, "opencbm_plugin_pp_dc_write_n");
 
     if(settings->drive_type != cbm_dt_cbm1541)
     {
@@ -256,10 +286,13 @@ static void close_disk(void)
 static int send_track_map(imgcopy_settings *settings, unsigned char tr, const char *trackmap, unsigned char count)
 {
     int i, size;
-    unsigned char *data;
+    unsigned char data[2+2*MAX_SECTORS];
 
     size = imgcopy_sector_count(settings, tr);
-    data = malloc(2+2*size);
+    if(size < 0 || size > MAX_SECTORS)
+    {
+        return -1;
+    }
 
     data[0] = tr;
     data[1] = count;
@@ -269,7 +302,6 @@ static int send_track_map(imgcopy_settings *settings, unsigned char tr, const ch
 	data[2+2*i] = data[2+2*i+1] = !NEED_SECTOR(trackmap[i]);
     
     write_n(data, 2*size+2);
-    free(data);
                                                                         SETSTATEDEBUG((void)0);
     return 0;
 }
@@ -186,6 +186,29 @@ static int read_block(unsigned char tr, unsigned char se, unsigned char *block)
     return status;
 }
 
+/* like read_block(), but the turbo checksum program only sends the checksum */
+static int read_sum(unsigned char tr, unsigned char se, unsigned char *sum)
+{
+    unsigned char status;
+
+                                                                        SETSTATEDEBUG((void)0);
+    write_n(&tr, 1);
+                                                                        SETSTATEDEBUG((void)0);
+    write_n(&se, 1);
+                                                                        SETSTATEDEBUG((void)0);
+#ifndef USE_CBM_IEC_WAIT    
+    arch_usleep(20000);
+#endif    
+                                                                        SETSTATEDEBUG((void)0);
+    read_n(&status, 1);
+                                                                        SETSTATEDEBUG((void)0);
+    read_n(sum, SUMSIZE);
+                                                                        SETSTATEDEBUG((void)0);
+    cbm_iec_release(fd_cbm, IEC_DATA);
+                                                                        SETSTATEDEBUG((void)0);
+    return status;
+}
+
 static int write_block(unsigned char tr, unsigned char se, const unsigned char *blk, int size, int read_status)
 {
     unsigned char status;
@@ -222,9 +245,9 @@ static int open_disk(CBM_FILE fd, imgcopy_settings *settings,
     fd_cbm = fd;
     two_sided = settings->two_sided;
 
-    opencbm_plugin_s1_read_n = cbm_get_plugin_function_address("opencbm_plugin_s1_read_n");
+    opencbm_plugin_s1_read_n = cbm_get_plugin_function_address_ex(fd, "opencbm_plugin_s1_read_n");
 
-    opencbm_plugin_s1_write_n = cbm_get_plugin_function_address("opencbm_plugin_s1_write_n");
+    opencbm_plugin_s1_write_n = cbm_get_plugin_function_address_ex(fd, "opencbm_plugin_s1_write_n");
 
                                                                         SETSTATEDEBUG((void)0);
 	switch(settings->drive_type)
@@ -278,10 +301,13 @@ static void close_disk(void)
 static int send_track_map(imgcopy_settings *settings, unsigned char tr, const char *trackmap, unsigned char count)
 {
     int i, size;
-    unsigned char *data;
+    unsigned char data[2+MAX_SECTORS];
                                                                         SETSTATEDEBUG((void)0);
     size = imgcopy_sector_count(settings, tr);
-    data = malloc(size+2);
+    if(size < 0 || size > MAX_SECTORS)
+    {
+        return -1;
+    }
 
     data[0] = tr;
     data[1] = count;
@@ -291,7 +317,6 @@ static int send_track_map(imgcopy_settings *settings, unsigned char tr, const ch
 	data[2+i] = !NEED_SECTOR(trackmap[i]);
                                                                         SETSTATEDEBUG((void)0);
     write_n(data, size+2);
-    free(data);
                                                                         SETSTATEDEBUG((void)0);
     return 0;
 }
@@ -164,6 +164,27 @@ static int read_block(unsigned char tr, unsigned char se, unsigned char *block)
     return status;
 }
 
+/* like read_block(), but the turbo checksum program only sends the checksum */
+static int read_sum(unsigned char tr, unsigned char se, unsigned char *sum)
+{
+    unsigned char status;
+
+                                                                        SETSTATEDEBUG((void)0);
+    write_n(&tr, 1);
+                                                                        SETSTATEDEBUG((void)0);
+    write_n(&se, 1);
+#ifndef USE_CBM_IEC_WAIT
+    arch_usleep(20000);
+#endif
+                                                                        SETSTATEDEBUG((void)0);
+    read_n(&status, 1);
+                                                                        SETSTATEDEBUG((void)0);
+    read_n(sum, SUMSIZE);
+                                                                        SETSTATEDEBUG((void)0);
+
+    return status;
+}
+
 static int write_block(unsigned char tr, unsigned char se, const unsigned char *blk, int size, int read_status)
 {
     unsigned char status;
@@ -194,9 +215,9 @@ static int open_disk(CBM_FILE fd, imgcopy_settings *settings,
     fd_cbm = fd;
     two_sided = settings->two_sided;
 
-    opencbm_plugin_s2_read_n = cbm_get_plugin_function_address("opencbm_plugin_s2_read_n");
+    opencbm_plugin_s2_read_n = cbm_get_plugin_function_address_ex(fd, "opencbm_plugin_s2_read_n");
 
-    opencbm_plugin_s2_write_n = cbm_get_plugin_function_address("opencbm_plugin_s2_write_n");
+    opencbm_plugin_s2_write_n = cbm_get_plugin_function_address_ex(fd, "opencbm_plugin_s2_write_n");
 
                                                                         SETSTATEDEBUG((void)0);
     switch(settings->drive_type)
@@ -262,11 +283,14 @@ static int send_track_map(imgcopy_settings *settings, unsigned char tr, const ch
 {
     int i;
     int size;
-    unsigned char *data;
+    unsigned char data[2+MAX_SECTORS];
 
                                                                         SETSTATEDEBUG((void)0);
     size = imgcopy_sector_count(settings, tr);
-    data = malloc(2+size);
+    if(size < 0 || size > MAX_SECTORS)
+    {
+        return -1;
+    }
 
     data[0] = tr;
     data[1] = count;
@@ -276,7 +300,6 @@ static int send_track_map(imgcopy_settings *settings, unsigned char tr, const ch
         data[2+i] = !NEED_SECTOR(trackmap[i]);
     
     write_n(data, size+2);
-    free(data);
                                                                         SETSTATEDEBUG((void)0);
     return 0;
 }
@@ -110,6 +110,21 @@ static int read_block(unsigned char tr, unsigned char se, unsigned char *block)
     return status;
 }
 
+/* like read_block(), but the turbo checksum program only sends the checksum */
+static int read_sum(unsigned char tr, unsigned char se, unsigned char *sum)
+{
+    unsigned char status;
+    unsigned char buf[2];
+
+    buf[0] = tr;
+    buf[1] = se;
+    write_n(buf, 2);
+
+    read_n(&status, 1);
+    read_n(sum, SUMSIZE);
+    return status;
+}
+
 static int write_block(unsigned char tr, unsigned char se, const unsigned char *blk, int size, int read_status)
 {
     unsigned char status;
@@ -139,8 +154,8 @@ static int open_disk(CBM_FILE fd, imgcopy_settings *settings,
     fd_cbm = fd;
     two_sided = settings->two_sided;
 
-    opencbm_plugin_s3_read_n = cbm_get_plugin_function_address("opencbm_plugin_s3_read_n");
-    opencbm_plugin_s3_write_n = cbm_get_plugin_function_address("opencbm_plugin_s3_write_n");
+    opencbm_plugin_s3_read_n = cbm_get_plugin_function_address_ex(fd, "opencbm_plugin_s3_read_n");
+    opencbm_plugin_s3_write_n = cbm_get_plugin_function_address_ex(fd, "opencbm_plugin_s3_write_n");
 
     switch(settings->drive_type)
     {
@@ -195,14 +210,17 @@ static void close_disk(void)
 static int send_track_map(imgcopy_settings *settings, unsigned char tr, const char *trackmap, unsigned char count)
 {
     int i, size;
-    unsigned char *data;
+    unsigned char data[2+MAX_SECTORS];
 
 #ifdef DEBUG
     printf("s3_send_trackmap() \n");
 #endif
 
     size = imgcopy_sector_count(settings, tr);
-    data = malloc(size+2);
+    if(size < 0 || size > MAX_SECTORS)
+    {
+        return -1;
+    }
 
     data[0] = tr;
     data[1] = count;
@@ -212,7 +230,6 @@ static int send_track_map(imgcopy_settings *settings, unsigned char tr, const ch
     data[2+i] = !NEED_SECTOR(trackmap[i]);
 
     write_n(data, size+2);
-    free(data);
     return 0;
 }
 
@@ -101,6 +101,10 @@ SOURCE=.\getpluginaddress.c
 # End Source File
 # Begin Source File
 
+SOURCE=..\journal.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\libstring.c
 # End Source File
 # Begin Source File
@@ -137,6 +141,10 @@ SOURCE=..\getpluginaddress.h
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\include\journal.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\include\libmisc.h
 # End Source File
 # End Group
@@ -0,0 +1,253 @@
+/*
+ *      This program is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU General Public License
+ *      as published by the Free Software Foundation; either version
+ *      2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 The OpenCBM project
+ *
+*/
+
+/*! **************************************************************
+** \file libmisc/journal.c \n
+** \author The OpenCBM project \n
+** \n
+** \brief Sidecar journals for resuming interrupted disk copies
+**
+** While a disk is copied into an image, the copy tools keep the
+** state of every sector (their sector map) in a journal file next
+** to the image, named like the image with ".journal" appended.
+** If the copy is interrupted, the journal tells which sectors
+** do not need to be read again.
+**
+** The file starts with a header line, followed by a line with the
+** id given by the caller, which describes the layout of the map,
+** and a line which identifies the disk being copied (for example,
+** its disk ID and a checksum of its BAM). The map itself follows
+** as it is.
+**
+****************************************************************/
+
+#include "arch.h"
+#include "journal.h"
+#include "libmisc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*! the first line of every journal */
+#define JOURNAL_HEADER "OpenCBM journal 2\n"
+
+/*! appended to the name of the image */
+#define JOURNAL_SUFFIX ".journal"
+
+/*! \brief An open journal */
+struct cbmlibmisc_journal_s
+{
+    FILE *File;     /*!< the journal file */
+    char *Name;     /*!< the name of the journal file */
+    long MapOffset; /*!< the file position of the map */
+};
+
+/*! \brief Read the journal of an image
+
+ \param ImageName
+   The name of the image the journal belongs to.
+
+ \param Id
+   A string which identifies the layout of the map. The journal
+   is only used if it has been created with the same Id.
+
+ \param DiskId
+   A string which identifies the disk being copied. The journal
+   is only used if it has been created with the same DiskId.
+
+ \param Map
+   Pointer to a buffer which gets the map.
+
+ \param Size
+   The size of the map.
+
+ \return
+   0 if the map has been read, 1 if there is no journal,
+   -1 if the journal does not match or cannot be read, -2 if
+   the journal has been written for another disk. If the
+   return value is not 0, the contents of Map are undefined.
+*/
+int
+cbmlibmisc_journal_load(const char *ImageName, const char *Id,
+                        const char *DiskId, void *Map, size_t Size)
+{
+    char *name;
+    char *header;
+    size_t header_length;
+    size_t disk_length;
+    FILE *file;
+    int ret = -1;
+
+    name = cbmlibmisc_strcat(ImageName, JOURNAL_SUFFIX);
+    if (name == NULL)
+    {
+        return -1;
+    }
+
+    file = fopen(name, "rb");
+    cbmlibmisc_strfree(name);
+    if (file == NULL)
+    {
+        return 1;
+    }
+
+    header_length = strlen(JOURNAL_HEADER) + strlen(Id) + 1;
+    disk_length = strlen(DiskId) + 1;
+    header = malloc(header_length > disk_length ? header_length : disk_length);
+
+    if (header != NULL
+        && fread(header, header_length, 1, file) == 1
+        && memcmp(header, JOURNAL_HEADER, strlen(JOURNAL_HEADER)) == 0
+        && memcmp(header + strlen(JOURNAL_HEADER), Id, strlen(Id)) == 0
+        && header[header_length - 1] == '\n')
+    {
+        if (fread(header, disk_length, 1, file) != 1
+            || memcmp(header, DiskId, strlen(DiskId)) != 0
+            || header[disk_length - 1] != '\n')
+        {
+            ret = -2;
+        }
+        else if (fread(Map, Size, 1, file) == 1)
+        {
+            ret = 0;
+        }
+    }
+
+    free(header);
+    fclose(file);
+    return ret;
+}
+
+/*! \brief Create the journal of an image
+
+ If there is a journal already, it is overwritten.
+
+ \param ImageName
+   The name of the image the journal belongs to.
+
+ \param Id
+   A string which identifies the layout of the map.
+   It must not contain a newline.
+
+ \param DiskId
+   A string which identifies the disk being copied.
+   It must not contain a newline.
+
+ \param Map
+   Pointer to the initial map.
+
+ \param Size
+   The size of the map.
+
+ \return
+   The journal, or NULL if it could not be created.
+*/
+cbmlibmisc_journal *
+cbmlibmisc_journal_create(const char *ImageName, const char *Id,
+                          const char *DiskId, const void *Map, size_t Size)
+{
+    cbmlibmisc_journal *journal;
+
+    journal = calloc(1, sizeof(*journal));
+    if (journal == NULL)
+    {
+        return NULL;
+    }
+
+    do {
+        journal->Name = cbmlibmisc_strcat(ImageName, JOURNAL_SUFFIX);
+        if (journal->Name == NULL)
+        {
+            break;
+        }
+
+        journal->File = fopen(journal->Name, "w+b");
+        if (journal->File == NULL)
+        {
+            break;
+        }
+
+        if (fputs(JOURNAL_HEADER, journal->File) == EOF
+            || fputs(Id, journal->File) == EOF
+            || fputc('\n', journal->File) == EOF
+            || fputs(DiskId, journal->File) == EOF
+            || fputc('\n', journal->File) == EOF)
+        {
+            break;
+        }
+
+        journal->MapOffset = ftell(journal->File);
+
+        if (fwrite(Map, Size, 1, journal->File) != 1
+            || fflush(journal->File) != 0)
+        {
+            break;
+        }
+
+        return journal;
+
+    } while (0);
+
+    if (journal->File)
+    {
+        fclose(journal->File);
+        arch_unlink(journal->Name);
+    }
+    cbmlibmisc_strfree(journal->Name);
+    free(journal);
+    return NULL;
+}
+
+/*! \brief Change one byte of the map in a journal
+
+ The change is handed to the operating system immediately, so it
+ survives if the program is killed.
+
+ \param Journal
+   The journal, as returned by cbmlibmisc_journal_create().
+
+ \param Offset
+   The position of the byte in the map.
+
+ \param Value
+   The new value.
+*/
+void
+cbmlibmisc_journal_update(cbmlibmisc_journal *Journal,
+                          size_t Offset, char Value)
+{
+    if (fseek(Journal->File, Journal->MapOffset + (long) Offset, SEEK_SET) == 0)
+    {
+        fputc(Value, Journal->File);
+        fflush(Journal->File);
+    }
+}
+
+/*! \brief Close a journal
+
+ \param Journal
+   The journal, as returned by cbmlibmisc_journal_create().
+
+ \param Remove
+   If not 0, the journal file is removed; use this when the copy
+   has been completed, so there is nothing to resume.
+*/
+void
+cbmlibmisc_journal_close(cbmlibmisc_journal *Journal, int Remove)
+{
+    fclose(Journal->File);
+    if (Remove)
+    {
+        arch_unlink(Journal->Name);
+    }
+    cbmlibmisc_strfree(Journal->Name);
+    free(Journal);
+}
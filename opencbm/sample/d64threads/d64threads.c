@@ -0,0 +1,224 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version
+ *  2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 The OpenCBM project
+ */
+
+/*! **************************************************************
+** \file sample/d64threads/d64threads.c \n
+** \author The OpenCBM project \n
+** \n
+** \brief Run several d64copy contexts at the same time
+**
+****************************************************************/
+
+#include "opencbm.h"
+#include "d64copy.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arch.h"
+
+/*! number of blocks of a 35 track image */
+#define IMAGE_BLOCKS 683
+
+/*! size of a 35 track image without an error map */
+#define IMAGE_SIZE (IMAGE_BLOCKS * 256)
+
+/*! default number of threads */
+#define DEFAULT_THREADS 4
+
+/*! maximum number of threads */
+#define MAX_THREADS 64
+
+/*! what one thread does */
+typedef struct
+{
+    int number;
+    ARCH_THREAD thread;
+    char src_name[32];
+    char dst_name[32];
+    int copied;
+    int result;
+} copy_job;
+
+/*! \brief Print the errors of the copies
+
+ The callback gets no context, so the messages of all threads
+ go here. Only errors are shown.
+*/
+static void
+message_cb(int severity, const char *format, ...)
+{
+    va_list args;
+
+    if (severity == sev_fatal)
+    {
+        va_start(args, format);
+        fputs("d64threads: ", stderr);
+        vfprintf(stderr, format, args);
+        fputs("\n", stderr);
+        va_end(args);
+    }
+}
+
+/*! \brief Nothing to report while copying */
+static int
+status_cb(d64copy_status status)
+{
+    (void) status;
+    return 0;
+}
+
+/*! \brief Fill an image with a pattern only this thread uses */
+static unsigned char
+pattern(int number, long offset)
+{
+    return (unsigned char) (offset * 7 + (offset >> 8) * 13 + number * 101);
+}
+
+/*! \brief Write the source image of a job */
+static int
+write_source(copy_job *job)
+{
+    FILE *f;
+    long i;
+    int ret = 0;
+
+    f = fopen(job->src_name, "wb");
+    if (f == NULL)
+    {
+        return 1;
+    }
+    for (i = 0; i < IMAGE_SIZE && ret == 0; i++)
+    {
+        ret = putc(pattern(job->number, i), f) == EOF;
+    }
+    return fclose(f) != 0 || ret;
+}
+
+/*! \brief Compare the destination image of a job with its pattern */
+static int
+compare_destination(copy_job *job)
+{
+    FILE *f;
+    long i;
+    int c;
+    int ret = 0;
+
+    f = fopen(job->dst_name, "rb");
+    if (f == NULL)
+    {
+        return 1;
+    }
+    for (i = 0; i < IMAGE_SIZE && ret == 0; i++)
+    {
+        c = getc(f);
+        ret = c == EOF || (unsigned char) c != pattern(job->number, i);
+    }
+    if (ret == 0 && getc(f) != EOF)
+    {
+        /* the error map must be gone after a copy without errors */
+        ret = 1;
+    }
+    fclose(f);
+    return ret;
+}
+
+/*! \brief Copy one image with a context of its own, then compare */
+static void
+copy_thread(void *context)
+{
+    copy_job *job = context;
+    d64copy_context *ctx;
+    d64copy_settings *settings;
+
+    job->result = 1;
+
+    ctx = d64copy_create_context();
+    settings = d64copy_get_default_settings();
+    if (ctx != NULL && settings != NULL)
+    {
+        settings->error_mode = em_never;
+        job->copied = d64copy_copy_image_ctx(ctx, settings,
+            job->src_name, job->dst_name, message_cb, status_cb);
+        if (job->copied == IMAGE_BLOCKS)
+        {
+            job->result = compare_destination(job);
+        }
+    }
+    free(settings);
+    if (ctx != NULL)
+    {
+        d64copy_free_context(ctx);
+    }
+}
+
+int ARCH_MAINDECL
+main(int argc, char *argv[])
+{
+    copy_job jobs[MAX_THREADS];
+    int threads = DEFAULT_THREADS;
+    int i;
+    int ret = 0;
+
+    if (argc > 2 || (argc == 2 &&
+        ((threads = atoi(argv[1])) <= 0 || threads > MAX_THREADS)))
+    {
+        fprintf(stderr, "Usage: %s [threads]\n\n"
+            "Copy one %d block image per thread, default %d, at the same\n"
+            "time, each one with a d64copy context of its own, and compare\n"
+            "the copies with the originals. No drive is needed; the images\n"
+            "are written to the current directory and removed afterwards.\n",
+            argv[0], IMAGE_BLOCKS, DEFAULT_THREADS);
+        return 1;
+    }
+
+    memset(jobs, 0, sizeof(jobs));
+    for (i = 0; i < threads; i++)
+    {
+        jobs[i].number = i;
+        sprintf(jobs[i].src_name, "d64threads-%d-src.d64", i);
+        sprintf(jobs[i].dst_name, "d64threads-%d-dst.d64", i);
+        remove(jobs[i].dst_name);
+        if (write_source(&jobs[i]))
+        {
+            fprintf(stderr, "d64threads: could not write %s\n",
+                jobs[i].src_name);
+            threads = i + 1;
+            ret = 1;
+            break;
+        }
+    }
+
+    for (i = 0; i < threads && ret == 0; i++)
+    {
+        jobs[i].thread = arch_thread_create(copy_thread, &jobs[i]);
+        if (jobs[i].thread == NULL)
+        {
+            fprintf(stderr, "d64threads: could not start thread %d\n", i);
+            ret = 1;
+        }
+    }
+
+    for (i = 0; i < threads; i++)
+    {
+        if (jobs[i].thread != NULL)
+        {
+            arch_thread_join(jobs[i].thread);
+            printf("thread %2d: %d blocks copied, %s\n", i, jobs[i].copied,
+                jobs[i].result ? "MISMATCH" : "ok");
+            ret |= jobs[i].result;
+        }
+        remove(jobs[i].src_name);
+        remove(jobs[i].dst_name);
+    }
+
+    return ret;
+}
@@ -0,0 +1,224 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version
+ *  2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 The OpenCBM project
+ */
+
+/*! **************************************************************
+** \file sample/gcrbench/gcrbench.c \n
+** \author The OpenCBM project \n
+** \n
+** \brief Compare and measure the GCR kernels of libopencbm
+**
+****************************************************************/
+
+#include "opencbm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "arch.h"
+
+/*! number of data blocks converted per round */
+#define BENCH_BLOCKS 683
+
+/*! default number of rounds */
+#define BENCH_ROUNDS 200
+
+/*! check_short() tries 1 to this many groups */
+#define SHORT_GROUPS 8
+
+static unsigned char gcr[BENCH_BLOCKS * GCR_BLOCK_GCRSIZE];
+static unsigned char plain[BENCH_BLOCKS * GCR_BLOCK_GROUPS * 4];
+static unsigned char reference[BENCH_BLOCKS * GCR_BLOCK_GROUPS * 4];
+static unsigned char errors[BENCH_BLOCKS * GCR_BLOCK_GROUPS * 4];
+static unsigned char reference_errors[BENCH_BLOCKS * GCR_BLOCK_GROUPS * 4];
+static unsigned char encoded[BENCH_BLOCKS * GCR_BLOCK_GCRSIZE];
+
+/*! \brief Convert a number of bytes in a time into MB/s */
+static double
+mb_per_second(double bytes, clock_t ticks)
+{
+    if (ticks <= 0)
+    {
+        ticks = 1;
+    }
+    return bytes / (1024.0 * 1024.0) / ((double) ticks / CLOCKS_PER_SEC);
+}
+
+/*! \brief Check a kernel with a few groups
+
+ Kernels may convert several groups at once and leave the rest
+ to others; check that they do not touch bytes after the buffers.
+*/
+static int
+check_short(const char *name)
+{
+    unsigned char in[SHORT_GROUPS * 5 + 16];
+    unsigned char out[SHORT_GROUPS * 5 + 16];
+    unsigned char expected[SHORT_GROUPS * 5 + 16];
+    size_t groups;
+
+    for (groups = 1; groups <= SHORT_GROUPS; groups++)
+    {
+        memcpy(in, gcr, groups * 5);
+
+        gcr_select_kernel("quintet");
+        memset(expected, 0xaa, sizeof(expected));
+        gcr_5_to_4_decode_groups(in, expected, groups, NULL);
+
+        gcr_select_kernel(name);
+        memset(out, 0xaa, sizeof(out));
+        gcr_5_to_4_decode_groups(in, out, groups, NULL);
+        if (memcmp(out, expected, sizeof(out)) != 0)
+        {
+            return 1;
+        }
+
+        gcr_select_kernel("quintet");
+        memset(expected, 0xaa, sizeof(expected));
+        gcr_4_to_5_encode_groups(in, expected, groups);
+
+        gcr_select_kernel(name);
+        memset(out, 0xaa, sizeof(out));
+        gcr_4_to_5_encode_groups(in, out, groups);
+        if (memcmp(out, expected, sizeof(out)) != 0)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*! \brief Check that all kernels give the same results
+
+ The input contains random data, so it has a lot of illegal
+ GCR codes, too.
+*/
+static int
+check_kernels(void)
+{
+    const size_t groups = BENCH_BLOCKS * GCR_BLOCK_GROUPS;
+    const char *name;
+    unsigned int k;
+    int illegal, reference_illegal = 0;
+    size_t i;
+    int ret = 0;
+
+    for (i = 0; i < sizeof(gcr); i++)
+    {
+        gcr[i] = (unsigned char) rand();
+    }
+
+    for (k = 0; (name = gcr_kernel_name(k)) != NULL; k++)
+    {
+        gcr_select_kernel(name);
+
+        memset(errors, 0, sizeof(errors));
+        illegal = gcr_5_to_4_decode_groups(gcr, plain, groups, errors);
+
+        if (k == 0)
+        {
+            memcpy(reference, plain, sizeof(plain));
+            memcpy(reference_errors, errors, sizeof(errors));
+            reference_illegal = illegal;
+        }
+        else if (memcmp(reference, plain, sizeof(plain)) != 0
+            || memcmp(reference_errors, errors, sizeof(errors)) != 0
+            || reference_illegal != illegal)
+        {
+            fprintf(stderr, "kernel %s: decoding differs from %s\n",
+                name, gcr_kernel_name(0));
+            ret = 1;
+        }
+
+        gcr_4_to_5_encode_groups(reference, encoded, groups);
+        gcr_5_to_4_decode_groups(encoded, plain, groups, NULL);
+        if (memcmp(reference, plain, sizeof(plain)) != 0)
+        {
+            fprintf(stderr, "kernel %s: encoding does not round-trip\n", name);
+            ret = 1;
+        }
+
+        if (check_short(name))
+        {
+            fprintf(stderr, "kernel %s: short buffers are not converted "
+                "correctly\n", name);
+            ret = 1;
+        }
+    }
+
+    gcr_select_kernel(NULL);
+    return ret;
+}
+
+/*! \brief Measure one kernel */
+static void
+bench_kernel(const char *name, int rounds)
+{
+    const size_t groups = BENCH_BLOCKS * GCR_BLOCK_GROUPS;
+    clock_t start, decode_ticks, encode_ticks;
+    int i;
+
+    gcr_select_kernel(name);
+
+    /* decode valid GCR data, as it comes from a disk */
+    gcr_4_to_5_encode_groups(reference, encoded, groups);
+
+    start = clock();
+    for (i = 0; i < rounds; i++)
+    {
+        gcr_5_to_4_decode_groups(encoded, plain, groups, errors);
+    }
+    decode_ticks = clock() - start;
+
+    start = clock();
+    for (i = 0; i < rounds; i++)
+    {
+        gcr_4_to_5_encode_groups(plain, encoded, groups);
+    }
+    encode_ticks = clock() - start;
+
+    printf("%-10s decode %8.1f MB/s   encode %8.1f MB/s\n", name,
+        mb_per_second((double) rounds * sizeof(gcr), decode_ticks),
+        mb_per_second((double) rounds * sizeof(gcr), encode_ticks));
+}
+
+int ARCH_MAINDECL
+main(int argc, char *argv[])
+{
+    const char *name;
+    unsigned int k;
+    int rounds = BENCH_ROUNDS;
+
+    if (argc > 2 || (argc == 2 && (rounds = atoi(argv[1])) <= 0))
+    {
+        fprintf(stderr, "Usage: %s [rounds]\n\n"
+            "Convert %d GCR blocks (one 1541 disk) \"rounds\" times with\n"
+            "every GCR kernel of libopencbm which runs on this CPU, default\n"
+            "%d. Speeds are given in MB of GCR data per second. The first\n"
+            "kernel is the one libopencbm uses by default.\n",
+            argv[0], BENCH_BLOCKS, BENCH_ROUNDS);
+        return 1;
+    }
+
+    srand(1541);
+
+    if (check_kernels())
+    {
+        return 1;
+    }
+
+    for (k = 0; (name = gcr_kernel_name(k)) != NULL; k++)
+    {
+        bench_kernel(name, rounds);
+    }
+
+    gcr_select_kernel(NULL);
+    return 0;
+}
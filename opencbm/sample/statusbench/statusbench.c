@@ -0,0 +1,147 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version
+ *  2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 The OpenCBM project
+ */
+
+/*! **************************************************************
+** \file sample/statusbench/statusbench.c \n
+** \author The OpenCBM project \n
+** \n
+** \brief Measure how many small bus transactions per second an adapter does
+**
+****************************************************************/
+
+#include "opencbm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arch.h"
+
+/*! default number of operations per measurement */
+#define BENCH_OPS 500
+
+/*! \brief Print the number of operations per second since start */
+static void
+print_result(const char *name, int ops, unsigned long start)
+{
+    unsigned long ms;
+
+    ms = arch_time_ms() - start;
+    printf("%-18s %6d ops in %5lu ms, %8.1f ops/s\n",
+        name, ops, ms, ops * 1000.0 / (ms ? ms : 1));
+}
+
+/*! \brief Read the status of a drive again and again
+
+ \return
+   0 if all reads succeeded, 1 otherwise.
+*/
+static int
+bench_status(CBM_FILE fd, unsigned char drive, int ops)
+{
+    char buf[48];
+    unsigned long start;
+    int i;
+
+    start = arch_time_ms();
+    for (i = 0; i < ops; i++)
+    {
+        if (cbm_device_status(fd, drive, buf, sizeof(buf)) == 99)
+        {
+            fprintf(stderr, "statusbench: no status from drive %d: %s\n",
+                drive, buf);
+            return 1;
+        }
+    }
+    print_result("cbm_device_status:", ops, start);
+    return 0;
+}
+
+/*! \brief Send a command and read its answer again and again
+
+ "M-R" of one byte of the drive's zero page is used, as it does not
+ touch the disk. The answer is read over the command channel, as with
+ cbm_identify().
+
+ \return
+   0 if all commands succeeded, 1 otherwise.
+*/
+static int
+bench_command(CBM_FILE fd, unsigned char drive, int ops)
+{
+    static const unsigned char command[] = { 'M', '-', 'R', 0x00, 0x00, 0x01 };
+    char buf[48];
+    unsigned long start;
+    int i;
+
+    start = arch_time_ms();
+    for (i = 0; i < ops; i++)
+    {
+        if (cbm_exec_command(fd, drive, command, sizeof(command)) != 0
+            || cbm_talk(fd, drive, 15) != 0
+            || cbm_raw_read(fd, buf, 1) != 1)
+        {
+            cbm_untalk(fd);
+            fprintf(stderr, "statusbench: \"M-R\" failed on drive %d\n", drive);
+            return 1;
+        }
+        cbm_untalk(fd);
+    }
+    print_result("cbm_exec_command:", ops, start);
+    return 0;
+}
+
+int ARCH_MAINDECL
+main(int argc, char *argv[])
+{
+    CBM_FILE fd;
+    char *adapter = NULL;
+    unsigned char drive = 8;
+    int ops = BENCH_OPS;
+    int arg = 1;
+    int ret;
+
+    if (argc > arg + 1 && strcmp(argv[arg], "-@") == 0)
+    {
+        adapter = argv[arg + 1];
+        arg += 2;
+    }
+    if (argc > arg + 2 || (argc > arg && (atoi(argv[arg]) < 4 || atoi(argv[arg]) > 30))
+        || (argc == arg + 2 && (ops = atoi(argv[arg + 1])) <= 0))
+    {
+        fprintf(stderr, "Usage: %s [-@ adapter] [drive [ops]]\n\n"
+            "Measure how many status reads and small commands per second\n"
+            "drive (default 8) and the adapter do, with ops (default %d)\n"
+            "operations each. To compare the xum1541 with and without the\n"
+            "single round trip requests, run it once with version 7 and once\n"
+            "with version 8 firmware.\n",
+            argv[0], BENCH_OPS);
+        return 1;
+    }
+    if (argc > arg)
+    {
+        drive = (unsigned char) atoi(argv[arg]);
+    }
+
+    if (cbm_driver_open_ex(&fd, adapter) != 0)
+    {
+        fprintf(stderr, "statusbench: could not open the driver\n");
+        return 1;
+    }
+
+    ret = bench_status(fd, drive, ops);
+    if (ret == 0)
+    {
+        ret = bench_command(fd, drive, ops);
+    }
+
+    cbm_driver_close(fd);
+
+    return ret;
+}
@@ -23,6 +23,13 @@ typedef void (*Write2Fn_t)(uint8_t *data);
 static uint16_t usbDataLen;
 static uint8_t usbDataDir = XUM_DATA_DIR_NONE;
 
+/*
+ * If set, usbSendByte()/usbRecvByte() use this buffer instead of the
+ * bulk endpoints. This lets a command run the protocol handlers on
+ * data of its own, see deviceStatus().
+ */
+static uint8_t *localIoPtr;
+
 // Are we in the middle of a command sequence (XUM1541_INIT .. SHUTDOWN)?
 #define XUM1541_CMD_IN_PROGRESS 0x80
 static uint8_t cmdSeqInProgress;
@@ -87,6 +94,12 @@ usbInitIo(uint16_t len, uint8_t dir)
         DEBUGF(DBG_ERROR, "ERR: usbInitIo left in bad state %d\n", usbDataDir);
 #endif
 
+    if (localIoPtr != NULL) {
+        usbDataLen = len;
+        usbDataDir = dir;
+        return;
+    }
+
     // Select the proper endpoint for this direction
     if (dir == ENDPOINT_DIR_IN) {
         Endpoint_SelectEndpoint(XUM_BULK_IN_ENDPOINT);
@@ -114,7 +127,9 @@ void
 usbIoDone(void)
 {
     // Finalize any outstanding transactions
-    if (usbDataDir == ENDPOINT_DIR_IN) {
+    if (localIoPtr != NULL) {
+        // Nothing to do for the local buffer
+    } else if (usbDataDir == ENDPOINT_DIR_IN) {
         /*
          * If the transfer left an incomplete endpoint (mod endpoint size)
          * or possibly never transferred any data (error or timeout case),
@@ -157,6 +172,12 @@ usbSendByte(uint8_t data)
     }
 #endif
 
+    if (localIoPtr != NULL) {
+        *localIoPtr++ = data;
+        usbDataLen--;
+        return doDeviceReset ? -1 : 0;
+    }
+
     // Write data back to the host buffer for USB transfer
     Endpoint_Write_Byte(data);
     usbDataLen--;
@@ -188,6 +209,12 @@ usbRecvByte(uint8_t *data)
     }
 #endif
 
+    if (localIoPtr != NULL) {
+        *data = *localIoPtr++;
+        usbDataLen--;
+        return doDeviceReset ? -1 : 0;
+    }
+
     /*
      * Check if the endpoint is currently empty.
      * If so, clear the endpoint bank to get more data from host and
@@ -654,6 +681,44 @@ usbHandleControl(uint8_t cmd, uint8_t *replyBuf)
 // Store the 16-bit response to a bulk command in a status buffer.
 #define XUM_SET_STATUS_VAL(buf, v)  *(uint16_t *)((buf) + 1) = (v)
 
+/*
+ * Read the error channel of a device and send the status followed by
+ * the bytes read to the host, in one packet. The protocol handlers
+ * take their bytes from and put them into a local buffer meanwhile.
+ */
+static int8_t
+deviceStatus(uint8_t device, uint16_t len)
+{
+    uint8_t buf[XUM_STATUSBUF_SIZE + XUM_DEVSTATUS_MAX];
+    uint8_t status;
+    uint16_t count;
+
+    if (len > XUM_DEVSTATUS_MAX)
+        len = XUM_DEVSTATUS_MAX;
+
+    // Without a talker, report an error to the host
+    status = XUM1541_IO_ERROR;
+    count = 0;
+    buf[0] = 0x40 | device;
+    buf[1] = 0x6f;
+    localIoPtr = buf;
+    if (cmds->cbm_raw_write(2, XUM_WRITE_ATN | XUM_WRITE_TALK) == 2) {
+        localIoPtr = &buf[XUM_STATUSBUF_SIZE];
+        count = cmds->cbm_raw_read(len);
+
+        buf[0] = 0x5f;
+        localIoPtr = buf;
+        cmds->cbm_raw_write(1, XUM_WRITE_ATN);
+        status = XUM1541_IO_READY;
+    }
+    localIoPtr = NULL;
+
+    buf[0] = status;
+    XUM_SET_STATUS_VAL(buf, count);
+    USB_WriteBlock(buf, XUM_STATUSBUF_SIZE + count);
+    return 0;
+}
+
 int8_t
 usbHandleBulk(uint8_t *request, uint8_t *status)
 {
@@ -710,6 +775,10 @@ usbHandleBulk(uint8_t *request, uint8_t *status)
             ioReadLoop(nib_parburst_read_checked, len);
             ret = 0;
             break;
+        case XUM1541_SEQ:
+            seq_run(len, ENDPOINT_DIR_IN);
+            ret = 0;
+            break;
 #ifdef SRQ_NIB_SUPPORT
         case XUM1541_NIB_SRQ:
             ioReadNibSrqLoop(len);
@@ -770,6 +839,13 @@ usbHandleBulk(uint8_t *request, uint8_t *status)
             ioWriteLoop(nib_parburst_write_checked, len);
             ret = 0;
             break;
+        case XUM1541_SEQ_LOAD:
+            XUM_SET_STATUS_VAL(status, seq_load(len));
+            break;
+        case XUM1541_SEQ:
+            seq_run(len, ENDPOINT_DIR_OUT);
+            ret = 0;
+            break;
 #ifdef SRQ_NIB_SUPPORT
         case XUM1541_NIB_SRQ:
             ioWriteNibSrqLoop(len);
@@ -794,6 +870,16 @@ usbHandleBulk(uint8_t *request, uint8_t *status)
         }
         break;
 
+    case XUM1541_DEVICE_STATUS:
+        // Only for drives, not in tape mode
+        if ((currState & XUM1541_TAPE_PRESENT) != 0) {
+            ret = -1;
+            break;
+        }
+        DEBUGF(DBG_INFO, "st:%d %d\n", request[1], len);
+        ret = deviceStatus(request[1], len);
+        break;
+
     /* Low-level port access */
     case XUM1541_GET_EOI:
         XUM_SET_STATUS_VAL(status, eoi ? 1 : 0);
@@ -317,7 +317,13 @@ USB_ReadBlock(uint8_t *buf, uint8_t len)
     if (doDeviceReset)
         return false;
 
-    Endpoint_ClearOUT();
+    /*
+     * Release the bank unless the host sent more than we read. With
+     * XUM1541_CAP_FRAMED, that is write data following the command
+     * block, which the command handler reads via usbRecvByte().
+     */
+    if (!Endpoint_IsReadWriteAllowed())
+        Endpoint_ClearOUT();
     return true;
 }
 
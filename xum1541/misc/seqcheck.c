@@ -0,0 +1,416 @@
+/*
+ * Host-side check of the IEC micro-sequence engine
+ * Copyright (c) 2026 The OpenCBM project
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version
+ * 2 of the License, or (at your option) any later version.
+ */
+
+/*
+ * Runs seq.c on the host against a model of the drive side of the s1
+ * protocol (gbyte and sbyte in opencbm/libd64copy/s1.a65), with the
+ * programs libd64copy loads (opencbm/libd64copy/s1seq.h). Both programs
+ * are loaded once, then the bytes are moved in the order of a d64copy
+ * block read and write.
+ *
+ * The drive either reacts to every line change of the firmware at once
+ * or only when the firmware waits, which are the two extremes of the
+ * timing on real hardware.
+ *
+ * Build and run it with "make seqcheck".
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xum1541_types.h"
+#include "s1seq.h"
+
+// Stand-ins for xum1541.h and the board header, so seq.c builds here
+#define _XUM1541_H
+#define IO_DATA             0x01
+#define IO_CLK              0x02
+#define IO_ATN              0x04
+#define ENDPOINT_DIR_OUT    0x00
+#define ENDPOINT_DIR_IN     0x80
+#define DEBUGF(level, format, args...)
+#define DELAY_US(us)        drive_run()
+
+// Give up waiting after this many TimerWorker() calls without progress
+#define STALL_LIMIT         100000
+
+static uint8_t hostLines, driveLines;
+static bool eager, hostWaits;
+static long idle;
+
+// Bytes from and to the host, see usbRecvByte() and usbSendByte()
+static const uint8_t *usbIn;
+static uint16_t usbInLen;
+static uint8_t *usbOut;
+static uint16_t usbOutLen;
+
+static void drive_run(void);
+
+static uint8_t
+iec_get(uint8_t line)
+{
+    return ((hostLines | driveLines) & line) != 0;
+}
+
+static void
+iec_set(uint8_t line)
+{
+    hostLines |= line;
+    if (eager)
+        drive_run();
+}
+
+static void
+iec_release(uint8_t line)
+{
+    hostLines &= ~line;
+    if (eager)
+        drive_run();
+}
+
+static uint8_t
+iec_pp_read(void)
+{
+    return 0;
+}
+
+static void
+iec_pp_write(uint8_t val)
+{
+    (void)val;
+}
+
+bool
+TimerWorker(void)
+{
+    hostWaits = true;
+    drive_run();
+    hostWaits = false;
+    return ++idle < STALL_LIMIT;
+}
+
+void
+usbInitIo(uint16_t len, uint8_t dir)
+{
+    (void)len;
+    (void)dir;
+}
+
+void
+usbIoDone(void)
+{
+}
+
+int8_t
+usbRecvByte(uint8_t *data)
+{
+    if (usbInLen == 0)
+        return -1;
+    *data = *usbIn++;
+    usbInLen--;
+    return 0;
+}
+
+int8_t
+usbSendByte(uint8_t data)
+{
+    if (usbOutLen == 0)
+        return -1;
+    *usbOut++ = data;
+    usbOutLen--;
+    return 0;
+}
+
+uint16_t seq_load(uint16_t len);
+void seq_run(uint16_t len, uint8_t dir);
+
+#include "seq.c"
+
+/*
+ * The drive. It runs a list of jobs, each receiving (gbyte) or sending
+ * (sbyte) a number of bytes. Every state is a loop of s1.a65 which
+ * waits for the firmware.
+ */
+enum drive_state {
+    DRIVE_IDLE,
+    DRIVE_BUSY,
+    DRIVE_NEXT_BIT,
+    RECV_WAIT_CLK_RELEASED,     // read1
+    RECV_WAIT_DATA_TOGGLED,     // read2
+    RECV_WAIT_CLK_SET,          // read3
+    SEND_WAIT_DATA_SET,         // write1
+    SEND_WAIT_DATA_RELEASED,    // write3
+    SEND_WAIT_CLK_SET,          // write4
+};
+
+struct drive_job {
+    bool send;
+    uint8_t *data;
+    int len;
+};
+
+static struct drive_job *job;
+static enum drive_state state;
+static int pos, bits;
+static uint8_t tmp, sample;
+
+static void
+drive_start(struct drive_job *jobs)
+{
+    job = jobs;
+    pos = bits = 0;
+    state = job->len != 0 ? DRIVE_NEXT_BIT : DRIVE_IDLE;
+}
+
+static void
+drive_run(void)
+{
+    for (;;) {
+        switch (state) {
+        case DRIVE_IDLE:
+            return;
+        case DRIVE_BUSY:
+            /*
+             * Between the jobs, the drive reads or writes a sector. This
+             * takes far longer than the firmware needs to finish the
+             * last byte, so it only ends while the firmware waits.
+             */
+            if (!hostWaits)
+                return;
+            state = DRIVE_NEXT_BIT;
+            break;
+        case DRIVE_NEXT_BIT:
+            if (bits == 0 && pos == job->len) {
+                job++;
+                pos = 0;
+                state = job->len != 0 ? DRIVE_BUSY : DRIVE_IDLE;
+                break;
+            }
+            if (bits == 0) {
+                bits = 8;
+                tmp = job->send ? job->data[pos] : 0;
+            }
+            if (job->send) {
+                // LSB first, the bit goes out on CLK
+                driveLines = (tmp & 1) ? IO_CLK : 0;
+                sample = driveLines;
+                tmp >>= 1;
+                state = SEND_WAIT_DATA_SET;
+            } else {
+                state = RECV_WAIT_CLK_RELEASED;
+            }
+            break;
+        case RECV_WAIT_CLK_RELEASED:
+            if (iec_get(IO_CLK))
+                return;
+            // MSB first, the bit comes in on DATA
+            driveLines = 0;
+            sample = iec_get(IO_DATA);
+            tmp = (tmp << 1) | sample;
+            driveLines = IO_CLK;
+            state = RECV_WAIT_DATA_TOGGLED;
+            break;
+        case RECV_WAIT_DATA_TOGGLED:
+            if (iec_get(IO_DATA) == sample)
+                return;
+            driveLines = 0;
+            state = RECV_WAIT_CLK_SET;
+            break;
+        case RECV_WAIT_CLK_SET:
+            if (!iec_get(IO_CLK))
+                return;
+            driveLines = IO_DATA;
+            if (--bits == 0)
+                job->data[pos++] = tmp;
+            state = DRIVE_NEXT_BIT;
+            break;
+        case SEND_WAIT_DATA_SET:
+            if (!iec_get(IO_DATA))
+                return;
+            driveLines = sample ^ IO_CLK;
+            state = SEND_WAIT_DATA_RELEASED;
+            break;
+        case SEND_WAIT_DATA_RELEASED:
+            if (iec_get(IO_DATA))
+                return;
+            driveLines = IO_DATA;
+            state = SEND_WAIT_CLK_SET;
+            break;
+        case SEND_WAIT_CLK_SET:
+            if (!iec_get(IO_CLK))
+                return;
+            if (--bits == 0)
+                pos++;
+            state = DRIVE_NEXT_BIT;
+            break;
+        }
+        idle = 0;
+    }
+}
+
+static bool
+load(const uint8_t *prog, uint16_t len)
+{
+    usbIn = prog;
+    usbInLen = len;
+    return seq_load(len) == len;
+}
+
+static bool
+host_write(const uint8_t *data, uint16_t len)
+{
+    usbIn = data;
+    usbInLen = len;
+    seq_run(len, ENDPOINT_DIR_OUT);
+    return usbInLen == 0;
+}
+
+static bool
+host_read(uint8_t *data, uint16_t len)
+{
+    usbOut = data;
+    usbOutLen = len;
+    seq_run(len, ENDPOINT_DIR_IN);
+    return usbOutLen == 0;
+}
+
+// Move the bytes of one d64copy block read and one block write
+static int
+check_s1(bool eagerDrive)
+{
+    uint8_t ts[2] = { 18, 1 }, status[1] = { 0 }, block[256];
+    uint8_t driveTs[2], driveBlock[256], hostStatus[2], hostBlock[256];
+    struct drive_job jobs[] = {
+        { false, driveTs, 2 },
+        { true, status, 1 },
+        { true, block, 256 },
+        { false, driveBlock, 256 },
+        { true, status, 1 },
+        { false, NULL, 0 },
+    };
+    int i;
+
+    for (i = 0; i < 256; i++)
+        block[i] = (uint8_t)(i * 37 + 11);
+    memset(driveBlock, 0, sizeof(driveBlock));
+    memset(hostBlock, 0, sizeof(hostBlock));
+
+    eager = eagerDrive;
+    idle = 0;
+    hostLines = IO_CLK;
+    driveLines = IO_DATA;
+    drive_start(jobs);
+
+    // Like libd64copy, load each program once, before the first block
+    if (!load(s1_seq_write, sizeof(s1_seq_write)) ||
+        !load(s1_seq_read, sizeof(s1_seq_read))) {
+        printf("s1: seq_load rejects a program\n");
+        return 1;
+    }
+
+    if (!host_write(ts, 2) ||
+        !host_read(&hostStatus[0], 1) || !host_read(hostBlock, 256) ||
+        !host_write(hostBlock, 256) ||
+        !host_read(&hostStatus[1], 1)) {
+        printf("s1 (%s drive): transfer stalled\n", eager ? "eager" : "lazy");
+        return 1;
+    }
+    drive_run();
+
+    if (state != DRIVE_IDLE || memcmp(driveTs, ts, 2) != 0 ||
+        hostStatus[0] != 0 || hostStatus[1] != 0 ||
+        memcmp(hostBlock, block, 256) != 0 ||
+        memcmp(driveBlock, block, 256) != 0) {
+        printf("s1 (%s drive): data differs\n", eager ? "eager" : "lazy");
+        return 1;
+    }
+    return 0;
+}
+
+// Programs seq_load() must refuse
+static int
+check_rejects(void)
+{
+    static const uint8_t zeroRepeat[] = {
+        XUM_SEQ_RECV, XUM_SEQ_REPEAT, 0, XUM_SEQ_NEXT, XUM_SEQ_END };
+    static const uint8_t nested[] = {
+        XUM_SEQ_RECV, XUM_SEQ_REPEAT, 2, XUM_SEQ_REPEAT, 2,
+        XUM_SEQ_NEXT, XUM_SEQ_NEXT, XUM_SEQ_END };
+    static const uint8_t unpaired[] = {
+        XUM_SEQ_RECV, XUM_SEQ_NEXT, XUM_SEQ_END };
+    static const uint8_t noEnd[] = { XUM_SEQ_RECV, XUM_SEQ_DELAY, 2 };
+    static const uint8_t badOp[] = { XUM_SEQ_RECV, 0xe0, XUM_SEQ_END };
+    static const uint8_t noData[] = { XUM_SEQ_SHIFT, XUM_SEQ_END };
+    static const uint8_t bothWays[] = {
+        XUM_SEQ_RECV, XUM_SEQ_SEND, XUM_SEQ_END };
+    uint8_t tooLong[XUM_SEQ_MAX_SIZE + 1];
+    int ret = 0;
+
+    memset(tooLong, XUM_SEQ_SHIFT, sizeof(tooLong));
+    tooLong[0] = XUM_SEQ_RECV;
+    tooLong[sizeof(tooLong) - 1] = XUM_SEQ_END;
+
+    if (load(zeroRepeat, sizeof(zeroRepeat)) ||
+        load(nested, sizeof(nested)) ||
+        load(unpaired, sizeof(unpaired)) ||
+        load(noEnd, sizeof(noEnd)) ||
+        load(badOp, sizeof(badOp)) ||
+        load(noData, sizeof(noData)) ||
+        load(bothWays, sizeof(bothWays)) ||
+        load(tooLong, sizeof(tooLong))) {
+        printf("seq_load accepts a broken program\n");
+        ret = 1;
+    }
+    return ret;
+}
+
+// opencbm-plugin.h promises the firmware's encoding
+static int
+check_encoding(void)
+{
+    static const uint8_t host[] = {
+        IEC_SEQ_DATA, IEC_SEQ_CLOCK, IEC_SEQ_ATN, IEC_SEQ_INV,
+        IEC_SEQ_END, IEC_SEQ_SET, IEC_SEQ_RELEASE, IEC_SEQ_WAIT_SET,
+        IEC_SEQ_WAIT_RELEASE, IEC_SEQ_PUT_BIT7, IEC_SEQ_PUT_BIT0,
+        IEC_SEQ_GET, IEC_SEQ_WAIT_BIT7, IEC_SEQ_SHIFT, IEC_SEQ_DELAY,
+        IEC_SEQ_REPEAT, IEC_SEQ_NEXT, IEC_SEQ_RECV, IEC_SEQ_SEND,
+        IEC_SEQ_PP_READ, IEC_SEQ_PP_WRITE, IEC_SEQ_MAX_SIZE };
+    static const uint8_t firmware[] = {
+        XUM_SEQ_DATA, XUM_SEQ_CLK, XUM_SEQ_ATN, XUM_SEQ_INV,
+        XUM_SEQ_END, XUM_SEQ_SET, XUM_SEQ_RELEASE, XUM_SEQ_WAIT_SET,
+        XUM_SEQ_WAIT_RELEASE, XUM_SEQ_PUT_BIT7, XUM_SEQ_PUT_BIT0,
+        XUM_SEQ_GET, XUM_SEQ_WAIT_BIT7, XUM_SEQ_SHIFT, XUM_SEQ_DELAY,
+        XUM_SEQ_REPEAT, XUM_SEQ_NEXT, XUM_SEQ_RECV, XUM_SEQ_SEND,
+        XUM_SEQ_PP_READ, XUM_SEQ_PP_WRITE, XUM_SEQ_MAX_SIZE };
+
+    if (sizeof(host) != sizeof(firmware) ||
+        memcmp(host, firmware, sizeof(host)) != 0) {
+        printf("IEC_SEQ_* and XUM_SEQ_* differ\n");
+        return 1;
+    }
+    return 0;
+}
+
+int
+main(void)
+{
+    int ret;
+
+    ret = check_encoding();
+    ret |= check_rejects();
+    ret |= check_s1(true);
+    ret |= check_s1(false);
+
+    printf("seqcheck: %s\n", ret ? "FAILED" : "ok");
+    return ret;
+}
@@ -0,0 +1,234 @@
+/*
+ * IEC micro-sequence engine
+ * Copyright (c) 2026 The OpenCBM project
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version
+ * 2 of the License, or (at your option) any later version.
+ */
+
+/*
+ * Runs small host-supplied programs of IEC line operations. The host
+ * compiles a byte-wise transfer protocol (set, release, wait, sample, ...)
+ * into a program with XUM1541_SEQ_LOAD and then moves a whole block with
+ * one XUM1541_SEQ read or write. See xum1541_types.h for the opcodes.
+ *
+ * One program is kept per direction: the one with RECV runs for writes,
+ * the one with SEND for reads. The host loads both once per transfer.
+ */
+
+#include "xum1541.h"
+
+// [0]: write (ENDPOINT_DIR_OUT), [1]: read (ENDPOINT_DIR_IN)
+static uint8_t seqProg[2][XUM_SEQ_MAX_SIZE];
+static uint8_t seqLen[2];
+
+// Convert the XUM_SEQ_* line bits of an opcode to the board's IO_* bits
+static uint8_t
+seq_hw(uint8_t op)
+{
+    uint8_t hw = 0;
+
+    if ((op & XUM_SEQ_DATA) != 0)
+        hw |= IO_DATA;
+    if ((op & XUM_SEQ_CLK) != 0)
+        hw |= IO_CLK;
+    if ((op & XUM_SEQ_ATN) != 0)
+        hw |= IO_ATN;
+    return hw;
+}
+
+// Returns true if any of the given lines is set (pulled low)
+static bool
+seq_get(uint8_t op)
+{
+    if ((op & XUM_SEQ_DATA) != 0 && iec_get(IO_DATA))
+        return true;
+    if ((op & XUM_SEQ_CLK) != 0 && iec_get(IO_CLK))
+        return true;
+    if ((op & XUM_SEQ_ATN) != 0 && iec_get(IO_ATN))
+        return true;
+    return false;
+}
+
+/*
+ * Wait until the lines in "op" reach the requested state. Returns false
+ * if we were aborted by the host or timed out.
+ */
+static bool
+seq_wait(uint8_t op, bool set)
+{
+    while (seq_get(op) != set) {
+        if (!TimerWorker())
+            return false;
+    }
+    return true;
+}
+
+// Store a program. Returns its length or 0 if it was rejected.
+uint16_t
+seq_load(uint16_t len)
+{
+    uint8_t prog[XUM_SEQ_MAX_SIZE];
+    uint8_t i, op, depth, slot;
+    bool recv, send;
+    uint8_t data;
+    uint16_t count;
+
+    usbInitIo(len, ENDPOINT_DIR_OUT);
+    for (count = 0; count < len; count++) {
+        if (usbRecvByte(&data) != 0)
+            break;
+        if (count < sizeof(prog))
+            prog[count] = data;
+    }
+    usbIoDone();
+    if (count != len || len > sizeof(prog))
+        return 0;
+
+    /*
+     * Check operands and REPEAT/NEXT pairing once so seq_run() doesn't
+     * have to, and find the direction of the program
+     */
+    depth = 0;
+    recv = send = false;
+    for (i = 0; i < len; i++) {
+        op = prog[i] & 0xf0;
+        if (op == XUM_SEQ_DELAY || op == XUM_SEQ_REPEAT) {
+            if (++i == len)
+                return 0;
+            if (op == XUM_SEQ_REPEAT && (depth++ != 0 || prog[i] == 0))
+                return 0;
+        } else if (op == XUM_SEQ_NEXT) {
+            if (depth-- == 0)
+                return 0;
+        } else if (op == XUM_SEQ_END) {
+            break;
+        } else if (op > XUM_SEQ_NEXT && prog[i] > XUM_SEQ_PP_WRITE) {
+            return 0;
+        } else if (prog[i] == XUM_SEQ_RECV) {
+            recv = true;
+        } else if (prog[i] == XUM_SEQ_SEND) {
+            send = true;
+        }
+    }
+    // A program must move data, in one direction only
+    if (depth != 0 || i == len || recv == send)
+        return 0;
+
+    slot = send ? 1 : 0;
+    memcpy(seqProg[slot], prog, len);
+    seqLen[slot] = len;
+    DEBUGF(DBG_INFO, "seqld %d %d\n", slot, len);
+    return len;
+}
+
+/*
+ * Run the program of direction "dir" once per data unit until "len" bytes
+ * were moved.
+ * For ENDPOINT_DIR_OUT, RECV fetches bytes from the host, for
+ * ENDPOINT_DIR_IN, SEND returns them.
+ */
+void
+seq_run(uint16_t len, uint8_t dir)
+{
+    const uint8_t *prog;
+    uint8_t pc, op, data, loopPc, loopCount, slot;
+    bool moved, bit;
+
+    slot = dir == ENDPOINT_DIR_IN ? 1 : 0;
+    prog = seqProg[slot];
+    usbInitIo(len, dir);
+    data = 0;
+    while (seqLen[slot] != 0 && len != 0) {
+        moved = false;
+        loopPc = loopCount = 0;
+        for (pc = 0; (op = prog[pc]) != XUM_SEQ_END; pc++) {
+            switch (op & 0xf0) {
+            case XUM_SEQ_SET:
+                iec_set(seq_hw(op));
+                break;
+            case XUM_SEQ_RELEASE:
+                iec_release(seq_hw(op));
+                break;
+            case XUM_SEQ_WAIT_SET:
+                if (!seq_wait(op, true))
+                    goto done;
+                break;
+            case XUM_SEQ_WAIT_RELEASE:
+                if (!seq_wait(op, false))
+                    goto done;
+                break;
+            case XUM_SEQ_PUT_BIT7:
+            case XUM_SEQ_PUT_BIT0:
+                bit = (data & ((op & 0xf0) == XUM_SEQ_PUT_BIT7 ? 0x80 : 0x01))
+                    != 0;
+                if (bit != ((op & XUM_SEQ_INV) != 0))
+                    iec_set(seq_hw(op));
+                else
+                    iec_release(seq_hw(op));
+                break;
+            case XUM_SEQ_GET:
+                bit = seq_get(op) != ((op & XUM_SEQ_INV) != 0);
+                data = (data >> 1) | (bit ? 0x80 : 0);
+                break;
+            case XUM_SEQ_WAIT_BIT7:
+                bit = ((data & 0x80) != 0) != ((op & XUM_SEQ_INV) != 0);
+                if (!seq_wait(op, !bit))
+                    goto done;
+                break;
+            case XUM_SEQ_SHIFT:
+                if ((op & XUM_SEQ_INV) != 0)
+                    data >>= 1;
+                else
+                    data <<= 1;
+                break;
+            case XUM_SEQ_DELAY:
+                for (op = prog[++pc]; op != 0; op--)
+                    DELAY_US(1);
+                break;
+            case XUM_SEQ_REPEAT:
+                loopCount = prog[++pc];
+                loopPc = pc;
+                break;
+            case XUM_SEQ_NEXT:
+                if (--loopCount != 0)
+                    pc = loopPc;
+                break;
+            default:
+                switch (op) {
+                case XUM_SEQ_RECV:
+                    if (dir != ENDPOINT_DIR_OUT || len == 0 ||
+                        usbRecvByte(&data) != 0)
+                        goto done;
+                    len--;
+                    moved = true;
+                    break;
+                case XUM_SEQ_SEND:
+                    if (dir != ENDPOINT_DIR_IN || len == 0 ||
+                        usbSendByte(data) != 0)
+                        goto done;
+                    len--;
+                    moved = true;
+                    break;
+                case XUM_SEQ_PP_READ:
+                    data = iec_pp_read();
+                    break;
+                case XUM_SEQ_PP_WRITE:
+                    iec_pp_write(data);
+                    break;
+                }
+            }
+        }
+
+        // A program that moves no data would never terminate
+        if (!moved) {
+            DEBUGF(DBG_ERROR, "seq: no data\n");
+            break;
+        }
+    }
+
+done:
+    usbIoDone();
+}
@@ -197,6 +197,7 @@ struct ProtocolFunctions *ieee_init(void);
  * p2 - parallel
  * pp - parallel
  * nib - nibbler parallel
+ * seq - host-supplied IEC micro-sequence
  * Tape - 153x tape
  */
 uint8_t s1_read_byte(void);
@@ -207,6 +208,8 @@ uint8_t p2_read_byte(void);
 void p2_write_byte(uint8_t c);
 void pp_read_2_bytes(uint8_t *c);
 void pp_write_2_bytes(uint8_t *c);
+uint16_t seq_load(uint16_t len);
+void seq_run(uint16_t len, uint8_t dir);
 uint8_t nib_parburst_read(void);
 int8_t nib_read_handshaked(uint8_t *c, uint8_t toggle);
 void nib_parburst_write(uint8_t data);
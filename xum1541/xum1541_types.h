@@ -15,7 +15,10 @@
 #define XUM1541_PID                 0x0504
 
 // XUM1541_INIT reports this versions
-#define XUM1541_VERSION             7
+#define XUM1541_VERSION             8
+
+// Oldest firmware version the host side still works with
+#define XUM1541_VERSION_MIN         7
 
 // USB parameters for descriptor configuration
 #define XUM_BULK_IN_ENDPOINT        3
@@ -44,10 +47,21 @@
 #else
 #define XUM1541_CAP_TAP             0
 #endif
+#define XUM1541_CAP_SEQ             0x20 // IEC micro-sequence engine
+#define XUM1541_CAP_FRAMED          0x40 // write data may follow command block
+#define XUM1541_CAP_STATUS          0x80 // XUM1541_DEVICE_STATUS
+
+// Capabilities which only firmware version 8 and later reports
+#define XUM1541_CAP_VERSION_8       (XUM1541_CAP_SEQ |      \
+                                     XUM1541_CAP_FRAMED |   \
+                                     XUM1541_CAP_STATUS)
 
 #define XUM1541_CAPABILITIES        (XUM1541_CAP_CBM |      \
                                      XUM1541_CAP_NIB |      \
                                      XUM1541_CAP_TAP |      \
+                                     XUM1541_CAP_SEQ |      \
+                                     XUM1541_CAP_FRAMED |   \
+                                     XUM1541_CAP_STATUS |   \
                                      XUM1541_CAP_IEEE488)
 
 // Actual auto-detected status
@@ -74,6 +88,17 @@
 #define XUM1541_READ                8
 #define XUM1541_WRITE               (XUM1541_READ + 1)
 
+/*
+ * Read the error channel of a device: talk, read until EOI, untalk.
+ * The device address is in the mode byte of the command block, the
+ * maximum number of bytes to read in its length. The response is a
+ * status buffer (XUM1541_IO_READY and the number of bytes read, or
+ * XUM1541_IO_ERROR if the device did not talk) followed by the bytes,
+ * all in one packet.
+ */
+#define XUM1541_DEVICE_STATUS       (XUM1541_READ + 2)
+#define XUM_DEVSTATUS_MAX           48
+
 /*
  * Maximum size for USB transfers (read/write commands, all protocols).
  * This should be ok for the raw USB protocol. I haven't tested this much
@@ -147,11 +172,54 @@
 #define XUM1541_NIB_SRQ_COMMAND     (9 << 4) // Serial commands
 #define XUM1541_TAP                (10 << 4) // tape read/write
 #define XUM1541_TAP_CONFIG         (11 << 4) // tape send/receive configuration
+#define XUM1541_SEQ_LOAD           (12 << 4) // upload IEC micro-sequence (write)
+#define XUM1541_SEQ                (13 << 4) // run IEC micro-sequence (r/w)
 
 // Flags for use with write and XUM1541_CBM protocol
 #define XUM_WRITE_TALK              (1 << 0)
 #define XUM_WRITE_ATN               (1 << 1)
 
+/*
+ * IEC micro-sequence programs for XUM1541_SEQ_LOAD/XUM1541_SEQ.
+ *
+ * A program is a short list of line operations the firmware runs once per
+ * data unit, so a custom transfer protocol moves a whole block in a single
+ * bulk transaction instead of one USB round trip per line change. Each
+ * opcode is one byte: the upper nibble is the operation and the lower
+ * nibble a set of IEC lines (XUM_SEQ_DATA etc.) plus XUM_SEQ_INV, which
+ * inverts the sense of the test or bit. DELAY and REPEAT take one operand
+ * byte. The program works on a one-byte shift register that is filled by
+ * RECV/GET/PP_READ and drained by SEND/PUT/PP_WRITE; a pass that neither
+ * receives nor sends a byte is an error. The firmware keeps one program per
+ * direction: one with RECV runs for XUM1541_SEQ writes, one with SEND for
+ * reads, and a program with both or neither is rejected.
+ */
+#define XUM_SEQ_MAX_SIZE            32
+
+#define XUM_SEQ_DATA                0x01
+#define XUM_SEQ_CLK                 0x02
+#define XUM_SEQ_ATN                 0x04
+#define XUM_SEQ_INV                 0x08
+#define XUM_SEQ_LINES(x)            ((x) & 0x07)
+
+#define XUM_SEQ_END                 0x00 // end of one pass
+#define XUM_SEQ_SET                 0x10 // set lines
+#define XUM_SEQ_RELEASE             0x20 // release lines
+#define XUM_SEQ_WAIT_SET            0x30 // wait until any line is set
+#define XUM_SEQ_WAIT_RELEASE        0x40 // wait until all lines released
+#define XUM_SEQ_PUT_BIT7            0x50 // set lines if bit 7 (^INV), else release
+#define XUM_SEQ_PUT_BIT0            0x60 // set lines if bit 0 (^INV), else release
+#define XUM_SEQ_GET                 0x70 // shift right, bit 7 = line set (^INV)
+#define XUM_SEQ_WAIT_BIT7           0x80 // wait until line state != bit 7 (^INV)
+#define XUM_SEQ_SHIFT               0x90 // shift left, or right with INV
+#define XUM_SEQ_DELAY               0xa0 // wait <operand> us
+#define XUM_SEQ_REPEAT              0xb0 // run until NEXT <operand> times
+#define XUM_SEQ_NEXT                0xc0 // end of REPEAT body
+#define XUM_SEQ_RECV                0xd0 // load next byte from the host
+#define XUM_SEQ_SEND                0xd1 // return byte to the host
+#define XUM_SEQ_PP_READ             0xd2 // load byte from the parallel port
+#define XUM_SEQ_PP_WRITE            0xd3 // put byte on the parallel port
+
 // Request an early exit from nib read via burst_read_track_var()
 #define XUM1541_NIB_READ_VAR        0x8000
 